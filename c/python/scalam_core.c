@@ -0,0 +1,922 @@
+/*
+  Smart search for upgrade paths
+  Copyright (C) 2016 Andrew Leeming <andrew.leeming@codethink.co.uk> and
+  Bob Mottram <bob.mottram@codethink.co.uk>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Python bindings to the core, so that Python orchestration can drive
+   systems and populations directly. Scores and genes are exposed as
+   read only buffers over the memory of the core, without copying, so
+   that numpy.asarray gives arrays which follow the population as it
+   evolves. Build with make python */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <stddef.h>
+#include "../src/scalam.h"
+
+/* A buffer over memory owned by a System or Population, which is kept
+   alive for as long as the buffer is in use */
+typedef struct {
+    PyObject_HEAD
+    PyObject * owner;
+    void * data;
+    char * format;
+    int ndim;
+    Py_ssize_t itemsize;
+    Py_ssize_t shape[3];
+    Py_ssize_t strides[3];
+} ViewObject;
+
+typedef struct {
+    PyObject_HEAD
+    sc_system * sys;
+} SystemObject;
+
+typedef struct {
+    PyObject_HEAD
+    sc_population * population;
+
+    /* The system whose dependency matrix the population shares */
+    PyObject * system;
+} PopulationObject;
+
+static PyTypeObject ViewType;
+static PyTypeObject SystemType;
+static PyTypeObject PopulationType;
+
+/**
+ * @brief Returns whether a view is laid out in C order without gaps
+ * @param view The view
+ * @returns Non-zero if contiguous
+ */
+static int view_contiguous(ViewObject * view)
+{
+    Py_ssize_t stride = view->itemsize;
+    int i;
+
+    for (i = view->ndim - 1; i >= 0; i--) {
+        if ((view->shape[i] > 1) && (view->strides[i] != stride))
+            return 0;
+        stride *= view->shape[i];
+    }
+    return 1;
+}
+
+static int View_getbuffer(PyObject * self, Py_buffer * buffer, int flags)
+{
+    ViewObject * view = (ViewObject*)self;
+    Py_ssize_t i, length = view->itemsize;
+
+    buffer->obj = NULL;
+    if ((flags & PyBUF_WRITABLE) == PyBUF_WRITABLE) {
+        PyErr_SetString(PyExc_BufferError, "view is read only");
+        return -1;
+    }
+    if (((flags & PyBUF_STRIDES) != PyBUF_STRIDES) && !view_contiguous(view)) {
+        PyErr_SetString(PyExc_BufferError, "view is not contiguous");
+        return -1;
+    }
+
+    for (i = 0; i < view->ndim; i++)
+        length *= view->shape[i];
+
+    buffer->buf = view->data;
+    buffer->obj = self;
+    Py_INCREF(self);
+    buffer->len = length;
+    buffer->readonly = 1;
+    buffer->itemsize = view->itemsize;
+    buffer->format = ((flags & PyBUF_FORMAT) == PyBUF_FORMAT) ? view->format : NULL;
+    buffer->ndim = view->ndim;
+    buffer->shape = ((flags & PyBUF_ND) == PyBUF_ND) ? view->shape : NULL;
+    buffer->strides = ((flags & PyBUF_STRIDES) == PyBUF_STRIDES) ? view->strides : NULL;
+    buffer->suboffsets = NULL;
+    buffer->internal = NULL;
+    return 0;
+}
+
+static void View_dealloc(ViewObject * self)
+{
+    Py_XDECREF(self->owner);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static PyBufferProcs View_as_buffer = {
+    View_getbuffer, NULL
+};
+
+static PyTypeObject ViewType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "scalam_core.View",
+    .tp_basicsize = sizeof(ViewObject),
+    .tp_dealloc = (destructor)View_dealloc,
+    .tp_as_buffer = &View_as_buffer,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Read only buffer over memory of the core",
+};
+
+/**
+ * @brief Returns a memoryview over memory owned by a System or Population
+ * @param owner The object which owns the memory
+ * @param data Start of the memory
+ * @param format Struct format of each item, such as "i"
+ * @param itemsize Size of each item in bytes
+ * @param ndim Number of dimensions, up to three
+ * @param shape Size of each dimension
+ * @param strides Bytes between items along each dimension
+ * @returns New memoryview, or NULL on error
+ */
+static PyObject * view_create(PyObject * owner, void * data, char * format,
+                              Py_ssize_t itemsize, int ndim,
+                              Py_ssize_t * shape, Py_ssize_t * strides)
+{
+    ViewObject * view;
+    PyObject * memory;
+    int i;
+
+    view = PyObject_New(ViewObject, &ViewType);
+    if (view == NULL)
+        return NULL;
+
+    Py_INCREF(owner);
+    view->owner = owner;
+    view->data = data;
+    view->format = format;
+    view->itemsize = itemsize;
+    view->ndim = ndim;
+    for (i = 0; i < ndim; i++) {
+        view->shape[i] = shape[i];
+        view->strides[i] = strides[i];
+    }
+
+    memory = PyMemoryView_FromObject((PyObject*)view);
+    Py_DECREF(view);
+    return memory;
+}
+
+/**
+ * @brief Returns a view of one field of every program within a system.
+ *        Programs are held as an array of structures, so the view
+ *        steps over whole programs
+ */
+static PyObject * system_program_view(SystemObject * self, size_t offset,
+                                      char * format, Py_ssize_t itemsize)
+{
+    Py_ssize_t shape = self->sys->no_of_programs;
+    Py_ssize_t stride = sizeof(sc_program);
+
+    return view_create((PyObject*)self,
+                       (unsigned char*)self->sys->program + offset,
+                       format, itemsize, 1, &shape, &stride);
+}
+
+static PyObject * System_new(PyTypeObject * type, PyObject * args,
+                             PyObject * kwds)
+{
+    SystemObject * self = (SystemObject*)type->tp_alloc(type, 0);
+
+    if (self == NULL)
+        return NULL;
+
+    self->sys = (sc_system*)calloc(1, sizeof(sc_system));
+    if (self->sys == NULL) {
+        Py_DECREF(self);
+        return PyErr_NoMemory();
+    }
+    return (PyObject*)self;
+}
+
+static void System_dealloc(SystemObject * self)
+{
+    if (self->sys != NULL) {
+        system_free(self->sys);
+        free(self->sys);
+    }
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static PyObject * System_synthetic(PyTypeObject * type, PyObject * args)
+{
+    SystemObject * self;
+    int no_of_programs;
+    unsigned int random_seed = 0;
+
+    if (!PyArg_ParseTuple(args, "i|I", &no_of_programs, &random_seed))
+        return NULL;
+
+    self = (SystemObject*)System_new(type, NULL, NULL);
+    if (self == NULL)
+        return NULL;
+
+    if (synthetic_system_create(self->sys, no_of_programs, random_seed) != 0) {
+        Py_DECREF(self);
+        PyErr_SetString(PyExc_ValueError, "unable to create synthetic system");
+        return NULL;
+    }
+    return (PyObject*)self;
+}
+
+static PyObject * System_from_repos(PyTypeObject * type, PyObject * args)
+{
+    SystemObject * self;
+    char * repos_dir;
+    int retval;
+
+    if (!PyArg_ParseTuple(args, "s", &repos_dir))
+        return NULL;
+
+    self = (SystemObject*)System_new(type, NULL, NULL);
+    if (self == NULL)
+        return NULL;
+
+    Py_BEGIN_ALLOW_THREADS
+    retval = system_create_from_repos(self->sys, repos_dir);
+    Py_END_ALLOW_THREADS
+
+    if (retval != 0) {
+        Py_DECREF(self);
+        PyErr_Format(PyExc_OSError, "unable to create system from %s (%d)",
+                     repos_dir, retval);
+        return NULL;
+    }
+    return (PyObject*)self;
+}
+
+static PyObject * System_add_program(SystemObject * self, PyObject * args,
+                                     PyObject * kwds)
+{
+    static char * keywords[] = {
+        "name", "no_of_versions", "version_index", "installed",
+        "versions_file", NULL
+    };
+    char * name, * versions_file = NULL;
+    int no_of_versions, version_index = 0, installed = 0, p;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "si|ips", keywords,
+                                     &name, &no_of_versions, &version_index,
+                                     &installed, &versions_file))
+        return NULL;
+
+    if ((no_of_versions < 1) || (version_index < 0) ||
+        (version_index >= no_of_versions)) {
+        PyErr_SetString(PyExc_ValueError, "version index out of range");
+        return NULL;
+    }
+
+    if (system_program_index_from_name(self->sys, name) >= 0) {
+        PyErr_Format(PyExc_ValueError, "program %s already exists", name);
+        return NULL;
+    }
+
+    p = system_add_program(self->sys, name);
+    if (p < 0) {
+        PyErr_Format(PyExc_ValueError, "unable to add program %s (%d)", name, p);
+        return NULL;
+    }
+
+    self->sys->program[p].no_of_versions = no_of_versions;
+    self->sys->program[p].version_index = version_index;
+    self->sys->program[p].installed = (unsigned char)installed;
+    if (versions_file != NULL)
+        self->sys->program[p].versions_file = string_pool_add(versions_file);
+
+    if (state_layout_create(self->sys) != 0) {
+        PyErr_SetString(PyExc_ValueError, "unable to lay out system state");
+        return NULL;
+    }
+    return PyLong_FromLong(p);
+}
+
+static PyObject * System_restrict_versions(SystemObject * self, PyObject * args)
+{
+    sc_candidate_options options;
+    char * thinning = "all";
+
+    candidates_options_init(&options);
+    if (!PyArg_ParseTuple(args, "|si", &thinning, &options.every))
+        return NULL;
+
+    if (strcmp(thinning, "all") == 0)
+        options.thinning = SC_CANDIDATES_ALL;
+    else if (strcmp(thinning, "tags") == 0)
+        options.thinning = SC_CANDIDATES_TAGS;
+    else if (strcmp(thinning, "merges") == 0)
+        options.thinning = SC_CANDIDATES_MERGES;
+    else if (strcmp(thinning, "every") == 0)
+        options.thinning = SC_CANDIDATES_EVERY_NTH;
+    else {
+        PyErr_Format(PyExc_ValueError, "unknown thinning %s", thinning);
+        return NULL;
+    }
+
+    if (candidates_system(self->sys, &options) != 0) {
+        PyErr_SetString(PyExc_ValueError, "unable to restrict versions");
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject * System_index(SystemObject * self, PyObject * args)
+{
+    char * name;
+    int p;
+
+    if (!PyArg_ParseTuple(args, "s", &name))
+        return NULL;
+
+    p = system_program_index_from_name(self->sys, name);
+    if (p < 0) {
+        PyErr_Format(PyExc_KeyError, "%s", name);
+        return NULL;
+    }
+    return PyLong_FromLong(p);
+}
+
+static PyObject * System_name(SystemObject * self, PyObject * args)
+{
+    int p;
+
+    if (!PyArg_ParseTuple(args, "i", &p))
+        return NULL;
+
+    if ((p < 0) || (p >= self->sys->no_of_programs)) {
+        PyErr_SetString(PyExc_IndexError, "program index out of range");
+        return NULL;
+    }
+    return PyUnicode_FromString(string_pool_get(self->sys->program[p].name));
+}
+
+static PyObject * System_get_no_of_programs(SystemObject * self, void * closure)
+{
+    return PyLong_FromLong(self->sys->no_of_programs);
+}
+
+static PyObject * System_get_state_bytes(SystemObject * self, void * closure)
+{
+    return PyLong_FromLong(self->sys->state_bytes);
+}
+
+static PyObject * System_get_no_of_versions(SystemObject * self, void * closure)
+{
+    return system_program_view(self, offsetof(sc_program, no_of_versions),
+                               "i", sizeof(int));
+}
+
+static PyObject * System_get_version_index(SystemObject * self, void * closure)
+{
+    return system_program_view(self, offsetof(sc_program, version_index),
+                               "i", sizeof(int));
+}
+
+static PyObject * System_get_installed(SystemObject * self, void * closure)
+{
+    return system_program_view(self, offsetof(sc_program, installed),
+                               "B", sizeof(unsigned char));
+}
+
+static PyMethodDef System_methods[] = {
+    {"synthetic", (PyCFunction)System_synthetic, METH_VARARGS | METH_CLASS,
+     "synthetic(no_of_programs, seed=0)\nCreates a synthetic system"},
+    {"from_repos", (PyCFunction)System_from_repos, METH_VARARGS | METH_CLASS,
+     "from_repos(repos_dir)\nCreates a system from the git repos within a directory"},
+    {"add_program", (PyCFunction)System_add_program, METH_VARARGS | METH_KEYWORDS,
+     "add_program(name, no_of_versions, version_index=0, installed=False, versions_file=None)\n"
+     "Adds a program, returning its index"},
+    {"restrict_versions", (PyCFunction)System_restrict_versions, METH_VARARGS,
+     "restrict_versions(thinning='all', every=1)\n"
+     "Restricts programs to candidate versions, thinned to all, tags, merges or every"},
+    {"index", (PyCFunction)System_index, METH_VARARGS,
+     "index(name)\nReturns the index of a program"},
+    {"name", (PyCFunction)System_name, METH_VARARGS,
+     "name(index)\nReturns the name of a program"},
+    {NULL}
+};
+
+static PyGetSetDef System_getset[] = {
+    {"no_of_programs", (getter)System_get_no_of_programs, NULL,
+     "Number of programs", NULL},
+    {"state_bytes", (getter)System_get_state_bytes, NULL,
+     "Size of a packed system state in bytes", NULL},
+    {"no_of_versions", (getter)System_get_no_of_versions, NULL,
+     "View of the number of versions of each program", NULL},
+    {"version_index", (getter)System_get_version_index, NULL,
+     "View of the current version index of each program", NULL},
+    {"installed", (getter)System_get_installed, NULL,
+     "View of whether each program is installed", NULL},
+    {NULL}
+};
+
+static PyTypeObject SystemType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "scalam_core.System",
+    .tp_basicsize = sizeof(SystemObject),
+    .tp_dealloc = (destructor)System_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "A system of programs and their versions",
+    .tp_methods = System_methods,
+    .tp_getset = System_getset,
+    .tp_new = System_new,
+};
+
+/**
+ * @brief Returns the genome at an index within the current generation,
+ *        setting an exception if the index is out of range
+ */
+static sc_genome * population_genome(PopulationObject * self, int index)
+{
+    if ((index < 0) || (index >= self->population->size)) {
+        PyErr_SetString(PyExc_IndexError, "genome index out of range");
+        return NULL;
+    }
+    return self->population->individual[index];
+}
+
+static int Population_init(PopulationObject * self, PyObject * args,
+                           PyObject * kwds)
+{
+    static char * keywords[] = { "system", "size", "seed", NULL };
+    PyObject * system;
+    sc_system * sys;
+    sc_goal * goal;
+    unsigned int random_seed = 0;
+    int size, retval;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!i|I", keywords,
+                                     &SystemType, &system, &size,
+                                     &random_seed))
+        return -1;
+
+    sys = ((SystemObject*)system)->sys;
+    if ((sys->no_of_programs < 1) || (size < 2) ||
+        (size > SC_MAX_POPULATION_SIZE)) {
+        PyErr_SetString(PyExc_ValueError, "invalid system or population size");
+        return -1;
+    }
+
+    if (self->population != NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "population already created");
+        return -1;
+    }
+
+    goal = (sc_goal*)malloc(sizeof(sc_goal));
+    self->population = (sc_population*)malloc(sizeof(sc_population));
+    if ((goal == NULL) || (self->population == NULL)) {
+        free(goal);
+        free(self->population);
+        self->population = NULL;
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    retval = goal_create_latest_versions(sys, goal);
+    if (retval == 0)
+        retval = population_create_seeded(size, self->population, sys, goal,
+                                          random_seed);
+    if (retval == 0)
+        retval = population_columns_enable(self->population);
+    Py_END_ALLOW_THREADS
+
+    free(goal);
+    if (retval != 0) {
+        free(self->population);
+        self->population = NULL;
+        PyErr_Format(PyExc_ValueError, "unable to create population (%d)", retval);
+        return -1;
+    }
+
+    Py_INCREF(system);
+    self->system = system;
+    return 0;
+}
+
+static void Population_dealloc(PopulationObject * self)
+{
+    if (self->population != NULL) {
+        /* the dependency matrix belongs to the system */
+        self->population->sys.dependency_probability = NULL;
+        population_free(self->population);
+        free(self->population);
+    }
+    Py_XDECREF(self->system);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+/**
+ * @brief Checks that a population was created, setting an exception if not
+ */
+static int population_created(PopulationObject * self)
+{
+    if (self->population == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "population not created");
+        return 0;
+    }
+    return 1;
+}
+
+static PyObject * Population_next_generation(PopulationObject * self,
+                                             PyObject * unused)
+{
+    int retval;
+
+    if (!population_created(self))
+        return NULL;
+
+    Py_BEGIN_ALLOW_THREADS
+    retval = population_next_generation(self->population);
+    Py_END_ALLOW_THREADS
+
+    if (retval != 0) {
+        PyErr_Format(PyExc_RuntimeError, "unable to create next generation (%d)",
+                     retval);
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject * Population_set_test_passes(PopulationObject * self,
+                                             PyObject * args)
+{
+    int index, test_passes;
+
+    if (!population_created(self) ||
+        !PyArg_ParseTuple(args, "ii", &index, &test_passes))
+        return NULL;
+
+    if (population_genome(self, index) == NULL)
+        return NULL;
+
+    if (population_set_test_passes(self->population, index, test_passes) != 0) {
+        PyErr_SetString(PyExc_ValueError, "unable to set test passes");
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject * Population_set_partial_score(PopulationObject * self,
+                                               PyObject * args)
+{
+    int index, test_passes, steps_completed;
+
+    if (!population_created(self) ||
+        !PyArg_ParseTuple(args, "iii", &index, &test_passes, &steps_completed))
+        return NULL;
+
+    if (population_genome(self, index) == NULL)
+        return NULL;
+
+    if (population_set_partial_score(self->population, index, test_passes,
+                                     steps_completed) != 0) {
+        PyErr_SetString(PyExc_ValueError, "unable to set partial score");
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject * Population_best_index(PopulationObject * self, PyObject * unused)
+{
+    if (!population_created(self))
+        return NULL;
+    return PyLong_FromLong(population_best_index(self->population));
+}
+
+static PyObject * Population_worst_index(PopulationObject * self, PyObject * unused)
+{
+    if (!population_created(self))
+        return NULL;
+    return PyLong_FromLong(population_worst_index(self->population));
+}
+
+static PyObject * Population_best_score(PopulationObject * self, PyObject * unused)
+{
+    if (!population_created(self))
+        return NULL;
+    return PyFloat_FromDouble(population_best_score(self->population));
+}
+
+static PyObject * Population_average_score(PopulationObject * self,
+                                           PyObject * unused)
+{
+    if (!population_created(self))
+        return NULL;
+    return PyFloat_FromDouble(population_average_score(self->population));
+}
+
+static PyObject * Population_variance(PopulationObject * self, PyObject * unused)
+{
+    if (!population_created(self))
+        return NULL;
+    return PyFloat_FromDouble(population_variance(self->population));
+}
+
+static PyObject * Population_mutate(PopulationObject * self, PyObject * args)
+{
+    sc_genome * individual;
+    int index;
+
+    if (!population_created(self) || !PyArg_ParseTuple(args, "i", &index))
+        return NULL;
+
+    individual = population_genome(self, index);
+    if (individual == NULL)
+        return NULL;
+
+    if (genome_mutate(self->population, individual) != 0) {
+        PyErr_SetString(PyExc_RuntimeError, "unable to mutate genome");
+        return NULL;
+    }
+
+    /* the genome changed, so its views need to be refreshed */
+    population_columns_update(self->population);
+    Py_RETURN_NONE;
+}
+
+static PyObject * Population_distance(PopulationObject * self, PyObject * args)
+{
+    sc_genome * genome1, * genome2;
+    int index1, index2;
+
+    if (!population_created(self) ||
+        !PyArg_ParseTuple(args, "ii", &index1, &index2))
+        return NULL;
+
+    genome1 = population_genome(self, index1);
+    genome2 = population_genome(self, index2);
+    if ((genome1 == NULL) || (genome2 == NULL))
+        return NULL;
+
+    return PyLong_FromLong(genome_distance(self->population, genome1, genome2));
+}
+
+static PyObject * Population_hash(PopulationObject * self, PyObject * args)
+{
+    sc_genome * individual;
+    int index;
+
+    if (!population_created(self) || !PyArg_ParseTuple(args, "i", &index))
+        return NULL;
+
+    individual = population_genome(self, index);
+    if (individual == NULL)
+        return NULL;
+
+    return PyLong_FromUnsignedLong(genome_hash(self->population, individual));
+}
+
+static PyObject * Population_goal_distance(PopulationObject * self,
+                                           PyObject * args)
+{
+    sc_genome * individual;
+    int index;
+
+    if (!population_created(self) || !PyArg_ParseTuple(args, "i", &index))
+        return NULL;
+
+    individual = population_genome(self, index);
+    if (individual == NULL)
+        return NULL;
+
+    return PyLong_FromLong(goal_genome_distances(self->population,
+                                                 individual, NULL));
+}
+
+static PyObject * Population_get_size(PopulationObject * self, void * closure)
+{
+    if (!population_created(self))
+        return NULL;
+    return PyLong_FromLong(self->population->size);
+}
+
+static PyObject * Population_get_evaluations(PopulationObject * self,
+                                             void * closure)
+{
+    if (!population_created(self))
+        return NULL;
+    return PyLong_FromLong(self->population->evaluations);
+}
+
+/**
+ * @brief Returns a float parameter of the population, given its offset
+ */
+static PyObject * Population_get_parameter(PopulationObject * self,
+                                           void * closure)
+{
+    if (!population_created(self))
+        return NULL;
+    return PyFloat_FromDouble(*(float*)((unsigned char*)self->population +
+                                        (size_t)closure));
+}
+
+/**
+ * @brief Sets a float parameter of the population in the range 0.0 - 1.0
+ */
+static int Population_set_parameter(PopulationObject * self, PyObject * value,
+                                    void * closure)
+{
+    double parameter;
+
+    if (!population_created(self))
+        return -1;
+
+    if (value == NULL) {
+        PyErr_SetString(PyExc_TypeError, "cannot delete parameter");
+        return -1;
+    }
+
+    parameter = PyFloat_AsDouble(value);
+    if ((parameter == -1.0) && PyErr_Occurred())
+        return -1;
+
+    if ((parameter < 0) || (parameter > 1)) {
+        PyErr_SetString(PyExc_ValueError, "parameter must be within 0.0 - 1.0");
+        return -1;
+    }
+
+    *(float*)((unsigned char*)self->population + (size_t)closure) =
+        (float)parameter;
+    return 0;
+}
+
+static PyObject * Population_get_scores(PopulationObject * self, void * closure)
+{
+    Py_ssize_t shape, stride = sizeof(float);
+
+    if (!population_created(self))
+        return NULL;
+
+    shape = self->population->columns->size;
+    return view_create((PyObject*)self, self->population->columns->score,
+                       "f", sizeof(float), 1, &shape, &stride);
+}
+
+static PyObject * Population_get_steps(PopulationObject * self, void * closure)
+{
+    Py_ssize_t shape, stride = sizeof(int);
+
+    if (!population_created(self))
+        return NULL;
+
+    shape = self->population->columns->size;
+    return view_create((PyObject*)self, self->population->columns->steps,
+                       "i", sizeof(int), 1, &shape, &stride);
+}
+
+/**
+ * @brief Returns a view of genes indexed as [genome, step, program].
+ *        Within the columns genomes are adjacent, so the view is strided.
+ *        Only the steps which a genome has are meaningful.
+ */
+static PyObject * population_gene_view(PopulationObject * self, void * data,
+                                       char * format, Py_ssize_t itemsize)
+{
+    sc_population_columns * columns = self->population->columns;
+    Py_ssize_t shape[3], strides[3];
+
+    shape[0] = columns->size;
+    shape[1] = SC_MAX_CHANGE_SEQUENCE;
+    shape[2] = columns->no_of_programs;
+    strides[0] = itemsize;
+    strides[1] = itemsize * columns->no_of_programs * columns->size;
+    strides[2] = itemsize * columns->size;
+
+    return view_create((PyObject*)self, data, format, itemsize, 3,
+                       shape, strides);
+}
+
+static PyObject * Population_get_versions(PopulationObject * self,
+                                          void * closure)
+{
+    if (!population_created(self))
+        return NULL;
+    return population_gene_view(self, self->population->columns->version_index,
+                                "i", sizeof(int));
+}
+
+static PyObject * Population_get_installed(PopulationObject * self,
+                                           void * closure)
+{
+    if (!population_created(self))
+        return NULL;
+    return population_gene_view(self, self->population->columns->installed,
+                                "B", sizeof(unsigned char));
+}
+
+static PyMethodDef Population_methods[] = {
+    {"next_generation", (PyCFunction)Population_next_generation, METH_NOARGS,
+     "Creates the next generation from the scores of the current one"},
+    {"set_test_passes", (PyCFunction)Population_set_test_passes, METH_VARARGS,
+     "set_test_passes(index, test_passes)\nScores a genome"},
+    {"set_partial_score", (PyCFunction)Population_set_partial_score, METH_VARARGS,
+     "set_partial_score(index, test_passes, steps_completed)\n"
+     "Scores a genome whose evaluation ended early"},
+    {"best_index", (PyCFunction)Population_best_index, METH_NOARGS,
+     "Returns the index of the highest scoring genome"},
+    {"worst_index", (PyCFunction)Population_worst_index, METH_NOARGS,
+     "Returns the index of the lowest scoring genome"},
+    {"best_score", (PyCFunction)Population_best_score, METH_NOARGS,
+     "Returns the highest score"},
+    {"average_score", (PyCFunction)Population_average_score, METH_NOARGS,
+     "Returns the average score"},
+    {"variance", (PyCFunction)Population_variance, METH_NOARGS,
+     "Returns the variance of the scores"},
+    {"mutate", (PyCFunction)Population_mutate, METH_VARARGS,
+     "mutate(index)\nMutates a genome"},
+    {"distance", (PyCFunction)Population_distance, METH_VARARGS,
+     "distance(index1, index2)\nReturns the distance between two genomes"},
+    {"hash", (PyCFunction)Population_hash, METH_VARARGS,
+     "hash(index)\nReturns the hash of a genome"},
+    {"goal_distance", (PyCFunction)Population_goal_distance, METH_VARARGS,
+     "goal_distance(index)\nReturns the distance of a genome from the goal"},
+    {NULL}
+};
+
+static PyGetSetDef Population_getset[] = {
+    {"size", (getter)Population_get_size, NULL,
+     "Number of genomes", NULL},
+    {"evaluations", (getter)Population_get_evaluations, NULL,
+     "Total number of genome evaluations", NULL},
+    {"mutation_rate", (getter)Population_get_parameter,
+     (setter)Population_set_parameter, "Mutation rate, 0.0 - 1.0",
+     (void*)offsetof(sc_population, mutation_rate)},
+    {"crossover", (getter)Population_get_parameter,
+     (setter)Population_set_parameter, "Crossover, 0.0 - 1.0",
+     (void*)offsetof(sc_population, crossover)},
+    {"rebels", (getter)Population_get_parameter,
+     (setter)Population_set_parameter, "Fraction of rebels, 0.0 - 1.0",
+     (void*)offsetof(sc_population, rebels)},
+    {"scores", (getter)Population_get_scores, NULL,
+     "View of the score of each genome", NULL},
+    {"steps", (getter)Population_get_steps, NULL,
+     "View of the number of upgrade steps of each genome", NULL},
+    {"versions", (getter)Population_get_versions, NULL,
+     "View of version indexes as [genome, step, program]", NULL},
+    {"installed", (getter)Population_get_installed, NULL,
+     "View of installed states as [genome, step, program]", NULL},
+    {NULL}
+};
+
+static PyTypeObject PopulationType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "scalam_core.Population",
+    .tp_basicsize = sizeof(PopulationObject),
+    .tp_dealloc = (destructor)Population_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Population(system, size, seed=0)\n"
+    "A population of upgrade sequences towards the latest versions",
+    .tp_methods = Population_methods,
+    .tp_getset = Population_getset,
+    .tp_init = (initproc)Population_init,
+    .tp_new = PyType_GenericNew,
+};
+
+static struct PyModuleDef scalam_core_module = {
+    PyModuleDef_HEAD_INIT,
+    "scalam_core",
+    "Bindings to the scalam core",
+    -1,
+    NULL
+};
+
+PyMODINIT_FUNC PyInit_scalam_core(void)
+{
+    PyObject * module;
+
+    if ((PyType_Ready(&ViewType) < 0) ||
+        (PyType_Ready(&SystemType) < 0) ||
+        (PyType_Ready(&PopulationType) < 0))
+        return NULL;
+
+    module = PyModule_Create(&scalam_core_module);
+    if (module == NULL)
+        return NULL;
+
+    Py_INCREF(&SystemType);
+    Py_INCREF(&PopulationType);
+    if ((PyModule_AddObject(module, "System", (PyObject*)&SystemType) < 0) ||
+        (PyModule_AddObject(module, "Population",
+                            (PyObject*)&PopulationType) < 0)) {
+        Py_DECREF(&SystemType);
+        Py_DECREF(&PopulationType);
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    PyModule_AddIntConstant(module, "MAX_CHANGE_SEQUENCE", SC_MAX_CHANGE_SEQUENCE);
+    PyModule_AddIntConstant(module, "MAX_POPULATION_SIZE", SC_MAX_POPULATION_SIZE);
+    PyModule_AddIntConstant(module, "MAX_SYSTEM_SIZE", SC_MAX_SYSTEM_SIZE);
+    return module;
+}
@@ -0,0 +1,382 @@
+/*
+  Smart search for upgrade paths
+  Copyright (C) 2016 Andrew Leeming <andrew.leeming@codethink.co.uk> and
+  Bob Mottram <bob.mottram@codethink.co.uk>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "scalam.h"
+#include <fcntl.h>
+
+/* Kinds of token found within a morph file */
+#define SC_BASEROCK_NAME        0
+#define SC_BASEROCK_DEPENDENCY  1
+
+/* A chunk name or a dependency, within the mapped contents of a file */
+typedef struct {
+    int kind;
+    int length;
+    const char * str;
+} sc_baserock_token;
+
+/* The tokens of a single morph file */
+typedef struct {
+    char filename[SC_MAX_STRING*2];
+    char * contents;
+    size_t size;
+    int no_of_tokens;
+    int max_tokens;
+    sc_baserock_token * token;
+} sc_baserock_file;
+
+/* Morph files within a definitions directory */
+typedef struct {
+    int no_of_files;
+    sc_baserock_file * file;
+} sc_baserock_files;
+
+/**
+ * @brief Adds a token to a morph file, with surrounding white space removed
+ * @param file The morph file
+ * @param kind The kind of token
+ * @param str Start of the token
+ * @param end End of the line containing the token
+ * @returns zero on success
+ */
+static int baserock_add_token(sc_baserock_file * file, int kind,
+                              const char * str, const char * end)
+{
+    sc_baserock_token * token;
+    int max_tokens;
+
+    while ((str < end) && ((*str == ' ') || (*str == '\t')))
+        str++;
+    while ((end > str) &&
+           ((end[-1] == ' ') || (end[-1] == '\t') || (end[-1] == '\r')))
+        end--;
+
+    /* empty names are ignored */
+    if (end == str)
+        return 0;
+
+    if (file->no_of_tokens >= file->max_tokens) {
+        max_tokens = (file->max_tokens < 64) ? 64 : file->max_tokens * 2;
+        token = (sc_baserock_token*)realloc(file->token,
+                                            max_tokens*sizeof(sc_baserock_token));
+        if (token == NULL)
+            return 1;
+        file->token = token;
+        file->max_tokens = max_tokens;
+    }
+
+    token = &file->token[file->no_of_tokens++];
+    token->kind = kind;
+    token->str = str;
+    token->length = (int)(end - str);
+    return 0;
+}
+
+/**
+ * @brief Maps a morph file into memory and finds the chunk names and
+ *        their dependencies. A chunk name is on a line beginning with
+ *        "- name:" and the dependencies which follow it are on lines
+ *        beginning with "  - "
+ * @param file The morph file, with its filename set
+ * @returns zero on success
+ */
+static int baserock_parse_file(sc_baserock_file * file)
+{
+    struct stat st;
+    const char * line, * end, * eol;
+    int fd;
+
+    /* files which can't be read are skipped */
+    fd = open(file->filename, O_RDONLY);
+    if (fd < 0)
+        return 0;
+
+    if ((fstat(fd, &st) != 0) || (st.st_size == 0)) {
+        close(fd);
+        return 0;
+    }
+
+    file->contents = (char*)mmap(NULL, (size_t)st.st_size, PROT_READ,
+                                 MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (file->contents == MAP_FAILED) {
+        file->contents = NULL;
+        return 2;
+    }
+    file->size = (size_t)st.st_size;
+
+    line = file->contents;
+    end = file->contents + file->size;
+    while (line < end) {
+        eol = (const char*)memchr(line, '\n', end - line);
+        if (eol == NULL)
+            eol = end;
+
+        if ((eol - line > 7) && (strncmp(line, "- name:", 7) == 0)) {
+            if (baserock_add_token(file, SC_BASEROCK_NAME, line + 7, eol) != 0)
+                return 3;
+        }
+        else if ((eol - line > 4) && (strncmp(line, "  - ", 4) == 0)) {
+            if (baserock_add_token(file, SC_BASEROCK_DEPENDENCY,
+                                   line + 4, eol) != 0)
+                return 4;
+        }
+
+        line = eol + 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Deallocates morph files and unmaps their contents
+ * @param files The morph files
+ */
+static void baserock_files_free(sc_baserock_files * files)
+{
+    int f;
+
+    for (f = 0; f < files->no_of_files; f++) {
+        if (files->file[f].contents != NULL)
+            munmap(files->file[f].contents, files->file[f].size);
+        free(files->file[f].token);
+    }
+    free(files->file);
+    files->file = NULL;
+    files->no_of_files = 0;
+}
+
+/**
+ * @brief Comparison function used to sort morph files by filename
+ */
+static int baserock_compare_files(const void * a, const void * b)
+{
+    return strcmp(((sc_baserock_file*)a)->filename,
+                  ((sc_baserock_file*)b)->filename);
+}
+
+/**
+ * @brief Finds the strata morph files within a definitions directory and
+ *        parses them in parallel. Each file is read only once
+ * @param definitions_dir The directory where baserock definitions exist
+ * @param files Returned morph files, in filename order
+ * @returns zero on success
+ */
+static int baserock_files_parse(char * definitions_dir, sc_baserock_files * files)
+{
+    DIR * dirp;
+    struct dirent * dp;
+    sc_baserock_file * file;
+    char search_dir[SC_MAX_STRING];
+    int f, max_files = 0, retval = 0;
+
+    memset((void*)files, '\0', sizeof(sc_baserock_files));
+
+    snprintf(search_dir, SC_MAX_STRING, "%s/strata", definitions_dir);
+    dirp = opendir(search_dir);
+    if (dirp == NULL)
+        return 1;
+
+    while ((dp = readdir(dirp)) != NULL) {
+        /* is this a morph file ? */
+        if (strstr(dp->d_name, ".morph") == NULL)
+            continue;
+
+        if (files->no_of_files >= max_files) {
+            max_files = (max_files < 64) ? 64 : max_files * 2;
+            file = (sc_baserock_file*)realloc(files->file,
+                                              max_files*sizeof(sc_baserock_file));
+            if (file == NULL) {
+                (void)closedir(dirp);
+                baserock_files_free(files);
+                return 2;
+            }
+            files->file = file;
+        }
+
+        file = &files->file[files->no_of_files++];
+        memset((void*)file, '\0', sizeof(sc_baserock_file));
+        snprintf(file->filename, sizeof(file->filename), "%s/%s",
+                 search_dir, dp->d_name);
+    }
+    (void)closedir(dirp);
+
+    /* the order of directory entries isn't defined */
+    if (files->no_of_files > 1)
+        qsort((void*)files->file, files->no_of_files,
+              sizeof(sc_baserock_file), baserock_compare_files);
+
+#pragma omp parallel for schedule(dynamic)
+    for (f = 0; f < files->no_of_files; f++) {
+        if (baserock_parse_file(&files->file[f]) != 0) {
+#pragma omp atomic write
+            retval = 3;
+        }
+    }
+
+    if (retval != 0)
+        baserock_files_free(files);
+
+    return retval;
+}
+
+/**
+ * @brief Sets the dependency matrix of a system from parsed morph files.
+ *        Dependencies upon programs which aren't within the system are
+ *        ignored, as are chunks which aren't within the system.
+ * @param files The parsed morph files
+ * @param sys System object
+ * @returns zero on success
+ */
+static int baserock_update_dependencies(sc_baserock_files * files, sc_system * sys)
+{
+    sc_baserock_token * token;
+    int f, t, program_index, dependency_index;
+
+    if (sys->dependency_probability == NULL)
+        if (system_create_dependency_matrix(sys) != 0)
+            return 1;
+
+    /* names may have been set without updating the index */
+    if (sys->indexed_programs != sys->no_of_programs)
+        system_index_names(sys);
+
+    for (f = 0; f < files->no_of_files; f++) {
+        program_index = -1;
+        for (t = 0; t < files->file[f].no_of_tokens; t++) {
+            token = &files->file[f].token[t];
+            if (token->kind == SC_BASEROCK_NAME) {
+                program_index = system_program_index_from_string(sys, token->str,
+                                                                 token->length);
+                continue;
+            }
+            if (program_index < 0)
+                continue;
+
+            /* NOTE: some dependencies are not found.
+               This could mean that baserock definitions are inconsistent or have bugs */
+            dependency_index = system_program_index_from_string(sys, token->str,
+                                                                token->length);
+            if (dependency_index < 0)
+                continue;
+
+            sys->dependency_probability[program_index][dependency_index] = 1.0;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Comparison function used to sort programs by name
+ */
+static int baserock_compare_programs(const void * a, const void * b)
+{
+    return strcmp(string_pool_get(((sc_program*)a)->name),
+                  string_pool_get(((sc_program*)b)->name));
+}
+
+/**
+ * @brief Updates the dependency matrix for a system from baserock definitions
+ * @param definitions_dir The directory where baserock definitions exist
+ * @param sys System object
+ * @returns zero on success
+ */
+int system_from_baserock_update_dependencies(char * definitions_dir, sc_system * sys)
+{
+    sc_baserock_files files;
+    int retval;
+
+    if (baserock_files_parse(definitions_dir, &files) != 0)
+        return 1;
+
+    retval = baserock_update_dependencies(&files, sys);
+    baserock_files_free(&files);
+    if (retval != 0)
+        return 10 + retval;
+
+    return 0;
+}
+
+/**
+ * @brief Extracts programs and their dependencies from baserock strata files.
+ *        Each morph file is read once, with files read in parallel, and
+ *        program names are looked up using the name index of the system.
+ * @param definitions_dir The directory where baserock definitions exist
+ * @param sys System object
+ * @returns zero on success
+ */
+int system_from_baserock(char * definitions_dir, sc_system * sys)
+{
+    sc_baserock_files files;
+    sc_baserock_token * token;
+    sc_string name;
+    int f, t, p, retval = 0;
+
+    /* clear the system object */
+    sys->no_of_programs = 0;
+    system_index_names(sys);
+
+    if (baserock_files_parse(definitions_dir, &files) != 0)
+        return 1;
+
+    /* each chunk name becomes a program, the first time it's seen */
+    for (f = 0; (f < files.no_of_files) && (retval == 0); f++) {
+        for (t = 0; t < files.file[f].no_of_tokens; t++) {
+            token = &files.file[f].token[t];
+            if (token->kind != SC_BASEROCK_NAME)
+                continue;
+
+            if (system_program_index_from_string(sys, token->str,
+                                                 token->length) >= 0)
+                continue;
+
+            name = string_pool_add_length(token->str, token->length);
+            if ((name == 0) ||
+                (system_add_program(sys, string_pool_get(name)) < 0)) {
+                retval = 3;
+                break;
+            }
+        }
+    }
+
+    if (retval == 0) {
+        /* programs are in alphabetical order */
+        qsort((void*)sys->program, sys->no_of_programs, sizeof(sc_program),
+              baserock_compare_programs);
+        system_index_names(sys);
+
+        if (state_layout_create(sys) != 0)
+            retval = 4;
+    }
+
+    if (retval == 0) {
+        /* clear any previous dependencies */
+        if (sys->dependency_probability != NULL)
+            for (p = 0; p < sys->no_of_programs; p++)
+                memset((void*)sys->dependency_probability[p], '\0',
+                       sizeof(double)*SC_MAX_SYSTEM_SIZE);
+
+        if (baserock_update_dependencies(&files, sys) != 0)
+            retval = 5;
+    }
+
+    baserock_files_free(&files);
+    return retval;
+}
@@ -0,0 +1,324 @@
+/*
+  Smart search for upgrade paths
+  Copyright (C) 2016 Andrew Leeming <andrew.leeming@codethink.co.uk> and
+  Bob Mottram <bob.mottram@codethink.co.uk>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "scalam.h"
+
+/**
+ * @brief Sets the default options, which keep every version between
+ *        the start and reference
+ * @param options The options object
+ */
+void candidates_options_init(sc_candidate_options * options)
+{
+    memset((void*)options, '\0', sizeof(sc_candidate_options));
+    options->thinning = SC_CANDIDATES_ALL;
+    options->every = 1;
+}
+
+/**
+ * @brief Comparison function used to sort commits
+ */
+static int candidates_compare_commits(const void * a, const void * b)
+{
+    return strcmp(*(char**)a, *(char**)b);
+}
+
+/**
+ * @brief Splits text into lines in place
+ * @param text The text, which is modified
+ * @param lines Returned array of lines, which should be freed
+ * @returns The number of lines, or -1 on error
+ */
+static int candidates_split_lines(char * text, char *** lines)
+{
+    int i, no_of_lines = 0, max_lines = 64;
+    char * line = text, * end;
+    char ** grown;
+
+    *lines = (char**)malloc(max_lines*sizeof(char*));
+    if (*lines == NULL)
+        return -1;
+
+    while ((line != NULL) && (*line != 0)) {
+        end = strchr(line, '\n');
+        if (end != NULL)
+            *end = 0;
+        if (no_of_lines >= max_lines) {
+            max_lines *= 2;
+            grown = (char**)realloc(*lines, max_lines*sizeof(char*));
+            if (grown == NULL)
+                return -1;
+            *lines = grown;
+        }
+        (*lines)[no_of_lines++] = line;
+        line = (end != NULL) ? end + 1 : NULL;
+    }
+
+    /* carriage returns from files edited elsewhere */
+    for (i = 0; i < no_of_lines; i++)
+        (*lines)[i][strcspn((*lines)[i], "\r")] = 0;
+
+    return no_of_lines;
+}
+
+/**
+ * @brief Reads the whole of a file
+ * @param filename The file
+ * @returns The terminated contents of the file, which should be freed,
+ *          or NULL on error
+ */
+static char * candidates_read_file(char * filename)
+{
+    char * text;
+    long length;
+    FILE * fp;
+
+    fp = fopen(filename, "r");
+    if (fp == NULL)
+        return NULL;
+
+    fseek(fp, 0, SEEK_END);
+    length = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    text = (char*)malloc(length + 1);
+    if ((text != NULL) && (fread(text, 1, length, fp) != (size_t)length)) {
+        free(text);
+        text = NULL;
+    }
+    if (text != NULL)
+        text[length] = 0;
+
+    fclose(fp);
+    return text;
+}
+
+/**
+ * @brief Lists the commits within a repo which are tagged, or which are
+ *        merges within the first parent history of master
+ * @param repo_dir Directory containing the git repo
+ * @param thinning SC_CANDIDATES_TAGS or SC_CANDIDATES_MERGES
+ * @param result Returned output of git, which holds the commits
+ *               and should be freed
+ * @param commits Returned sorted array of commits, which should be freed
+ * @returns The number of commits, or -1 on error
+ */
+static int candidates_marked_commits(char * repo_dir, int thinning,
+                                     sc_process_result * result,
+                                     char *** commits)
+{
+    /* annotated tags point at tag objects, so the commits which
+       they refer to are also listed */
+    char * tags_argv[] = {
+        "git", "-C", repo_dir, "for-each-ref",
+        "--format=%(objectname)%0a%(*objectname)", "refs/tags", NULL
+    };
+    char * merges_argv[] = {
+        "git", "-C", repo_dir, "rev-list", "--first-parent", "--merges",
+        "master", NULL
+    };
+    sc_process_options options;
+    int no_of_commits;
+
+    *commits = NULL;
+    process_options_init(&options);
+    options.quiet = 1;
+    if (process_run_with_options((thinning == SC_CANDIDATES_TAGS) ?
+                                 tags_argv : merges_argv,
+                                 &options, result) != 0)
+        return -1;
+
+    no_of_commits = candidates_split_lines(result->output, commits);
+    if (no_of_commits > 0)
+        qsort((void*)*commits, no_of_commits, sizeof(char*),
+              candidates_compare_commits);
+
+    return no_of_commits;
+}
+
+/**
+ * @brief Restricts a program to the candidate versions between a start
+ *        and reference version, which may optionally be thinned. The
+ *        candidates are written to a file alongside the versions file,
+ *        which then becomes the versions file of the program, so that
+ *        version indexes within genomes index into the candidates.
+ *        Tags and merges are only known for git repos. Other programs
+ *        have versions from changelogs, which are all releases, so
+ *        thinning to tags or merges keeps every one of them.
+ * @param prog Program object. Its version index becomes the index of the
+ *             start version among the candidates
+ * @param start_index Index of the start version
+ * @param reference_index Index of the reference version
+ * @param options How the versions are thinned
+ * @returns zero on success
+ */
+int candidates_program(sc_program * prog, int start_index,
+                       int reference_index, sc_candidate_options * options)
+{
+    char * versions_file = string_pool_get(prog->versions_file);
+    char directory[SC_MAX_STRING*2];
+    char git_dir[SC_MAX_STRING*2+8];
+    char * text, * separator;
+    char ** version, ** marked = NULL;
+    unsigned char * keep;
+    sc_process_result result;
+    int i, lo, hi, no_of_versions, no_of_marked = -1;
+    int no_of_candidates = 0, start_candidate = 0, retval = 0;
+    FILE * fp;
+
+    if ((options->thinning < SC_CANDIDATES_ALL) ||
+        (options->thinning > SC_CANDIDATES_EVERY_NTH) ||
+        (options->every < 1))
+        return 1;
+
+    if ((start_index < 0) || (start_index >= prog->no_of_versions) ||
+        (reference_index < 0) || (reference_index >= prog->no_of_versions))
+        return 2;
+
+    text = candidates_read_file(versions_file);
+    if (text == NULL)
+        return 3;
+
+    no_of_versions = candidates_split_lines(text, &version);
+    if (no_of_versions != prog->no_of_versions) {
+        free(text);
+        free(version);
+        return 4;
+    }
+
+    /* the candidates are kept in the same directory as the versions */
+    snprintf(directory, sizeof(directory), "%s", versions_file);
+    separator = strrchr(directory, '/');
+    if (separator != NULL)
+        *separator = 0;
+    else
+        sprintf(directory, ".");
+
+    memset((void*)&result, '\0', sizeof(sc_process_result));
+    snprintf(git_dir, sizeof(git_dir), "%s/.git", directory);
+    if (((options->thinning == SC_CANDIDATES_TAGS) ||
+         (options->thinning == SC_CANDIDATES_MERGES)) &&
+        directory_exists(git_dir)) {
+        no_of_marked = candidates_marked_commits(directory, options->thinning,
+                                                 &result, &marked);
+        if (no_of_marked < 0)
+            retval = 5;
+    }
+
+    lo = (start_index < reference_index) ? start_index : reference_index;
+    hi = (start_index < reference_index) ? reference_index : start_index;
+
+    /* Version index zero is the oldest, at the end of the file */
+    keep = (unsigned char*)calloc(no_of_versions, 1);
+    for (i = lo; (retval == 0) && (keep != NULL) && (i <= hi); i++) {
+        if ((i == lo) || (i == hi))
+            keep[i] = 1;
+        else if (options->thinning == SC_CANDIDATES_EVERY_NTH)
+            keep[i] = ((i - lo) % options->every == 0);
+        else if (no_of_marked >= 0)
+            keep[i] = (bsearch((void*)&version[no_of_versions - 1 - i],
+                               (void*)marked, no_of_marked, sizeof(char*),
+                               candidates_compare_commits) != NULL);
+        else
+            keep[i] = 1;
+
+        if (keep[i]) {
+            if (i < start_index)
+                start_candidate++;
+            no_of_candidates++;
+        }
+    }
+    if (keep == NULL)
+        retval = 6;
+
+    if (retval == 0) {
+        prog->versions_file = string_pool_printf("%s/%s", directory,
+                                                 SC_CANDIDATES_FILENAME);
+        fp = fopen(string_pool_get(prog->versions_file), "w");
+        if (fp == NULL) {
+            prog->versions_file = string_pool_add(versions_file);
+            retval = 7;
+        }
+        else {
+            for (i = hi; i >= lo; i--)
+                if (keep[i])
+                    fprintf(fp, "%s\n", version[no_of_versions - 1 - i]);
+            fclose(fp);
+
+            prog->no_of_versions = no_of_candidates;
+            prog->version_index = start_candidate;
+        }
+    }
+
+    process_result_free(&result);
+    free(marked);
+    free(keep);
+    free(version);
+    free(text);
+    return retval;
+}
+
+/**
+ * @brief Restricts every program within a system to the candidate
+ *        versions between its current version and its latest version,
+ *        which are the start and reference of the goal created by
+ *        goal_create_latest_versions. Goals should be created after this.
+ *        If any program fails then every program keeps its original
+ *        versions, so the system is never partly restricted.
+ * @param sys System object
+ * @param options How the versions are thinned
+ * @returns zero on success
+ */
+int candidates_system(sc_system * sys, sc_candidate_options * options)
+{
+    sc_program * original;
+    int p, retval = 0;
+
+    if (sys->no_of_programs <= 0)
+        return 0;
+
+    original = (sc_program*)malloc(sys->no_of_programs*sizeof(sc_program));
+    if (original == NULL)
+        return 3;
+    memcpy((void*)original, (void*)sys->program,
+           sys->no_of_programs*sizeof(sc_program));
+
+    for (p = 0; p < sys->no_of_programs; p++) {
+        if (sys->program[p].no_of_versions <= 0)
+            continue;
+
+        if (candidates_program(&sys->program[p], sys->program[p].version_index,
+                               sys->program[p].no_of_versions - 1,
+                               options) != 0) {
+            retval = 1;
+            break;
+        }
+    }
+
+    if (retval != 0)
+        memcpy((void*)sys->program, (void*)original,
+               sys->no_of_programs*sizeof(sc_program));
+    free(original);
+
+    /* fewer versions may need narrower version indexes */
+    if (state_layout_create(sys) != 0)
+        return 2;
+
+    return retval;
+}
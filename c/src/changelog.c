@@ -0,0 +1,638 @@
+/*
+  Smart search for upgrade paths
+  Copyright (C) 2016 Andrew Leeming <andrew.leeming@codethink.co.uk> and
+  Bob Mottram <bob.mottram@codethink.co.uk>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* for memmem */
+#define _GNU_SOURCE
+
+#include "scalam.h"
+
+/* Files within an archive which may contain a changelog, most useful
+   first. Names are compared without case. Debian changelogs and spec
+   files list every release, whereas a GNU ChangeLog often has no
+   versions at all */
+static char * changelog_member_name[] = {
+    "debian/changelog", ".spec", "NEWS", "NEWS.md", "NEWS.txt",
+    "CHANGELOG.md", "CHANGELOG", "CHANGELOG.txt", "CHANGES", "CHANGES.md",
+    "CHANGES.txt", "HISTORY.md", "HISTORY.txt", "HISTORY", "RELEASES.md",
+    "RELEASES.txt", "RELEASE.md", "ChangeLog", NULL
+};
+
+/**
+ * @brief Sets up an empty list of versions
+ * @param changelog The changelog object
+ */
+void changelog_init(sc_changelog * changelog)
+{
+    memset((void*)changelog, '\0', sizeof(sc_changelog));
+}
+
+/**
+ * @brief Frees the list of versions
+ * @param changelog The changelog object
+ */
+void changelog_free(sc_changelog * changelog)
+{
+    if (changelog->version != NULL)
+        free(changelog->version);
+    changelog_init(changelog);
+}
+
+/**
+ * @brief Adds a version to the end of the list, unless it is already
+ *        within the list. Changelogs are newest first, so only the most
+ *        recent mention of a version counts.
+ * @param changelog The changelog object
+ * @param str The version, which needn't be terminated
+ * @param length Length of the version
+ * @returns zero on success
+ */
+static int changelog_add_version(sc_changelog * changelog,
+                                 const char * str, int length)
+{
+    sc_string version;
+    sc_string * versions;
+    int i, max_versions;
+
+    if (length <= 0)
+        return 0;
+
+    version = string_pool_add_length(str, length);
+    if (version == 0)
+        return 1;
+
+    /* pooled strings are equal only if they are the same string */
+    for (i = 0; i < changelog->no_of_versions; i++)
+        if (changelog->version[i] == version)
+            return 0;
+
+    if (changelog->no_of_versions >= changelog->max_versions) {
+        max_versions = (changelog->max_versions < 64) ?
+            64 : changelog->max_versions * 2;
+        versions = (sc_string*)realloc(changelog->version,
+                                       max_versions*sizeof(sc_string));
+        if (versions == NULL)
+            return 2;
+        changelog->version = versions;
+        changelog->max_versions = max_versions;
+    }
+
+    changelog->version[changelog->no_of_versions++] = version;
+    return 0;
+}
+
+/**
+ * @brief Returns whether a word looks like a version number, such as
+ *        1.2, v2.0.1 or 3.4-rc1, rather than a date or a number
+ * @param str The word
+ * @param length Length of the word
+ * @returns Non-zero if the word is a version
+ */
+static int changelog_is_version(const char * str, int length)
+{
+    int i, dots = 0;
+
+    if ((length > 1) && ((str[0] == 'v') || (str[0] == 'V'))) {
+        str++;
+        length--;
+    }
+
+    if ((length < 3) || (str[0] < '0') || (str[0] > '9'))
+        return 0;
+
+    for (i = 0; i < length; i++) {
+        if (str[i] == '.')
+            dots++;
+        else if (!(((str[i] >= '0') && (str[i] <= '9')) ||
+                   ((str[i] >= 'a') && (str[i] <= 'z')) ||
+                   ((str[i] >= 'A') && (str[i] <= 'Z')) ||
+                   (str[i] == '-') || (str[i] == '+') ||
+                   (str[i] == '~') || (str[i] == '_')))
+            return 0;
+    }
+
+    return (dots > 0);
+}
+
+/**
+ * @brief Reads the version from a Debian changelog entry, which
+ *        begins with a line such as:
+ *        package (1.2-3) unstable; urgency=medium
+ * @param changelog The changelog object
+ * @param line The line
+ * @param length Length of the line
+ * @returns zero on success
+ */
+static int changelog_parse_debian_line(sc_changelog * changelog,
+                                       const char * line, int length)
+{
+    const char * start, * end;
+
+    /* the details of each entry are indented */
+    if ((length == 0) || (line[0] == ' ') || (line[0] == '\t'))
+        return 0;
+
+    start = memchr(line, '(', length);
+    if (start == NULL)
+        return 0;
+    start++;
+
+    end = memchr(start, ')', length - (start - line));
+    if (end == NULL)
+        return 0;
+
+    if (memchr(end, ';', length - (end - line)) == NULL)
+        return 0;
+
+    return changelog_add_version(changelog, start, (int)(end - start));
+}
+
+/**
+ * @brief Reads the version from an RPM %changelog entry, which
+ *        begins with a line such as:
+ *        * Mon Jan 01 2018 Name <email> - 1.2-3
+ *        The version is the last word on the line
+ * @param changelog The changelog object
+ * @param line The line
+ * @param length Length of the line
+ * @returns zero on success
+ */
+static int changelog_parse_rpm_line(sc_changelog * changelog,
+                                    const char * line, int length)
+{
+    int start;
+
+    if ((length == 0) || (line[0] != '*'))
+        return 0;
+
+    while ((length > 0) &&
+           ((line[length-1] == ' ') || (line[length-1] == '\t')))
+        length--;
+
+    start = length;
+    while ((start > 0) && (line[start-1] != ' ') && (line[start-1] != '\t'))
+        start--;
+
+    /* entries without a version end with the email address */
+    if ((start == length) || (line[start] == '<') || (line[length-1] == '>'))
+        return 0;
+
+    if (line[start] == '-')
+        start++;
+
+    return changelog_add_version(changelog, &line[start], length - start);
+}
+
+/**
+ * @brief Reads a version from a heading within a NEWS, CHANGES or
+ *        HISTORY file, or a ChangeLog. Headings begin at the start of
+ *        a line, possibly after markdown, and only contain words before
+ *        the version, for example:
+ *        * Noteworthy changes in release 1.34 (2021-02-13) [stable]
+ *        ## [2.0.1] - 2020-05-01
+ *        Version 3.1
+ * @param changelog The changelog object
+ * @param line The line
+ * @param length Length of the line
+ * @returns zero on success
+ */
+static int changelog_parse_news_line(sc_changelog * changelog,
+                                     const char * line, int length)
+{
+    int i = 0, start, end, words = 0, alphabetic;
+
+    /* indented lines are the details of an entry */
+    if ((length == 0) || (line[0] == ' ') || (line[0] == '\t'))
+        return 0;
+
+    while ((i < length) && ((line[i] == '#') || (line[i] == '*') ||
+                            (line[i] == '=') || (line[i] == '-')))
+        i++;
+
+    while ((i < length) && (words < SC_CHANGELOG_MAX_HEADING_WORDS)) {
+        /* separators between words */
+        while ((i < length) &&
+               ((line[i] == ' ') || (line[i] == '\t') || (line[i] == '[') ||
+                (line[i] == ']') || (line[i] == '(') || (line[i] == ')') ||
+                (line[i] == ',') || (line[i] == ':') || (line[i] == ';')))
+            i++;
+        if (i >= length)
+            break;
+
+        start = i;
+        while ((i < length) &&
+               (line[i] != ' ') && (line[i] != '\t') && (line[i] != '[') &&
+               (line[i] != ']') && (line[i] != '(') && (line[i] != ')') &&
+               (line[i] != ',') && (line[i] != ':') && (line[i] != ';'))
+            i++;
+        end = i;
+
+        /* the end of a sentence */
+        while ((end > start) && (line[end-1] == '.'))
+            end--;
+
+        if (changelog_is_version(&line[start], end - start)) {
+            if ((line[start] == 'v') || (line[start] == 'V'))
+                start++;
+            return changelog_add_version(changelog, &line[start], end - start);
+        }
+
+        /* only words may come before the version */
+        alphabetic = 1;
+        for (; start < end; start++) {
+            if (!(((line[start] >= 'a') && (line[start] <= 'z')) ||
+                  ((line[start] >= 'A') && (line[start] <= 'Z')))) {
+                alphabetic = 0;
+                break;
+            }
+        }
+        if (!alphabetic)
+            break;
+        words++;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Guesses the format of a changelog from its filename
+ * @param filename The filename, or path within an archive
+ * @returns The format, or SC_CHANGELOG_UNKNOWN
+ */
+int changelog_format_from_filename(char * filename)
+{
+    char * name = strrchr(filename, '/');
+    int length;
+
+    name = (name != NULL) ? name + 1 : filename;
+    length = strlen(name);
+
+    /* compressed changelogs are named as if they weren't */
+    if ((length > 3) && (strcmp(&name[length-3], ".gz") == 0))
+        length -= 3;
+
+    if ((length > 5) && (strncmp(&name[length-5], ".spec", 5) == 0))
+        return SC_CHANGELOG_RPM;
+
+    if ((strncmp(name, "changelog.Debian", 16) == 0) ||
+        (strstr(filename, "debian/changelog") != NULL))
+        return SC_CHANGELOG_DEBIAN;
+
+    return SC_CHANGELOG_UNKNOWN;
+}
+
+/**
+ * @brief Guesses the format of a changelog from its contents
+ * @param text The changelog text
+ * @param length Length of the text
+ * @returns The format
+ */
+int changelog_format_from_text(const char * text, int length)
+{
+    const char * end;
+    int line_length;
+
+    /* spec files contain a %changelog section */
+    if (((length >= 10) && (strncmp(text, "%changelog", 10) == 0)) ||
+        (memmem(text, length, "\n%changelog", 11) != NULL))
+        return SC_CHANGELOG_RPM;
+
+    /* a Debian changelog begins with an entry heading */
+    end = memchr(text, '\n', length);
+    line_length = (end != NULL) ? (int)(end - text) : length;
+    if ((line_length > 0) && (text[0] != ' ') && (text[0] != '\t') &&
+        (memchr(text, '(', line_length) != NULL) &&
+        (memmem(text, line_length, "urgency=", 8) != NULL))
+        return SC_CHANGELOG_DEBIAN;
+
+    return SC_CHANGELOG_NEWS;
+}
+
+/**
+ * @brief Reads the versions from the text of a changelog, line by line,
+ *        adding them to the list in the order in which they appear,
+ *        which for changelogs is newest first
+ * @param changelog The changelog object
+ * @param text The changelog text
+ * @param length Length of the text
+ * @param format The format, or SC_CHANGELOG_UNKNOWN to guess it
+ * @returns zero on success
+ */
+int changelog_parse(sc_changelog * changelog, const char * text, int length,
+                    int format)
+{
+    const char * line = text, * end;
+    int line_length, in_changelog = 0, retval = 0;
+
+    if (format == SC_CHANGELOG_UNKNOWN)
+        format = changelog_format_from_text(text, length);
+    changelog->format = format;
+
+    while ((line < text + length) && (retval == 0)) {
+        end = memchr(line, '\n', length - (line - text));
+        line_length = (end != NULL) ? (int)(end - line) :
+            (int)(length - (line - text));
+        if ((line_length > 0) && (line[line_length-1] == '\r'))
+            line_length--;
+
+        switch (format) {
+        case SC_CHANGELOG_DEBIAN:
+            retval = changelog_parse_debian_line(changelog, line, line_length);
+            break;
+        case SC_CHANGELOG_RPM:
+            /* only within the %changelog section of a spec file */
+            if ((line_length > 0) && (line[0] == '%'))
+                in_changelog = ((line_length >= 10) &&
+                                (strncmp(line, "%changelog", 10) == 0));
+            else if (in_changelog)
+                retval = changelog_parse_rpm_line(changelog, line, line_length);
+            break;
+        default:
+            retval = changelog_parse_news_line(changelog, line, line_length);
+            break;
+        }
+
+        if (end == NULL)
+            break;
+        line = end + 1;
+    }
+
+    return retval;
+}
+
+/**
+ * @brief Parses the output of a command which writes a changelog
+ * @param changelog The changelog object
+ * @param argv The command and its arguments
+ * @param format The format, or SC_CHANGELOG_UNKNOWN to guess it
+ * @returns zero on success
+ */
+static int changelog_parse_command(sc_changelog * changelog,
+                                   char * const * argv, int format)
+{
+    sc_process_options options;
+    sc_process_result result;
+    int retval;
+
+    process_options_init(&options);
+    options.quiet = 1;
+    if (process_run_with_options(argv, &options, &result) != 0) {
+        process_result_free(&result);
+        return 1;
+    }
+
+    retval = changelog_parse(changelog, result.output, result.output_length,
+                             format);
+    process_result_free(&result);
+    if (retval != 0)
+        return 2;
+    return 0;
+}
+
+/**
+ * @brief Reads the versions from a changelog file, which may be
+ *        compressed with gzip
+ * @param changelog The changelog object
+ * @param filename The changelog file
+ * @returns zero on success
+ */
+int changelog_read(sc_changelog * changelog, char * filename)
+{
+    char * argv[] = { "gzip", "-dcf", filename, NULL };
+
+    if (!file_exists(filename))
+        return 1;
+
+    if (changelog_parse_command(changelog, argv,
+                                changelog_format_from_filename(filename)) != 0)
+        return 2;
+
+    return 0;
+}
+
+/**
+ * @brief Returns the priority of a file within an archive as a changelog
+ * @param path Path of the file within the archive
+ * @param length Length of the path
+ * @returns Array index within changelog_member_name, or -1 if the file
+ *          isn't a changelog
+ */
+static int changelog_member_priority(const char * path, int length)
+{
+    const char * name;
+    int i, name_length;
+
+    /* directories */
+    if ((length == 0) || (path[length-1] == '/'))
+        return -1;
+
+    for (i = 0; changelog_member_name[i] != NULL; i++) {
+        name_length = strlen(changelog_member_name[i]);
+        if (name_length > length)
+            continue;
+        name = &path[length - name_length];
+
+        /* spec files can have any name */
+        if (changelog_member_name[i][0] == '.') {
+            if (strncmp(name, changelog_member_name[i], name_length) == 0)
+                return i;
+            continue;
+        }
+
+        if ((strncasecmp(name, changelog_member_name[i], name_length) == 0) &&
+            ((name == path) || (name[-1] == '/')))
+            return i;
+    }
+    return -1;
+}
+
+/**
+ * @brief Reads the versions from the changelog within a tarball,
+ *        which may be compressed. The changelog is read straight out of
+ *        the archive without anything being extracted to disk. If there
+ *        are several then the most useful which contains versions is used.
+ * @param changelog The changelog object
+ * @param archive The tarball
+ * @returns zero on success
+ */
+int changelog_read_tarball(sc_changelog * changelog, char * archive)
+{
+    sc_process_result listing;
+    char * list_argv[] = { "tar", "-tf", archive, NULL };
+    char member[SC_MAX_STRING*4];
+    char * extract_argv[] = { "tar", "-xOf", archive, member, NULL };
+    const char * line, * end, * best_line;
+    int line_length, priority, best_priority, best_length, depth, best_depth;
+    int i, previous_priority = -1, previous_depth = -1;
+    const char * previous_line = NULL;
+
+    if (!file_exists(archive))
+        return 1;
+
+    if (process_run_with_options(list_argv, NULL, &listing) != 0) {
+        process_result_free(&listing);
+        return 2;
+    }
+
+    /* try changelogs in order of priority, then the shallowest first,
+       until one of them contains some versions */
+    while (changelog->no_of_versions == 0) {
+        best_line = NULL;
+        best_priority = -1;
+        best_length = 0;
+        best_depth = 0;
+
+        for (line = listing.output;
+             (line != NULL) && (line < listing.output + listing.output_length);
+             line = (end != NULL) ? end + 1 : NULL) {
+            end = strchr(line, '\n');
+            line_length = (end != NULL) ? (int)(end - line) : (int)strlen(line);
+
+            priority = changelog_member_priority(line, line_length);
+            if (priority < 0)
+                continue;
+
+            depth = 0;
+            for (i = 0; i < line_length; i++)
+                if (line[i] == '/')
+                    depth++;
+
+            /* the changelogs which were tried before, in the same order */
+            if ((priority < previous_priority) ||
+                ((priority == previous_priority) &&
+                 ((depth < previous_depth) ||
+                  ((depth == previous_depth) && (line <= previous_line)))))
+                continue;
+
+            if ((best_line == NULL) || (priority < best_priority) ||
+                ((priority == best_priority) && (depth < best_depth))) {
+                best_line = line;
+                best_priority = priority;
+                best_length = line_length;
+                best_depth = depth;
+            }
+        }
+
+        if ((best_line == NULL) || (best_length >= (int)sizeof(member)))
+            break;
+
+        memcpy(member, best_line, best_length);
+        member[best_length] = 0;
+        previous_line = best_line;
+        previous_priority = best_priority;
+        previous_depth = best_depth;
+
+        changelog_parse_command(changelog, extract_argv,
+                                changelog_format_from_filename(member));
+    }
+
+    process_result_free(&listing);
+
+    if (changelog->no_of_versions == 0)
+        return 3;
+
+    return 0;
+}
+
+/**
+ * @brief Reads the versions from the changelog within a Debian package,
+ *        without extracting the package to disk
+ * @param changelog The changelog object
+ * @param package The package file
+ * @returns zero on success
+ */
+int changelog_read_deb_package(sc_changelog * changelog, char * package)
+{
+    char * argv[] = {
+        "/bin/sh", "-c",
+        "dpkg-deb --fsys-tarfile \"$1\" | "
+        "tar -xO --wildcards --no-anchored \"$2\" | gzip -dc",
+        "scalam", package, "usr/share/doc/*/changelog.Debian.gz", NULL
+    };
+
+    if (!file_exists(package))
+        return 1;
+
+    if (!software_installed("dpkg-deb"))
+        return 2;
+
+    if ((changelog_parse_command(changelog, argv,
+                                 SC_CHANGELOG_DEBIAN) != 0) ||
+        (changelog->no_of_versions == 0)) {
+        /* native packages only have a changelog */
+        argv[5] = "usr/share/doc/*/changelog.gz";
+        changelog_parse_command(changelog, argv, SC_CHANGELOG_UNKNOWN);
+    }
+
+    if (changelog->no_of_versions == 0)
+        return 3;
+
+    return 0;
+}
+
+/**
+ * @brief Reads the versions from the %changelog of the spec file within
+ *        an RPM package, without extracting the package to disk
+ * @param changelog The changelog object
+ * @param package The package file
+ * @returns zero on success
+ */
+int changelog_read_rpm_package(sc_changelog * changelog, char * package)
+{
+    char * argv[] = {
+        "/bin/sh", "-c",
+        "rpm2cpio \"$1\" | cpio -i --quiet --to-stdout \"*.spec\"",
+        "scalam", package, NULL
+    };
+
+    if (!file_exists(package))
+        return 1;
+
+    if (!software_installed("rpm2cpio") || !software_installed("cpio"))
+        return 2;
+
+    if ((changelog_parse_command(changelog, argv, SC_CHANGELOG_RPM) != 0) ||
+        (changelog->no_of_versions == 0))
+        return 3;
+
+    return 0;
+}
+
+/**
+ * @brief Saves the versions as a versions file, newest first, in the
+ *        same way as the commits of a git repo
+ * @param changelog The changelog object
+ * @param versions_file The file to save to
+ * @returns zero on success
+ */
+int changelog_save(sc_changelog * changelog, char * versions_file)
+{
+    FILE * fp;
+    int i;
+
+    fp = fopen(versions_file, "w");
+    if (fp == NULL)
+        return 1;
+
+    for (i = 0; i < changelog->no_of_versions; i++)
+        fprintf(fp, "%s\n", string_pool_get(changelog->version[i]));
+
+    if (fclose(fp) != 0)
+        return 2;
+    return 0;
+}
@@ -0,0 +1,252 @@
+/*
+  Smart search for upgrade paths
+  Copyright (C) 2016 Andrew Leeming <andrew.leeming@codethink.co.uk> and
+  Bob Mottram <bob.mottram@codethink.co.uk>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "scalam.h"
+
+/**
+ * @brief Enables the structure-of-arrays view of a population.
+ *        Once enabled the columns are kept up to date as scores are set
+ *        and new generations are created, and population statistics
+ *        are calculated from them.
+ * @param population The population object
+ * @returns zero on success
+ */
+int population_columns_enable(sc_population * population)
+{
+    sc_population_columns * columns;
+    size_t genes;
+
+    if (population->columns != NULL)
+        return population_columns_update(population);
+
+    if (population->size <= 0)
+        return 1;
+
+    columns = (sc_population_columns*)malloc(sizeof(sc_population_columns));
+    if (columns == NULL)
+        return 2;
+
+    memset((void*)columns, '\0', sizeof(sc_population_columns));
+    columns->size = population->size;
+    columns->no_of_programs = population->sys.no_of_programs;
+
+    genes = (size_t)SC_MAX_CHANGE_SEQUENCE *
+        (size_t)columns->no_of_programs * (size_t)columns->size;
+
+    columns->score = (float*)malloc(columns->size*sizeof(float));
+    columns->steps = (int*)malloc(columns->size*sizeof(int));
+    columns->version_index = (int*)malloc(genes*sizeof(int));
+    columns->installed = (unsigned char*)malloc(genes*sizeof(unsigned char));
+
+    population->columns = columns;
+
+    if ((columns->score == NULL) || (columns->steps == NULL) ||
+        (columns->version_index == NULL) || (columns->installed == NULL)) {
+        population_columns_free(population);
+        return 3;
+    }
+
+    return population_columns_update(population);
+}
+
+/**
+ * @brief Deallocates the structure-of-arrays view of a population,
+ *        if there is one
+ * @param population The population object
+ */
+void population_columns_free(sc_population * population)
+{
+    sc_population_columns * columns = population->columns;
+
+    if (columns == NULL)
+        return;
+
+    free(columns->score);
+    free(columns->steps);
+    free(columns->version_index);
+    free(columns->installed);
+    free(columns);
+
+    population->columns = NULL;
+}
+
+/**
+ * @brief Copies the current generation into the structure-of-arrays view
+ * @param population The population object
+ * @returns zero on success
+ */
+int population_columns_update(sc_population * population)
+{
+    sc_population_columns * columns = population->columns;
+    sc_genome * individual;
+    unsigned char * state;
+    int i, step, p;
+    size_t column;
+
+    if (columns == NULL)
+        return 1;
+
+    if ((columns->size != population->size) ||
+        (columns->no_of_programs != population->sys.no_of_programs))
+        return 2;
+
+    for (i = 0; i < columns->size; i++) {
+        individual = population->individual[i];
+
+        columns->score[i] = individual->score;
+        columns->steps[i] = individual->steps;
+
+        /* only the steps which this genome has are meaningful */
+        for (step = 0; step < individual->steps; step++) {
+            state = genome_state(population, individual, step);
+            column = (size_t)step * columns->no_of_programs;
+            for (p = 0; p < columns->no_of_programs; p++, column++) {
+                columns->version_index[column*columns->size + i] =
+                    state_get_version(&population->sys, state, p);
+                columns->installed[column*columns->size + i] =
+                    (unsigned char)state_get_installed(&population->sys, state, p);
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Finds the genomes which install a given program at a given step
+ * @param population The population object, with columns enabled
+ * @param step Index within the upgrade sequence
+ * @param program_index Array index of the program within the system
+ * @param genome_index Returned array indexes of the genomes which install
+ *                     the program at this step. May be NULL if only the
+ *                     number of genomes is needed
+ * @returns The number of genomes, or negative on error
+ */
+int population_columns_installs(sc_population * population,
+                                int step, int program_index,
+                                int * genome_index)
+{
+    sc_population_columns * columns = population->columns;
+    unsigned char * installed;
+    int i, ctr = 0;
+
+    if (columns == NULL)
+        return -1;
+
+    if ((step < 0) || (step >= SC_MAX_CHANGE_SEQUENCE))
+        return -2;
+
+    if ((program_index < 0) || (program_index >= columns->no_of_programs))
+        return -3;
+
+    installed = &columns->installed[((size_t)step*columns->no_of_programs +
+                                     program_index) * columns->size];
+
+    for (i = 0; i < columns->size; i++) {
+        /* genomes with fewer steps don't install anything here */
+        if ((installed[i] != 0) && (step < columns->steps[i])) {
+            if (genome_index != NULL)
+                genome_index[ctr] = i;
+            ctr++;
+        }
+    }
+
+    return ctr;
+}
+
+/**
+ * @brief Returns the average fitness score from the score column
+ * @param columns Structure-of-arrays view of a population
+ * @returns Average score
+ */
+float population_columns_average_score(sc_population_columns * columns)
+{
+    float score = 0;
+    int i;
+
+    if (columns->size <= 0) return 0;
+
+    for (i = 0; i < columns->size; i++)
+        score += columns->score[i];
+
+    return score / (float)columns->size;
+}
+
+/**
+ * @brief Returns the RMS variance of the score column
+ * @param columns Structure-of-arrays view of a population
+ * @returns RMS score variance
+ */
+float population_columns_variance(sc_population_columns * columns)
+{
+    int i;
+    float average_score = population_columns_average_score(columns);
+    float diff, variance = 0;
+
+    if ((columns->size <= 0) || (average_score <= 0))
+        return 0;
+
+    for (i = 0; i < columns->size; i++) {
+        diff = columns->score[i] - average_score;
+        variance += diff*diff;
+    }
+    return (float)sqrt(variance / (float)columns->size);
+}
+
+/**
+ * @brief Returns the index of the top scoring genome from the score column
+ * @param columns Structure-of-arrays view of a population
+ * @returns Array index of the highest scoring genome, or -1 on failure
+ */
+int population_columns_best_index(sc_population_columns * columns)
+{
+    float max_score = 0;
+    int i, index = -1;
+
+    if (columns->size <= 0) return 0;
+
+    for (i = 0; i < columns->size; i++) {
+        if (columns->score[i] > max_score) {
+            max_score = columns->score[i];
+            index = i;
+        }
+    }
+    return index;
+}
+
+/**
+ * @brief Returns the index of the lowest scoring genome from the score column
+ * @param columns Structure-of-arrays view of a population
+ * @returns Array index of the lowest scoring genome, or -1 on failure
+ */
+int population_columns_worst_index(sc_population_columns * columns)
+{
+    float min_score = 0;
+    int i, index = -1;
+
+    if (columns->size <= 0) return 0;
+
+    for (i = 0; i < columns->size; i++) {
+        if ((min_score == 0) || (columns->score[i] < min_score)) {
+            min_score = columns->score[i];
+            index = i;
+        }
+    }
+    return index;
+}
@@ -0,0 +1,276 @@
+/*
+  Smart search for upgrade paths
+  Copyright (C) 2016 Andrew Leeming <andrew.leeming@codethink.co.uk> and
+  Bob Mottram <bob.mottram@codethink.co.uk>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "scalam.h"
+
+/**
+ * @brief Comparison function used to sort hashes
+ */
+int diversity_compare_hashes(const void * a, const void * b)
+{
+    uint32_t hash1 = *(const uint32_t*)a;
+    uint32_t hash2 = *(const uint32_t*)b;
+
+    if (hash1 < hash2) return -1;
+    if (hash1 > hash2) return 1;
+    return 0;
+}
+
+/**
+ * @brief Comparison function used to sort version indexes
+ */
+int diversity_compare_versions(const void * a, const void * b)
+{
+    return *(const int*)a - *(const int*)b;
+}
+
+/**
+ * @brief Returns the proportion of genomes within the current
+ *        generation which are unique, using genome hashes
+ * @param population The population object
+ * @returns Unique ratio in the range 0.0 -> 1.0
+ */
+float diversity_unique_ratio(sc_population * population)
+{
+    uint32_t * hashes;
+    int i, unique = 1;
+
+    hashes = (uint32_t*)malloc(population->size*sizeof(uint32_t));
+    if (hashes == NULL)
+        return 1;
+
+    for (i = 0; i < population->size; i++)
+        hashes[i] = genome_hash(population, population->individual[i]);
+
+    qsort((void*)hashes, population->size, sizeof(uint32_t),
+          diversity_compare_hashes);
+
+    for (i = 1; i < population->size; i++)
+        if (hashes[i] != hashes[i-1])
+            unique++;
+
+    free(hashes);
+
+    return unique / (float)population->size;
+}
+
+/**
+ * @brief Calculates the mean Hamming distance between pairs of genomes.
+ *        For small populations every pair is compared, otherwise
+ *        a random sample of pairs is used.
+ * @param population The population object
+ * @param random_seed Seed used to sample pairs
+ * @param normalised Returned mean distance in the range 0.0 -> 1.0
+ * @returns Mean distance in genes
+ */
+float diversity_hamming(sc_population * population, unsigned int * random_seed,
+                        float * normalised)
+{
+    int i, j, sample, pairs, max_steps, sampled = 0;
+    double distance = 0, max_distance = 0;
+    sc_genome * genome1, * genome2;
+
+    *normalised = 0;
+
+    pairs = population->size * (population->size - 1) / 2;
+    if (pairs <= 0)
+        return 0;
+
+    if (pairs > SC_DIVERSITY_SAMPLES) {
+        pairs = SC_DIVERSITY_SAMPLES;
+        sampled = 1;
+    }
+
+    i = 0;
+    j = 1;
+    for (sample = 0; sample < pairs; sample++) {
+        if (sampled) {
+            /* a random pair of different genomes */
+            i = rand_num(random_seed) % population->size;
+            j = rand_num(random_seed) % (population->size - 1);
+            if (j >= i) j++;
+        }
+
+        genome1 = population->individual[i];
+        genome2 = population->individual[j];
+
+        distance += genome_distance(population, genome1, genome2);
+
+        max_steps = genome1->steps;
+        if (genome2->steps > max_steps)
+            max_steps = genome2->steps;
+        max_distance += max_steps * population->sys.no_of_programs;
+
+        /* next pair in sequence */
+        if (++j >= population->size) {
+            i++;
+            j = i + 1;
+        }
+    }
+
+    if (max_distance > 0)
+        *normalised = (float)(distance / max_distance);
+
+    return (float)(distance / pairs);
+}
+
+/**
+ * @brief Calculates the mean entropy of version indexes at each locus.
+ *        Only loci at steps which at least two genomes have can be
+ *        measured, and if there are many of them a random sample is used.
+ * @param population The population object
+ * @param random_seed Seed used to sample loci
+ * @returns Mean entropy in bits, or zero if no locus could be measured
+ */
+float diversity_entropy(sc_population * population, unsigned int * random_seed)
+{
+    sc_population_columns * columns = population->columns;
+    int * values;
+    int i, k, ctr, locus, step, p, loci, samples, measured = 0;
+    int max_steps = 0, shared_steps = 0;
+    double entropy = 0, probability;
+
+    if (population->sys.no_of_programs <= 0)
+        return 0;
+
+    /* Steps below the second longest sequence are shared by at least
+       two genomes. Later steps only belong to the longest genome, so
+       there is nothing to compare them with */
+    for (i = 0; i < population->size; i++) {
+        step = population->individual[i]->steps;
+        if (step > max_steps) {
+            shared_steps = max_steps;
+            max_steps = step;
+        }
+        else if (step > shared_steps) {
+            shared_steps = step;
+        }
+    }
+
+    loci = shared_steps * population->sys.no_of_programs;
+    if (loci <= 0)
+        return 0;
+
+    samples = loci;
+    if (samples > SC_DIVERSITY_SAMPLES)
+        samples = SC_DIVERSITY_SAMPLES;
+
+    values = (int*)malloc(population->size*sizeof(int));
+    if (values == NULL)
+        return 0;
+
+    for (locus = 0; locus < samples; locus++) {
+        if (samples < loci) {
+            step = rand_num(random_seed) % shared_steps;
+            p = rand_num(random_seed) % population->sys.no_of_programs;
+        }
+        else {
+            step = locus / population->sys.no_of_programs;
+            p = locus % population->sys.no_of_programs;
+        }
+
+        /* versions at this locus for genomes which have this step */
+        k = 0;
+        for (i = 0; i < population->size; i++) {
+            if (population->individual[i]->steps <= step)
+                continue;
+            if (columns != NULL)
+                values[k++] =
+                    columns->version_index[((size_t)step*columns->no_of_programs + p) *
+                                           columns->size + i];
+            else
+                values[k++] =
+                    state_get_version(&population->sys,
+                                      genome_state(population,
+                                                   population->individual[i],
+                                                   step), p);
+        }
+        if (k < 2)
+            continue;
+        measured++;
+
+        qsort((void*)values, k, sizeof(int), diversity_compare_versions);
+
+        /* count runs of the same version */
+        ctr = 1;
+        for (i = 1; i <= k; i++) {
+            if ((i < k) && (values[i] == values[i-1])) {
+                ctr++;
+                continue;
+            }
+            probability = ctr / (double)k;
+            entropy -= probability * log2(probability);
+            ctr = 1;
+        }
+    }
+
+    free(values);
+
+    if (measured == 0)
+        return 0;
+
+    return (float)(entropy / measured);
+}
+
+/**
+ * @brief Measures the diversity of the current generation.
+ *        Sampling uses its own random seed so that measuring diversity
+ *        doesn't alter the course of the search. It is measured afresh
+ *        each generation, since most genomes are replaced, and the cost
+ *        is bounded by SC_DIVERSITY_SAMPLES.
+ * @param population The population object
+ * @returns zero on success
+ */
+int population_diversity_update(sc_population * population)
+{
+    unsigned int random_seed = population->random_seed;
+    sc_diversity * diversity = &population->diversity;
+
+    if (population->size <= 0)
+        return 1;
+
+    diversity->unique_ratio = diversity_unique_ratio(population);
+    diversity->hamming =
+        diversity_hamming(population, &random_seed,
+                          &diversity->hamming_normalised);
+    diversity->entropy = diversity_entropy(population, &random_seed);
+
+    return 0;
+}
+
+/**
+ * @brief Returns whether the population has lost diversity or the
+ *        search has stagnated, based upon the last diversity update
+ * @param population The population object
+ * @returns zero if neither, 1 if diversity is lost or 2 if stagnated
+ */
+int population_diversity_lost(sc_population * population)
+{
+    if ((population->diversity.hamming_normalised <
+         population->diversity_threshold) ||
+        (population->diversity.unique_ratio <
+         population->unique_threshold))
+        return 1;
+
+    if ((population->stagnation_limit > 0) &&
+        (population->stagnant_generations >= population->stagnation_limit))
+        return 2;
+
+    return 0;
+}
@@ -0,0 +1,509 @@
+/*
+  Smart search for upgrade paths
+  Copyright (C) 2016 Andrew Leeming <andrew.leeming@codethink.co.uk> and
+  Bob Mottram <bob.mottram@codethink.co.uk>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "scalam.h"
+
+static char * stage_name[] = { "configure", "build", "test" };
+
+/**
+ * @brief Returns a monotonic time in seconds, for timing stages
+ * @returns Time in seconds
+ */
+static double evaluator_seconds()
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + ((double)t.tv_nsec / 1000000000.0);
+}
+
+/**
+ * @brief Initialises an evaluator which runs a shell command for each stage
+ * @param evaluator The evaluator to be initialised
+ * @param command Command to be run for each stage of each program
+ * @param repos_dir Directory containing the repos
+ * @param install_prefix Directory into which programs are installed
+ */
+void evaluator_init(sc_evaluator * evaluator, char * command,
+                    char * repos_dir, char * install_prefix)
+{
+    int p;
+
+    memset((void*)evaluator, '\0', sizeof(sc_evaluator));
+
+    if (command != NULL)
+        sprintf(evaluator->command, "%s", command);
+    if (repos_dir != NULL)
+        sprintf(evaluator->repos_dir, "%s", repos_dir);
+    if (install_prefix != NULL)
+        sprintf(evaluator->install_prefix, "%s", install_prefix);
+
+    evaluator->abort_on_failure = 1;
+
+    /* nothing has been tested yet */
+    for (p = 0; p < SC_MAX_SYSTEM_SIZE; p++)
+        evaluator->max_test_passes[p] = -1;
+}
+
+/**
+ * @brief Allocates space for the install steps of any genome
+ *        within a population
+ * @param evaluation The evaluation to be created
+ * @param population The population object
+ * @returns zero on success
+ */
+int evaluation_create(sc_evaluation * evaluation, sc_population * population)
+{
+    memset((void*)evaluation, '\0', sizeof(sc_evaluation));
+
+    evaluation->max_install_steps =
+        SC_MAX_CHANGE_SEQUENCE * population->sys.no_of_programs;
+    if (evaluation->max_install_steps <= 0)
+        return 1;
+
+    evaluation->result =
+        (sc_program_result*)malloc(evaluation->max_install_steps *
+                                   sizeof(sc_program_result));
+    if (evaluation->result == NULL)
+        return 2;
+
+    evaluation->reference_state =
+        (unsigned char*)malloc(population->sys.state_bytes);
+    if (evaluation->reference_state == NULL) {
+        evaluation_free(evaluation);
+        return 3;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Deallocates an evaluation
+ * @param evaluation The evaluation object
+ */
+void evaluation_free(sc_evaluation * evaluation)
+{
+    free(evaluation->result);
+    evaluation->result = NULL;
+    free(evaluation->reference_state);
+    evaluation->reference_state = NULL;
+    evaluation->max_install_steps = 0;
+}
+
+/**
+ * @brief Returns the packed state after a step of a genome. A genome
+ *        with no steps goes straight to the goal, so its only step
+ *        is the reference state
+ * @param population The population object
+ * @param individual The genome
+ * @param evaluation Evaluation holding the packed reference state
+ * @param step Index of the step
+ * @returns The packed state
+ */
+static unsigned char * evaluator_step_state(sc_population * population,
+                                            sc_genome * individual,
+                                            sc_evaluation * evaluation,
+                                            int step)
+{
+    if (individual->steps == 0)
+        return evaluation->reference_state;
+
+    return genome_state(population, individual, step);
+}
+
+/**
+ * @brief Creates the ordered list of install steps for a genome.
+ *        At the first step every installed program is installed.
+ *        At later steps only programs which are newly installed or
+ *        which change version are installed. A genome with no steps
+ *        has a single step which installs the reference state.
+ * @param population The population object
+ * @param index Array index of the genome within the population
+ * @param evaluation Returned install steps, with their results cleared
+ * @returns zero on success
+ */
+int evaluator_install_steps(sc_population * population, int index,
+                            sc_evaluation * evaluation)
+{
+    sc_system * sys = &population->sys;
+    sc_genome * individual;
+    sc_program_result * result;
+    unsigned char * state, * prev_state = NULL;
+    int step, p, version_index, no_of_steps;
+
+    if ((index < 0) || (index >= population->size))
+        return 1;
+
+    individual = population->individual[index];
+
+    evaluation->no_of_install_steps = 0;
+    evaluation->no_of_results = 0;
+    evaluation->programs_passed = 0;
+    evaluation->test_passes = 0;
+    evaluation->steps_completed = 0;
+    evaluation->aborted = 0;
+    evaluation->abort_reason = SC_ABORT_NONE;
+    evaluation->upper_bound = 0;
+    evaluation->duration = 0;
+
+    no_of_steps = individual->steps;
+    if (no_of_steps == 0) {
+        state_pack(sys, &population->goal.reference,
+                   evaluation->reference_state);
+        no_of_steps = 1;
+    }
+
+    for (step = 0; step < no_of_steps; step++) {
+        state = evaluator_step_state(population, individual, evaluation, step);
+
+        for (p = 0; p < sys->no_of_programs; p++) {
+            if (!state_get_installed(sys, state, p))
+                continue;
+
+            version_index = state_get_version(sys, state, p);
+
+            /* already installed at this version */
+            if ((prev_state != NULL) &&
+                state_get_installed(sys, prev_state, p) &&
+                (state_get_version(sys, prev_state, p) == version_index))
+                continue;
+
+            if (evaluation->no_of_install_steps >= evaluation->max_install_steps)
+                return 2;
+
+            result = &evaluation->result[evaluation->no_of_install_steps++];
+            memset((void*)result, '\0', sizeof(sc_program_result));
+            result->step = step;
+            result->program_index = p;
+            result->version_index = version_index;
+        }
+
+        prev_state = state;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Runs the evaluator command for one stage of one program.
+ *        The stage passes if the command exits with zero status.
+ *        The command may contain its own arguments or environment
+ *        variables, so it is run by a shell, but the arguments added
+ *        here are passed separately rather than being quoted within it.
+ * @returns zero if the stage passed
+ */
+static int evaluator_run_command(sc_evaluator * evaluator, sc_system * sys,
+                                 int stage, int program_index,
+                                 int version_index, char * source_dir,
+                                 char * install_prefix,
+                                 int * test_passes, int * test_failures)
+{
+    char commandstr[SC_MAX_STRING+8];
+    char version[SC_MAX_STRING];
+    char * argv[] = {
+        "/bin/sh", "-c", commandstr, "scalam", stage_name[stage],
+        string_pool_get(sys->program[program_index].name), version,
+        source_dir, install_prefix, NULL
+    };
+    sc_process_options options;
+    sc_process_result result;
+    char * line;
+    int passes, failures;
+
+    /* the version index is passed on when there is no commit for it */
+    if (program_version_from_index(&sys->program[program_index],
+                                   version_index, version) != 0)
+        sprintf(version, "%d", version_index);
+
+    sprintf(commandstr, "%s \"$@\"", evaluator->command);
+
+    process_options_init(&options);
+    options.timeout = (int)(evaluator->stage_timeout*1000);
+    process_run_with_options(argv, &options, &result);
+
+    if ((stage == SC_STAGE_TEST) && (result.output != NULL)) {
+        /* the last line containing numbers is the test summary */
+        line = result.output;
+        while (line != NULL) {
+            if (sscanf(line, "%d %d", &passes, &failures) == 2) {
+                *test_passes = passes;
+                *test_failures = failures;
+            }
+            line = strchr(line, '\n');
+            if (line != NULL)
+                line++;
+        }
+    }
+    process_result_free(&result);
+
+    if (result.exit_status == SC_PROCESS_NOT_RUN)
+        return 1;
+    if (result.exit_status < 0)
+        return 2;
+
+    return result.exit_status;
+}
+
+/**
+ * @brief Configures, builds and tests a single program
+ * @param evaluator The evaluator object
+ * @param sys System object
+ * @param source_dir Directory containing the source for the program
+ * @param install_prefix Directory into which the program is installed
+ * @param result The install step, which is returned with its results
+ */
+static void evaluator_run_program(sc_evaluator * evaluator, sc_system * sys,
+                                  char * source_dir, char * install_prefix,
+                                  sc_program_result * result)
+{
+    int stage, retval;
+    int test_passes, test_failures;
+    double start_time;
+
+    for (stage = 0; stage < SC_STAGES; stage++) {
+        test_passes = -1;
+        test_failures = 0;
+        start_time = evaluator_seconds();
+
+        if (evaluator->backend != NULL)
+            retval = evaluator->backend(evaluator->backend_context, sys,
+                                        stage, result->program_index,
+                                        result->version_index,
+                                        source_dir, install_prefix,
+                                        &test_passes, &test_failures);
+        else
+            retval = evaluator_run_command(evaluator, sys, stage,
+                                           result->program_index,
+                                           result->version_index,
+                                           source_dir, install_prefix,
+                                           &test_passes, &test_failures);
+
+        result->duration[stage] = evaluator_seconds() - start_time;
+        result->passed[stage] = (retval == 0);
+
+        if (stage == SC_STAGE_TEST) {
+            /* with no test summary a passing test stage counts as one pass */
+            if (test_passes < 0)
+                test_passes = result->passed[stage];
+            result->test_passes = test_passes;
+            result->test_failures = test_failures;
+        }
+
+        if (!result->passed[stage])
+            break;
+    }
+}
+
+/**
+ * @brief Returns an optimistic score for a genome part way through its
+ *        evaluation. Each remaining install step is assumed to pass
+ *        as many tests as the most seen for that program so far.
+ * @param evaluator The evaluator object
+ * @param population The population object
+ * @param index Array index of the genome within the population
+ * @param evaluation Evaluation of the genome so far
+ * @param next_install_step Index of the next install step to be evaluated
+ * @returns Upper bound score, or INFINITY if a remaining program
+ *          hasn't been tested yet
+ */
+float evaluator_upper_bound(sc_evaluator * evaluator, sc_population * population,
+                            int index, sc_evaluation * evaluation,
+                            int next_install_step)
+{
+    int i, max_passes, test_passes = evaluation->test_passes;
+
+    for (i = next_install_step; i < evaluation->no_of_install_steps; i++) {
+        max_passes = evaluator->max_test_passes[evaluation->result[i].program_index];
+        if (max_passes < 0)
+            return INFINITY;
+        test_passes += max_passes;
+    }
+
+    /* the same weighting as population_set_test_passes, with every
+       step completed, so it is never below the partial score */
+    return (float)test_passes /
+        (float)(1 + population->individual[index]->steps);
+}
+
+/**
+ * @brief Ends an evaluation early
+ * @param evaluation The evaluation object
+ * @param reason The reason for ending, such as SC_ABORT_FAILURE
+ */
+static void evaluator_abort(sc_evaluation * evaluation, int reason)
+{
+    evaluation->aborted = 1;
+    evaluation->abort_reason = reason;
+}
+
+/**
+ * @brief Evaluates a genome by building and testing each of its install
+ *        steps in order, then sets its score from the number of tests
+ *        which passed. Results are passed to the callback as each program
+ *        completes, and the evaluation stops early if a stage fails
+ *        and abort_on_failure is set, or if the callback asks it to.
+ *        Evaluation also ends when the time or step budget runs out,
+ *        or when pruning is enabled and the genome can no longer beat
+ *        the elite score. In those cases the genome gets a partial score
+ *        from the tests which passed so far.
+ * @param evaluator The evaluator object
+ * @param population The population object
+ * @param index Array index of the genome within the population
+ * @param evaluation Returned results, created with evaluation_create
+ * @returns zero on success
+ */
+int evaluator_run(sc_evaluator * evaluator, sc_population * population,
+                  int index, sc_evaluation * evaluation)
+{
+    sc_system * sys = &population->sys;
+    sc_program_result * result;
+    char source_dir[SC_MAX_STRING*2];
+    char * install_prefix = evaluator->install_prefix;
+    int i, workspace = -1, checked_out_step = -1, failed, retval;
+    double start_time = evaluator_seconds();
+
+    if ((evaluator->backend == NULL) && (evaluator->command[0] == 0))
+        return 1;
+
+    if (evaluator_install_steps(population, index, evaluation) != 0)
+        return 2;
+
+    if (evaluator->workspaces != NULL) {
+        workspace = workspace_acquire(evaluator->workspaces);
+        if (workspace < 0)
+            return 3;
+        install_prefix = evaluator->workspaces->workspace[workspace].install_prefix;
+    }
+
+    for (i = 0; i < evaluation->no_of_install_steps; i++) {
+        result = &evaluation->result[i];
+
+        if ((evaluator->step_budget > 0) && (i >= evaluator->step_budget)) {
+            evaluator_abort(evaluation, SC_ABORT_STEPS);
+            break;
+        }
+
+        if ((evaluator->time_budget > 0) &&
+            (evaluator_seconds() - start_time >= evaluator->time_budget)) {
+            evaluator_abort(evaluation, SC_ABORT_TIME);
+            break;
+        }
+
+        /* a hopeless genome isn't worth building any further */
+        if (evaluator->prune && (evaluator->elite_score > 0) &&
+            (evaluator_upper_bound(evaluator, population, index,
+                                   evaluation, i) <= evaluator->elite_score)) {
+            evaluator_abort(evaluation, SC_ABORT_PRUNED);
+            break;
+        }
+
+        if (workspace >= 0) {
+            /* update the sources at the start of each step */
+            if (result->step != checked_out_step) {
+                if (workspace_checkout(evaluator->workspaces, workspace, sys,
+                                       evaluator_step_state(population,
+                                                            population->individual[index],
+                                                            evaluation,
+                                                            result->step)) != 0) {
+                    evaluator_abort(evaluation, SC_ABORT_FAILURE);
+                    break;
+                }
+                checked_out_step = result->step;
+            }
+            workspace_program_directory(evaluator->workspaces, workspace, sys,
+                                        result->program_index, source_dir);
+        }
+        else {
+            sprintf(source_dir, "%s/%s", evaluator->repos_dir,
+                    string_pool_get(sys->program[result->program_index].name));
+        }
+
+        evaluator_run_program(evaluator, sys, source_dir, install_prefix, result);
+        evaluation->no_of_results++;
+
+        failed = !result->passed[SC_STAGE_TEST];
+        if (!failed)
+            evaluation->programs_passed++;
+        evaluation->test_passes += result->test_passes;
+
+        if (result->passed[SC_STAGE_BUILD]) {
+#pragma omp critical (evaluator)
+            {
+                if (result->test_passes >
+                    evaluator->max_test_passes[result->program_index])
+                    evaluator->max_test_passes[result->program_index] =
+                        result->test_passes;
+
+                /* builds at the reference version show how many
+                   tests the goal should pass */
+                goal_record_result(&population->goal, result);
+            }
+        }
+
+        if (evaluator->callback != NULL) {
+            if (evaluator->callback(evaluator->callback_context, index, result) != 0) {
+                evaluator_abort(evaluation, SC_ABORT_CALLBACK);
+                break;
+            }
+        }
+
+        /* there is no point building later steps on a broken one */
+        if (failed && evaluator->abort_on_failure) {
+            if (i < evaluation->no_of_install_steps - 1)
+                evaluator_abort(evaluation, SC_ABORT_FAILURE);
+            break;
+        }
+    }
+
+    /* steps are complete up to the first one which didn't pass */
+    evaluation->steps_completed = population->individual[index]->steps;
+    for (i = 0; i < evaluation->no_of_install_steps; i++) {
+        if ((i >= evaluation->no_of_results) ||
+            !evaluation->result[i].passed[SC_STAGE_TEST]) {
+            evaluation->steps_completed = evaluation->result[i].step;
+            break;
+        }
+    }
+
+    if (workspace >= 0)
+        workspace_release(evaluator->workspaces, workspace);
+
+    evaluation->duration = evaluator_seconds() - start_time;
+
+    retval = population_set_partial_score(population, index,
+                                          evaluation->test_passes,
+                                          evaluation->steps_completed);
+    if (retval != 0)
+        return 10 + retval;
+    population->individual[index]->build_time = (float)evaluation->duration;
+
+    evaluation->upper_bound = population->individual[index]->score;
+    if (evaluation->aborted)
+        evaluation->upper_bound =
+            evaluator_upper_bound(evaluator, population, index, evaluation,
+                                  evaluation->no_of_results);
+
+#pragma omp critical (evaluator)
+    {
+        if (population->individual[index]->score > evaluator->elite_score)
+            evaluator->elite_score = population->individual[index]->score;
+    }
+
+    return 0;
+}
@@ -19,6 +19,81 @@
 
 #include "scalam.h"
 
+/**
+ * @brief Returns the number of bytes needed for a genome within
+ *        the given population
+ * @param population The population in which the genome exists
+ * @returns Size of a genome in bytes
+ */
+size_t genome_size(sc_population * population)
+{
+    return sizeof(sc_genome) +
+        (size_t)SC_MAX_CHANGE_SEQUENCE * (size_t)population->sys.state_bytes;
+}
+
+/**
+ * @brief Returns the packed system state for an upgrade step
+ * @param population The population in which the genome exists
+ * @param individual The genome
+ * @param step The index within the upgrade series
+ * @returns Pointer to the packed state
+ */
+unsigned char * genome_state(sc_population * population,
+                             sc_genome * individual, int step)
+{
+    return (unsigned char*)individual->change +
+        (size_t)step * (size_t)population->sys.state_bytes;
+}
+
+/**
+ * @brief Returns a hash of the upgrade sequence of a genome.
+ *        Genomes with the same upgrade sequence have the same hash.
+ * @param population The population in which the genome exists
+ * @param individual The genome
+ * @returns Hash value
+ */
+uint32_t genome_hash(sc_population * population, sc_genome * individual)
+{
+    uint32_t hash = 2166136261U;
+    int step;
+
+    hash = (hash ^ (uint32_t)individual->steps) * 16777619U;
+    for (step = 0; step < individual->steps; step++)
+        hash = state_hash(&population->sys,
+                          genome_state(population, individual, step), hash);
+
+    return hash;
+}
+
+/**
+ * @brief Returns the number of genes which differ between two genomes.
+ *        Steps which only one of the genomes has count as entirely different.
+ * @param population The population in which the genomes exist
+ * @param genome1 The first genome
+ * @param genome2 The second genome
+ * @returns Hamming distance in genes
+ */
+int genome_distance(sc_population * population,
+                    sc_genome * genome1, sc_genome * genome2)
+{
+    int step, distance = 0;
+    int min_steps = genome1->steps;
+    int max_steps = genome2->steps;
+
+    if (min_steps > max_steps) {
+        min_steps = genome2->steps;
+        max_steps = genome1->steps;
+    }
+
+    for (step = 0; step < min_steps; step++)
+        distance += state_distance(&population->sys,
+                                   genome_state(population, genome1, step),
+                                   genome_state(population, genome2, step));
+
+    return distance +
+        (max_steps - min_steps) * population->sys.no_of_programs;
+}
+
 /**
  * @brief Creates a single upgrade step consisting of a set of programs,
  *        their versions/commits and whether they are installed or not
@@ -32,6 +107,7 @@ int genome_create_installation_step(sc_population * population,
                                     int upgrade_step)
 {
     int prog_index;
+    unsigned char * state = genome_state(population, individual, upgrade_step);
 
     /* for each possible program within the system */
     for (prog_index = 0;
@@ -43,13 +119,13 @@ int genome_create_installation_step(sc_population * population,
             return 2;
 
         /* assign a random version/commit for this program */
-        individual->change[upgrade_step].version_index[prog_index] =
-            rand_num(&individual->random_seed) %
-            population->sys.program[prog_index].no_of_versions;
+        state_set_version(&population->sys, state, prog_index,
+                          rand_num(&individual->random_seed) %
+                          population->sys.program[prog_index].no_of_versions);
 
         /* assign a random install state for this program, 0 or 1 */
-        individual->change[upgrade_step].installed[prog_index] =
-            rand_num(&individual->random_seed) % 2;
+        state_set_installed(&population->sys, state, prog_index,
+                            rand_num(&individual->random_seed) % 2);
     }
 
     return 0;
@@ -75,6 +151,7 @@ int genome_mutate_existing_programs(sc_population * population, sc_genome * indi
 {
     /* mutate a program in an existing install step */
     int install_step, gene_index, no_of_programs, vindex;
+    unsigned char * state;
 
     if (individual->steps <= 0)
         return 0;
@@ -87,30 +164,32 @@ int genome_mutate_existing_programs(sc_population * population, sc_genome * indi
     if (population->sys.program[gene_index].no_of_versions <= 0)
         return 1;
 
+    state = genome_state(population, individual, install_step);
+
     if (rand_num(&individual->random_seed) % 2 == 0) {
 
         /* commit of version index within versions_file */
-        vindex = individual->change[install_step].version_index[gene_index];
+        vindex = state_get_version(&population->sys, state, gene_index);
 
         /* incremental: tweak the version/commit up or down */
         if (rand_num(&individual->random_seed) % 2 == 0) {
             /* don't exceed the number of versions in versions_file */
             if (vindex <
                 population->sys.program[gene_index].no_of_versions - 1) {
-                individual->change[install_step].version_index[gene_index]++;
+                state_set_version(&population->sys, state, gene_index, vindex+1);
             }
         }
         else {
             /* don't index below zero */
             if (vindex > 0)
-                individual->change[install_step].version_index[gene_index]--;
+                state_set_version(&population->sys, state, gene_index, vindex-1);
         }
     }
     else {
         /* absolute: any version/commit may be selected */
-        individual->change[install_step].version_index[gene_index] =
-            rand_num(&individual->random_seed) %
-            population->sys.program[gene_index].no_of_versions;
+        state_set_version(&population->sys, state, gene_index,
+                          rand_num(&individual->random_seed) %
+                          population->sys.program[gene_index].no_of_versions);
     }
     return 0;
 }
@@ -123,11 +202,12 @@ int genome_mutate_existing_programs(sc_population * population, sc_genome * indi
  */
 int genome_mutate_insertion_deletion(sc_population * population, sc_genome * individual)
 {
-    int upgrade_step, removal_index;
+    int removal_index;
     int mutation_type = rand_num(&individual->random_seed) % 2;
     if (mutation_type == 1) {
         /* add an upgrade step */
-        if (individual->steps < population->sys.no_of_programs-1) {
+        if ((individual->steps < population->sys.no_of_programs-1) &&
+            (individual->steps < SC_MAX_CHANGE_SEQUENCE)) {
             /* create another installation step */
             if (genome_create_installation_step(population,
                                                 individual,
@@ -142,12 +222,10 @@ int genome_mutate_insertion_deletion(sc_population * population, sc_genome * ind
             removal_index = rand_num(&individual->random_seed) % individual->steps;
 
             /* shuffle the subsequent steps down to fill the gap */
-            for (upgrade_step = removal_index;
-                 upgrade_step < individual->steps; upgrade_step++) {
-                memcpy((void*)&individual->change[upgrade_step],
-                       (void*)&individual->change[upgrade_step+1],
-                       sizeof(sc_system_state));
-            }
+            memmove((void*)genome_state(population, individual, removal_index),
+                    (void*)genome_state(population, individual, removal_index+1),
+                    (size_t)(individual->steps - removal_index - 1) *
+                    (size_t)population->sys.state_bytes);
 
             /* decrement the number of install steps */
             individual->steps--;
@@ -197,8 +275,9 @@ int genome_spawn(sc_population * population,
                  sc_genome * parent1, sc_genome * parent2,
                  sc_genome * child)
 {
+    uint64_t mask[(SC_MAX_SYSTEM_SIZE + 63) / 64];
     int install_step, p;
-    sc_genome * parent;
+    unsigned char * child_state;
 
     /* check that objects have been allocated */
     if (population == NULL) return 1;
@@ -212,9 +291,17 @@ int genome_spawn(sc_population * population,
     if (rand_num(&parent1->random_seed)%100 > 50)
         child->steps = parent2->steps;
 
-    /* clear scores */
+    /* clear scores, and anything left by the previous genome
+       which occupied this space */
     child->score = 0;
     child->spawning_probability = 0;
+    child->evaluated = 0;
+    child->steps_completed = 0;
+    child->test_passes = 0;
+    child->goal_distance = 0;
+    child->build_time = 0;
+    child->rank = 0;
+    child->crowding = 0;
 
     /* Set random number generator seed */
     if (rand_num(&parent1->random_seed)%100 > 50)
@@ -224,29 +311,35 @@ int genome_spawn(sc_population * population,
 
     /* At every install step */
     for (install_step = 0; install_step < child->steps; install_step++) {
+        child_state = genome_state(population, child, install_step);
 
-        /* for each program (gene) in the system */
-        for (p = 0; p < population->sys.no_of_programs; p++) {
-
-            /* choose a parent */
-            parent = parent1;
+        /* choose a parent for each program (gene) in the system,
+           with a set bit meaning the second parent */
+        memset((void*)mask, '\0',
+               population->sys.installed_words*sizeof(uint64_t));
+        for (p = 0; p < population->sys.no_of_programs; p++)
             if (rand_num(&child->random_seed)%100 > 50)
-                parent = parent2;
-
-            /* does this install step exceed the number
-               for the parent? */
-            if (install_step >= parent->steps)
-                if (parent == parent1)
-                    parent = parent2;
-                else
-                    parent = parent1;
-
-            /* get a program (gene) from this parent */
-            child->change[install_step].version_index[p] =
-                parent->change[install_step].version_index[p];
-            child->change[install_step].installed[p] =
-                parent->change[install_step].installed[p];
+                mask[p >> 6] |= (uint64_t)1 << (p & 63);
+
+        /* does this install step exceed the number
+           for one of the parents? */
+        if (install_step >= parent1->steps) {
+            memcpy((void*)child_state,
+                   (void*)genome_state(population, parent2, install_step),
+                   population->sys.state_bytes);
+            continue;
         }
+        if (install_step >= parent2->steps) {
+            memcpy((void*)child_state,
+                   (void*)genome_state(population, parent1, install_step),
+                   population->sys.state_bytes);
+            continue;
+        }
+
+        state_crossover(&population->sys,
+                        genome_state(population, parent1, install_step),
+                        genome_state(population, parent2, install_step),
+                        mask, child_state);
     }
 
     return genome_mutate(population, child);
@@ -266,7 +359,7 @@ int genome_create(sc_population * population, sc_genome * individual)
     int upgrade_step, prog_index;
 
     /* clear all values */
-    memset((void*)individual,'\0',sizeof(sc_genome));
+    memset((void*)individual,'\0',genome_size(population));
 
     /* Assign a random seed for this individual.
        Each genome has its own random seed so that evaluations could
@@ -39,22 +39,277 @@ int goal_create_latest_versions(sc_system * sys, sc_goal * goal)
         goal->start.installed[p] = sys->program[p].installed;
 
         /* goal is just all programs installed and on their final
-           commit (the head of master) */
-        goal->reference.version_index[p] = sys->program[p].no_of_versions;
+           commit (the head of master), which is the last valid index */
+        goal->reference.version_index[p] = 0;
+        if (sys->program[p].no_of_versions > 0)
+            goal->reference.version_index[p] =
+                sys->program[p].no_of_versions - 1;
         goal->reference.installed[p] = 1;
+
+        /* not known until the reference version has been built */
+        goal->test_passes[p] = -1;
+    }
+
+    return goal_update_distances(sys, goal);
+}
+
+/**
+ * @brief Returns how far a single program is from its reference.
+ *        The distance is the number of versions away from the reference
+ *        version. A program which should be installed but isn't is further
+ *        away than any installed version, and a program which shouldn't be
+ *        installed but is has a distance of one.
+ * @param sys System object
+ * @param goal Goal object
+ * @param program_index Array index of the program within the system
+ * @param installed Whether the program is installed
+ * @param version_index Version index of the program
+ * @returns Distance from the reference
+ */
+int goal_program_distance(sc_system * sys, sc_goal * goal, int program_index,
+                          int installed, int version_index)
+{
+    int distance;
+
+    if (!goal->reference.installed[program_index])
+        return (installed != 0);
+
+    if (!installed)
+        return sys->program[program_index].no_of_versions + 1;
+
+    distance = version_index - goal->reference.version_index[program_index];
+    if (distance < 0)
+        distance = -distance;
+
+    return distance;
+}
+
+/**
+ * @brief Precomputes the distance of each program from the reference
+ *        at the start. This should be called if the start or reference
+ *        of a goal are changed.
+ * @param sys System object
+ * @param goal Goal object
+ * @returns zero on success
+ */
+int goal_update_distances(sc_system * sys, sc_goal * goal)
+{
+    int p;
+
+    if ((sys->no_of_programs < 0) ||
+        (sys->no_of_programs > SC_MAX_SYSTEM_SIZE))
+        return 1;
+
+    goal->start_distance = 0;
+    for (p = 0; p < sys->no_of_programs; p++) {
+        goal->distance[p] =
+            goal_program_distance(sys, goal, p,
+                                  goal->start.installed[p],
+                                  goal->start.version_index[p]);
+        goal->start_distance += goal->distance[p];
     }
 
     return 0;
 }
 
 /**
- * @brief Calculates what the ideal end goal score is
+ * @brief Returns the distance of a packed system state from the reference
+ * @param sys System object
+ * @param goal Goal object
+ * @param state Packed system state
+ * @returns Total distance from the reference
+ */
+int goal_state_distance(sc_system * sys, sc_goal * goal, unsigned char * state)
+{
+    int p, distance = 0;
+
+    for (p = 0; p < sys->no_of_programs; p++)
+        distance +=
+            goal_program_distance(sys, goal, p,
+                                  state_get_installed(sys, state, p),
+                                  state_get_version(sys, state, p));
+
+    return distance;
+}
+
+/**
+ * @brief Returns the distance of a packed system state from the reference,
+ *        given the distance of a previous state. Only the programs which
+ *        changed are visited.
+ * @param sys System object
  * @param goal Goal object
- * @returns score or negative on error
+ * @param prev_state The previous packed state
+ * @param state The packed state
+ * @param prev_distance Distance of the previous state from the reference
+ * @returns Total distance from the reference
+ */
+int goal_distance_update(sc_system * sys, sc_goal * goal,
+                         unsigned char * prev_state, unsigned char * state,
+                         int prev_distance)
+{
+    int changed[SC_MAX_SYSTEM_SIZE];
+    int i, p, no_of_changes, distance = prev_distance;
+
+    no_of_changes = state_changed_programs(sys, prev_state, state, changed);
+
+    for (i = 0; i < no_of_changes; i++) {
+        p = changed[i];
+        distance +=
+            goal_program_distance(sys, goal, p,
+                                  state_get_installed(sys, state, p),
+                                  state_get_version(sys, state, p)) -
+            goal_program_distance(sys, goal, p,
+                                  state_get_installed(sys, prev_state, p),
+                                  state_get_version(sys, prev_state, p));
+    }
+
+    return distance;
+}
+
+/**
+ * @brief Calculates the distance from the reference at each step of
+ *        an upgrade sequence. The first step is calculated in full
+ *        and later steps incrementally.
+ * @param population The population object
+ * @param individual The genome
+ * @param distance Returned distance at each step of the genome
+ * @returns The distance at the end of the sequence. A genome with no
+ *          steps goes straight to the goal, so has a distance of zero
+ */
+int goal_genome_distances(sc_population * population, sc_genome * individual,
+                          int * distance)
+{
+    sc_system * sys = &population->sys;
+    unsigned char * state, * prev_state;
+    int step, current = 0;
+
+    for (step = 0; step < individual->steps; step++) {
+        state = genome_state(population, individual, step);
+        if (step == 0) {
+            current = goal_state_distance(sys, &population->goal, state);
+        }
+        else {
+            prev_state = genome_state(population, individual, step-1);
+            current = goal_distance_update(sys, &population->goal,
+                                           prev_state, state, current);
+        }
+        if (distance != NULL)
+            distance[step] = current;
+    }
+
+    return current;
+}
+
+/**
+ * @brief Records the number of tests which pass for a program once it
+ *        is at its reference version, from a real build
+ * @param goal Goal object
+ * @param result Result of building and testing one program
+ * @returns 1 if the result was for the reference version, otherwise zero
+ */
+int goal_record_result(sc_goal * goal, sc_program_result * result)
+{
+    int p = result->program_index;
+
+    if ((p < 0) || (p >= SC_MAX_SYSTEM_SIZE))
+        return 0;
+
+    if (!goal->reference.installed[p] ||
+        (result->version_index != goal->reference.version_index[p]) ||
+        !result->passed[SC_STAGE_BUILD])
+        return 0;
+
+    if (result->test_passes > goal->test_passes[p])
+        goal->test_passes[p] = result->test_passes;
+    return 1;
+}
+
+/**
+ * @brief Calculates what the ideal end goal score is. That is the score
+ *        of a genome which goes straight to the goal with every test
+ *        passing. It is only known once every program has been built
+ *        at its reference version, see goal_record_result.
+ * @param goal Goal object
+ * @returns score, or negative if the reference test counts are not
+ *          yet known
  */
 float goal_max_score(sc_goal * goal)
 {
-    /* TODO */
+    int p, test_passes = 0;
+
+    for (p = 0; p < SC_MAX_SYSTEM_SIZE; p++) {
+        if (!goal->reference.installed[p])
+            continue;
+        if (goal->test_passes[p] < 0)
+            return -1;
+        test_passes += goal->test_passes[p];
+    }
+
+    /* scores are divided by one more than the number of steps */
+    return (float)test_passes;
+}
+
+/**
+ * @brief Returns whether the best genome of a population has reached
+ *        the maximum possible score, after which there is no point
+ *        searching further
+ * @param population The population object
+ * @returns non-zero if the maximum score has been reached
+ */
+int goal_reached(sc_population * population)
+{
+    float max_score = goal_max_score(&population->goal);
+
+    if (max_score <= 0)
+        return 0;
+
+    return (population_best_score(population) >= max_score);
+}
+
+/**
+ * @brief Returns the number of tests expected to pass at the reference,
+ *        assuming a single test for each program not yet measured
+ * @param goal Goal object
+ * @returns Expected number of test passes
+ */
+static float goal_expected_test_passes(sc_goal * goal)
+{
+    int p, test_passes = 0;
+
+    for (p = 0; p < SC_MAX_SYSTEM_SIZE; p++) {
+        if (!goal->reference.installed[p])
+            continue;
+        if (goal->test_passes[p] < 0)
+            test_passes++;
+        else
+            test_passes += goal->test_passes[p];
+    }
+    return (float)test_passes;
+}
+
+/**
+ * @brief Returns a cheap estimate of the score of a genome without
+ *        building it, from how close its final step gets to the goal
+ * @param population The population object
+ * @param individual The genome
+ * @returns Estimated score. Once the reference test counts are known
+ *          it is no more than goal_max_score
+ */
+float goal_heuristic_score(sc_population * population, sc_genome * individual)
+{
+    sc_goal * goal = &population->goal;
+    float closeness = 1;
+    int distance;
+
+    distance = goal_genome_distances(population, individual, NULL);
+
+    if (goal->start_distance > 0) {
+        closeness = 1.0f - ((float)distance / (float)goal->start_distance);
+        if (closeness < 0)
+            closeness = 0;
+    }
 
-    return 0.0;
+    /* weighted in the same way as real scores */
+    return goal_expected_test_passes(goal) * closeness /
+        (float)(1 + individual->steps);
 }
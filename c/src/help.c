@@ -25,9 +25,65 @@ void show_help()
 
     printf(" -v --version             Show version number\n");
     printf(" -r --run                 Run a simulation\n");
+    printf(" -s --synthetic           Run against a synthetic build oracle\n");
+    printf(" -w --sweep               Sweep hyper-parameters with parallel runs\n");
+    printf(" -i --ingest              Fetch and index the versions of many programs\n");
+
+    printf("\nOptions for every mode:\n");
+    printf(" --seed number            Random seed, so that a run can be repeated\n");
+    printf(" --threads number         Maximum number of threads\n");
+    printf("                          Results don't depend upon the number of threads\n");
+    printf(" --manifest filename      Where to record the seed, parameters and system\n");
+    printf("                          fingerprint of a run, default %s\n", SC_DEFAULT_MANIFEST_FILENAME);
     
     printf("\nSimulation mode:\n");
-    printf(" %s -r|--run repos_dir max_generation\n", (char*)APPNAME);
+    printf(" %s -r|--run repos_dir max_generation [build_command]\n", (char*)APPNAME);
     printf("  repos_dir               Directory where repo is located\n");
     printf("  max_generation          Maximum number of generations to simulate\n");
+    printf("  build_command           Command run to configure, build and test\n");
+    printf("                          each program as:\n");
+    printf("                          build_command stage program version source_dir prefix\n");
+    printf(" --candidates all|tags|merges|N\n");
+    printf("                          Only search versions between the current and latest,\n");
+    printf("                          optionally only tags, merges or every Nth version\n");
+
+    printf("\nSynthetic mode:\n");
+    printf(" %s -s|--synthetic no_of_programs max_generation\n", (char*)APPNAME);
+    printf("  no_of_programs          Number of programs in the synthetic system\n");
+    printf("  max_generation          Maximum number of generations to simulate\n");
+
+    printf("\nSweep mode:\n");
+    printf(" %s -w|--sweep grid|random no_of_programs max_generation count [results_file]\n", (char*)APPNAME);
+    printf("  grid|random             Cover a grid of parameters or sample at random\n");
+    printf("  no_of_programs          Number of programs in the synthetic system\n");
+    printf("  max_generation          Maximum number of generations for each run\n");
+    printf("  count                   Runs of each grid point, or random samples\n");
+    printf("  results_file            CSV file for the results, default sweep.csv\n");
+    printf("                          A summary is also saved as results_file.summary.csv\n");
+    printf(" --range name=min:max:steps\n");
+    printf("                          Range of a parameter, one of population, mutation,\n");
+    printf("                          crossover or rebels. May be given more than once\n");
+    printf(" --ranges filename        Load ranges from a file, one per line\n");
+    printf(" --system-seed number     Seed of the synthetic system, which is otherwise\n");
+    printf("                          the random seed. The seeds of runs come from --seed\n");
+
+    printf("\nIngest mode:\n");
+    printf(" %s -i|--ingest sources_file repos_dir [results_file]\n", (char*)APPNAME);
+    printf("  sources_file            Programs to ingest, one per line as:\n");
+    printf("                          name git|tarball|deb|rpm url\n");
+    printf("                          name aptitude\n");
+    printf("                          or name url, guessing the source from the url\n");
+    printf("  repos_dir               Directory in which to clone repos and keep archives\n");
+    printf("  results_file            CSV file with the time taken by each stage,\n");
+    printf("                          default ingest.csv\n");
+
+    printf("\nOptions for ingest mode:\n");
+    printf(" --clone full|blobless|treeless\n");
+    printf("                          How much of each git repo to fetch, default full.\n");
+    printf("                          Partial clones fetch file contents when needed\n");
+    printf(" --reference repo_dir     Borrow objects from an existing repo\n");
+    printf(" --since revision         Only fetch history from the start version onwards\n");
+    printf(" --depth number           Commits of history to fetch. With --since this is\n");
+    printf("                          the number of commits before the start version\n");
+    printf(" --no-checkout            Only check out commits when they are built\n");
 }
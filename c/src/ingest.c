@@ -0,0 +1,644 @@
+/*
+  Smart search for upgrade paths
+  Copyright (C) 2016 Andrew Leeming <andrew.leeming@codethink.co.uk> and
+  Bob Mottram <bob.mottram@codethink.co.uk>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "scalam.h"
+
+/* Names of sources, as used within sources files */
+static char * ingest_source_name[SC_INGEST_SOURCES] = {
+    "git", "tarball", "deb", "rpm", "aptitude"
+};
+
+/* Names of stages, as used when saving results */
+static char * ingest_stage_name[SC_INGEST_STAGES] = {
+    "fetch", "extract", "index"
+};
+
+/**
+ * @brief Returns a monotonic time in seconds, for timing stages
+ * @returns Time in seconds
+ */
+static double ingest_seconds()
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + ((double)t.tv_nsec / 1000000000.0);
+}
+
+/**
+ * @brief Creates an ingest with no programs and the default
+ *        number of programs within each stage
+ * @param ingest The ingest object
+ */
+void ingest_create(sc_ingest * ingest)
+{
+    memset((void*)ingest, '\0', sizeof(sc_ingest));
+    ingest->max_running[SC_INGEST_FETCH] = SC_INGEST_DEFAULT_FETCHES;
+    ingest->max_running[SC_INGEST_EXTRACT] = SC_INGEST_DEFAULT_EXTRACTS;
+    ingest->max_running[SC_INGEST_INDEX] = SC_INGEST_DEFAULT_INDEXES;
+    program_clone_options_init(&ingest->clone);
+}
+
+/**
+ * @brief Frees the programs of an ingest
+ * @param ingest The ingest object
+ */
+void ingest_free(sc_ingest * ingest)
+{
+    int i;
+
+    for (i = 0; i < ingest->no_of_entries; i++)
+        changelog_free(&ingest->entry[i].changelog);
+
+    free(ingest->entry);
+    ingest->entry = NULL;
+    ingest->no_of_entries = 0;
+    ingest->max_entries = 0;
+}
+
+/**
+ * @brief Returns the source with the given name, such as git or deb
+ * @param name Name of the source
+ * @returns The source, or -1 if it isn't known
+ */
+int ingest_source_from_name(char * name)
+{
+    int source;
+
+    for (source = 0; source < SC_INGEST_SOURCES; source++)
+        if (strcmp(name, ingest_source_name[source]) == 0)
+            return source;
+
+    return -1;
+}
+
+/**
+ * @brief Returns whether a url ends with the given suffix
+ * @param url The url
+ * @param suffix The suffix, such as a file extension
+ * @returns Non-zero if the url ends with the suffix
+ */
+static int ingest_url_has_suffix(char * url, char * suffix)
+{
+    int length = strlen(url), suffix_length = strlen(suffix);
+
+    return ((length >= suffix_length) &&
+            (strcmp(&url[length - suffix_length], suffix) == 0));
+}
+
+/**
+ * @brief Guesses the source of a url from its extension, for sources
+ *        files which don't give one. Anything which isn't a package or
+ *        tarball is assumed to be a git repo
+ * @param url URL or filename of the repo or archive
+ * @returns The source
+ */
+int ingest_source_from_url(char * url)
+{
+    if (ingest_url_has_suffix(url, ".deb"))
+        return SC_INGEST_DEB;
+
+    if (ingest_url_has_suffix(url, ".rpm"))
+        return SC_INGEST_RPM;
+
+    if ((strstr(url, ".tar.") != NULL) ||
+        ingest_url_has_suffix(url, ".tgz") ||
+        ingest_url_has_suffix(url, ".tar"))
+        return SC_INGEST_TARBALL;
+
+    return SC_INGEST_GIT;
+}
+
+/**
+ * @brief Adds a program to be ingested
+ * @param ingest The ingest object
+ * @param name Name of the program, which is also the name of its
+ *             directory within the repos directory
+ * @param source Where the versions come from, such as SC_INGEST_GIT
+ * @param url URL or filename of the repo or archive. May be NULL
+ *            for aptitude
+ * @returns zero on success
+ */
+int ingest_add(sc_ingest * ingest, char * name, int source, char * url)
+{
+    sc_ingest_entry * entry;
+    sc_program prog;
+    int i, max_entries;
+
+    if ((source < 0) || (source >= SC_INGEST_SOURCES))
+        return 1;
+
+    if ((source != SC_INGEST_APTITUDE) && ((url == NULL) || (url[0] == 0)))
+        return 2;
+
+    if (ingest->no_of_entries >= SC_MAX_SYSTEM_SIZE)
+        return 3;
+
+    /* names must be unique, since each has its own directory.
+       Pooled strings which are equal have the same offset */
+    memset((void*)&prog, '\0', sizeof(sc_program));
+    prog.name = string_pool_add(name);
+    if (program_name_is_valid(&prog) != 0)
+        return 4;
+    for (i = 0; i < ingest->no_of_entries; i++)
+        if (ingest->entry[i].name == prog.name)
+            return 5;
+
+    if (ingest->no_of_entries >= ingest->max_entries) {
+        max_entries = ingest->max_entries * 2;
+        if (max_entries < 64)
+            max_entries = 64;
+        entry = (sc_ingest_entry*)realloc(ingest->entry,
+                                          max_entries*sizeof(sc_ingest_entry));
+        if (entry == NULL)
+            return 6;
+        ingest->entry = entry;
+        ingest->max_entries = max_entries;
+    }
+
+    entry = &ingest->entry[ingest->no_of_entries];
+    memset((void*)entry, '\0', sizeof(sc_ingest_entry));
+    entry->name = prog.name;
+    if (url != NULL)
+        entry->url = string_pool_add(url);
+    entry->source = source;
+    entry->program_index = -1;
+    changelog_init(&entry->changelog);
+
+    ingest->no_of_entries++;
+    return 0;
+}
+
+/**
+ * @brief Loads the programs to be ingested from a sources file.
+ *        Each line contains a program name, then its source and a url:
+ *        name git|tarball|deb|rpm url
+ *        name aptitude
+ *        If the source is left out it is guessed from the url.
+ *        Anything after a # is a comment.
+ * @param ingest The ingest object
+ * @param filename The sources file
+ * @returns zero on success
+ */
+int ingest_load_sources(sc_ingest * ingest, char * filename)
+{
+    char linestr[SC_MAX_STRING*4];
+    char * field[3];
+    char * comment, * token, * save;
+    int fields, source, retval = 0;
+    FILE * fp;
+
+    fp = fopen(filename, "r");
+    if (fp == NULL)
+        return 1;
+
+    while ((retval == 0) && (fgets(linestr, sizeof(linestr), fp) != NULL)) {
+        comment = strchr(linestr, '#');
+        if (comment != NULL)
+            *comment = 0;
+
+        fields = 0;
+        token = strtok_r(linestr, " \t\r\n", &save);
+        while (token != NULL) {
+            if (fields < 3)
+                field[fields] = token;
+            fields++;
+            token = strtok_r(NULL, " \t\r\n", &save);
+        }
+
+        /* blank lines */
+        if (fields == 0)
+            continue;
+
+        if ((fields < 2) || (fields > 3)) {
+            retval = 2;
+            break;
+        }
+
+        source = ingest_source_from_name(field[1]);
+        if (fields == 3) {
+            if (source < 0)
+                retval = 2;
+            else if (ingest_add(ingest, field[0], source, field[2]) != 0)
+                retval = 3;
+        }
+        else if (source == SC_INGEST_APTITUDE) {
+            if (ingest_add(ingest, field[0], source, NULL) != 0)
+                retval = 3;
+        }
+        else if (source >= 0) {
+            /* every other source needs a url */
+            retval = 2;
+        }
+        else if (ingest_add(ingest, field[0],
+                            ingest_source_from_url(field[1]), field[1]) != 0) {
+            retval = 3;
+        }
+    }
+
+    fclose(fp);
+    return retval;
+}
+
+/**
+ * @brief Sets the maximum number of programs within a stage at once
+ * @param ingest The ingest object
+ * @param stage The stage, such as SC_INGEST_FETCH
+ * @param max_running The maximum number of programs, at least one
+ * @returns zero on success
+ */
+int ingest_set_max_running(sc_ingest * ingest, int stage, int max_running)
+{
+    if ((stage < 0) || (stage >= SC_INGEST_STAGES))
+        return 1;
+
+    if (max_running < 1)
+        return 2;
+
+    ingest->max_running[stage] = max_running;
+    return 0;
+}
+
+/**
+ * @brief Waits until fewer than the maximum number of programs are
+ *        within a stage, then counts a new one
+ * @param ingest The ingest object
+ * @param stage The stage
+ */
+static void ingest_acquire_stage(sc_ingest * ingest, int stage)
+{
+    int acquired = 0;
+
+    while (!acquired) {
+#pragma omp critical (ingest_stages)
+        {
+            if (ingest->running[stage] < ingest->max_running[stage]) {
+                ingest->running[stage]++;
+                acquired = 1;
+            }
+        }
+        if (!acquired)
+            usleep(SC_PROCESS_POLL_INTERVAL*1000);
+    }
+}
+
+/**
+ * @brief Counts a program as having left a stage
+ * @param ingest The ingest object
+ * @param stage The stage
+ */
+static void ingest_release_stage(sc_ingest * ingest, int stage)
+{
+#pragma omp critical (ingest_stages)
+    ingest->running[stage]--;
+}
+
+/**
+ * @brief Returns whether a stage has any work to do for a source.
+ *        Git repos are cloned already checked out, and aptitude
+ *        provides versions rather than an archive
+ * @param source The source
+ * @param stage The stage
+ * @returns Non-zero if the stage is needed
+ */
+static int ingest_stage_needed(int source, int stage)
+{
+    if (stage == SC_INGEST_EXTRACT)
+        return ((source != SC_INGEST_GIT) && (source != SC_INGEST_APTITUDE));
+
+    return 1;
+}
+
+/**
+ * @brief Fetches a program, by cloning its repo or downloading its
+ *        archive. Repos which have already been cloned are used as
+ *        they are
+ * @param ingest The ingest object, giving the clone options
+ * @param entry The program being ingested
+ * @param repos_dir Directory containing the repos
+ * @returns zero on success
+ */
+static int ingest_fetch(sc_ingest * ingest, sc_ingest_entry * entry,
+                        char * repos_dir)
+{
+    char repo_dir[SC_MAX_STRING*2];
+    char archive[SC_MAX_STRING*2];
+
+    switch (entry->source) {
+    case SC_INGEST_GIT:
+        snprintf(repo_dir, sizeof(repo_dir), "%s/%s",
+                 repos_dir, string_pool_get(entry->name));
+        if (directory_exists(repo_dir))
+            return 0;
+        if (program_repo_clone(string_pool_get(entry->url), repo_dir,
+                               &ingest->clone) != 0)
+            return 1;
+        return 0;
+    case SC_INGEST_APTITUDE:
+        if (program_get_versions_from_aptitude(repos_dir, &entry->program) != 0)
+            return 2;
+        return 0;
+    }
+
+    if (program_fetch_archive(repos_dir, string_pool_get(entry->url),
+                              archive) != 0)
+        return 3;
+
+    entry->archive = string_pool_add(archive);
+    return 0;
+}
+
+/**
+ * @brief Reads the changelog from the archive of a program
+ * @param entry The program being ingested
+ * @returns zero on success
+ */
+static int ingest_extract(sc_ingest_entry * entry)
+{
+    char * archive = string_pool_get(entry->archive);
+    int retval = 1;
+
+    switch (entry->source) {
+    case SC_INGEST_TARBALL:
+        retval = changelog_read_tarball(&entry->changelog, archive);
+        break;
+    case SC_INGEST_DEB:
+        retval = changelog_read_deb_package(&entry->changelog, archive);
+        break;
+    case SC_INGEST_RPM:
+        retval = changelog_read_rpm_package(&entry->changelog, archive);
+        break;
+    }
+    if (retval != 0)
+        return 1;
+
+    if (entry->changelog.no_of_versions == 0)
+        return 2;
+
+    return 0;
+}
+
+/**
+ * @brief Creates the versions file of a program and sets its current
+ *        version. For archives this is the newest version within
+ *        the changelog
+ * @param entry The program being ingested
+ * @param repos_dir Directory containing the repos
+ * @returns zero on success
+ */
+static int ingest_index(sc_ingest_entry * entry, char * repos_dir)
+{
+    char repo_dir[SC_MAX_STRING*2];
+    sc_program * prog = &entry->program;
+    int retval;
+
+    switch (entry->source) {
+    case SC_INGEST_GIT:
+        snprintf(repo_dir, sizeof(repo_dir), "%s/%s",
+                 repos_dir, string_pool_get(entry->name));
+        if (program_repo_get_commits(repo_dir, prog) != 0)
+            return 1;
+        if (prog->no_of_versions <= 0)
+            return 2;
+        retval = program_repo_get_current_version(repo_dir, prog);
+        if (retval != 0)
+            return 2 + retval;
+        return 0;
+    case SC_INGEST_APTITUDE:
+        prog->no_of_versions = lines_in_file(string_pool_get(prog->versions_file));
+        break;
+    default:
+        retval = program_versions_from_changelog(&entry->changelog,
+                                                 repos_dir, prog);
+        changelog_free(&entry->changelog);
+        if (retval != 0)
+            return 5;
+    }
+
+    if (prog->no_of_versions <= 0)
+        return 2;
+
+    prog->version_index = prog->no_of_versions - 1;
+    return 0;
+}
+
+/**
+ * @brief Runs one stage for a program
+ * @param ingest The ingest object
+ * @param entry The program being ingested
+ * @param stage The stage
+ * @param repos_dir Directory containing the repos
+ * @returns zero on success
+ */
+static int ingest_run_stage(sc_ingest * ingest, sc_ingest_entry * entry,
+                            int stage, char * repos_dir)
+{
+    switch (stage) {
+    case SC_INGEST_FETCH:
+        return ingest_fetch(ingest, entry, repos_dir);
+    case SC_INGEST_EXTRACT:
+        return ingest_extract(entry);
+    }
+    return ingest_index(entry, repos_dir);
+}
+
+/**
+ * @brief Ingests one program through every stage, then adds it
+ *        to the system
+ * @param ingest The ingest object
+ * @param index Array index of the program within the ingest
+ * @param repos_dir Directory containing the repos
+ * @param sys System to which the program is added
+ */
+static void ingest_entry_run(sc_ingest * ingest, int index, char * repos_dir,
+                             sc_system * sys)
+{
+    sc_ingest_entry * entry = &ingest->entry[index];
+    double start_time;
+    int stage, p = -1;
+
+    entry->status = SC_INGEST_RUNNING;
+
+    for (stage = 0; stage < SC_INGEST_STAGES; stage++) {
+        if (!ingest_stage_needed(entry->source, stage))
+            continue;
+
+        ingest_acquire_stage(ingest, stage);
+        start_time = ingest_seconds();
+        entry->error = ingest_run_stage(ingest, entry, stage, repos_dir);
+        entry->duration[stage] = ingest_seconds() - start_time;
+        ingest_release_stage(ingest, stage);
+
+        if (entry->error != 0) {
+            entry->failed_stage = stage;
+            break;
+        }
+    }
+
+    /* the system is fed in whatever order programs finish */
+#pragma omp critical (ingest_system)
+    {
+        if (entry->error == 0) {
+            p = system_add_program(sys, string_pool_get(entry->name));
+            if (p >= 0) {
+                sys->program[p] = entry->program;
+                entry->program_index = p;
+            }
+            else {
+                entry->failed_stage = SC_INGEST_INDEX;
+                entry->error = 10;
+            }
+        }
+
+        if (entry->error == 0) {
+            entry->status = SC_INGEST_DONE;
+            ingest->completed++;
+        }
+        else {
+            entry->status = SC_INGEST_FAILED;
+            ingest->failed++;
+        }
+
+        if (ingest->callback != NULL)
+            (*ingest->callback)(ingest->callback_context, entry,
+                                ingest->completed + ingest->failed,
+                                ingest->no_of_entries);
+    }
+}
+
+/**
+ * @brief Ingests the versions of every program, creating a system from
+ *        them. Each program passes through the fetch, extract and index
+ *        stages, and many programs may be within each stage at once up
+ *        to its maximum. Programs are added to the system as they
+ *        finish. Programs which fail are left out of the system, and
+ *        have their failed stage and error within their entry
+ * @param ingest The ingest object
+ * @param repos_dir Directory in which to clone repos and keep archives
+ * @param sys Returned system
+ * @returns zero on success
+ */
+int ingest_run(sc_ingest * ingest, char * repos_dir, sc_system * sys)
+{
+    sc_ingest_entry * entry;
+    double start_time = ingest_seconds();
+    int i, stage, p, threads = 0;
+
+    if (ingest->no_of_entries == 0)
+        return 1;
+
+    if ((repos_dir[0] == 0) ||
+        (!directory_exists(repos_dir) && (mkdir(repos_dir, 0700) != 0)))
+        return 2;
+
+    memset((void*)sys, '\0', sizeof(sc_system));
+    if (system_create_dependency_matrix(sys) != 0)
+        return 3;
+
+    ingest->completed = 0;
+    ingest->failed = 0;
+    for (i = 0; i < ingest->no_of_entries; i++) {
+        entry = &ingest->entry[i];
+        entry->status = SC_INGEST_WAITING;
+        entry->failed_stage = 0;
+        entry->error = 0;
+        entry->program_index = -1;
+        memset((void*)entry->duration, '\0', sizeof(entry->duration));
+        changelog_free(&entry->changelog);
+        memset((void*)&entry->program, '\0', sizeof(sc_program));
+        entry->program.name = entry->name;
+        entry->program.repo_url = entry->url;
+    }
+
+    /* enough threads for every stage to be full. Most of the time
+       they are waiting upon processes */
+    for (stage = 0; stage < SC_INGEST_STAGES; stage++) {
+        ingest->running[stage] = 0;
+        threads += ingest->max_running[stage];
+    }
+    if (threads > ingest->no_of_entries)
+        threads = ingest->no_of_entries;
+
+#pragma omp parallel for schedule(dynamic) num_threads(threads)
+    for (i = 0; i < ingest->no_of_entries; i++)
+        ingest_entry_run(ingest, i, repos_dir, sys);
+
+    ingest->duration = ingest_seconds() - start_time;
+
+    /* Put the programs into the order of the sources, so that the
+       system is the same whichever order they finished in */
+    p = 0;
+    for (i = 0; i < ingest->no_of_entries; i++) {
+        entry = &ingest->entry[i];
+        if (entry->status != SC_INGEST_DONE)
+            continue;
+        sys->program[p] = entry->program;
+        entry->program_index = p++;
+    }
+    sys->no_of_programs = p;
+    system_index_names(sys);
+
+    if (p == 0)
+        return 4;
+
+    if (state_layout_create(sys) != 0)
+        return 5;
+
+    return 0;
+}
+
+/**
+ * @brief Saves the result and timing of each stage for every program
+ *        to a CSV file
+ * @param ingest The ingest object
+ * @param filename The CSV file
+ * @returns zero on success
+ */
+int ingest_save(sc_ingest * ingest, char * filename)
+{
+    sc_ingest_entry * entry;
+    FILE * fp;
+    int i;
+
+    fp = fopen(filename, "w");
+    if (fp == NULL)
+        return 1;
+
+    fprintf(fp, "name,source,url,status,failed_stage,error,no_of_versions,"
+            "fetch_seconds,extract_seconds,index_seconds\n");
+
+    for (i = 0; i < ingest->no_of_entries; i++) {
+        entry = &ingest->entry[i];
+        fprintf(fp, "%s,%s,%s,%s,%s,%d,%d,%f,%f,%f\n",
+                string_pool_get(entry->name),
+                ingest_source_name[entry->source],
+                string_pool_get(entry->url),
+                (entry->status == SC_INGEST_DONE) ? "done" :
+                ((entry->status == SC_INGEST_FAILED) ? "failed" : "waiting"),
+                (entry->status == SC_INGEST_FAILED) ?
+                ingest_stage_name[entry->failed_stage] : "",
+                entry->error, entry->program.no_of_versions,
+                entry->duration[SC_INGEST_FETCH],
+                entry->duration[SC_INGEST_EXTRACT],
+                entry->duration[SC_INGEST_INDEX]);
+    }
+
+    fclose(fp);
+    return 0;
+}
@@ -19,9 +19,122 @@
 
 #include "scalam.h"
 
+/**
+ * @brief Sets the default options which apply to every mode
+ * @param options The options object
+ */
+static void run_options_init(sc_run_options * options)
+{
+    memset((void*)options, '\0', sizeof(sc_run_options));
+    options->random_seed = (unsigned int)time(NULL);
+    options->max_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (options->max_threads < 1)
+        options->max_threads = 1;
+    sprintf(options->manifest_filename, "%s", SC_DEFAULT_MANIFEST_FILENAME);
+    program_clone_options_init(&options->clone);
+    candidates_options_init(&options->candidates);
+    sweep_ranges_init(options->sweep_range);
+}
+
+/**
+ * @brief Removes the options which apply to every mode from the arguments,
+ *        so that the remaining arguments only belong to the mode
+ * @param argc The number of arguments
+ * @param argv The arguments, which are updated
+ * @param options Returned options
+ * @returns The number of remaining arguments, or negative on error
+ */
+static int run_options_parse(int argc, char **argv, sc_run_options * options)
+{
+    int i, remaining = 1;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i],"--no-checkout")==0) {
+            options->clone.no_checkout = 1;
+            continue;
+        }
+        if ((strcmp(argv[i],"--seed")==0) ||
+            (strcmp(argv[i],"--threads")==0) ||
+            (strcmp(argv[i],"--manifest")==0) ||
+            (strcmp(argv[i],"--clone")==0) ||
+            (strcmp(argv[i],"--reference")==0) ||
+            (strcmp(argv[i],"--depth")==0) ||
+            (strcmp(argv[i],"--since")==0) ||
+            (strcmp(argv[i],"--candidates")==0) ||
+            (strcmp(argv[i],"--system-seed")==0) ||
+            (strcmp(argv[i],"--range")==0) ||
+            (strcmp(argv[i],"--ranges")==0)) {
+            if (i + 1 >= argc)
+                return -1;
+
+            if (strcmp(argv[i],"--seed")==0)
+                options->random_seed = (unsigned int)strtoul(argv[i+1], NULL, 10);
+            else if (strcmp(argv[i],"--threads")==0)
+                options->max_threads = atoi(argv[i+1]);
+            else if (strcmp(argv[i],"--clone")==0) {
+                if (strcmp(argv[i+1],"full")==0)
+                    options->clone.filter = SC_CLONE_FULL;
+                else if (strcmp(argv[i+1],"blobless")==0)
+                    options->clone.filter = SC_CLONE_BLOBLESS;
+                else if (strcmp(argv[i+1],"treeless")==0)
+                    options->clone.filter = SC_CLONE_TREELESS;
+                else
+                    return -3;
+            }
+            else if (strcmp(argv[i],"--reference")==0)
+                snprintf(options->clone.reference, SC_MAX_STRING, "%s", argv[i+1]);
+            else if (strcmp(argv[i],"--depth")==0)
+                options->clone.depth = atoi(argv[i+1]);
+            else if (strcmp(argv[i],"--since")==0)
+                snprintf(options->clone.start_revision, SC_MAX_STRING, "%s", argv[i+1]);
+            else if (strcmp(argv[i],"--candidates")==0) {
+                options->restrict_versions = 1;
+                if (strcmp(argv[i+1],"all")==0)
+                    options->candidates.thinning = SC_CANDIDATES_ALL;
+                else if (strcmp(argv[i+1],"tags")==0)
+                    options->candidates.thinning = SC_CANDIDATES_TAGS;
+                else if (strcmp(argv[i+1],"merges")==0)
+                    options->candidates.thinning = SC_CANDIDATES_MERGES;
+                else {
+                    options->candidates.thinning = SC_CANDIDATES_EVERY_NTH;
+                    options->candidates.every = atoi(argv[i+1]);
+                    if (options->candidates.every < 1)
+                        return -3;
+                }
+            }
+            else if (strcmp(argv[i],"--system-seed")==0) {
+                options->system_seed = (unsigned int)strtoul(argv[i+1], NULL, 10);
+                options->system_seed_given = 1;
+            }
+            else if (strcmp(argv[i],"--range")==0) {
+                if (sweep_range_parse(options->sweep_range, argv[i+1]) != 0)
+                    return -3;
+            }
+            else if (strcmp(argv[i],"--ranges")==0) {
+                if (sweep_ranges_load(options->sweep_range, argv[i+1]) != 0)
+                    return -3;
+            }
+            else
+                snprintf(options->manifest_filename, SC_MAX_STRING, "%s", argv[i+1]);
+            i++;
+            continue;
+        }
+        argv[remaining++] = argv[i];
+    }
+
+    if (options->max_threads < 1)
+        return -2;
+
+    if (options->clone.depth < 0)
+        return -3;
+
+    return remaining;
+}
+
 int main(int argc, char **argv)
 {
     int i;
+    sc_run_options options;
 
     /* If there are no arguments then show help */
     if (argc <= 1) {
@@ -29,6 +142,17 @@ int main(int argc, char **argv)
         return 0;
     }
 
+    run_options_init(&options);
+    argc = run_options_parse(argc, argv, &options);
+    if (argc < 0) {
+        printf("Error: Invalid option value\n\n");
+        show_help();
+        return 1;
+    }
+
+    /* external commands such as builds run no more than one per thread */
+    process_set_max_running(options.max_threads);
+
     /* Parse the arguments */
     for (i = 1; i < argc; i++) {
         /* show help */
@@ -37,6 +161,11 @@ int main(int argc, char **argv)
             show_help();
             return 0;
         }
+        if ((strcmp(argv[i],"-v")==0) ||
+            (strcmp(argv[i],"--version")==0)) {
+            printf("%s version %s\n", (char*)APPNAME, (char*)VERSION);
+            return 0;
+        }
         if ((strcmp(argv[i],"-t")==0) ||
             (strcmp(argv[i],"--tests")==0)) {
             run_tests();
@@ -44,15 +173,45 @@ int main(int argc, char **argv)
         }
         if (((strcmp(argv[i],"-r")==0) ||
             (strcmp(argv[i],"--run")==0)) &&
-            argc == 4) {
+            ((argc == 4) || (argc == 5))) {
             
             
             char * repos_dir;
+            char * build_command = NULL;
             int generation_max;
             
             repos_dir=argv[i+1];
             generation_max=atoi(argv[i+2]);
-            run_simulation(repos_dir, generation_max);
+            if (argc == 5)
+                build_command=argv[i+3];
+            run_simulation(repos_dir, generation_max, build_command, &options);
+            return 0;
+        }
+        if (((strcmp(argv[i],"-s")==0) ||
+            (strcmp(argv[i],"--synthetic")==0)) &&
+            argc == 4) {
+            run_synthetic(atoi(argv[i+1]), atoi(argv[i+2]), &options);
+            return 0;
+        }
+        if (((strcmp(argv[i],"-w")==0) ||
+            (strcmp(argv[i],"--sweep")==0)) &&
+            ((argc == 6) || (argc == 7))) {
+            char * filename = "sweep.csv";
+
+            if (argc == 7)
+                filename = argv[i+5];
+            run_sweep(argv[i+1], atoi(argv[i+2]), atoi(argv[i+3]),
+                      atoi(argv[i+4]), filename, &options);
+            return 0;
+        }
+        if (((strcmp(argv[i],"-i")==0) ||
+            (strcmp(argv[i],"--ingest")==0)) &&
+            ((argc == 4) || (argc == 5))) {
+            char * filename = "ingest.csv";
+
+            if (argc == 5)
+                filename = argv[i+3];
+            run_ingest(argv[i+1], argv[i+2], filename, &options);
             return 0;
         }
     }
@@ -65,27 +224,72 @@ int main(int argc, char **argv)
 }
 
 
-void run_simulation(char * repos_dir, int generation_max)
+void run_simulation(char * repos_dir, int generation_max, char * build_command,
+                    sc_run_options * options)
 {
     /* Init System */
     sc_system sys;
     system_create_from_repos(&sys, repos_dir);
 
+    /* only search the versions between the start and the goal */
+    if (options->restrict_versions &&
+        (candidates_system(&sys, &options->candidates) != 0)) {
+        printf("Unable to restrict programs to their candidate versions\n");
+        system_free(&sys);
+        return;
+    }
+
     /* Init Goal */
     sc_goal goal;
     goal_create_latest_versions(&sys, &goal);
-    float goal_score=goal_max_score(&goal);
 
 
 
     /* Init population */
     sc_population *population=(sc_population *)malloc(sizeof(sc_population));
-    population_create(sys.no_of_programs, population, &sys, &goal);
+    population_create_seeded(sys.no_of_programs, population, &sys, &goal,
+                             options->random_seed);
 
     /* Init Dataframe for recording output */
     sc_dataframe *df = (sc_dataframe *)malloc(sizeof(sc_dataframe));
     plot_create_dataframe(df, population);
 
+    /* Init evaluator, if there is a build command */
+    sc_evaluator evaluator;
+    sc_evaluation evaluation;
+    sc_workspace_pool workspaces;
+    char workspaces_template[] = "/tmp/scalam_workspaces.XXXXXX";
+    if (build_command != NULL) {
+        /* each evaluation checks out, builds and installs within
+           its own workspace, so evaluations don't share a tree */
+        char * workspaces_dir = mkdtemp(workspaces_template);
+        int no_of_workspaces = options->max_threads;
+        if (no_of_workspaces > SC_MAX_WORKSPACES)
+            no_of_workspaces = SC_MAX_WORKSPACES;
+        if ((workspaces_dir == NULL) ||
+            (workspace_pool_create(&workspaces, repos_dir, workspaces_dir,
+                                   no_of_workspaces) != 0)) {
+            printf("Unable to create build workspaces\n");
+            if (workspaces_dir != NULL)
+                rmdir(workspaces_dir);
+            plot_dataframe_free(df);
+            population_free(population);
+            free(population);
+            return;
+        }
+
+        evaluator_init(&evaluator, build_command, repos_dir, NULL);
+        evaluator.workspaces = &workspaces;
+        evaluation_create(&evaluation, population);
+
+        /* real builds are expensive, so screen children before building */
+        population_surrogate_enable(population);
+    }
+
+    /* record how the run can be repeated */
+    manifest_save(options->manifest_filename, "run", options,
+                  generation_max, population);
+
     /* Start simulation */
     /* TODO init scores already set? */
     int i;
@@ -98,27 +302,33 @@ void run_simulation(char * repos_dir, int generation_max)
         int j;
         for(j=0; j<population->size; j++)
         {
+            /* survivors from the previous generation keep their scores */
+            if (population->individual[j]->evaluated)
+                continue;
+
             /* TODO
              *
              * evaluate score
              * - Run in container
              * - Record which programs instal/run/pass tests
              */
-            float score=system_build(population, j);
-            //printf("[%d,%d] Score = %f\n",i,j,score);
+            if (build_command != NULL) {
+                evaluator_run(&evaluator, population, j, &evaluation);
+            }
+            else {
+                float score=system_build(population, j);
+                //printf("[%d,%d] Score = %f\n",i,j,score);
+            }
             
 			plot_create_df_slice(df, population);
         }
 
-        float highest_score = population_best_score(population);
-        if(highest_score == goal_score) /* FIXME float cmp */
+        /* the maximum is only known once the reference has been built
+           and tested, after which no genome can score more */
+        if (goal_reached(population))
         {
-            /* TODO
-             *
-             * End condition once we have found a successful candidate.
-             * Exit or keep going?
-             */
             printf("A possible solution found\n");
+            break;
         }
 
         ret=population_next_generation(population);
@@ -132,8 +342,181 @@ void run_simulation(char * repos_dir, int generation_max)
     }
 
     /* Make sure we have a copy of the data to analyse */
-    plot_dataframe_save(df);
+    plot_dataframe_save(df, NULL);
     
+    if (population->surrogate != NULL) {
+        printf("Surrogate accuracy %.1f%%, %d children screened out\n",
+               surrogate_accuracy(population->surrogate)*100,
+               population->surrogate->children_screened);
+    }
+
+    if (build_command != NULL) {
+        evaluation_free(&evaluation);
+        workspace_pool_free(&workspaces, &population->sys);
+    }
+    population_free(population);
     free(population);
     plot_dataframe_free(df);
 }
+
+void run_synthetic(int no_of_programs, int generation_max,
+                   sc_run_options * options)
+{
+    sc_system * sys = (sc_system *)malloc(sizeof(sc_system));
+    sc_goal * goal = (sc_goal *)malloc(sizeof(sc_goal));
+    sc_synthetic_oracle * oracle =
+        (sc_synthetic_oracle *)malloc(sizeof(sc_synthetic_oracle));
+    sc_population * population = (sc_population *)malloc(sizeof(sc_population));
+    unsigned int random_seed = options->random_seed;
+    int generations, evaluations;
+
+    if (synthetic_system_create(sys, no_of_programs, random_seed) != 0) {
+        printf("Unable to create a synthetic system of %d programs\n",
+               no_of_programs);
+        free(sys);
+        free(goal);
+        free(oracle);
+        free(population);
+        return;
+    }
+    synthetic_oracle_create(oracle, sys, random_seed + 1);
+    goal_create_latest_versions(sys, goal);
+    population_create_seeded(SC_MAX_POPULATION_SIZE / 4, population, sys, goal,
+                             random_seed + 2);
+    manifest_save(options->manifest_filename, "synthetic", options,
+                  generation_max, population);
+
+    synthetic_run(oracle, population, generation_max, options->max_threads,
+                  &generations, &evaluations);
+
+    printf("Generations: %d\n", generations);
+    if (evaluations >= 0)
+        printf("Evaluations to solution: %d\n", evaluations);
+    else
+        printf("No solution found after %d evaluations\n",
+               population->evaluations);
+
+    synthetic_oracle_free(oracle);
+    population_free(population);
+    free(population);
+    free(oracle);
+    free(goal);
+    free(sys);
+}
+
+void run_sweep(char * mode, int no_of_programs, int generation_max,
+               int count, char * filename, sc_run_options * options)
+{
+    sc_sweep sweep;
+    unsigned int random_seed = options->random_seed;
+    unsigned int system_seed = random_seed;
+    char summary_filename[SC_MAX_STRING];
+    int retval;
+
+    /* the same system can be searched with different run seeds */
+    if (options->system_seed_given)
+        system_seed = options->system_seed;
+
+    if (sweep_create(&sweep, no_of_programs, generation_max, system_seed,
+                     options->sweep_range) != 0) {
+        printf("Unable to create a sweep of %d programs\n", no_of_programs);
+        return;
+    }
+
+    /* a grid is repeated count times, otherwise count points are sampled */
+    if (strcmp(mode, "grid") == 0)
+        retval = sweep_grid(&sweep, count, random_seed + 2);
+    else if (strcmp(mode, "random") == 0)
+        retval = sweep_random(&sweep, count, 1, random_seed + 2);
+    else {
+        printf("Unknown sweep mode %s\n", mode);
+        sweep_free(&sweep);
+        return;
+    }
+
+    if (retval != 0) {
+        printf("Unable to create sweep runs %d\n", retval);
+        sweep_free(&sweep);
+        return;
+    }
+
+    printf("Running %d simulations of %d points\n",
+           sweep.no_of_runs, sweep.no_of_points);
+    manifest_save(options->manifest_filename, "sweep", options,
+                  generation_max, NULL);
+    retval = sweep_run(&sweep, options->max_threads);
+    if (retval != 0)
+        printf("Some runs failed %d\n", retval);
+
+    snprintf(summary_filename, SC_MAX_STRING, "%s.summary.csv", filename);
+    if ((sweep_save(&sweep, filename) != 0) ||
+        (sweep_save_summary(&sweep, summary_filename) != 0))
+        printf("Unable to save results to %s\n", filename);
+    else
+        printf("Results saved to %s and %s\n", filename, summary_filename);
+
+    sweep_free(&sweep);
+}
+
+/**
+ * @brief Reports the progress of an ingest as each program finishes
+ */
+static void run_ingest_progress(void * context, sc_ingest_entry * entry,
+                                int finished, int total)
+{
+    FILE * fp = (FILE*)context;
+
+    if (entry->status == SC_INGEST_DONE)
+        fprintf(fp, "[%d/%d] %s %d versions %.1fs\n", finished, total,
+                string_pool_get(entry->name), entry->program.no_of_versions,
+                entry->duration[SC_INGEST_FETCH] +
+                entry->duration[SC_INGEST_EXTRACT] +
+                entry->duration[SC_INGEST_INDEX]);
+    else
+        fprintf(fp, "[%d/%d] %s failed at stage %d error %d\n", finished, total,
+                string_pool_get(entry->name), entry->failed_stage,
+                entry->error);
+    fflush(fp);
+}
+
+void run_ingest(char * sources_filename, char * repos_dir,
+                char * filename, sc_run_options * options)
+{
+    sc_ingest ingest;
+    sc_system * sys = (sc_system *)malloc(sizeof(sc_system));
+    int retval;
+
+    memset((void*)sys, '\0', sizeof(sc_system));
+    ingest_create(&ingest);
+    retval = ingest_load_sources(&ingest, sources_filename);
+    if (retval != 0) {
+        printf("Unable to load sources from %s %d\n", sources_filename, retval);
+        ingest_free(&ingest);
+        free(sys);
+        return;
+    }
+
+    /* fetches wait upon the network rather than the processor,
+       so only the other stages are limited to the number of threads */
+    ingest_set_max_running(&ingest, SC_INGEST_EXTRACT, options->max_threads);
+    ingest_set_max_running(&ingest, SC_INGEST_INDEX, options->max_threads);
+    process_set_max_running(0);
+    ingest.clone = options->clone;
+    ingest.callback = run_ingest_progress;
+    ingest.callback_context = (void*)stdout;
+
+    retval = ingest_run(&ingest, repos_dir, sys);
+    printf("Ingested %d of %d programs in %.1fs\n", ingest.completed,
+           ingest.no_of_entries, ingest.duration);
+    if (retval != 0)
+        printf("Unable to create a system %d\n", retval);
+
+    if (ingest_save(&ingest, filename) != 0)
+        printf("Unable to save results to %s\n", filename);
+    else
+        printf("Results saved to %s\n", filename);
+
+    ingest_free(&ingest);
+    system_free(sys);
+    free(sys);
+}
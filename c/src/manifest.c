@@ -0,0 +1,148 @@
+/*
+  Smart search for upgrade paths
+  Copyright (C) 2016 Andrew Leeming <andrew.leeming@codethink.co.uk> and
+  Bob Mottram <bob.mottram@codethink.co.uk>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "scalam.h"
+
+/**
+ * @brief Gets the current version of a program, as a commit or version
+ *        string if there is a versions file, otherwise as an index
+ * @param prog Program object
+ * @param version Returned version
+ */
+static void manifest_program_version(sc_program * prog, char * version)
+{
+    if ((prog->versions_file == 0) ||
+        (program_version_from_index(prog, prog->version_index, version) != 0))
+        sprintf(version, "%d", prog->version_index);
+}
+
+/**
+ * @brief Adds a string to a 64 bit FNV-1a hash, including its terminator
+ * @param hash The hash so far
+ * @param str The string to add
+ * @returns The updated hash
+ */
+static uint64_t manifest_hash_string(uint64_t hash, char * str)
+{
+    do {
+        hash ^= (unsigned char)*str;
+        hash *= 1099511628211ULL;
+    } while (*str++ != 0);
+    return hash;
+}
+
+/**
+ * @brief Returns a fingerprint of a system, from the name, current version
+ *        and installed state of each of its programs. Runs on systems
+ *        with the same fingerprint start from the same place
+ * @param sys System object
+ * @returns 64 bit fingerprint
+ */
+uint64_t manifest_fingerprint(sc_system * sys)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    char version[SC_MAX_STRING];
+    int p;
+
+    for (p = 0; p < sys->no_of_programs; p++) {
+        manifest_program_version(&sys->program[p], version);
+        hash = manifest_hash_string(hash,
+                                    string_pool_get(sys->program[p].name));
+        hash = manifest_hash_string(hash, version);
+        hash = manifest_hash_string(hash,
+                                    sys->program[p].installed ? "1" : "0");
+    }
+    return hash;
+}
+
+/**
+ * @brief Saves a manifest describing a run, so that it can be repeated.
+ *        This records the seed, the parameters of the search, the
+ *        version of this program and a fingerprint of the system,
+ *        as lines of the form key = value
+ * @param filename The manifest file to save
+ * @param mode The mode which was run, such as run or synthetic
+ * @param options Options which apply to every mode
+ * @param max_generations The maximum number of generations
+ * @param population The population, after it was created. May be NULL if
+ *                   there isn't a single population
+ * @returns zero on success
+ */
+int manifest_save(char * filename, char * mode, sc_run_options * options,
+                  int max_generations, sc_population * population)
+{
+    FILE * fp;
+    sc_system * sys;
+    char version[SC_MAX_STRING];
+    int p;
+
+    fp = fopen(filename, "w");
+    if (fp == NULL)
+        return 1;
+
+    fprintf(fp, "version = %s %s\n", (char*)APPNAME, (char*)VERSION);
+    fprintf(fp, "compiler = %s\n", __VERSION__);
+    fprintf(fp, "mode = %s\n", mode);
+    fprintf(fp, "seed = %u\n", options->random_seed);
+    fprintf(fp, "threads = %d\n", options->max_threads);
+    fprintf(fp, "max_generations = %d\n", max_generations);
+
+    if (strcmp(mode, "sweep") == 0) {
+        fprintf(fp, "system_seed = %u\n",
+                options->system_seed_given ?
+                options->system_seed : options->random_seed);
+        for (p = 0; p < SC_SWEEP_PARAMETERS; p++)
+            fprintf(fp, "range = %s %f %f %d\n", sweep_parameter(p),
+                    options->sweep_range[p].minimum,
+                    options->sweep_range[p].maximum,
+                    options->sweep_range[p].steps);
+    }
+
+    if (population != NULL) {
+        sys = &population->sys;
+
+        fprintf(fp, "population_size = %d\n", population->size);
+        fprintf(fp, "mutation_rate = %f\n", population->mutation_rate);
+        fprintf(fp, "crossover = %f\n", population->crossover);
+        fprintf(fp, "rebels = %f\n", population->rebels);
+        fprintf(fp, "elites = %d\n", population->elites);
+        fprintf(fp, "replacement = %d\n", population->replacement);
+        fprintf(fp, "objectives = %d\n", population->objectives);
+        fprintf(fp, "diversity_response = %d\n",
+                population->diversity_response);
+        fprintf(fp, "diversity_threshold = %f\n",
+                population->diversity_threshold);
+        fprintf(fp, "unique_threshold = %f\n", population->unique_threshold);
+        fprintf(fp, "stagnation_limit = %d\n", population->stagnation_limit);
+        fprintf(fp, "surrogate = %d\n", (population->surrogate != NULL));
+
+        fprintf(fp, "no_of_programs = %d\n", sys->no_of_programs);
+        fprintf(fp, "fingerprint = %016llx\n",
+                (unsigned long long)manifest_fingerprint(sys));
+        for (p = 0; p < sys->no_of_programs; p++) {
+            manifest_program_version(&sys->program[p], version);
+            fprintf(fp, "program = %s %s %d\n",
+                    string_pool_get(sys->program[p].name), version,
+                    (int)sys->program[p].installed);
+        }
+    }
+
+    fclose(fp);
+    return 0;
+}
@@ -0,0 +1,259 @@
+/*
+  Smart search for upgrade paths
+  Copyright (C) 2016 Andrew Leeming <andrew.leeming@codethink.co.uk> and
+  Bob Mottram <bob.mottram@codethink.co.uk>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "scalam.h"
+
+/**
+ * @brief Returns the value of an objective for a genome, arranged so
+ *        that smaller values are always better
+ * @param individual The genome
+ * @param objective One of SC_OBJECTIVE_
+ * @returns Objective value to be minimised
+ */
+static float genome_objective(sc_genome * individual, int objective)
+{
+    switch(objective) {
+    case SC_OBJECTIVE_TEST_PASSES: return -(float)individual->test_passes;
+    case SC_OBJECTIVE_STEPS: return (float)individual->steps;
+    case SC_OBJECTIVE_GOAL_DISTANCE: return (float)individual->goal_distance;
+    case SC_OBJECTIVE_BUILD_TIME: return individual->build_time;
+    }
+    return 0;
+}
+
+/**
+ * @brief Returns true if the first genome dominates the second. That is,
+ *        it is no worse for any objective and better for at least one
+ * @param genome1 First genome
+ * @param genome2 Second genome
+ * @returns True if genome1 dominates genome2
+ */
+int genome_dominates(sc_genome * genome1, sc_genome * genome2)
+{
+    int objective, better = 0;
+    float value1, value2;
+
+    for (objective = 0; objective < SC_OBJECTIVES; objective++) {
+        value1 = genome_objective(genome1, objective);
+        value2 = genome_objective(genome2, objective);
+        if (value1 > value2)
+            return 0;
+        if (value1 < value2)
+            better = 1;
+    }
+    return better;
+}
+
+/**
+ * @brief Calculates the crowding distance of each genome within a front.
+ *        Genomes at the extremes of any objective get an infinite
+ *        distance, so that the ends of the front are kept.
+ * @param population The population object
+ * @param front Array indexes of the genomes within the front
+ * @param front_size The number of genomes within the front
+ */
+static void population_crowding_distance(sc_population * population,
+                                         int * front, int front_size)
+{
+    int objective, i, j, temp;
+    float range, lower, upper;
+    sc_genome ** individual = population->individual;
+
+    for (i = 0; i < front_size; i++)
+        individual[front[i]]->crowding = 0;
+
+    if (front_size < 3) {
+        for (i = 0; i < front_size; i++)
+            individual[front[i]]->crowding = INFINITY;
+        return;
+    }
+
+    for (objective = 0; objective < SC_OBJECTIVES; objective++) {
+        /* fronts are small, so an insertion sort by this objective */
+        for (i = 1; i < front_size; i++) {
+            temp = front[i];
+            j = i - 1;
+            while ((j >= 0) &&
+                   (genome_objective(individual[front[j]], objective) >
+                    genome_objective(individual[temp], objective))) {
+                front[j+1] = front[j];
+                j--;
+            }
+            front[j+1] = temp;
+        }
+
+        lower = genome_objective(individual[front[0]], objective);
+        upper = genome_objective(individual[front[front_size-1]], objective);
+        individual[front[0]]->crowding = INFINITY;
+        individual[front[front_size-1]]->crowding = INFINITY;
+
+        range = upper - lower;
+        if (range <= 0)
+            continue;
+
+        for (i = 1; i < front_size-1; i++)
+            individual[front[i]]->crowding +=
+                (genome_objective(individual[front[i+1]], objective) -
+                 genome_objective(individual[front[i-1]], objective)) / range;
+    }
+}
+
+/**
+ * @brief Ranks the population into Pareto fronts using fast non-dominated
+ *        sorting, calculates crowding distances, then sorts the population
+ *        by front and by decreasing crowding distance within each front,
+ *        so that the first genomes are the most likely to be parents.
+ *        Spawning probabilities are also set from the ranks, and any
+ *        columns are updated to match the new order.
+ * @param population The population after evaluation of genomes
+ * @returns zero on success
+ */
+int population_pareto_sort(sc_population * population)
+{
+    int size = population->size;
+    int i, j, temp, rank, front_start, front_size, next_size;
+    int * dominated_count, * front;
+    unsigned char * dominates;
+    sc_genome ** individual = population->individual;
+    sc_genome ** sorted;
+
+    if (size <= 0)
+        return 1;
+
+    dominated_count = (int*)malloc(size*sizeof(int));
+    front = (int*)malloc(size*sizeof(int));
+    sorted = (sc_genome**)malloc(size*sizeof(sc_genome*));
+    dominates = (unsigned char*)malloc((size_t)size*(size_t)size);
+    if ((dominated_count == NULL) || (front == NULL) ||
+        (sorted == NULL) || (dominates == NULL)) {
+        free(dominated_count);
+        free(front);
+        free(sorted);
+        free(dominates);
+        return 2;
+    }
+
+    /* for each genome, which others it dominates and how many
+       dominate it */
+    memset((void*)dominates, '\0', (size_t)size*(size_t)size);
+    memset((void*)dominated_count, '\0', size*sizeof(int));
+    for (i = 0; i < size; i++) {
+        for (j = i+1; j < size; j++) {
+            if (genome_dominates(individual[i], individual[j])) {
+                dominates[i*size + j] = 1;
+                dominated_count[j]++;
+            }
+            else if (genome_dominates(individual[j], individual[i])) {
+                dominates[j*size + i] = 1;
+                dominated_count[i]++;
+            }
+        }
+    }
+
+    /* the first front is every genome which isn't dominated */
+    front_size = 0;
+    for (i = 0; i < size; i++) {
+        if (dominated_count[i] == 0) {
+            front[front_size++] = i;
+            individual[i]->rank = 0;
+        }
+    }
+
+    /* peel off each front in turn. The fronts are stored one after
+       another within the front array */
+    rank = 0;
+    front_start = 0;
+    while (front_size > 0) {
+        population_crowding_distance(population, &front[front_start],
+                                     front_size);
+
+        /* within the front the more isolated genomes come first */
+        for (i = front_start + 1; i < front_start + front_size; i++) {
+            temp = front[i];
+            j = i - 1;
+            while ((j >= front_start) &&
+                   (individual[front[j]]->crowding <
+                    individual[temp]->crowding)) {
+                front[j+1] = front[j];
+                j--;
+            }
+            front[j+1] = temp;
+        }
+
+        next_size = 0;
+        for (i = front_start; i < front_start + front_size; i++) {
+            for (j = 0; j < size; j++) {
+                if (!dominates[front[i]*size + j])
+                    continue;
+                dominated_count[j]--;
+                if (dominated_count[j] == 0) {
+                    individual[j]->rank = rank + 1;
+                    front[front_start + front_size + next_size++] = j;
+                }
+            }
+        }
+
+        rank++;
+        front_start += front_size;
+        front_size = next_size;
+    }
+
+    /* the fronts array is now in order of rank */
+    for (i = 0; i < size; i++)
+        sorted[i] = individual[front[i]];
+    memcpy((void*)individual, (void*)sorted, size*sizeof(sc_genome*));
+
+    for (i = 0; i < size; i++)
+        individual[i]->spawning_probability =
+            1.0f / (float)(1 + individual[i]->rank);
+
+    free(dominated_count);
+    free(front);
+    free(sorted);
+    free(dominates);
+
+    /* the columns follow the new order of the genomes */
+    if (population->columns != NULL)
+        if (population_columns_update(population) != 0)
+            return 3;
+
+    return 0;
+}
+
+/**
+ * @brief Returns the non-dominated front of upgrade paths, after
+ *        population_pareto_sort has been called
+ * @param population The population object
+ * @param genome_index Returned array indexes of the genomes on the front.
+ *                     May be NULL if only the number is needed
+ * @returns The number of genomes on the front
+ */
+int population_pareto_front(sc_population * population, int * genome_index)
+{
+    int i, ctr = 0;
+
+    for (i = 0; i < population->size; i++) {
+        if (population->individual[i]->rank != 0)
+            continue;
+        if (genome_index != NULL)
+            genome_index[ctr] = i;
+        ctr++;
+    }
+    return ctr;
+}
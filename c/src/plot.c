@@ -27,7 +27,13 @@
  */
 void plot_create_df_slice(sc_dataframe * df, sc_population * population)
 {
-    sc_dataframe_slice *slice=(sc_dataframe_slice *)malloc(sizeof(sc_dataframe_slice));
+    sc_dataframe_slice *slice;
+
+    /* Don't exceed the size of the slice pool */
+    if (df->slice_no >= SC_MAX_DF_SIZE)
+        return;
+
+    slice=&df->slice_pool[df->slice_no];
 
     /* Dataframe Fields */
     slice->population_size=population->size;
@@ -65,40 +71,46 @@ void plot_create_dataframe(sc_dataframe * df, sc_population * population)
     /* Allocate space for all the slices */
     df->slice = (sc_dataframe_slice **)
                     malloc(sizeof(sc_dataframe_slice *)*SC_MAX_DF_SIZE);
+
+    /* A single block from which slices are taken in sequence,
+       rather than a separate allocation for every slice */
+    df->slice_pool = (sc_dataframe_slice *)
+                    malloc(sizeof(sc_dataframe_slice)*SC_MAX_DF_SIZE);
 }
 
 
 /**
  * @brief Saves the contents of the dataframe to an CSV file
  * @param df The dataframe to produce the CSV file from
- * @returns
+ * @param filename The CSV file to save, or NULL for the default filename
+ * @returns zero on success
  */
-void plot_dataframe_save(sc_dataframe * df)
+int plot_dataframe_save(sc_dataframe * df, char * filename)
 {
     int i,j;
 
     FILE * fp;
-    char *filename="dataframe.csv";
+    if (filename == NULL)
+        filename = SC_DEFAULT_DATAFRAME_FILENAME;
     fp = fopen(filename, "w");
-    if (fp)
-    {
-        /* Dataframe headers */
-        fprintf(fp, "cycle_ix,genome_ix,score\n");
+    if (fp == NULL)
+        return 1;
+
+    /* Dataframe headers */
+    fprintf(fp, "cycle_ix,genome_ix,score\n");
 
-        /* Each cycle */
-        for( i=0; i< df->slice_no; i++)
+    /* Each cycle */
+    for( i=0; i< df->slice_no; i++)
+    {
+        /* Each genome score for this cycle */
+        for( j=0; j< df->slice[i]->population_size; j++)
         {
-            /* Each genome score for this cycle */
-            for( j=0; j< df->slice[i]->population_size; j++)
-            {
-                fprintf(fp, "%d,%d,%f\n", i, j, df->slice[i]->scores[j]);
-            }
+            fprintf(fp, "%d,%d,%f\n", i, j, df->slice[i]->scores[j]);
         }
-
-        fclose(fp);
     }
 
-
+    fclose(fp);
+    return 0;
 }
 
 /**
@@ -109,12 +121,9 @@ void plot_dataframe_save(sc_dataframe * df)
 void plot_dataframe_free(sc_dataframe * df)
 {
     /* Free all the df slices */
-    int i;
-    for( i=0; i< df->slice_no; i++)
-    {
-        free(df->slice[i]);
-    }
-    
+    free(df->slice_pool);
+    free(df->slice);
+
     /* Free up main df object */
     free(df);
 }
\ No newline at end of file
@@ -23,9 +23,13 @@
  * @brief Assigns one genome in the population to try going straight
  *        to the goal, with no intermediate upgrade steps
  * @param population The population object
+ * @param first_index Genomes before this index are not changed,
+ *                    so that survivors from a previous generation
+ *                    keep their scores
  * @returns The array index of the genome which was selected
  */
-int population_create_direct_ascent_genome(sc_population * population)
+int population_create_direct_ascent_genome(sc_population * population,
+                                           int first_index)
 {
     int index, ctr = 0;
 
@@ -34,17 +38,79 @@ int population_create_direct_ascent_genome(sc_population * population)
         if (population->individual[index]->steps == 0) return index;
     }
 
+    if (first_index >= population->size)
+        first_index = 0;
+
     /* Pick a random genome in the population.
        Possibly this index could be zero if we are evaluating
        genomes sequentially. */
-    index = rand_num(&population->random_seed) % population->size;
+    index = first_index +
+        rand_num(&population->random_seed) % (population->size - first_index);
 
     /* set its steps to zero so that it tries to go straight to the goal */
     population->individual[index]->steps = 0;
 
+    /* this is now a different upgrade path which needs evaluating */
+    population->individual[index]->score = 0;
+    population->individual[index]->evaluated = 0;
+    population->individual[index]->steps_completed = 0;
+    population->individual[index]->test_passes = 0;
+    population->individual[index]->build_time = 0;
+
     return index;
 }
 
+/**
+ * @brief Allocates a single contiguous block for the genomes of both
+ *        the current and next generations and points the individual
+ *        and next_generation arrays into it.
+ *        The first half of the arena holds the current generation and
+ *        the second half the next generation, although after swaps and
+ *        sorting any pointer may refer to any slot.
+ * @param population The population object, with its size already set
+ * @returns zero on success
+ */
+int population_arena_create(sc_population * population)
+{
+    int i;
+    size_t arena_size, alignment = SC_ARENA_ALIGNMENT;
+
+    /* round each genome up to a whole number of cache lines */
+    population->genome_stride =
+        ((genome_size(population) + SC_ARENA_ALIGNMENT - 1) /
+         SC_ARENA_ALIGNMENT) * SC_ARENA_ALIGNMENT;
+
+    arena_size = 2 * (size_t)population->size * population->genome_stride;
+    if (arena_size == 0)
+        arena_size = SC_ARENA_ALIGNMENT;
+
+    /* large arenas are aligned on a huge page boundary */
+    if (arena_size >= SC_HUGE_PAGE_SIZE)
+        alignment = SC_HUGE_PAGE_SIZE;
+
+    if (posix_memalign((void**)&population->arena, alignment, arena_size) != 0) {
+        population->arena = NULL;
+        return 1;
+    }
+
+#ifdef MADV_HUGEPAGE
+    if (alignment == SC_HUGE_PAGE_SIZE)
+        madvise(population->arena, arena_size, MADV_HUGEPAGE);
+#endif
+
+    memset((void*)population->arena, '\0', arena_size);
+
+    for (i = 0; i < population->size; i++) {
+        population->individual[i] =
+            (sc_genome*)(population->arena + (size_t)i*population->genome_stride);
+        population->next_generation[i] =
+            (sc_genome*)(population->arena +
+                         (size_t)(population->size + i)*population->genome_stride);
+    }
+
+    return 0;
+}
+
 /**
  * @brief For a given goal create a population of possible upgrade paths
  * @param size Number of individuals in the population.
@@ -58,6 +124,26 @@ int population_create_direct_ascent_genome(sc_population * population)
 int population_create(int size, sc_population * population,
                       sc_system * system_definition,
                       sc_goal * goal)
+{
+    return population_create_seeded(size, population, system_definition,
+                                    goal, (unsigned int)time(NULL));
+}
+
+/**
+ * @brief For a given goal create a population of possible upgrade paths,
+ *        using a given random seed so that the population is repeatable
+ * @param size Number of individuals in the population.
+ *             It's expected that this will remain constant
+ * @param population The population to be created
+ * @param system_definition Defines all of the programs within the system
+ *                          and their possible versions/commits
+ * @param goal The given goal
+ * @param random_seed Seed from which the genomes are created
+ * @returns zero on success
+ */
+int population_create_seeded(int size, sc_population * population,
+                             sc_system * system_definition,
+                             sc_goal * goal, unsigned int random_seed)
 {
     int i, retval;
 
@@ -83,23 +169,32 @@ int population_create(int size, sc_population * population,
     population->mutation_rate = SC_DEFAULT_MUTATION_RATE;
     population->crossover = SC_DEFAULT_CROSSOVER;
     population->rebels = SC_DEFAULT_REBELS;
+    population->diversity_response = SC_DEFAULT_DIVERSITY_RESPONSE;
+    population->diversity_threshold = SC_DEFAULT_DIVERSITY_THRESHOLD;
+    population->unique_threshold = SC_DEFAULT_UNIQUE_THRESHOLD;
+    population->stagnation_limit = SC_DEFAULT_STAGNATION_LIMIT;
+    population->replacement = SC_REPLACEMENT_GENERATIONAL;
+    population->elites = SC_DEFAULT_ELITES;
+    population->steady_state_replacements = SC_DEFAULT_STEADY_STATE_REPLACEMENTS;
 
     /* Possibly this could be the same as an island index
        for deterministic islanded runs */
-    population->random_seed = (unsigned int)time(NULL);
+    population->random_seed = random_seed;
 
     memcpy((void*)&population->goal, (void*)goal, sizeof(sc_goal));
     memcpy((void*)&population->sys, (void*)system_definition,
            sizeof(sc_system));
 
+    /* the size of genomes depends upon the packed state layout */
+    if (state_layout_create(&population->sys) != 0)
+        return 6;
+
+    /* space for the genomes of both generations */
+    if (population_arena_create(population) != 0)
+        return 5;
+
     /* Create an initially random population */
     for (i = 0; i < population->size; i++) {
-        population->individual[i] = (sc_genome*)malloc(sizeof(sc_genome));
-        if (population->individual[i] == NULL)
-            return 5;
-        population->next_generation[i] = (sc_genome*)malloc(sizeof(sc_genome));
-        if (population->next_generation[i] == NULL)
-            return 6;
         retval = genome_create(population, population->individual[i]);
         if (retval != 0) {
             population_free(population);
@@ -107,7 +202,7 @@ int population_create(int size, sc_population * population,
         }
     }
 
-    population_create_direct_ascent_genome(population);
+    population_create_direct_ascent_genome(population, 0);
 
     return 0;
 }
@@ -118,13 +213,11 @@ int population_create(int size, sc_population * population,
  */
 void population_free(sc_population * population)
 {
-    int i;
+    /* all genomes live within the arena */
+    free(population->arena);
 
-    /* free the individual genomes */
-    for (i = 0; i < population->size; i++) {
-        free(population->individual[i]);
-        free(population->next_generation[i]);
-    }
+    population_columns_free(population);
+    population_surrogate_free(population);
 
     free(population->individual);
     free(population->next_generation);
@@ -157,8 +250,9 @@ int genome_unique(sc_population * population,
     for (i = 0; i < genome_index; i++) {
         if (genome_array[i]->steps != genome->steps)
             continue;
-        if (memcmp((void*)&genome_array[i]->change,
-                   genome->change, genome->steps*sizeof(sc_system_state)) == 0)
+        if (memcmp((void*)genome_array[i]->change, (void*)genome->change,
+                   (size_t)genome->steps *
+                   (size_t)population->sys.state_bytes) == 0)
             return 0;
     }
     return 1;
@@ -186,6 +280,18 @@ int population_copy(sc_population * destination, sc_population * source)
     destination->mutation_rate = source->mutation_rate;
     destination->crossover = source->crossover;
     destination->rebels = source->rebels;
+    destination->replacement = source->replacement;
+    destination->elites = source->elites;
+    destination->steady_state_replacements = source->steady_state_replacements;
+    destination->evaluations = source->evaluations;
+    destination->objectives = source->objectives;
+    destination->diversity = source->diversity;
+    destination->diversity_response = source->diversity_response;
+    destination->diversity_threshold = source->diversity_threshold;
+    destination->unique_threshold = source->unique_threshold;
+    destination->stagnation_limit = source->stagnation_limit;
+    destination->stagnant_generations = source->stagnant_generations;
+    destination->best_score_so_far = source->best_score_so_far;
     destination->random_seed = source->random_seed;
     memcpy((void*)&destination->goal, (void*)&source->goal, sizeof(sc_goal));
     system_copy(&destination->sys, &source->sys);
@@ -201,19 +307,22 @@ int population_copy(sc_population * destination, sc_population * source)
     if (destination->next_generation == NULL)
         return 4;
 
+    if (population_arena_create(destination) != 0)
+        return 5;
+
     /* copy individuals */
-    for (i = 0; i < source->size; i++) {
-        destination->individual[i] = (sc_genome*)malloc(sizeof(sc_genome));
-        if (destination->individual[i] == NULL)
-            return 5;
+    for (i = 0; i < source->size; i++)
+        memcpy(destination->individual[i],
+               source->individual[i],genome_size(source));
 
-        destination->next_generation[i] = (sc_genome*)malloc(sizeof(sc_genome));
-        if (destination->next_generation[i] == NULL)
+    /* the destination has its own columns if the source had them */
+    destination->columns = NULL;
+    if (source->columns != NULL)
+        if (population_columns_enable(destination) != 0)
             return 6;
 
-        memcpy(destination->individual[i],
-               source->individual[i],sizeof(sc_genome));
-    }
+    if (population_surrogate_copy(destination, source) != 0)
+        return 7;
 
     return 0;
 }
@@ -271,7 +380,8 @@ int population_spawning_probabilities(sc_population * population)
 }
 
 /**
- * @brief sorts the current generation in order of their spawning probability
+ * @brief sorts the current generation in order of their spawning probability.
+ *        Any columns are updated to match the new order
  * @param population The population to be updated after evaluation of genomes
  * @returns zero on success
  */
@@ -298,6 +408,12 @@ int population_sort(sc_population * population)
             population->individual[i] = temp_genome;
         }
     }
+
+    /* the columns follow the new order of the genomes */
+    if (population->columns != NULL)
+        if (population_columns_update(population) != 0)
+            return 1;
+
     return 0;
 }
 
@@ -321,43 +437,224 @@ sc_genome * population_parent(sc_population * population)
 }
 
 /**
- * @brief Creates the next generation
+ * @brief Decides how many children of the next generation should be
+ *        new random genomes, and adjusts the mutation rate, depending
+ *        upon the diversity of the evaluated generation and whether the
+ *        search has stagnated
+ * @param population The population after evaluation of genomes
+ * @param diversity_lost Non-zero if a response is needed
+ * @returns The number of random genomes to create
+ */
+int population_diversity_response(sc_population * population,
+                                  int diversity_lost)
+{
+    int fresh = 0;
+
+    if (!diversity_lost)
+        return 0;
+
+    switch(population->diversity_response) {
+    case SC_DIVERSITY_RESPONSE_HYPERMUTATE:
+        population->mutation_rate *= SC_HYPERMUTATION_FACTOR;
+        if (population->mutation_rate > 1)
+            population->mutation_rate = 1;
+        break;
+    case SC_DIVERSITY_RESPONSE_REBELS:
+        fresh = (int)(population->rebels * population->size);
+        if (fresh < 1)
+            fresh = 1;
+        break;
+    case SC_DIVERSITY_RESPONSE_RESTART:
+        fresh = (int)(SC_RESTART_FRACTION * population->size);
+        break;
+    }
+
+    if (fresh > population->size)
+        fresh = population->size;
+
+    /* give the response some time to take effect */
+    population->stagnant_generations = 0;
+
+    return fresh;
+}
+
+/**
+ * @brief Returns the number of top scoring genomes which are carried
+ *        over unchanged into the next generation
+ * @param population The population object
+ * @returns Number of surviving genomes
+ */
+int population_survivors(sc_population * population)
+{
+    int survivors = population->elites;
+
+    if (population->replacement == SC_REPLACEMENT_STEADY_STATE)
+        survivors = population->size - population->steady_state_replacements;
+
+    if (survivors < 0)
+        survivors = 0;
+
+    /* at least one new child each generation */
+    if (survivors > population->size - 1)
+        survivors = population->size - 1;
+
+    return survivors;
+}
+
+/**
+ * @brief Creates a unique child genome within the next generation
+ * @param population The population object
+ * @param index Array index of the child within the next generation
+ * @param random Create a new random genome rather than spawning
+ *               from parents
+ * @returns zero on success
+ */
+static int population_create_child(sc_population * population,
+                                   int index, int random)
+{
+    int retval, tries = 0;
+
+    do {
+        if (random)
+            retval = genome_create(population,
+                                   population->next_generation[index]);
+        else
+            retval = genome_spawn(population,
+                                  population_parent(population),
+                                  population_parent(population),
+                                  population->next_generation[index]);
+        if (retval != 0)
+            return 30 + retval;
+
+        /* if there is repeated failure to create a unique
+           child genome */
+        tries++;
+        if (tries > SC_MAX_TRIES_FOR_UNIQUE_GENOME)
+            return 4;
+    } while (!genome_unique(population,
+                            population->next_generation[index], index, 1));
+
+    return 0;
+}
+
+/**
+ * @brief Creates the next generation.
+ *        If a surrogate model is enabled then several candidates are
+ *        created for each child and the one with the best predicted
+ *        score is kept, so that fewer unpromising genomes get built.
  * @param population The population to be updated after evaluation of genomes
  * @returns zero on success
  */
 int population_next_generation(sc_population * population)
 {
     sc_genome ** temp_buffer;
-    int i, retval, tries;
+    int i, c, retval, diversity_lost, fresh, survivors, screen;
+    float best_score, mutation_rate = population->mutation_rate;
+    float prediction, best_prediction;
+
+    /* measure the diversity of the evaluated generation */
+    if (population_diversity_update(population) != 0)
+        return 5;
+
+    /* has the search stagnated? */
+    best_score = population_best_score(population);
+    if (best_score > population->best_score_so_far) {
+        population->best_score_so_far = best_score;
+        population->stagnant_generations = 0;
+    }
+    else {
+        population->stagnant_generations++;
+    }
 
-    /* update spawning probabilities */
-    if (population_spawning_probabilities(population) != 0)
-        return 1;
+    if (population->objectives == SC_OBJECTIVES_PARETO) {
+        /* rank into fronts, which also sorts the population */
+        if (population_pareto_sort(population) != 0)
+            return 6;
+        diversity_lost = population_diversity_lost(population);
+    }
+    else if (population_spawning_probabilities(population) != 0) {
+        /* With no variation in score either nothing has been evaluated
+           or there has been a catastrophic loss of diversity */
+        if (population->diversity_response == SC_DIVERSITY_RESPONSE_NONE)
+            return 1;
+
+        /* all genomes are equally likely to be parents */
+        for (i = 0; i < population->size; i++)
+            population->individual[i]->spawning_probability = 1;
+
+        diversity_lost = 1;
+    }
+    else {
+        diversity_lost = population_diversity_lost(population);
+    }
 
     /* sort the population in order of spawning probability */
-    if (population_sort(population) != 0)
-        return 2;
+    if (population->objectives != SC_OBJECTIVES_PARETO)
+        if (population_sort(population) != 0)
+            return 2;
+
+    /* The best genomes may survive unchanged, keeping their scores.
+       Since the population is sorted they are at the start */
+    survivors = population_survivors(population);
+    for (i = 0; i < survivors; i++)
+        memcpy((void*)population->next_generation[i],
+               (void*)population->individual[i],
+               genome_size(population));
+
+    /* the last few children may be new random genomes */
+    fresh = population_diversity_response(population, diversity_lost);
+    if (fresh > population->size - survivors)
+        fresh = population->size - survivors;
+
+    /* Only send the most promising children for evaluation once the
+       surrogate model has learned enough */
+    screen = ((population->surrogate != NULL) &&
+              (population->surrogate->samples >=
+               population->surrogate->min_samples));
 
     /* create the children of the next generation */
-    for (i = 0; i < population->size; i++) {
-        tries = 0;
-        do {
-            retval = genome_spawn(population,
-                                  population_parent(population),
-                                  population_parent(population),
-                                  population->next_generation[i]);
-            if (retval != 0)
-                return 30 + retval;
-
-            /* if there is repeated failure to create a unique
-               child genome */
-            tries++;
-            if (tries > SC_MAX_TRIES_FOR_UNIQUE_GENOME)
-                return 4;
-        } while (!genome_unique(population,
-                                population->next_generation[i], i, 1));
+    for (i = survivors; i < population->size; i++) {
+        retval = population_create_child(population, i,
+                                         (i >= population->size - fresh));
+        if (retval != 0) {
+            population->mutation_rate = mutation_rate;
+            return retval;
+        }
+
+        if ((!screen) || (i >= population->size - fresh))
+            continue;
+
+        /* keep the candidate with the best predicted score */
+        best_prediction =
+            surrogate_predict(population, population->next_generation[i]);
+        memcpy((void*)population->surrogate->candidate,
+               (void*)population->next_generation[i],
+               genome_size(population));
+        for (c = 1; c < population->surrogate->oversample; c++) {
+            retval = population_create_child(population, i, 0);
+            if (retval != 0) {
+                population->mutation_rate = mutation_rate;
+                return retval;
+            }
+
+            prediction =
+                surrogate_predict(population, population->next_generation[i]);
+            if (prediction > best_prediction) {
+                best_prediction = prediction;
+                memcpy((void*)population->surrogate->candidate,
+                       (void*)population->next_generation[i],
+                       genome_size(population));
+            }
+            population->surrogate->children_screened++;
+        }
+        memcpy((void*)population->next_generation[i],
+               (void*)population->surrogate->candidate,
+               genome_size(population));
     }
 
+    /* any hypermutation only lasts for one generation */
+    population->mutation_rate = mutation_rate;
+
     /* swap the arrays over, so the new generation is now
        the current one */
     temp_buffer = population->next_generation;
@@ -365,7 +662,12 @@ int population_next_generation(sc_population * population)
     population->individual = temp_buffer;
 
     /* one genome tries to go straight to the goal */
-    population_create_direct_ascent_genome(population);
+    population_create_direct_ascent_genome(population, survivors);
+
+    /* keep the structure-of-arrays view in step with the new generation */
+    if (population->columns != NULL)
+        if (population_columns_update(population) != 0)
+            return 5;
 
     return 0;
 }
@@ -382,14 +684,139 @@ int population_set_test_passes(sc_population * population, int index, int test_p
     if (index < 0) return 1;
     if (index >= population->size) return 2;
 
+    return population_set_partial_score(population, index, test_passes,
+                                        population->individual[index]->steps);
+}
+
+/**
+ * @brief Sets the evaluation score for a genome whose evaluation may
+ *        have ended before all of its steps were built and tested.
+ *        Only the tests which passed so far contribute to the score,
+ *        and the score is also weighted by the proportion of steps
+ *        which were completed, so a genome which fails early scores
+ *        less than one which gets further with the same test passes.
+ *        A genome which completes all of its steps has a weight of one.
+ * @param population The population after individuals have been evaluated
+ * @param index Array index of the genome for an individual
+ * @param test_passes The number of test passes before evaluation ended
+ * @param steps_completed The number of steps which were completed
+ * @returns zero on success
+ */
+int population_set_partial_score(sc_population * population, int index,
+                                 int test_passes, int steps_completed)
+{
+    sc_genome * individual;
+
+    if (index < 0) return 1;
+    if (index >= population->size) return 2;
+
+    individual = population->individual[index];
+    if ((steps_completed < 0) || (steps_completed > individual->steps))
+        return 3;
+
     /* This division biases the score in favour of shorter upgrade sequences */
-    population->individual[index]->score =
-        (float)test_passes /
-        (float)(1 + population->individual[index]->steps);
+    individual->score = (float)test_passes / (float)(1 + individual->steps);
+
+    /* steps which weren't completed count against the genome, but
+       test passes from the completed steps are never discarded */
+    individual->score *=
+        (float)(1 + steps_completed) / (float)(1 + individual->steps);
+    individual->steps_completed = steps_completed;
+    individual->test_passes = test_passes;
+    individual->goal_distance =
+        goal_genome_distances(population, individual, NULL);
+    individual->evaluated = 1;
+    population->evaluations++;
+
+    if (population->columns != NULL)
+        population->columns->score[index] = individual->score;
+
+    /* learn from every real evaluation */
+    if (population->surrogate != NULL)
+        surrogate_train(population, individual);
 
     return 0;
 }
 
+/**
+ * @brief Evaluates every genome of the current generation which hasn't
+ *        already been evaluated. Genomes are evaluated in parallel, but
+ *        their scores are set afterwards in array order, so the results
+ *        are the same whatever the number of threads.
+ * @param population The population object
+ * @param evaluate Function which evaluates a single genome. It may be
+ *                 called from several threads at once, so it must not
+ *                 change the population
+ * @param context Passed to the evaluate function
+ * @param max_threads Maximum number of genomes evaluated at once
+ * @param genome_index Returned array indexes of the genomes which were
+ *                     evaluated, in the order that their scores were set.
+ *                     May be NULL
+ * @returns The number of genomes evaluated, or negative on error
+ */
+int population_evaluate(sc_population * population,
+                        sc_genome_evaluate evaluate, void * context,
+                        int max_threads, int * genome_index)
+{
+    int * index, * test_passes, * steps_completed, * status;
+    float * build_time;
+    int i, n = 0, retval = 0;
+
+    if (max_threads < 1)
+        max_threads = 1;
+
+    index = (int*)malloc(population->size*sizeof(int));
+    test_passes = (int*)malloc(population->size*sizeof(int));
+    steps_completed = (int*)malloc(population->size*sizeof(int));
+    status = (int*)malloc(population->size*sizeof(int));
+    build_time = (float*)malloc(population->size*sizeof(float));
+    if ((index == NULL) || (test_passes == NULL) ||
+        (steps_completed == NULL) || (status == NULL) ||
+        (build_time == NULL)) {
+        retval = -1;
+    }
+    else {
+        /* survivors from the previous generation keep their scores */
+        for (i = 0; i < population->size; i++)
+            if (!population->individual[i]->evaluated)
+                index[n++] = i;
+
+#pragma omp parallel for schedule(dynamic) num_threads(max_threads)
+        for (i = 0; i < n; i++) {
+            build_time[i] = 0;
+            status[i] = evaluate(context, population, index[i],
+                                 &test_passes[i], &steps_completed[i],
+                                 &build_time[i]);
+        }
+
+        /* the order in which genomes finished doesn't matter */
+        for (i = 0; i < n; i++) {
+            if (status[i] != 0) {
+                retval = -2;
+                break;
+            }
+            if (population_set_partial_score(population, index[i],
+                                             test_passes[i],
+                                             steps_completed[i]) != 0) {
+                retval = -3;
+                break;
+            }
+            population->individual[index[i]]->build_time = build_time[i];
+            if (genome_index != NULL)
+                genome_index[i] = index[i];
+        }
+        if (retval == 0)
+            retval = n;
+    }
+
+    free(index);
+    free(test_passes);
+    free(steps_completed);
+    free(status);
+    free(build_time);
+    return retval;
+}
+
 /**
  * @brief Returns the evaluation score for a genome with the given array index
  * @param population The population after individuals have been evaluated
@@ -419,6 +846,9 @@ float population_average_score(sc_population * population)
 
     if (population->size <= 0) return 0;
 
+    if (population->columns != NULL)
+        return population_columns_average_score(population->columns);
+
     for (i = 0; i < population->size; i++) {
         score += population->individual[i]->score;
     }
@@ -437,6 +867,9 @@ int population_best_index(sc_population * population)
 
     if (population->size <= 0) return 0;
 
+    if (population->columns != NULL)
+        return population_columns_best_index(population->columns);
+
     for (i = 0; i < population->size; i++) {
         if (population->individual[i]->score > max_score) {
             max_score = population->individual[i]->score;
@@ -471,6 +904,9 @@ int population_worst_index(sc_population * population)
 
     if (population->size <= 0) return 0;
 
+    if (population->columns != NULL)
+        return population_columns_worst_index(population->columns);
+
     for (i = 0; i < population->size; i++) {
         if ((min_score == 0) ||
             (population->individual[i]->score < min_score)) {
@@ -495,6 +931,9 @@ float population_variance(sc_population * population)
     if ((population->size <= 0) || (average_score <= 0))
         return 0;
 
+    if (population->columns != NULL)
+        return population_columns_variance(population->columns);
+
     for (i = 0; i < population->size; i++) {
         diff = population->individual[i]->score - average_score;
         variance += diff*diff;
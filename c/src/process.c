@@ -0,0 +1,375 @@
+/*
+  Smart search for upgrade paths
+  Copyright (C) 2016 Andrew Leeming <andrew.leeming@codethink.co.uk> and
+  Bob Mottram <bob.mottram@codethink.co.uk>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* for pipe2 and posix_spawn_file_actions_addchdir_np */
+#define _GNU_SOURCE
+
+#include "scalam.h"
+
+extern char ** environ;
+
+/* The maximum number of processes which may run at once, or zero for
+   no limit, and the number which are currently running */
+static int process_max_running = 0;
+static int process_running = 0;
+
+/**
+ * @brief Returns the time in milliseconds from an arbitrary start
+ * @returns Monotonic time in milliseconds
+ */
+static long long process_milliseconds()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec*1000 + now.tv_nsec/1000000;
+}
+
+/**
+ * @brief Waits until fewer than the maximum number of processes
+ *        are running, then counts a new one
+ */
+static void process_acquire_slot()
+{
+    int acquired = 0;
+
+    while (!acquired) {
+#pragma omp critical (process_slots)
+        {
+            if ((process_max_running <= 0) ||
+                (process_running < process_max_running)) {
+                process_running++;
+                acquired = 1;
+            }
+        }
+        if (!acquired)
+            usleep(SC_PROCESS_POLL_INTERVAL*1000);
+    }
+}
+
+/**
+ * @brief Counts a process as no longer running
+ */
+static void process_release_slot()
+{
+#pragma omp critical (process_slots)
+    process_running--;
+}
+
+/**
+ * @brief Sets the maximum number of processes which may run at once.
+ *        Threads wanting to run more wait until others have finished
+ * @param max_running The maximum number of processes, or zero for no limit
+ */
+void process_set_max_running(int max_running)
+{
+#pragma omp critical (process_slots)
+    process_max_running = max_running;
+}
+
+/**
+ * @brief Sets the default options, which are to capture standard output,
+ *        read nothing from standard input and have no time limit
+ * @param options The options object
+ */
+void process_options_init(sc_process_options * options)
+{
+    memset((void*)options, '\0', sizeof(sc_process_options));
+}
+
+/**
+ * @brief Frees the captured output of a process
+ * @param result The result object
+ */
+void process_result_free(sc_process_result * result)
+{
+    if (result->output != NULL)
+        free(result->output);
+    result->output = NULL;
+    result->output_length = 0;
+    result->output_size = 0;
+}
+
+/**
+ * @brief Adds output to the growable buffer of a result, keeping it terminated
+ * @param result The result object
+ * @param data Output which was read
+ * @param length Length of the output
+ * @returns zero on success
+ */
+static int process_append_output(sc_process_result * result,
+                                 char * data, int length)
+{
+    int size = result->output_size;
+    char * output;
+
+    if (result->output_length + length + 1 > size) {
+        if (size < SC_PROCESS_READ_SIZE)
+            size = SC_PROCESS_READ_SIZE;
+        while (result->output_length + length + 1 > size)
+            size *= 2;
+
+        output = (char*)realloc(result->output, size);
+        if (output == NULL)
+            return 1;
+        result->output = output;
+        result->output_size = size;
+    }
+
+    memcpy(&result->output[result->output_length], data, length);
+    result->output_length += length;
+    result->output[result->output_length] = 0;
+    return 0;
+}
+
+/**
+ * @brief Runs a program directly, without a shell, streaming its
+ *        standard output either into the result or into a file
+ * @param argv Program and its arguments, terminated by NULL.
+ *             The program is searched for within PATH
+ * @param options Options for running the program, or NULL for defaults
+ * @param result Returned exit status and any captured output. This should
+ *               be freed with process_result_free
+ * @returns The exit status of the program, or SC_PROCESS_NOT_RUN,
+ *          SC_PROCESS_TIMED_OUT or SC_PROCESS_SIGNALLED
+ */
+int process_run_with_options(char * const * argv, sc_process_options * options,
+                             sc_process_result * result)
+{
+    sc_process_options default_options;
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attributes;
+    struct pollfd fds;
+    char buffer[SC_PROCESS_READ_SIZE];
+    FILE * output_fp = NULL;
+    long long deadline = 0;
+    int pipe_fd[2], status, retval, timeout;
+    ssize_t length;
+    pid_t pid;
+
+    memset((void*)result, '\0', sizeof(sc_process_result));
+    result->exit_status = SC_PROCESS_NOT_RUN;
+
+    if ((argv == NULL) || (argv[0] == NULL))
+        return result->exit_status;
+
+    if (options == NULL) {
+        process_options_init(&default_options);
+        options = &default_options;
+    }
+
+    if (options->output_filename != NULL) {
+        output_fp = fopen(options->output_filename, "w");
+        if (output_fp == NULL)
+            return result->exit_status;
+    }
+
+    /* close on exec, so that processes spawned by other threads
+       don't hold the pipe open */
+    if (pipe2(pipe_fd, O_CLOEXEC) != 0) {
+        if (output_fp != NULL)
+            fclose(output_fp);
+        return result->exit_status;
+    }
+
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, 0,
+                                     (options->input_filename != NULL) ?
+                                     options->input_filename : "/dev/null",
+                                     O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&actions, pipe_fd[1], 1);
+    if (options->quiet)
+        posix_spawn_file_actions_addopen(&actions, 2, "/dev/null", O_WRONLY, 0);
+    if (options->directory != NULL)
+        posix_spawn_file_actions_addchdir_np(&actions, options->directory);
+
+    /* with a time limit the program gets its own process group, so that
+       anything it starts can also be stopped */
+    posix_spawnattr_init(&attributes);
+    if (options->timeout > 0) {
+        posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP);
+        posix_spawnattr_setpgroup(&attributes, 0);
+    }
+
+    process_acquire_slot();
+    retval = posix_spawnp(&pid, argv[0], &actions, &attributes, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attributes);
+    close(pipe_fd[1]);
+
+    if (retval != 0) {
+        process_release_slot();
+        close(pipe_fd[0]);
+        if (output_fp != NULL)
+            fclose(output_fp);
+        return result->exit_status;
+    }
+
+    if (options->timeout > 0)
+        deadline = process_milliseconds() + options->timeout;
+
+    /* read the output until the program closes it or runs out of time */
+    fds.fd = pipe_fd[0];
+    fds.events = POLLIN;
+    while (!result->timed_out) {
+        timeout = -1;
+        if (deadline > 0) {
+            timeout = (int)(deadline - process_milliseconds());
+            if (timeout <= 0) {
+                result->timed_out = 1;
+                break;
+            }
+        }
+
+        retval = poll(&fds, 1, timeout);
+        if (retval == 0) {
+            result->timed_out = 1;
+            break;
+        }
+        if (retval < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        length = read(pipe_fd[0], buffer, SC_PROCESS_READ_SIZE);
+        if (length < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (length == 0)
+            break;
+
+        if (output_fp != NULL)
+            fwrite(buffer, 1, length, output_fp);
+        else
+            process_append_output(result, buffer, (int)length);
+    }
+    close(pipe_fd[0]);
+    if (output_fp != NULL)
+        fclose(output_fp);
+
+    /* the program may still be running after closing its output */
+    while (!result->timed_out) {
+        retval = waitpid(pid, &status, (deadline > 0) ? WNOHANG : 0);
+        if (retval == pid)
+            break;
+        if ((retval < 0) && (errno != EINTR)) {
+            process_release_slot();
+            return result->exit_status;
+        }
+        if ((deadline > 0) && (process_milliseconds() >= deadline))
+            result->timed_out = 1;
+        else if (retval == 0)
+            usleep(SC_PROCESS_POLL_INTERVAL*1000);
+    }
+
+    if (result->timed_out) {
+        kill(-pid, SIGKILL);
+        while ((waitpid(pid, &status, 0) < 0) && (errno == EINTR)) {}
+        result->exit_status = SC_PROCESS_TIMED_OUT;
+    }
+    else if (WIFEXITED(status))
+        result->exit_status = WEXITSTATUS(status);
+    else
+        result->exit_status = SC_PROCESS_SIGNALLED;
+
+    process_release_slot();
+    return result->exit_status;
+}
+
+/**
+ * @brief Runs a program, discarding its output
+ * @param argv Program and its arguments, terminated by NULL
+ * @param timeout Maximum run time in milliseconds, or zero for no limit
+ * @param quiet Non-zero if standard error should also be discarded
+ * @returns The exit status of the program, or negative if it
+ *          didn't run to completion
+ */
+int process_run(char * const * argv, int timeout, int quiet)
+{
+    sc_process_options options;
+    sc_process_result result;
+
+    process_options_init(&options);
+    options.timeout = timeout;
+    options.quiet = quiet;
+    process_run_with_options(argv, &options, &result);
+    process_result_free(&result);
+    return result.exit_status;
+}
+
+/**
+ * @brief Runs a program and returns its output, without any
+ *        trailing white space
+ * @param argv Program and its arguments, terminated by NULL
+ * @param timeout Maximum run time in milliseconds, or zero for no limit
+ * @param output Returned output, which is truncated to fit
+ * @param max_length Size of the output buffer
+ * @returns The exit status of the program, or negative if it
+ *          didn't run to completion
+ */
+int process_run_with_output(char * const * argv, int timeout,
+                            char * output, int max_length)
+{
+    sc_process_options options;
+    sc_process_result result;
+    int length;
+
+    process_options_init(&options);
+    options.timeout = timeout;
+    process_run_with_options(argv, &options, &result);
+
+    length = result.output_length;
+    while ((length > 0) &&
+           ((result.output[length-1] == '\n') ||
+            (result.output[length-1] == '\r') ||
+            (result.output[length-1] == ' ')))
+        length--;
+    if (length > max_length - 1)
+        length = max_length - 1;
+    if (length > 0)
+        memcpy(output, result.output, length);
+    output[length] = 0;
+
+    process_result_free(&result);
+    return result.exit_status;
+}
+
+/**
+ * @brief Runs a program, writing its output to a file
+ * @param argv Program and its arguments, terminated by NULL
+ * @param timeout Maximum run time in milliseconds, or zero for no limit
+ * @param filename File which the output is written to
+ * @returns The exit status of the program, or negative if it
+ *          didn't run to completion
+ */
+int process_run_to_file(char * const * argv, int timeout, char * filename)
+{
+    sc_process_options options;
+    sc_process_result result;
+
+    process_options_init(&options);
+    options.timeout = timeout;
+    options.output_filename = filename;
+    process_run_with_options(argv, &options, &result);
+    process_result_free(&result);
+    return result.exit_status;
+}
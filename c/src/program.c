@@ -27,16 +27,44 @@
  */
 int program_repo_get_current_checkout(char * repo_dir, char * commit)
 {
-    char commandstr[SC_MAX_STRING];
+    char * argv[] = {
+        "git", "-C", repo_dir, "rev-parse", "--verify", "-q", "HEAD", NULL
+    };
 
     commit[0] = 0;
-    sprintf(commandstr,
-            "cd %s\ngit log -1 | grep commit | awk -F ' ' '{print $2}'",
-            repo_dir);
+    if (process_run_with_output(argv, 0, commit, SC_MAX_STRING) < 0)
+        return 1;
+
+    return 0;
+}
 
-    if (run_shell_command_with_output(commandstr, commit) != 0)
+/**
+ * @brief Sets the version index of a program from the commit which is
+ *        currently checked out within its repo
+ * @param repo_dir Directory containing the git repo
+ * @param prog Program object, whose versions file already exists
+ * @returns zero on success
+ */
+int program_repo_get_current_version(char * repo_dir, sc_program * prog)
+{
+    char current_checkout[SC_MAX_STRING];
+    int line_number;
+
+    if (program_repo_get_current_checkout(repo_dir, current_checkout) != 0)
         return 1;
 
+    /* Get the array index from the checkout */
+    line_number =
+        get_line_number_from_string_in_file(string_pool_get(prog->versions_file),
+                                            current_checkout);
+    if (line_number < 0)
+        return 2;
+
+    /* Invert the line number so that the last line in versions_file
+       corresponds to version index zero. This just makes incrementing
+       through versions more intuitive. */
+    prog->version_index = prog->no_of_versions - 1 - line_number;
+
     return 0;
 }
 
@@ -48,13 +76,13 @@ int program_repo_get_current_checkout(char * repo_dir, char * commit)
  */
 int program_repo_get_head(char * repo_dir, char * commit)
 {
-    char commandstr[SC_MAX_STRING];
+    char * argv[] = {
+        "git", "-C", repo_dir, "rev-parse", "--verify", "-q",
+        "refs/heads/master", NULL
+    };
 
     commit[0] = 0;
-    sprintf(commandstr,
-            "cd %s\ngit show-ref --head | grep master | head -n 1 | awk -F ' ' '{print $1}'",
-            repo_dir);
-    if (run_shell_command_with_output(commandstr, commit) != 0)
+    if (process_run_with_output(argv, 0, commit, SC_MAX_STRING) < 0)
         return 1;
 
     return 0;
@@ -67,13 +95,15 @@ int program_repo_get_head(char * repo_dir, char * commit)
  */
 int program_name_is_valid(sc_program * prog)
 {
+    char * name = string_pool_get(prog->name);
+
     /* null string */
-    if (prog->name[0] == 0)
+    if (name[0] == 0)
         return 1;
 
     /* first character is not an ascii letter */
-    if (!(((prog->name[0] >= 'a') && (prog->name[0] <= 'z')) ||
-          ((prog->name[0] >= 'A') && (prog->name[0] <= 'Z'))))
+    if (!(((name[0] >= 'a') && (name[0] <= 'z')) ||
+          ((name[0] >= 'A') && (name[0] <= 'Z'))))
         return 2;
 
     return 0;
@@ -108,7 +138,7 @@ int program_version_from_index(sc_program * prog, int version_index, char * vers
     int retval;
 
     /* check that the versions file exists */
-    if (!file_exists(prog->versions_file)) {
+    if (!file_exists(string_pool_get(prog->versions_file))) {
         return 1;
     }
 
@@ -119,7 +149,7 @@ int program_version_from_index(sc_program * prog, int version_index, char * vers
         return 2;
     }
 
-    retval = get_line_from_file(prog->versions_file, version_index, version);
+    retval = get_line_from_file(string_pool_get(prog->versions_file), version_index, version);
     if (retval != 0) {
         printf("error: program_version_from_index: %d\n", retval);
         return 10+retval;
@@ -128,165 +158,359 @@ int program_version_from_index(sc_program * prog, int version_index, char * vers
     return 0;
 }
 
+/**
+ * @brief Sets the default clone options, which are to fetch the whole
+ *        history and check out the head
+ * @param options The options object
+ */
+void program_clone_options_init(sc_clone_options * options)
+{
+    memset((void*)options, '\0', sizeof(sc_clone_options));
+    options->filter = SC_CLONE_FULL;
+}
+
+/**
+ * @brief Clones a git repo, fetching only as much of it as the options
+ *        allow. Versions are listed from the first parent history of
+ *        master, which needs only commits, so partial and shallow clones
+ *        are enough until a commit is built
+ * @param repo_url URL of the git repo, or a local directory
+ * @param repo_dir Directory to clone into
+ * @param options Clone options, or NULL for a full clone
+ * @returns zero on success
+ */
+int program_repo_clone(char * repo_url, char * repo_dir,
+                       sc_clone_options * options)
+{
+    char url[SC_MAX_STRING*2];
+    char path[PATH_MAX];
+    char depth_arg[SC_MAX_STRING];
+    char exclude_arg[SC_MAX_STRING*2];
+    char deepen_arg[SC_MAX_STRING];
+    char * filter_arg[] = { NULL, "--filter=blob:none", "--filter=tree:0" };
+    char * argv[16];
+    char * deepen_argv[] = {
+        "git", "-C", repo_dir, "fetch", "--quiet", deepen_arg, "origin", NULL
+    };
+    sc_clone_options defaults;
+    int argc = 0;
+
+    if (options == NULL) {
+        program_clone_options_init(&defaults);
+        options = &defaults;
+    }
+
+    if ((options->filter < SC_CLONE_FULL) ||
+        (options->filter > SC_CLONE_TREELESS) ||
+        (options->depth < 0))
+        return 1;
+
+    /* local repos are copied whole unless they are cloned
+       through the file protocol */
+    snprintf(url, sizeof(url), "%s", repo_url);
+    if (((options->filter != SC_CLONE_FULL) || (options->depth > 0) ||
+         (options->start_revision[0] != 0)) &&
+        directory_exists(repo_url) && (realpath(repo_url, path) != NULL))
+        snprintf(url, sizeof(url), "file://%s", path);
+
+    argv[argc++] = "git";
+    argv[argc++] = "clone";
+    argv[argc++] = "--quiet";
+    if (options->no_checkout)
+        argv[argc++] = "--no-checkout";
+    if (options->filter != SC_CLONE_FULL)
+        argv[argc++] = filter_arg[options->filter];
+    if (options->reference[0] != 0) {
+        argv[argc++] = "--reference-if-able";
+        argv[argc++] = options->reference;
+    }
+    if (options->start_revision[0] != 0) {
+        snprintf(exclude_arg, sizeof(exclude_arg), "--shallow-exclude=%s",
+                 options->start_revision);
+        argv[argc++] = exclude_arg;
+    }
+    else if (options->depth > 0) {
+        snprintf(depth_arg, sizeof(depth_arg), "--depth=%d", options->depth);
+        argv[argc++] = depth_arg;
+    }
+    argv[argc++] = url;
+    argv[argc++] = repo_dir;
+    argv[argc] = NULL;
+
+    if (process_run(argv, SC_PROCESS_NETWORK_TIMEOUT, 1) != 0)
+        return 2;
+
+    /* history before the start version was excluded, so deepen it to
+       include the start version itself and any commits before it */
+    if (options->start_revision[0] != 0) {
+        snprintf(deepen_arg, sizeof(deepen_arg), "--deepen=%d",
+                 options->depth + 1);
+        if (process_run(deepen_argv, SC_PROCESS_NETWORK_TIMEOUT, 1) != 0)
+            return 3;
+    }
+
+    return 0;
+}
+
 /**
  * @brief Gets a list of commits from a git repo as a file called versions.txt
  * @param repos_dir Directory where the git repo will be checked out
  * @param repo_url URL of the git repo
  * @param prog Program object
+ * @param options How the repo is cloned, or NULL for a full clone
  * @returns zero on success
  */
-int program_get_versions_from_git(char * repos_dir, char * repo_url, sc_program * prog)
+int program_get_versions_from_git(char * repos_dir, char * repo_url,
+                                  sc_program * prog, sc_clone_options * options)
 {
-    char commandstr[SC_MAX_STRING];
+    char repo_dir[SC_MAX_STRING*2];
 
     if (program_name_is_valid(prog) != 0)
         return 5;
 
-    sprintf(commandstr, "cd %s && git clone %s \"%s\" --quiet", repos_dir, repo_url, prog->name);
+    snprintf(repo_dir, sizeof(repo_dir), "%s/%s",
+             repos_dir, string_pool_get(prog->name));
 
-    if (run_shell_command(commandstr) != 0)
+    /* the repo may already have been cloned */
+    if (!directory_exists(repo_dir) &&
+        (program_repo_clone(repo_url, repo_dir, options) != 0))
         return 6;
 
-    sprintf(prog->versions_file, "%s/%s/versions.txt", repos_dir, prog->name);
-    sprintf(commandstr, "cd \"%s/%s\" && git log --pretty=tformat:\"%H\" --all --first-parent master > %s",
-            repos_dir, prog->name, prog->versions_file);
-
-    if (run_shell_command(commandstr) != 0)
+    /* the same versions file and metadata as any other repo, so that
+       later updates are incremental */
+    if (program_repo_get_commits(repo_dir, prog) != 0)
         return 7;
 
-    if (!file_exists(prog->versions_file))
-        return 8;
+    return 0;
+}
 
-    prog->no_of_versions = lines_in_file(prog->versions_file);
+/**
+ * @brief Returns a local copy of a tarball or package, downloading it
+ *        into the repos directory if it isn't already a local file
+ * @param repos_dir Directory where downloads are kept
+ * @param url URL or filename of the tarball or package
+ * @param filename Returned local filename, with room for SC_MAX_STRING*2
+ * @returns zero on success
+ */
+int program_fetch_archive(char * repos_dir, char * url, char * filename)
+{
+    char * name;
+    char * argv[] = { "wget", "-q", "-O", filename, url, NULL };
+
+    if (file_exists(url)) {
+        snprintf(filename, SC_MAX_STRING*2, "%s", url);
+        return 0;
+    }
+
+    name = strrchr(url, '/');
+    name = (name != NULL) ? name + 1 : url;
+    if (name[0] == 0)
+        return 1;
+
+    snprintf(filename, SC_MAX_STRING*2, "%s/%s", repos_dir, name);
+    if (process_run(argv, SC_PROCESS_NETWORK_TIMEOUT, 0) != 0) {
+        unlink(filename);
+        return 2;
+    }
 
     return 0;
 }
 
 /**
- * @brief Gets a list of versions from a changelog
+ * @brief Saves the versions read from a changelog as the versions file
+ *        of a program, within a directory named after it
+ * @param changelog Versions read from a changelog
+ * @param repos_dir Directory containing the program directory
+ * @param prog Program object
+ * @returns zero on success
+ */
+int program_versions_from_changelog(sc_changelog * changelog,
+                                    char * repos_dir, sc_program * prog)
+{
+    char directory[SC_MAX_STRING*2];
+
+    snprintf(directory, sizeof(directory), "%s/%s",
+             repos_dir, string_pool_get(prog->name));
+    mkdir(directory, 0700);
+
+    prog->versions_file = string_pool_printf("%s/versions.txt", directory);
+    if (changelog_save(changelog, string_pool_get(prog->versions_file)) != 0)
+        return 1;
+
+    prog->no_of_versions = changelog->no_of_versions;
+    return 0;
+}
+
+/**
+ * @brief Gets a list of versions from a changelog. This can be a Debian
+ *        changelog, an RPM spec file or a NEWS, CHANGES, HISTORY or
+ *        ChangeLog file, and may be compressed with gzip. If the program
+ *        doesn't have a versions file yet then versions.txt is created
+ *        in the same directory as the changelog.
  * @param changelog_filename Filename of the changelog
  * @param prog Program object
  * @returns zero on success
  */
 int program_get_versions_from_changelog(char * changelog_filename, sc_program * prog)
 {
+    sc_changelog changelog;
+    char * directory;
+
     if (program_name_is_valid(prog) != 0)
         return 5;
 
     /* do we know where to put the resulting versions list? */
-    if (file_exists(prog->versions_file))
+    if (file_exists(string_pool_get(prog->versions_file)))
         return 6;
 
-    /* TODO */
+    changelog_init(&changelog);
+    if (changelog_read(&changelog, changelog_filename) != 0) {
+        changelog_free(&changelog);
+        return 7;
+    }
+    if (changelog.no_of_versions == 0) {
+        changelog_free(&changelog);
+        return 8;
+    }
+
+    if (prog->versions_file == 0) {
+        directory = strrchr(changelog_filename, '/');
+        if (directory != NULL)
+            prog->versions_file =
+                string_pool_printf("%.*s/versions.txt",
+                                   (int)(directory - changelog_filename),
+                                   changelog_filename);
+        else
+            prog->versions_file = string_pool_add("versions.txt");
+    }
+
+    if (changelog_save(&changelog, string_pool_get(prog->versions_file)) != 0) {
+        changelog_free(&changelog);
+        return 9;
+    }
+    prog->no_of_versions = changelog.no_of_versions;
+
+    changelog_free(&changelog);
     return 0;
 }
 
 /**
- * @brief Gets a list of versions from a changelog within a tarball
- * @param repos_dir Directory where the git repo will be checked out
- * @param tarball_url URL of the tarball
+ * @brief Gets a list of versions from a changelog within a tarball.
+ *        The changelog is read from the tarball without extracting it.
+ * @param repos_dir Directory where the versions list will be created
+ * @param tarball_url URL or filename of the tarball
  * @param prog Program object
  * @returns zero on success
  */
 int program_get_versions_from_tarball(char * repos_dir, char * tarball_url, sc_program * prog)
 {
-    char commandstr[SC_MAX_STRING];
+    sc_changelog changelog;
+    char tarball[SC_MAX_STRING*2];
+    int retval = 0;
 
     if (program_name_is_valid(prog) != 0)
         return 5;
 
     /* do we know where to put the resulting versions list? */
-    if (file_exists(prog->versions_file))
+    if (file_exists(string_pool_get(prog->versions_file)))
         return 6;
 
-    sprintf(commandstr, "cd %s && tar -xf %s -C %s --strip 1", repos_dir, tarball_url, prog->name);
-    if (run_shell_command(commandstr) != 0)
-        return 6;
+    if (program_fetch_archive(repos_dir, tarball_url, tarball) != 0)
+        return 7;
 
-    /* TODO
-       find the actual filename of the change log in the extracted directory
-       assumed to be ChangeLog, but could also be one of the following:
-       CHANGELOG.md, HISTORY.txt, HISTORY.md, History.md, NEWS.txt, NEWS.md,
-       News.txt, RELEASES.txt, RELEASE.md, releases.md
-    */
-    char changelog_filename[] = "foobar";
+    changelog_init(&changelog);
+    if (changelog_read_tarball(&changelog, tarball) != 0)
+        retval = 8;
+    else if (program_versions_from_changelog(&changelog, repos_dir, prog) != 0)
+        retval = 9;
+    changelog_free(&changelog);
 
-    return program_get_versions_from_changelog(changelog_filename, prog);
+    return retval;
 }
 
 /**
- * @brief Gets a list of versions from a debian package
- * @param repos_dir Directory where the git repo will be checked out
- * @param deb_url URL where the debian package can be downloaded from
+ * @brief Gets a list of versions from the changelog within a debian package
+ * @param repos_dir Directory where the versions list will be created
+ * @param deb_url URL or filename of the debian package
  * @param prog Program object
  * @returns zero on success
  */
 int program_get_versions_from_deb_package(char * repos_dir, char * deb_url, sc_program * prog)
 {
+    sc_changelog changelog;
+    char package[SC_MAX_STRING*2];
+    int retval = 0;
+
     if (program_name_is_valid(prog) != 0)
         return 5;
 
     /* do we know where to put the resulting versions list? */
-    if (file_exists(prog->versions_file))
+    if (file_exists(string_pool_get(prog->versions_file)))
         return 6;
 
-    /* TODO
-       This should wget the package, extract changelog from the DEBIAN directory then
-       call program_get_versions_from_changelog */
+    if (program_fetch_archive(repos_dir, deb_url, package) != 0)
+        return 7;
 
-    return 0;
+    changelog_init(&changelog);
+    if (changelog_read_deb_package(&changelog, package) != 0)
+        retval = 8;
+    else if (program_versions_from_changelog(&changelog, repos_dir, prog) != 0)
+        retval = 9;
+    changelog_free(&changelog);
+
+    return retval;
 }
 
 /**
- * @brief Gets a list of versions from a RPM package
- * @param repos_dir Directory where the git repo will be checked out
- * @param rpm_url URL where the debian package can be downloaded from
+ * @brief Gets a list of versions from the %changelog of the spec file
+ *        within a RPM package
+ * @param repos_dir Directory where the versions list will be created
+ * @param rpm_url URL or filename of the RPM package
  * @param prog Program object
  * @returns zero on success
  */
 int program_get_versions_from_rpm_package(char * repos_dir, char * rpm_url, sc_program * prog)
 {
+    sc_changelog changelog;
+    char package[SC_MAX_STRING*2];
+    int retval = 0;
+
     if (program_name_is_valid(prog) != 0)
         return 5;
 
     /* do we know where to put the resulting versions list? */
-    if (file_exists(prog->versions_file))
+    if (file_exists(string_pool_get(prog->versions_file)))
         return 6;
 
     /* Check that things are installed */
     if (!software_installed("rpm2cpio") || !software_installed("cpio"))
         return 8;
 
-
-    /* Grab the rpm from url */
-    char commandstr[SC_MAX_STRING];
-    sprintf(commandstr, "wget -q -O %s/%s.rpm %s", repos_dir, prog->name, rpm_url );
-    if (run_shell_command(commandstr) != 0)
+    if (program_fetch_archive(repos_dir, rpm_url, package) != 0)
         return 7;
 
-    /* Extract RPM */
-    sprintf(commandstr, "(rpm2cpio %s/%s.rpm | (cd %s; cpio -i --quiet 2> /dev/null))", repos_dir, prog->name, repos_dir);
-    if (run_shell_command(commandstr) != 0)
-        return 7;
+    changelog_init(&changelog);
+    if (changelog_read_rpm_package(&changelog, package) != 0)
+        retval = 8;
+    else if (program_versions_from_changelog(&changelog, repos_dir, prog) != 0)
+        retval = 9;
+    changelog_free(&changelog);
 
-    /* Grab the changelog from the spec file */
-    //sprintf(commandstr, "find %s -name *.spec",repos_dir);
-    //system(commandstr);
-
-    char mkdirstr[SC_MAX_STRING];
-    sprintf(mkdirstr, "%s/%s", repos_dir, prog->name);
-    mkdir(mkdirstr, 0700);
-
-    sprintf(prog->versions_file, "%s/%s/versions.txt", repos_dir, prog->name);
-    sprintf(commandstr, "awk '/^\\*(.*)$/ {print $(NF)}' %s/%s.spec > %s",repos_dir, prog->name,prog->versions_file);
-    if (run_shell_command(commandstr) != 0)
-        return 7;
+    return retval;
+}
 
-    if (!file_exists(prog->versions_file))
-        return 8;
-    prog->no_of_versions = lines_in_file(prog->versions_file);
+/**
+ * @brief Returns whether a url ends with the given suffix
+ * @param url The url
+ * @param suffix The suffix, such as a file extension
+ * @returns Non-zero if the url ends with the suffix
+ */
+static int program_url_has_suffix(char * url, char * suffix)
+{
+    int length = strlen(url), suffix_length = strlen(suffix);
 
-    return 0;
+    return ((length >= suffix_length) &&
+            (strcmp(&url[length - suffix_length], suffix) == 0));
 }
 
 /**
@@ -294,9 +518,11 @@ int program_get_versions_from_rpm_package(char * repos_dir, char * rpm_url, sc_p
  * @param repos_dir Directory where the git repo will be checked out
  * @param repo_url URL of the git repo or tarball
  * @param prog Program object
+ * @param options How git repos are cloned, or NULL for a full clone
  * @returns zero on success
  */
-int program_get_versions_from_repo(char * repos_dir, char * repo_url, sc_program * prog)
+int program_get_versions_from_repo(char * repos_dir, char * repo_url,
+                                   sc_program * prog, sc_clone_options * options)
 {
     /* check for empty strings */
     if (strlen(repos_dir) == 0)
@@ -310,41 +536,234 @@ int program_get_versions_from_repo(char * repos_dir, char * repo_url, sc_program
         if (repos_dir[strlen(repos_dir)-1]=='/')
             repos_dir[strlen(repos_dir)-1] = 0;
 
+    /* handle packages and tarballs, whose urls may also contain "git" */
+    if (program_url_has_suffix(repo_url, ".deb"))
+        return program_get_versions_from_deb_package(repos_dir, repo_url, prog);
+
+    if (program_url_has_suffix(repo_url, ".rpm"))
+        return program_get_versions_from_rpm_package(repos_dir, repo_url, prog);
+
+    if ((strstr(repo_url, ".tar.") != NULL) ||
+        program_url_has_suffix(repo_url, ".tgz") ||
+        program_url_has_suffix(repo_url, ".tar"))
+        return program_get_versions_from_tarball(repos_dir, repo_url, prog);
+
     /* handle git repos */
     if (strstr(repo_url, "git") != NULL) {
-        return program_get_versions_from_git(repos_dir, repo_url, prog);
+        return program_get_versions_from_git(repos_dir, repo_url, prog, options);
     }
+    return 4;
+}
 
-    /* handle tarballs */
-    if (strstr(repo_url, "tar.gz") != NULL) {
-        return program_get_versions_from_tarball(repos_dir, repo_url, prog);
+/**
+ * @brief Reads the metadata recorded when the versions file of a repo
+ *        was last updated
+ * @param metadata_file The metadata file
+ * @param head Returned head commit at the time of the last update
+ * @param no_of_versions Returned number of versions in the versions file
+ * @returns zero on success
+ */
+static int program_repo_read_metadata(char * metadata_file, char * head,
+                                      int * no_of_versions)
+{
+    FILE * fp;
+    char linestr[SC_MAX_STRING];
+    int found = 0;
+
+    head[0] = 0;
+    *no_of_versions = 0;
+
+    fp = fopen(metadata_file, "r");
+    if (fp == NULL)
+        return 1;
+
+    while (fgets(linestr, SC_MAX_STRING-1, fp) != NULL) {
+        if (sscanf(linestr, "head %255s", head) == 1)
+            found |= 1;
+        else if (sscanf(linestr, "versions %d", no_of_versions) == 1)
+            found |= 2;
     }
-    return 4;
+    fclose(fp);
+
+    if ((found != 3) || (*no_of_versions <= 0))
+        return 2;
+
+    return 0;
 }
 
 /**
- * @brief Gets a list of commits from a repo directory
+ * @brief Records the head commit and number of versions of a repo, so
+ *        that the next update only needs to look at newer commits
+ * @param metadata_file The metadata file
+ * @param head The head commit
+ * @param no_of_versions The number of versions in the versions file
+ * @returns zero on success
+ */
+static int program_repo_write_metadata(char * metadata_file, char * head,
+                                       int no_of_versions)
+{
+    FILE * fp;
+
+    fp = fopen(metadata_file, "w");
+    if (fp == NULL)
+        return 1;
+
+    fprintf(fp, "head %s\n", head);
+    fprintf(fp, "versions %d\n", no_of_versions);
+    fclose(fp);
+    return 0;
+}
+
+/**
+ * @brief Adds the contents of the current versions file to the end of
+ *        a file of newer versions, which then replaces it
+ * @param new_versions_file File containing the newer versions
+ * @param versions_file The current versions file
+ * @returns zero on success
+ */
+static int program_repo_prepend_versions(char * new_versions_file,
+                                         char * versions_file)
+{
+    FILE * fp_new, * fp;
+    char buffer[SC_PROCESS_READ_SIZE];
+    size_t length;
+    int retval = 0;
+
+    fp = fopen(versions_file, "r");
+    if (fp == NULL)
+        return 1;
+
+    fp_new = fopen(new_versions_file, "a");
+    if (fp_new == NULL) {
+        fclose(fp);
+        return 2;
+    }
+
+    while ((length = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
+        if (fwrite(buffer, 1, length, fp_new) != length) {
+            retval = 3;
+            break;
+        }
+    }
+    fclose(fp);
+    if (fclose(fp_new) != 0)
+        retval = 3;
+
+    if (retval != 0)
+        return retval;
+
+    if (rename(new_versions_file, versions_file) != 0)
+        return 4;
+
+    return 0;
+}
+
+/**
+ * @brief Gets a list of commits from a repo directory.
+ *        The list is kept up to date incrementally. If the repo has gained
+ *        commits since the last update then only the new commits are added
+ *        to the start of the versions file, so the version indexes of
+ *        existing commits don't change. The whole list is only recreated
+ *        if there is no metadata or the history was rewritten.
  * @param repo_dir Directory where the git repo exists
  * @param prog Program object
  * @returns zero on success
  */
 int program_repo_get_commits(char * repo_dir, sc_program * prog)
 {
-    char commandstr[SC_MAX_STRING];
+    return program_repo_update_commits(repo_dir, prog, NULL);
+}
+
+/**
+ * @brief Updates the list of commits for a repo directory, adding only
+ *        commits which are newer than the head recorded last time
+ * @param repo_dir Directory where the git repo exists
+ * @param prog Program object
+ * @param new_versions Returned number of versions which were added,
+ *                     or -1 if the whole list was recreated. May be NULL
+ * @returns zero on success
+ */
+int program_repo_update_commits(char * repo_dir, sc_program * prog,
+                                int * new_versions)
+{
+    char metadata_file[SC_MAX_STRING];
+    char new_versions_file[SC_MAX_STRING];
+    char head[SC_MAX_STRING];
+    char previous_head[SC_MAX_STRING];
+    char range[SC_MAX_STRING*2+2];
+    char * head_argv[] = {
+        "git", "-C", repo_dir, "rev-parse", "--verify", "-q", "master", NULL
+    };
+    char * ancestor_argv[] = {
+        "git", "-C", repo_dir, "merge-base", "--is-ancestor",
+        previous_head, head, NULL
+    };
+    char * new_log_argv[] = {
+        "git", "-C", repo_dir, "log", "--pretty=tformat:%H",
+        "--first-parent", range, NULL
+    };
+    char * log_argv[] = {
+        "git", "-C", repo_dir, "log", "--pretty=tformat:%H",
+        "--first-parent", head, NULL
+    };
+    int previous_versions, added;
 
     prog->no_of_versions = 0;
-    sprintf(prog->versions_file, "%s/versions.txt", repo_dir);
+    if (new_versions != NULL)
+        *new_versions = -1;
 
-    sprintf(commandstr, "git -C %s log --pretty=tformat:\"%H\" --all --first-parent master > %s",
-            repo_dir, prog->versions_file);
+    prog->versions_file = string_pool_printf("%s/versions.txt", repo_dir);
+    sprintf(metadata_file, "%s/%s", repo_dir, SC_VERSIONS_METADATA_FILENAME);
+    sprintf(new_versions_file, "%s/versions.new", repo_dir);
 
-    if (run_shell_command(commandstr) != 0)
+    if ((process_run_with_output(head_argv, 0, head, SC_MAX_STRING) != 0) ||
+        (head[0] == 0))
         return 1;
 
-    if (!file_exists(prog->versions_file))
+    if ((program_repo_read_metadata(metadata_file, previous_head,
+                                    &previous_versions) == 0) &&
+        file_exists(string_pool_get(prog->versions_file))) {
+        /* nothing has changed */
+        if (strcmp(head, previous_head) == 0) {
+            prog->no_of_versions = previous_versions;
+            if (new_versions != NULL)
+                *new_versions = 0;
+            return 0;
+        }
+
+        /* new commits on top of the previous head */
+        sprintf(range, "%s..%s", previous_head, head);
+        if ((process_run(ancestor_argv, 0, 1) == 0) &&
+            (process_run_to_file(new_log_argv, 0, new_versions_file) == 0)) {
+            added = lines_in_file(new_versions_file);
+
+            if (program_repo_prepend_versions(new_versions_file,
+                                              string_pool_get(prog->versions_file)) == 0) {
+                prog->no_of_versions = previous_versions + added;
+                if (new_versions != NULL)
+                    *new_versions = added;
+                return program_repo_write_metadata(metadata_file, head,
+                                                   prog->no_of_versions);
+            }
+        }
+        unlink(new_versions_file);
+    }
+
+    /* Recreate the whole list. Only the first parent history of master
+       is used, since commits from other refs would be interleaved by
+       date and shift the indexes of existing versions */
+    if (process_run_to_file(log_argv, 0,
+                            string_pool_get(prog->versions_file)) != 0)
         return 2;
 
-    prog->no_of_versions = lines_in_file(prog->versions_file);
+    if (!file_exists(string_pool_get(prog->versions_file)))
+        return 3;
+
+    prog->no_of_versions = lines_in_file(string_pool_get(prog->versions_file));
+
+    if (program_repo_write_metadata(metadata_file, head,
+                                    prog->no_of_versions) != 0)
+        return 4;
 
     return 0;
 }
@@ -357,28 +776,54 @@ int program_repo_get_commits(char * repo_dir, sc_program * prog)
  */
 int program_get_versions_from_aptitude(char * repos_dir, sc_program * prog)
 {
-    char commandstr[SC_MAX_STRING];
+    sc_process_result result;
+    char * argv[] = { "aptitude", "changelog", string_pool_get(prog->name), NULL };
+    char * line, * start, * end;
+    FILE * fp;
 
     if (program_name_is_valid(prog) != 0)
         return 5;
 
-    if (file_exists(prog->versions_file))
+    if (file_exists(string_pool_get(prog->versions_file)))
         return 6;
 
-    if (system("aptitude -h > /dev/null") == 127)
+    if (!software_installed("aptitude"))
         return 8;
 
     char mkdirstr[SC_MAX_STRING];
-    sprintf(mkdirstr, "%s/%s", repos_dir, prog->name);
+    sprintf(mkdirstr, "%s/%s", repos_dir, string_pool_get(prog->name));
     mkdir(mkdirstr, 0700);
-    sprintf(commandstr, "aptitude changelog %s | grep \"urgency\" | \
-            awk -F '(' '{print $2}' | awk -F ')' '{print $1}' > %s/%s/versions.txt",
-            prog->name, repos_dir, prog->name);
 
-    if (run_shell_command(commandstr) != 0)
+    if (process_run_with_options(argv, NULL, &result) < 0) {
+        process_result_free(&result);
         return 7;
+    }
 
-    sprintf(prog->versions_file, "%s/%s/versions.txt", repos_dir, prog->name);
+    prog->versions_file = string_pool_printf("%s/%s/versions.txt", repos_dir, string_pool_get(prog->name));
+    fp = fopen(string_pool_get(prog->versions_file), "w");
+    if (fp == NULL) {
+        process_result_free(&result);
+        return 7;
+    }
+
+    /* entries begin with a line such as:
+       package (version) distribution; urgency=medium */
+    line = result.output;
+    while ((line != NULL) && (*line != 0)) {
+        end = strchr(line, '\n');
+        if (end != NULL)
+            *end = 0;
+        if (strstr(line, "urgency") != NULL) {
+            start = strchr(line, '(');
+            if (start != NULL) {
+                start++;
+                fprintf(fp, "%.*s\n", (int)strcspn(start, ")"), start);
+            }
+        }
+        line = (end != NULL) ? end + 1 : NULL;
+    }
+    fclose(fp);
+    process_result_free(&result);
 
 
     return 0;
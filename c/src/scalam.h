@@ -26,8 +26,18 @@
 #include <unistd.h>
 #include <time.h>
 #include <math.h>
+#include <stdint.h>
+#include <stdarg.h>
 #include <dirent.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <spawn.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <errno.h>
+#include <limits.h>
 
 #define APPNAME "scalam"
 #define VERSION "0.1"
@@ -38,6 +48,10 @@
 /* maximum length of strings used for program names */
 #define SC_MAX_STRING                  256
 
+/* Written alongside the versions file of a repo, recording the head
+   commit and number of versions so that updates can be incremental */
+#define SC_VERSIONS_METADATA_FILENAME  "versions.meta"
+
 #define SC_MAX_POPULATION_SIZE         256
 
 /* The maximum number of state changes to get from the
@@ -50,23 +64,198 @@
 #define SC_DEFAULT_CROSSOVER           0.5
 #define SC_DEFAULT_REBELS              0.05
 
+/* How the next generation replaces the current one.
+   Generational replaces every genome other than any elites,
+   whereas steady state only replaces the worst few genomes */
+#define SC_REPLACEMENT_GENERATIONAL       0
+#define SC_REPLACEMENT_STEADY_STATE       1
+
+/* By default no genomes are carried over unchanged */
+#define SC_DEFAULT_ELITES                 0
+
+/* Number of genomes replaced per generation in steady state mode */
+#define SC_DEFAULT_STEADY_STATE_REPLACEMENTS 2
+
+/* Responses to a loss of diversity or stagnation of the search */
+#define SC_DIVERSITY_RESPONSE_NONE        0
+/* Raise the mutation rate for one generation */
+#define SC_DIVERSITY_RESPONSE_HYPERMUTATE 1
+/* Replace a proportion of the children, given by rebels,
+   with new random genomes */
+#define SC_DIVERSITY_RESPONSE_REBELS      2
+/* Replace all but the first few children with random genomes */
+#define SC_DIVERSITY_RESPONSE_RESTART     3
+
+#define SC_DEFAULT_DIVERSITY_RESPONSE     SC_DIVERSITY_RESPONSE_REBELS
+
+/* Normalised mean Hamming distance below which diversity is lost */
+#define SC_DEFAULT_DIVERSITY_THRESHOLD    0.05
+
+/* Proportion of unique genomes below which diversity is lost.
+   A few duplicates, or a hash collision, are not a loss */
+#define SC_DEFAULT_UNIQUE_THRESHOLD       0.5
+
+/* Generations without the best score improving before responding */
+#define SC_DEFAULT_STAGNATION_LIMIT       20
+
+/* Multiplier for the mutation rate when hypermutating */
+#define SC_HYPERMUTATION_FACTOR           5
+
+/* Proportion of children replaced during a partial restart */
+#define SC_RESTART_FRACTION               0.8
+
+/* Maximum number of genome pairs and loci sampled
+   when measuring diversity */
+#define SC_DIVERSITY_SAMPLES              256
+
+/* How genomes are ranked. Either by a single score, or by Pareto
+   ranking over several objectives as in NSGA-II */
+#define SC_OBJECTIVES_SINGLE              0
+#define SC_OBJECTIVES_PARETO              1
+
+/* Objectives used for Pareto ranking */
+#define SC_OBJECTIVE_TEST_PASSES          0
+#define SC_OBJECTIVE_STEPS                1
+#define SC_OBJECTIVE_GOAL_DISTANCE        2
+#define SC_OBJECTIVE_BUILD_TIME           3
+#define SC_OBJECTIVES                     4
+
 /* when converting probabilities into integer values */
 #define SC_MUTATION_SCALAR             1000
 
 /* The maximum number of tries when creating new unique genomes */
 #define SC_MAX_TRIES_FOR_UNIQUE_GENOME 1000
 
-/* Defines a program and its possible versions */
+/* Genomes within the population arena begin on cache line boundaries */
+#define SC_ARENA_ALIGNMENT             64
+
+/* Arenas at least this large are aligned so that the kernel
+   can back them with transparent huge pages */
+#define SC_HUGE_PAGE_SIZE              (2*1024*1024)
+
+/* Exit status returned when a process could not be started, ran for
+   longer than its timeout or was ended by a signal */
+#define SC_PROCESS_NOT_RUN             -1
+#define SC_PROCESS_TIMED_OUT           -2
+#define SC_PROCESS_SIGNALLED           -3
+
+/* Number of bytes read from a process at a time */
+#define SC_PROCESS_READ_SIZE           4096
+
+/* Milliseconds between checks on whether a process has finished */
+#define SC_PROCESS_POLL_INTERVAL       5
+
+/* Timeout in milliseconds for commands which use the network */
+#define SC_PROCESS_NETWORK_TIMEOUT     (60*60*1000)
+
+/* Options for running a process */
+typedef struct {
+    /* Directory to run within, or NULL for the current directory */
+    char * directory;
+
+    /* File used as standard input, or NULL for none */
+    char * input_filename;
+
+    /* File to which standard output is written, or NULL
+       for it to be captured within the result */
+    char * output_filename;
+
+    /* Maximum run time in milliseconds, or zero for no limit */
+    int timeout;
+
+    /* Discard standard error */
+    int quiet;
+} sc_process_options;
+
+/* The result of running a process */
+typedef struct {
+    /* Exit status, or one of the SC_PROCESS_ values if negative */
+    int exit_status;
+    int timed_out;
+
+    /* Captured standard output, which is terminated */
+    char * output;
+    int output_length;
+    int output_size;
+} sc_process_result;
+
+/* Formats of changelog from which versions can be read */
+#define SC_CHANGELOG_UNKNOWN           0
+#define SC_CHANGELOG_DEBIAN            1
+#define SC_CHANGELOG_RPM               2
+#define SC_CHANGELOG_NEWS              3
+
+/* The maximum number of words before the version within a heading
+   of a NEWS or ChangeLog file */
+#define SC_CHANGELOG_MAX_HEADING_WORDS 6
+
+/* Strings are stored within blocks of this many bits of position */
+#define SC_STRING_POOL_BLOCK_BITS      20
+#define SC_STRING_POOL_BLOCK_SIZE      (1<<SC_STRING_POOL_BLOCK_BITS)
+
+/* The maximum number of string pool blocks, which with the block bits
+   must fit within an sc_string */
+#define SC_STRING_POOL_MAX_BLOCKS      4096
+
+/* Initial number of slots in the index of pooled strings.
+   A power of two */
+#define SC_STRING_POOL_INITIAL_SLOTS   1024
+
+/* A string interned within the string pool. Zero is the empty string,
+   and equal strings are always the same sc_string */
+typedef unsigned int sc_string;
+
+/* Versions read from a changelog, newest first */
 typedef struct {
-    char name[SC_MAX_STRING];
+    int format;
+    int no_of_versions;
+    int max_versions;
+    sc_string * version;
+} sc_changelog;
+
+/* How much of a git repo is fetched when it is cloned. Blobless clones
+   fetch the contents of files only when a commit is checked out, and
+   treeless clones also fetch directories only when needed */
+#define SC_CLONE_FULL                  0
+#define SC_CLONE_BLOBLESS              1
+#define SC_CLONE_TREELESS              2
 
-    char repo_url[SC_MAX_STRING];
+/* Options for cloning a git repo */
+typedef struct {
+    /* One of the SC_CLONE_ filters */
+    int filter;
+
+    /* An existing repo whose objects are borrowed rather than fetched
+       again, or empty for none */
+    char reference[SC_MAX_STRING];
+
+    /* Revision of the start version, such as a tag. If given then only
+       history from the start version onwards is fetched */
+    char start_revision[SC_MAX_STRING];
+
+    /* Number of commits of history fetched, or zero for all of it.
+       With a start revision this is the number of commits before
+       the start version, otherwise it counts back from the head */
+    int depth;
+
+    /* Leave the working tree empty. Commits are then only checked out
+       within workspaces, when a build of them is scheduled */
+    int no_checkout;
+} sc_clone_options;
+
+/* Defines a program and its possible versions.
+   Strings are held within the string pool, so that programs and
+   the systems containing them are small and can be copied cheaply */
+typedef struct {
+    sc_string name;
+
+    sc_string repo_url;
 
     /* File containing list of versions
        For example, coule be the result of:
        git log --pretty=tformat:"%H" --all --first-parent master > versions.txt
        or could be created from a debian changelog */
-    char versions_file[SC_MAX_STRING];
+    sc_string versions_file;
 
     /* The number of possible versions.
        For exported git commit this would just be the line count */
@@ -80,6 +269,32 @@ typedef struct {
     unsigned char installed;
 } sc_program;
 
+/* How the versions between the start and reference of a program are
+   thinned into the candidates which the search chooses from. The start
+   and reference versions are always candidates */
+#define SC_CANDIDATES_ALL              0
+#define SC_CANDIDATES_TAGS             1
+#define SC_CANDIDATES_MERGES           2
+#define SC_CANDIDATES_EVERY_NTH        3
+
+/* Written alongside the versions file of a program, listing the
+   candidate versions newest first in the same way */
+#define SC_CANDIDATES_FILENAME         "candidates.txt"
+
+/* Options for restricting programs to their candidate versions */
+typedef struct {
+    /* One of the SC_CANDIDATES_ thinnings */
+    int thinning;
+
+    /* For SC_CANDIDATES_EVERY_NTH, the number of versions between
+       each candidate, counting from the start version */
+    int every;
+} sc_candidate_options;
+
+/* Number of slots in the index of program names. A power of two,
+   and at least twice the maximum number of programs */
+#define SC_NAME_INDEX_SIZE             8192
+
 /* A collection of programs defines the state of a system */
 typedef struct {
     int no_of_programs;
@@ -87,11 +302,41 @@ typedef struct {
     /* details for each program */
     sc_program program[SC_MAX_SYSTEM_SIZE];
 
+    /* Index used to find programs by name, using open addressing.
+       Slots hold program array indexes plus one, or zero if empty.
+       The index only covers the first indexed_programs programs.
+       See system_index_names */
+    unsigned int name_hash[SC_MAX_SYSTEM_SIZE];
+    int name_slot[SC_NAME_INDEX_SIZE];
+    int indexed_programs;
+
+    /* Layout of a packed system state, as stored within genomes.
+       A packed state begins with a bitset of installed flags held
+       in 64 bit words, followed by the version index of each program
+       using the fewest bytes (1, 2 or 4) able to hold no_of_versions.
+       Wider indexes come first so that every field is aligned.
+       See state_layout_create */
+    int state_bytes;
+    int installed_words;
+    unsigned char version_width[SC_MAX_SYSTEM_SIZE];
+    int version_offset[SC_MAX_SYSTEM_SIZE];
+
+    /* Programs in the order in which their version indexes are laid
+       out. There is one group for each width, widest first, so that
+       a byte offset within a state can be traced back to its program.
+       See state_program_at */
+    int version_order[SC_MAX_SYSTEM_SIZE];
+    int version_group_offset[3];
+    int version_group_first[3];
+    int version_group_size[3];
+
     /* log probabilities for dependencies between programs */
     double **dependency_probability;
 } sc_system;
 
 /* A minimal description of a change to a system.
+   This is the unpacked form, used for goals. Within genomes
+   each change is held in the packed form described by sc_system.
    Some version indexes could be the same as the previous
    step in the upgrade sequence
    Indexes could also go either forwards or backwards. */
@@ -107,14 +352,13 @@ typedef struct {
 } sc_system_state;
 
 /* A genome defines a sequence of changes to get to the reference state.
-   After evaluation a score is assigned to it */
+   After evaluation a score is assigned to it.
+   Genomes are variable in size, depending upon the system, so should
+   be allocated with genome_size bytes */
 typedef struct {
     /* the number of steps in the sequence */
     int steps;
 
-    /* The list of program versions at each step */
-    sc_system_state change[SC_MAX_CHANGE_SEQUENCE];
-
     /* score for this sequence after evaluation */
     float score;
 
@@ -123,6 +367,33 @@ typedef struct {
 
     /* seed for PRNG */
     unsigned int random_seed;
+
+    /* Non-zero once a score has been assigned. Genomes carried over
+       from the previous generation keep their score and don't need
+       to be evaluated again */
+    int evaluated;
+
+    /* The number of steps of the sequence which were built and tested
+       successfully, which is less than steps if evaluation ended early */
+    int steps_completed;
+
+    /* The number of tests which passed during evaluation */
+    int test_passes;
+
+    /* Distance from the goal at the end of the sequence */
+    int goal_distance;
+
+    /* Time in seconds taken to evaluate */
+    float build_time;
+
+    /* Pareto front index, with zero being the non-dominated front,
+       and crowding distance within the front */
+    int rank;
+    float crowding;
+
+    /* The packed system state at each step, SC_MAX_CHANGE_SEQUENCE
+       states of sys.state_bytes each. Use genome_state to get a step */
+    uint64_t change[];
 } sc_genome;
 
 /* Defines the goal of the upgrade */
@@ -132,8 +403,107 @@ typedef struct {
 
     /* What programs and versions do we want to end up with */
     sc_system_state reference;
+
+    /* Distance of each program from the reference at the start,
+       and their total. See goal_program_distance */
+    int distance[SC_MAX_SYSTEM_SIZE];
+    int start_distance;
+
+    /* The number of tests which pass for each program once it is at
+       the reference version, or -1 until it has been built there */
+    int test_passes[SC_MAX_SYSTEM_SIZE];
 } sc_goal;
 
+/* Column-wise copy of the genomes within a population, so that
+   population-wide statistics are sequential scans over contiguous
+   arrays rather than chasing a pointer per genome */
+typedef struct {
+    /* Number of genomes and programs which the columns hold */
+    int size;
+    int no_of_programs;
+
+    /* Score and number of upgrade steps for each genome */
+    float * score;
+    int * steps;
+
+    /* Version index and installed state for every (step, program)
+       pair, with all genomes adjacent to each other, indexed as
+       ((step * no_of_programs) + program) * size + genome */
+    int * version_index;
+    unsigned char * installed;
+} sc_population_columns;
+
+/* Size of the hashed feature space of the surrogate model */
+#define SC_SURROGATE_FEATURES          4096
+
+/* Version indexes are grouped into this many buckets for features */
+#define SC_SURROGATE_BUCKETS           8
+
+/* Candidate children generated for each one sent for evaluation */
+#define SC_DEFAULT_SURROGATE_OVERSAMPLE 4
+
+/* Evaluations needed before the surrogate is used to screen children */
+#define SC_DEFAULT_SURROGATE_MIN_SAMPLES 32
+
+#define SC_DEFAULT_SURROGATE_LEARNING_RATE 0.5f
+
+/* A cheap predictor of genome scores, trained online from real
+   evaluations. It is a logistic model over hashed features, one for
+   each installed (program, version bucket) and one for each installed
+   (program, version bucket, dependency, dependency version bucket).
+   It predicts the score relative to the best score seen so far */
+typedef struct {
+    float weight[SC_SURROGATE_FEATURES];
+    float bias;
+    float learning_rate;
+
+    /* Candidate children generated for each one sent for evaluation */
+    int oversample;
+
+    /* Training samples needed before children are screened */
+    int min_samples;
+
+    /* The best score seen, used to normalise scores */
+    float max_score;
+
+    /* Number of real evaluations trained upon */
+    int samples;
+
+    /* Predictions made before training on each evaluation, and the
+       number which were on the right side of half the best score */
+    int predictions;
+    int correct;
+    float absolute_error;
+
+    /* Extra candidate children generated by oversampling and screened
+       out by their predicted score */
+    int children_screened;
+
+    /* Dependencies of each program as compressed rows, so that the
+       dependencies of program p are dependency[dependency_start[p]]
+       up to dependency[dependency_start[p+1]] */
+    int * dependency_start;
+    int * dependency;
+
+    /* Holds the best candidate while screening children */
+    sc_genome * candidate;
+} sc_surrogate;
+
+/* Measures of the genetic diversity of a generation */
+typedef struct {
+    /* Mean Hamming distance between pairs of genomes in genes,
+       and the same normalised into the range 0.0 -> 1.0 */
+    float hamming;
+    float hamming_normalised;
+
+    /* Mean Shannon entropy of version indexes at each locus
+       (upgrade step and program) in bits */
+    float entropy;
+
+    /* Proportion of genomes which are unique, 0.0 -> 1.0 */
+    float unique_ratio;
+} sc_diversity;
+
 /* Population of genomes */
 typedef struct {
     /* Number of individuals in the population */
@@ -142,6 +512,23 @@ typedef struct {
     sc_genome ** individual;
     sc_genome ** next_generation;
 
+    /* Single contiguous block containing the genomes of both the
+       current and next generations. individual and next_generation
+       only ever point into this, so swapping generations is just
+       a pointer flip and freeing the population is a single free */
+    unsigned char * arena;
+
+    /* Number of bytes between consecutive genomes within the arena */
+    size_t genome_stride;
+
+    /* Optional structure-of-arrays view of the current generation.
+       NULL unless enabled with population_columns_enable */
+    sc_population_columns * columns;
+
+    /* Optional surrogate fitness model used to screen children.
+       NULL unless enabled with population_surrogate_enable */
+    sc_surrogate * surrogate;
+
     /* in the range 0.0 -> 1.0 */
     float mutation_rate;
 
@@ -151,6 +538,45 @@ typedef struct {
     /* Percentage of rebel genomes in the range 0.0 -> 1.0 */
     float rebels;
 
+    /* Replacement strategy, SC_REPLACEMENT_GENERATIONAL or
+       SC_REPLACEMENT_STEADY_STATE */
+    int replacement;
+
+    /* In generational mode, the number of top scoring genomes which
+       are carried over unchanged into the next generation */
+    int elites;
+
+    /* In steady state mode, the number of the worst genomes
+       replaced by new children each generation */
+    int steady_state_replacements;
+
+    /* Total number of genome evaluations */
+    int evaluations;
+
+    /* How genomes are ranked, SC_OBJECTIVES_SINGLE or
+       SC_OBJECTIVES_PARETO */
+    int objectives;
+
+    /* Diversity of the most recently evaluated generation */
+    sc_diversity diversity;
+
+    /* How to respond when diversity is lost or the search
+       stagnates. One of SC_DIVERSITY_RESPONSE_ */
+    int diversity_response;
+
+    /* normalised Hamming distance below which diversity is lost */
+    float diversity_threshold;
+
+    /* proportion of unique genomes below which diversity is lost */
+    float unique_threshold;
+
+    /* Generations without improvement before responding */
+    int stagnation_limit;
+
+    /* Generations since the best score last improved */
+    int stagnant_generations;
+    float best_score_so_far;
+
     /* Definition of the system */
     sc_system sys;
 
@@ -161,10 +587,402 @@ typedef struct {
     unsigned int random_seed;
 } sc_population;
 
+/* Evaluates a single genome without changing the population, returning
+   the test passes, the steps completed and the time taken. Returns
+   zero on success */
+typedef int (*sc_genome_evaluate)(void * context, sc_population * population,
+                                  int index, int * test_passes,
+                                  int * steps_completed, float * build_time);
+
+
+/* The maximum number of concurrent build workspaces */
+#define SC_MAX_WORKSPACES   64
+
+/* A build workspace gives a single evaluation its own view of the
+   repos, as git worktrees, together with its own install prefix.
+   Workspaces are pooled and reused between genomes, so that only
+   the programs whose versions differ need to be checked out again */
+typedef struct {
+    /* Root directory of the workspace */
+    char directory[SC_MAX_STRING];
+
+    /* Prefix into which programs are installed */
+    char install_prefix[SC_MAX_STRING];
+
+    /* Version index currently checked out for each program,
+       or -1 if there is no worktree for the program yet */
+    int version_index[SC_MAX_SYSTEM_SIZE];
+
+    /* Non-zero while an evaluation is using the workspace */
+    int in_use;
+} sc_workspace;
+
+/* A pool of build workspaces */
+typedef struct {
+    /* Directory containing the original repos */
+    char repos_dir[SC_MAX_STRING];
+
+    /* Directory within which workspaces are created */
+    char workspaces_dir[SC_MAX_STRING];
+
+    int no_of_workspaces;
+    sc_workspace * workspace;
+} sc_workspace_pool;
+
+/* Defaults for synthetic systems */
+#define SC_SYNTHETIC_MIN_VERSIONS       10
+#define SC_SYNTHETIC_MAX_VERSIONS       100
+#define SC_SYNTHETIC_MAX_DEPENDENCIES   3
+#define SC_SYNTHETIC_BROKEN_PER_MILLE   20
+
+/* A hidden ground truth model of which upgrades build, for use with
+   synthetic systems. Programs depend upon others, and each dependency
+   must stay within a window of versions relative to the program which
+   depends upon it, as a fraction of the version range. A program can
+   only move a limited number of versions in a single step, and a few
+   versions are broken. The latest versions are always compatible */
+typedef struct {
+    int no_of_programs;
+    int no_of_versions[SC_MAX_SYSTEM_SIZE];
+
+    /* For each program, tests which pass once it builds, the most
+       versions it can move in a single step and the cost of a build */
+    int tests[SC_MAX_SYSTEM_SIZE];
+    int max_jump[SC_MAX_SYSTEM_SIZE];
+    float build_cost[SC_MAX_SYSTEM_SIZE];
+
+    /* Dependency edges as compressed rows, so that the edges of program p
+       are from edge_start[p] up to edge_start[p+1] */
+    int edge_start[SC_MAX_SYSTEM_SIZE+1];
+    int no_of_edges;
+    int * edge_dependency;
+
+    /* How far a dependency can lag behind or lead the program which
+       depends upon it, as fractions of their version ranges */
+    float * edge_lag;
+    float * edge_lead;
+
+    /* Versions are broken with this probability in thousandths */
+    int broken_per_mille;
+
+    /* seed for the hidden model */
+    unsigned int random_seed;
+} sc_synthetic_oracle;
+
+/* Hyper-parameters which can be varied within a sweep */
+#define SC_SWEEP_POPULATION_SIZE    0
+#define SC_SWEEP_MUTATION_RATE      1
+#define SC_SWEEP_CROSSOVER          2
+#define SC_SWEEP_REBELS             3
+#define SC_SWEEP_PARAMETERS         4
+
+/* The most runs within a single sweep */
+#define SC_MAX_SWEEP_RUNS           100000
+
+/* Range of values for a hyper-parameter. With a single step
+   only the minimum is used */
+typedef struct {
+    float minimum;
+    float maximum;
+    int steps;
+} sc_sweep_range;
+
+/* A single simulation within a sweep, with its results */
+typedef struct {
+    /* Index of the point within parameter space. Repeats of the same
+       point with different seeds share the same index */
+    int point;
+
+    int population_size;
+    float mutation_rate;
+    float crossover;
+    float rebels;
+    unsigned int random_seed;
+
+    /* non-zero if the run failed */
+    int status;
+
+    int generations;
+    int evaluations;
+
+    /* Evaluations made before a solution was found, or -1 */
+    int evaluations_to_solution;
+
+    float best_score;
+    float average_score;
+
+    /* Time in seconds */
+    double duration;
+} sc_sweep_run;
+
+/* Independent simulations against a synthetic system, run in parallel,
+   for tuning hyper-parameters */
+typedef struct {
+    /* The synthetic system which every run searches */
+    int no_of_programs;
+    unsigned int system_seed;
+    int max_generations;
+
+    sc_sweep_range range[SC_SWEEP_PARAMETERS];
+
+    int no_of_points;
+    int no_of_runs;
+    int max_runs;
+    sc_sweep_run * run;
+} sc_sweep;
+
+/* Sources from which the versions of a program can be ingested */
+#define SC_INGEST_GIT                  0
+#define SC_INGEST_TARBALL              1
+#define SC_INGEST_DEB                  2
+#define SC_INGEST_RPM                  3
+#define SC_INGEST_APTITUDE             4
+#define SC_INGEST_SOURCES              5
+
+/* Stages through which each program is ingested. Fetching clones a
+   repo or downloads an archive, extracting reads the changelog from
+   an archive and indexing creates the versions file */
+#define SC_INGEST_FETCH                0
+#define SC_INGEST_EXTRACT              1
+#define SC_INGEST_INDEX                2
+#define SC_INGEST_STAGES               3
+
+/* Default maximum number of programs within each stage at once.
+   Fetches mostly wait upon the network, so more of them can run */
+#define SC_INGEST_DEFAULT_FETCHES      8
+#define SC_INGEST_DEFAULT_EXTRACTS     2
+#define SC_INGEST_DEFAULT_INDEXES      2
+
+/* Status of each program being ingested */
+#define SC_INGEST_WAITING              0
+#define SC_INGEST_RUNNING              1
+#define SC_INGEST_DONE                 2
+#define SC_INGEST_FAILED               3
+
+/* A program to be ingested, and what happened to it */
+typedef struct {
+    sc_string name;
+
+    /* URL or filename of the repo or archive.
+       Empty for aptitude, which only needs the name */
+    sc_string url;
+    int source;
+
+    int status;
+
+    /* When failed, the stage which failed and its error code */
+    int failed_stage;
+    int error;
+
+    /* Time taken by each stage in seconds */
+    double duration[SC_INGEST_STAGES];
+
+    /* Array index of the program within the system, or -1 */
+    int program_index;
+
+    /* Local copy of a downloaded archive */
+    sc_string archive;
+
+    /* Versions read from an archive, between extracting and indexing */
+    sc_changelog changelog;
+
+    sc_program program;
+} sc_ingest_entry;
+
+/* Called as each program is added to the system or fails, with the
+   number of programs finished so far. Calls are never concurrent */
+typedef void (*sc_ingest_callback)(void * context, sc_ingest_entry * entry,
+                                   int finished, int total);
+
+/* Ingests the versions of many programs, with each stage running
+   for several programs at once */
+typedef struct {
+    int no_of_entries;
+    int max_entries;
+    sc_ingest_entry * entry;
+
+    /* Maximum and current number of programs within each stage */
+    int max_running[SC_INGEST_STAGES];
+    int running[SC_INGEST_STAGES];
+
+    /* How git repos are cloned */
+    sc_clone_options clone;
+
+    int completed;
+    int failed;
+
+    /* Optional callback used to report progress */
+    sc_ingest_callback callback;
+    void * callback_context;
+
+    /* Total time in seconds */
+    double duration;
+} sc_ingest;
+
+/* Stages of evaluating a single program */
+#define SC_STAGE_CONFIGURE  0
+#define SC_STAGE_BUILD      1
+#define SC_STAGE_TEST       2
+#define SC_STAGES           3
+
+/* Reasons for an evaluation ending early */
+#define SC_ABORT_NONE       0
+#define SC_ABORT_FAILURE    1
+#define SC_ABORT_CALLBACK   2
+#define SC_ABORT_TIME       3
+#define SC_ABORT_STEPS      4
+#define SC_ABORT_PRUNED     5
+
+/* Result of configuring, building and testing one program
+   at one step of an upgrade sequence */
+typedef struct {
+    /* Index within the change sequence of the genome */
+    int step;
+
+    /* Array index of the program within the system */
+    int program_index;
+
+    /* Index of the version being installed */
+    int version_index;
+
+    /* Non-zero for each stage which passed */
+    int passed[SC_STAGES];
+
+    int test_passes;
+    int test_failures;
+
+    /* Time taken by each stage in seconds */
+    double duration[SC_STAGES];
+} sc_program_result;
+
+/* Evaluates one stage for one program in-process.
+   Returns zero if the stage passed */
+typedef int (*sc_evaluator_backend)(void * context, sc_system * sys,
+                                    int stage, int program_index,
+                                    int version_index, char * source_dir,
+                                    char * install_prefix,
+                                    int * test_passes, int * test_failures);
+
+/* Called as each program result becomes available.
+   Returns non-zero to abort the rest of the evaluation */
+typedef int (*sc_evaluator_callback)(void * context, int genome_index,
+                                     sc_program_result * result);
+
+/* Configures how genomes are built and tested */
+typedef struct {
+    /* Command run for each stage of each program when there is no
+       in-process backend. It is called as:
+       command stage program version source_dir install_prefix
+       where stage is configure, build or test. The test stage may
+       print the number of passes and failures */
+    char command[SC_MAX_STRING];
+
+    /* Optional in-process backend, used instead of the command */
+    sc_evaluator_backend backend;
+    void * backend_context;
+
+    /* Optional callback which receives results as they complete */
+    sc_evaluator_callback callback;
+    void * callback_context;
+
+    /* Stop evaluating a genome as soon as a stage fails */
+    int abort_on_failure;
+
+    /* Directory containing the repos, used when there are no workspaces */
+    char repos_dir[SC_MAX_STRING];
+
+    /* Install prefix used when there are no workspaces */
+    char install_prefix[SC_MAX_STRING];
+
+    /* Optional pool of workspaces to build within */
+    sc_workspace_pool * workspaces;
+
+    /* Maximum time in seconds and number of install steps for
+       evaluating a single genome, or zero for no limit */
+    double time_budget;
+    int step_budget;
+
+    /* Maximum time in seconds for one stage of one program, after
+       which the stage is stopped and fails, or zero for no limit */
+    double stage_timeout;
+
+    /* Stop evaluating a genome as soon as its upper bound score
+       can no longer beat elite_score */
+    int prune;
+
+    /* The best score evaluated so far */
+    float elite_score;
+
+    /* The most test passes seen for each program, or -1 if the
+       program hasn't been tested yet. Used for upper bound scores */
+    int max_test_passes[SC_MAX_SYSTEM_SIZE];
+} sc_evaluator;
+
+/* The install steps of one genome and their results */
+typedef struct {
+    /* The ordered install steps. Only the first no_of_results
+       have results */
+    sc_program_result * result;
+    int max_install_steps;
+    int no_of_install_steps;
+    int no_of_results;
+
+    /* Packed reference state, installed by a genome with no steps
+       which goes straight to the goal */
+    unsigned char * reference_state;
+
+    /* Programs for which every stage passed */
+    int programs_passed;
+
+    int test_passes;
+
+    /* Steps of the upgrade sequence completed successfully */
+    int steps_completed;
+
+    /* Non-zero if the evaluation ended early, with the reason */
+    int aborted;
+    int abort_reason;
+
+    /* Optimistic score at the point where evaluation ended */
+    float upper_bound;
+
+    /* Total time in seconds */
+    double duration;
+} sc_evaluation;
+
+/* Filename of the manifest describing a run, unless another is given */
+#define SC_DEFAULT_MANIFEST_FILENAME "manifest.txt"
+
+/* Options which apply to every mode. A run can be repeated exactly
+   from its seed, whatever the number of threads */
+typedef struct {
+    unsigned int random_seed;
+    int max_threads;
+    char manifest_filename[SC_MAX_STRING];
+
+    /* How git repos are cloned when ingesting */
+    sc_clone_options clone;
+
+    /* Whether each program is restricted to candidate versions
+       between its start and reference, and how */
+    int restrict_versions;
+    sc_candidate_options candidates;
+
+    /* Seed of the synthetic system searched by every run of a sweep.
+       Unless one is given the random seed is used */
+    unsigned int system_seed;
+    int system_seed_given;
+
+    /* Ranges of the hyper-parameters covered by a sweep */
+    sc_sweep_range sweep_range[SC_SWEEP_PARAMETERS];
+} sc_run_options;
 
 /* The largest number of rows in our dataframe */
 #define SC_MAX_DF_SIZE      10000
 
+/* Filename used when saving a dataframe, unless another is given */
+#define SC_DEFAULT_DATAFRAME_FILENAME "dataframe.csv"
+
 /* Partial set of rows in a dataframe, generated per step */
 typedef struct {
     int cycle_no;
@@ -178,6 +996,10 @@ typedef struct {
     int slice_no;
     sc_dataframe_slice **slice;
 
+    /* Storage for all slices, allocated once when the dataframe
+       is created. Pages are only touched as slices are added */
+    sc_dataframe_slice *slice_pool;
+
     /* List of params used for the simulation */
 
     /* Range  0.0 - 1.0 */
@@ -196,9 +1018,64 @@ typedef struct {
 
 void show_help();
 void run_tests();
-void run_simulation();
+void run_simulation(char * repos_dir, int generation_max, char * build_command,
+                    sc_run_options * options);
+void run_synthetic(int no_of_programs, int generation_max,
+                   sc_run_options * options);
+void run_sweep(char * mode, int no_of_programs, int generation_max,
+               int count, char * filename, sc_run_options * options);
+void run_ingest(char * sources_filename, char * repos_dir,
+                char * filename, sc_run_options * options);
+
+uint64_t manifest_fingerprint(sc_system * sys);
+int manifest_save(char * filename, char * mode, sc_run_options * options,
+                  int max_generations, sc_population * population);
+
+sc_string string_pool_add(const char * str);
+sc_string string_pool_add_length(const char * str, int length);
+sc_string string_pool_printf(const char * format, ...);
+char * string_pool_get(sc_string s);
+unsigned long string_pool_size();
+
+void changelog_init(sc_changelog * changelog);
+void changelog_free(sc_changelog * changelog);
+int changelog_format_from_filename(char * filename);
+int changelog_format_from_text(const char * text, int length);
+int changelog_parse(sc_changelog * changelog, const char * text, int length,
+                    int format);
+int changelog_read(sc_changelog * changelog, char * filename);
+int changelog_read_tarball(sc_changelog * changelog, char * archive);
+int changelog_read_deb_package(sc_changelog * changelog, char * package);
+int changelog_read_rpm_package(sc_changelog * changelog, char * package);
+int changelog_save(sc_changelog * changelog, char * versions_file);
+
+void candidates_options_init(sc_candidate_options * options);
+int candidates_program(sc_program * prog, int start_index,
+                       int reference_index, sc_candidate_options * options);
+int candidates_system(sc_system * sys, sc_candidate_options * options);
+
+void ingest_create(sc_ingest * ingest);
+void ingest_free(sc_ingest * ingest);
+int ingest_source_from_name(char * name);
+int ingest_source_from_url(char * url);
+int ingest_add(sc_ingest * ingest, char * name, int source, char * url);
+int ingest_load_sources(sc_ingest * ingest, char * filename);
+int ingest_set_max_running(sc_ingest * ingest, int stage, int max_running);
+int ingest_run(sc_ingest * ingest, char * repos_dir, sc_system * sys);
+int ingest_save(sc_ingest * ingest, char * filename);
+
+void process_set_max_running(int max_running);
+void process_options_init(sc_process_options * options);
+void process_result_free(sc_process_result * result);
+int process_run_with_options(char * const * argv, sc_process_options * options,
+                             sc_process_result * result);
+int process_run(char * const * argv, int timeout, int quiet);
+int process_run_with_output(char * const * argv, int timeout,
+                            char * output, int max_length);
+int process_run_to_file(char * const * argv, int timeout, char * filename);
 
 int run_shell_command(char * commandstr);
+int run_shell_command_exit_status(char * commandstr);
 int run_shell_command_with_output(char * commandstr, char * output);
 int file_exists(char * filename);
 int directory_exists(char * filename);
@@ -210,14 +1087,26 @@ int software_installed(char * softwarename);
 int rand_num(unsigned int * seed);
 
 /* functions to get versions of commits for a program */
-int program_get_versions_from_repo(char * repos_dir, char * repo_url, sc_program * prog);
+int program_get_versions_from_repo(char * repos_dir, char * repo_url,
+                                   sc_program * prog, sc_clone_options * options);
+int program_get_versions_from_git(char * repos_dir, char * repo_url,
+                                  sc_program * prog, sc_clone_options * options);
 int program_get_versions_from_changelog(char * changelog_filename, sc_program * prog);
 int program_get_versions_from_tarball(char * repos_dir, char * tarball_url, sc_program * prog);
 int program_get_versions_from_deb_package(char * repos_dir, char * deb_url, sc_program * prog);
 int program_get_versions_from_rpm_package(char * repos_dir, char * deb_url, sc_program * prog);
 int program_get_versions_from_aptitude(char * repos_dir, sc_program * prog);
 int program_repo_get_commits(char * repo_dir, sc_program * prog);
+int program_repo_update_commits(char * repo_dir, sc_program * prog,
+                                int * new_versions);
 int program_repo_get_current_checkout(char * repo_dir, char * commit);
+int program_repo_get_current_version(char * repo_dir, sc_program * prog);
+void program_clone_options_init(sc_clone_options * options);
+int program_repo_clone(char * repo_url, char * repo_dir,
+                       sc_clone_options * options);
+int program_fetch_archive(char * repos_dir, char * url, char * filename);
+int program_versions_from_changelog(sc_changelog * changelog,
+                                    char * repos_dir, sc_program * prog);
 int program_repo_get_head(char * repo_dir, char * commit);
 
 int genome_mutate(sc_population * population, sc_genome * individual);
@@ -228,29 +1117,148 @@ int genome_create(sc_population * population, sc_genome * individual);
 int genome_unique(sc_population * population,
                   sc_genome * genome, int genome_index,
                   int next_generation);
+size_t genome_size(sc_population * population);
+int genome_distance(sc_population * population,
+                    sc_genome * genome1, sc_genome * genome2);
+unsigned char * genome_state(sc_population * population,
+                             sc_genome * individual, int step);
+uint32_t genome_hash(sc_population * population, sc_genome * individual);
+
+int state_layout_create(sc_system * sys);
+int state_get_version(sc_system * sys, unsigned char * state, int program_index);
+void state_set_version(sc_system * sys, unsigned char * state,
+                       int program_index, int version_index);
+int state_get_installed(sc_system * sys, unsigned char * state, int program_index);
+void state_set_installed(sc_system * sys, unsigned char * state,
+                         int program_index, int installed);
+int state_cmp(sc_system * sys, unsigned char * state1, unsigned char * state2);
+uint32_t state_hash(sc_system * sys, unsigned char * state, uint32_t hash);
+int state_distance(sc_system * sys, unsigned char * state1, unsigned char * state2);
+void state_crossover(sc_system * sys, unsigned char * state1,
+                     unsigned char * state2, uint64_t * mask,
+                     unsigned char * child);
+int state_program_at(sc_system * sys, int offset);
+int state_changed_programs(sc_system * sys, unsigned char * state1,
+                           unsigned char * state2, int * changed);
+void state_pack(sc_system * sys, sc_system_state * unpacked, unsigned char * state);
+void state_unpack(sc_system * sys, unsigned char * state, sc_system_state * unpacked);
 
 int population_create(int size, sc_population * population,
                       sc_system * system_definition,
                       sc_goal * goal);
+int population_create_seeded(int size, sc_population * population,
+                             sc_system * system_definition,
+                             sc_goal * goal, unsigned int random_seed);
 void population_free(sc_population * population);
 int population_copy(sc_population * destination, sc_population * source);
+int population_arena_create(sc_population * population);
 int population_next_generation(sc_population * population);
+int population_sort(sc_population * population);
 float population_average_score(sc_population * population);
 int population_set_test_passes(sc_population * population, int index, int test_passes);
+int population_set_partial_score(sc_population * population, int index,
+                                 int test_passes, int steps_completed);
+int population_evaluate(sc_population * population,
+                        sc_genome_evaluate evaluate, void * context,
+                        int max_threads, int * genome_index);
 float population_get_score(sc_population * population, int index);
 int population_best_index(sc_population * population);
 int population_worst_index(sc_population * population);
 float population_best_score(sc_population * population);
 float population_variance(sc_population * population);
+int population_survivors(sc_population * population);
+
+int synthetic_system_create(sc_system * sys, int no_of_programs,
+                            unsigned int random_seed);
+int synthetic_oracle_create(sc_synthetic_oracle * oracle, sc_system * sys,
+                            unsigned int random_seed);
+void synthetic_oracle_free(sc_synthetic_oracle * oracle);
+int synthetic_version_broken(sc_synthetic_oracle * oracle,
+                             int program_index, int version_index);
+int synthetic_evaluate(sc_synthetic_oracle * oracle,
+                       sc_population * population, int index);
+int synthetic_solution(sc_synthetic_oracle * oracle,
+                       sc_population * population, sc_genome * individual);
+int synthetic_run(sc_synthetic_oracle * oracle, sc_population * population,
+                  int max_generations, int max_threads, int * generations,
+                  int * evaluations_to_solution);
+
+void sweep_ranges_init(sc_sweep_range * range);
+const char * sweep_parameter(int parameter);
+int sweep_range_parse(sc_sweep_range * range, char * spec);
+int sweep_ranges_load(sc_sweep_range * range, char * filename);
+int sweep_create(sc_sweep * sweep, int no_of_programs, int max_generations,
+                 unsigned int system_seed, sc_sweep_range * range);
+void sweep_free(sc_sweep * sweep);
+int sweep_add_run(sc_sweep * sweep, int point, int population_size,
+                  float mutation_rate, float crossover, float rebels,
+                  unsigned int random_seed);
+int sweep_grid(sc_sweep * sweep, int repeats, unsigned int random_seed);
+int sweep_random(sc_sweep * sweep, int samples, int repeats,
+                 unsigned int random_seed);
+int sweep_run(sc_sweep * sweep, int max_threads);
+int sweep_save(sc_sweep * sweep, char * filename);
+int sweep_save_summary(sc_sweep * sweep, char * filename);
+
+int population_pareto_sort(sc_population * population);
+int population_pareto_front(sc_population * population, int * genome_index);
+int genome_dominates(sc_genome * genome1, sc_genome * genome2);
+
+int population_diversity_update(sc_population * population);
+int population_diversity_lost(sc_population * population);
+
+int population_surrogate_enable(sc_population * population);
+void population_surrogate_free(sc_population * population);
+int population_surrogate_copy(sc_population * destination,
+                              sc_population * source);
+float surrogate_predict(sc_population * population, sc_genome * individual);
+int surrogate_train(sc_population * population, sc_genome * individual);
+float surrogate_accuracy(sc_surrogate * surrogate);
+
+int population_columns_enable(sc_population * population);
+int population_columns_update(sc_population * population);
+void population_columns_free(sc_population * population);
+int population_columns_installs(sc_population * population,
+                                int step, int program_index,
+                                int * genome_index);
+float population_columns_average_score(sc_population_columns * columns);
+float population_columns_variance(sc_population_columns * columns);
+int population_columns_best_index(sc_population_columns * columns);
+int population_columns_worst_index(sc_population_columns * columns);
 
 void plot_create_df_slice(sc_dataframe * df, sc_population * population);
 void plot_create_dataframe(sc_dataframe * df, sc_population * population);
-void plot_dataframe_save(sc_dataframe * df);
+int plot_dataframe_save(sc_dataframe * df, char * filename);
+void plot_dataframe_free(sc_dataframe * df);
 
 void run_program_tests();
 void run_genome_tests();
 void run_population_tests();
 void run_system_tests();
+void run_columns_tests();
+void run_process_tests();
+void run_changelog_tests();
+void run_ingest_tests();
+void run_candidates_tests();
+void run_string_pool_tests();
+void run_state_tests();
+void run_diversity_tests();
+void run_workspace_tests();
+void run_evaluator_tests();
+void run_surrogate_tests();
+void run_pareto_tests();
+void run_synthetic_tests();
+void run_sweep_tests();
+void run_manifest_tests();
+void run_goal_tests();
+void run_plot_tests();
+
+/* helpers shared between test suites */
+int test_create_system(sc_system * system_definition, char * repo_dir);
+void test_system_dummy(sc_system * sys);
+int test_population_dummy(sc_population * population);
+void test_state_system(sc_system * sys, int no_of_programs);
+int test_population_from_memory(sc_population * population, int size);
 
 int system_create_from_repos(sc_system * sys, char * repos_dir);
 int system_create_dependency_matrix(sc_system * sys);
@@ -263,10 +1271,50 @@ int system_from_baserock_get_string(sc_system * sys, char * linestr,
                                     char * definition_line_prefix,
                                     char * foundstr);
 int system_program_index_from_name(sc_system * sys, char * name);
+int system_program_index_from_string(sc_system * sys, const char * str,
+                                     int length);
+void system_index_names(sc_system * sys);
+int system_add_program(sc_system * sys, char * name);
 int system_program_install_sequence_probability(sc_system * sys,
                                                 char * program_name,
                                                 double * probability);
 
 int goal_create_latest_versions(sc_system * sys, sc_goal * goal);
+int goal_update_distances(sc_system * sys, sc_goal * goal);
+int goal_program_distance(sc_system * sys, sc_goal * goal, int program_index,
+                          int installed, int version_index);
+int goal_state_distance(sc_system * sys, sc_goal * goal, unsigned char * state);
+int goal_distance_update(sc_system * sys, sc_goal * goal,
+                         unsigned char * prev_state, unsigned char * state,
+                         int prev_distance);
+int goal_genome_distances(sc_population * population, sc_genome * individual,
+                          int * distance);
+int goal_record_result(sc_goal * goal, sc_program_result * result);
+float goal_max_score(sc_goal * goal);
+int goal_reached(sc_population * population);
+float goal_heuristic_score(sc_population * population, sc_genome * individual);
+
+int workspace_pool_create(sc_workspace_pool * pool, char * repos_dir,
+                          char * workspaces_dir, int no_of_workspaces);
+void workspace_pool_free(sc_workspace_pool * pool, sc_system * sys);
+int workspace_acquire(sc_workspace_pool * pool);
+void workspace_release(sc_workspace_pool * pool, int index);
+int workspace_checkout(sc_workspace_pool * pool, int index,
+                       sc_system * sys, unsigned char * state);
+int workspace_program_directory(sc_workspace_pool * pool, int index,
+                                sc_system * sys, int program_index,
+                                char * directory);
+
+void evaluator_init(sc_evaluator * evaluator, char * command,
+                    char * repos_dir, char * install_prefix);
+int evaluation_create(sc_evaluation * evaluation, sc_population * population);
+void evaluation_free(sc_evaluation * evaluation);
+int evaluator_install_steps(sc_population * population, int index,
+                            sc_evaluation * evaluation);
+int evaluator_run(sc_evaluator * evaluator, sc_population * population,
+                  int index, sc_evaluation * evaluation);
+float evaluator_upper_bound(sc_evaluator * evaluator, sc_population * population,
+                            int index, sc_evaluation * evaluation,
+                            int next_install_step);
 
 #endif
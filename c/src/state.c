@@ -0,0 +1,447 @@
+/*
+  Smart search for upgrade paths
+  Copyright (C) 2016 Andrew Leeming <andrew.leeming@codethink.co.uk> and
+  Bob Mottram <bob.mottram@codethink.co.uk>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "scalam.h"
+
+/**
+ * @brief Returns the number of bytes needed to store version indexes
+ *        for a program with the given number of versions
+ * @param no_of_versions The number of versions of the program
+ * @returns Width in bytes, being 1, 2 or 4
+ */
+int state_version_width(int no_of_versions)
+{
+    /* no_of_versions itself must also be representable, since
+       that is sometimes used to mean the head of master */
+    if (no_of_versions < 0x100)
+        return 1;
+    if (no_of_versions < 0x10000)
+        return 2;
+    return 4;
+}
+
+/**
+ * @brief Calculates the layout of packed system states for a system.
+ *        This should be called whenever programs are added to the
+ *        system or their number of versions changes.
+ * @param sys System object
+ * @returns zero on success
+ */
+int state_layout_create(sc_system * sys)
+{
+    int p, width, offset, group, ctr = 0;
+
+    if ((sys->no_of_programs < 0) ||
+        (sys->no_of_programs > SC_MAX_SYSTEM_SIZE))
+        return 1;
+
+    /* installed flags come first as a bitset */
+    sys->installed_words = (sys->no_of_programs + 63) / 64;
+    offset = sys->installed_words * (int)sizeof(uint64_t);
+
+    for (p = 0; p < sys->no_of_programs; p++)
+        sys->version_width[p] =
+            (unsigned char)state_version_width(sys->program[p].no_of_versions);
+
+    /* place the widest version indexes first, so that each
+       one is naturally aligned */
+    for (width = 4, group = 0; width >= 1; width /= 2, group++) {
+        sys->version_group_offset[group] = offset;
+        sys->version_group_first[group] = ctr;
+        for (p = 0; p < sys->no_of_programs; p++) {
+            if (sys->version_width[p] != width)
+                continue;
+            sys->version_offset[p] = offset;
+            sys->version_order[ctr++] = p;
+            offset += width;
+        }
+        sys->version_group_size[group] = ctr - sys->version_group_first[group];
+    }
+
+    /* round up to a whole number of 64 bit words so that consecutive
+       states within a genome also remain aligned */
+    sys->state_bytes =
+        ((offset + (int)sizeof(uint64_t) - 1) / (int)sizeof(uint64_t)) *
+        (int)sizeof(uint64_t);
+
+    return 0;
+}
+
+/**
+ * @brief Returns the version index of a program within a packed state
+ * @param sys System object
+ * @param state Packed system state
+ * @param program_index Array index of the program within the system
+ * @returns Version index
+ */
+int state_get_version(sc_system * sys, unsigned char * state, int program_index)
+{
+    unsigned char * field = state + sys->version_offset[program_index];
+    uint16_t v16;
+    uint32_t v32;
+
+    switch(sys->version_width[program_index]) {
+    case 1:
+        return (int)field[0];
+    case 2:
+        memcpy((void*)&v16, (void*)field, sizeof(uint16_t));
+        return (int)v16;
+    }
+    memcpy((void*)&v32, (void*)field, sizeof(uint32_t));
+    return (int)v32;
+}
+
+/**
+ * @brief Sets the version index of a program within a packed state
+ * @param sys System object
+ * @param state Packed system state
+ * @param program_index Array index of the program within the system
+ * @param version_index The version index to set
+ */
+void state_set_version(sc_system * sys, unsigned char * state,
+                       int program_index, int version_index)
+{
+    unsigned char * field = state + sys->version_offset[program_index];
+    uint16_t v16;
+    uint32_t v32;
+
+    switch(sys->version_width[program_index]) {
+    case 1:
+        field[0] = (unsigned char)version_index;
+        return;
+    case 2:
+        v16 = (uint16_t)version_index;
+        memcpy((void*)field, (void*)&v16, sizeof(uint16_t));
+        return;
+    }
+    v32 = (uint32_t)version_index;
+    memcpy((void*)field, (void*)&v32, sizeof(uint32_t));
+}
+
+/**
+ * @brief Returns whether a program is installed within a packed state
+ * @param sys System object
+ * @param state Packed system state
+ * @param program_index Array index of the program within the system
+ * @returns 1 if installed, otherwise 0. Programs outside of the
+ *          system are never installed
+ */
+int state_get_installed(sc_system * sys, unsigned char * state, int program_index)
+{
+    uint64_t * installed = (uint64_t*)state;
+
+    if ((program_index < 0) || (program_index >= sys->no_of_programs))
+        return 0;
+
+    return (int)((installed[program_index >> 6] >> (program_index & 63)) & 1);
+}
+
+/**
+ * @brief Sets whether a program is installed within a packed state
+ * @param sys System object
+ * @param state Packed system state
+ * @param program_index Array index of the program within the system
+ * @param installed Non-zero if the program is installed.
+ *                  Programs outside of the system are ignored
+ */
+void state_set_installed(sc_system * sys, unsigned char * state,
+                         int program_index, int installed)
+{
+    uint64_t * words = (uint64_t*)state;
+    uint64_t bit = (uint64_t)1 << (program_index & 63);
+
+    if ((program_index < 0) || (program_index >= sys->no_of_programs))
+        return;
+
+    if (installed)
+        words[program_index >> 6] |= bit;
+    else
+        words[program_index >> 6] &= ~bit;
+}
+
+/**
+ * @brief Compares two packed states
+ * @param sys System object
+ * @param state1 First packed state
+ * @param state2 Second packed state
+ * @returns zero if the states are the same
+ */
+int state_cmp(sc_system * sys, unsigned char * state1, unsigned char * state2)
+{
+    return memcmp((void*)state1, (void*)state2, sys->state_bytes);
+}
+
+/**
+ * @brief Updates a FNV-1a hash with the contents of a packed state
+ * @param sys System object
+ * @param state Packed system state
+ * @param hash The hash so far. Use 2166136261 for a new hash
+ * @returns The updated hash
+ */
+uint32_t state_hash(sc_system * sys, unsigned char * state, uint32_t hash)
+{
+    int i;
+
+    for (i = 0; i < sys->state_bytes; i++) {
+        hash ^= state[i];
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+/**
+ * @brief Returns the number of programs (genes) which differ between
+ *        two packed states, either in version or install status.
+ *        Install status is compared a word at a time, and versions
+ *        are compared within each group of the same width, so no
+ *        field needs to be decoded
+ * @param sys System object
+ * @param state1 First packed state
+ * @param state2 Second packed state
+ * @returns Hamming distance in genes
+ */
+int state_distance(sc_system * sys, unsigned char * state1, unsigned char * state2)
+{
+    uint64_t diff[(SC_MAX_SYSTEM_SIZE + 63) / 64];
+    uint64_t * installed1 = (uint64_t*)state1;
+    uint64_t * installed2 = (uint64_t*)state2;
+    uint32_t * v32_1, * v32_2;
+    uint16_t * v16_1, * v16_2;
+    unsigned char * v8_1, * v8_2;
+    int * order;
+    int i, p, distance = 0;
+
+    /* programs which differ in install status */
+    for (i = 0; i < sys->installed_words; i++)
+        diff[i] = installed1[i] ^ installed2[i];
+
+    /* add programs which differ in version, one width group at a time */
+    v32_1 = (uint32_t*)(state1 + sys->version_group_offset[0]);
+    v32_2 = (uint32_t*)(state2 + sys->version_group_offset[0]);
+    order = &sys->version_order[sys->version_group_first[0]];
+    for (i = 0; i < sys->version_group_size[0]; i++) {
+        if (v32_1[i] != v32_2[i]) {
+            p = order[i];
+            diff[p >> 6] |= (uint64_t)1 << (p & 63);
+        }
+    }
+
+    v16_1 = (uint16_t*)(state1 + sys->version_group_offset[1]);
+    v16_2 = (uint16_t*)(state2 + sys->version_group_offset[1]);
+    order = &sys->version_order[sys->version_group_first[1]];
+    for (i = 0; i < sys->version_group_size[1]; i++) {
+        if (v16_1[i] != v16_2[i]) {
+            p = order[i];
+            diff[p >> 6] |= (uint64_t)1 << (p & 63);
+        }
+    }
+
+    v8_1 = state1 + sys->version_group_offset[2];
+    v8_2 = state2 + sys->version_group_offset[2];
+    order = &sys->version_order[sys->version_group_first[2]];
+    for (i = 0; i < sys->version_group_size[2]; i++) {
+        if (v8_1[i] != v8_2[i]) {
+            p = order[i];
+            diff[p >> 6] |= (uint64_t)1 << (p & 63);
+        }
+    }
+
+    for (i = 0; i < sys->installed_words; i++)
+        distance += __builtin_popcountll(diff[i]);
+
+    return distance;
+}
+
+/**
+ * @brief Creates a packed state with each program (gene) taken from
+ *        one of two parent states. Install status is combined a word
+ *        at a time using the mask, and the child begins as a copy of
+ *        the first parent, with runs of adjacent version fields from
+ *        the second parent copied over it
+ * @param sys System object
+ * @param state1 First parent packed state
+ * @param state2 Second parent packed state
+ * @param mask Bitset of installed_words words, with the bit for each
+ *             program set if it is taken from the second parent
+ * @param child Returned packed state
+ */
+void state_crossover(sc_system * sys, unsigned char * state1,
+                     unsigned char * state2, uint64_t * mask,
+                     unsigned char * child)
+{
+    uint64_t * installed1 = (uint64_t*)state1;
+    uint64_t * installed2 = (uint64_t*)state2;
+    uint64_t * installed = (uint64_t*)child;
+    int * order;
+    int i, group, width, offset, run_start, p;
+
+    memcpy((void*)child, (void*)state1, sys->state_bytes);
+
+    for (i = 0; i < sys->installed_words; i++)
+        installed[i] = (installed1[i] & ~mask[i]) | (installed2[i] & mask[i]);
+
+    for (group = 0, width = 4; group < 3; group++, width /= 2) {
+        offset = sys->version_group_offset[group];
+        order = &sys->version_order[sys->version_group_first[group]];
+        run_start = -1;
+
+        /* one extra pass ends any run at the end of the group */
+        for (i = 0; i <= sys->version_group_size[group]; i++) {
+            p = -1;
+            if (i < sys->version_group_size[group])
+                p = order[i];
+
+            if ((p >= 0) && ((mask[p >> 6] >> (p & 63)) & 1)) {
+                if (run_start < 0)
+                    run_start = i;
+                continue;
+            }
+
+            if (run_start >= 0) {
+                memcpy((void*)(child + offset + run_start*width),
+                       (void*)(state2 + offset + run_start*width),
+                       (size_t)(i - run_start)*width);
+                run_start = -1;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Converts an unpacked system state into its packed form
+ * @param sys System object
+ * @param unpacked The unpacked system state
+ * @param state Returned packed state of sys->state_bytes
+ */
+void state_pack(sc_system * sys, sc_system_state * unpacked, unsigned char * state)
+{
+    int p;
+
+    memset((void*)state, '\0', sys->state_bytes);
+
+    for (p = 0; p < sys->no_of_programs; p++) {
+        state_set_version(sys, state, p, unpacked->version_index[p]);
+        state_set_installed(sys, state, p, unpacked->installed[p]);
+    }
+}
+
+/**
+ * @brief Converts a packed state into its unpacked form
+ * @param sys System object
+ * @param state The packed state
+ * @param unpacked Returned unpacked system state
+ */
+void state_unpack(sc_system * sys, unsigned char * state, sc_system_state * unpacked)
+{
+    int p;
+
+    for (p = 0; p < sys->no_of_programs; p++) {
+        unpacked->version_index[p] = state_get_version(sys, state, p);
+        unpacked->installed[p] = (unsigned char)state_get_installed(sys, state, p);
+    }
+}
+
+/**
+ * @brief Returns the program whose version index begins at the given
+ *        byte offset within a packed state
+ * @param sys System object
+ * @param offset Byte offset within a packed state
+ * @returns Array index of the program, or -1 if no version index
+ *          begins at the offset
+ */
+int state_program_at(sc_system * sys, int offset)
+{
+    int group, width, position;
+
+    for (width = 4, group = 0; width >= 1; width /= 2, group++) {
+        position = offset - sys->version_group_offset[group];
+        if ((position < 0) ||
+            (position >= sys->version_group_size[group] * width))
+            continue;
+
+        if (position % width != 0)
+            return -1;
+
+        return sys->version_order[sys->version_group_first[group] +
+                                  position / width];
+    }
+    return -1;
+}
+
+/**
+ * @brief Finds the programs which differ between two packed states.
+ *        Whole words are compared, so the cost depends mostly upon
+ *        the number of changes rather than the size of the system.
+ * @param sys System object
+ * @param state1 First packed state
+ * @param state2 Second packed state
+ * @param changed Returned array indexes of the programs which differ,
+ *                each appearing once. May be NULL if only the number
+ *                is needed
+ * @returns The number of programs which differ
+ */
+int state_changed_programs(sc_system * sys, unsigned char * state1,
+                           unsigned char * state2, int * changed)
+{
+    uint64_t * words1 = (uint64_t*)state1;
+    uint64_t * words2 = (uint64_t*)state2;
+    uint64_t diff;
+    int w, b, p, offset, bit, ctr = 0;
+    int no_of_words = sys->state_bytes / (int)sizeof(uint64_t);
+
+    for (w = 0; w < no_of_words; w++) {
+        diff = words1[w] ^ words2[w];
+        if (diff == 0)
+            continue;
+
+        if (w < sys->installed_words) {
+            /* each set bit is a program whose installed flag differs */
+            while (diff != 0) {
+                bit = __builtin_ctzll(diff);
+                if (changed != NULL)
+                    changed[ctr] = w*64 + bit;
+                ctr++;
+                diff &= diff - 1;
+            }
+            continue;
+        }
+
+        /* version indexes which begin within this word */
+        offset = w * (int)sizeof(uint64_t);
+        for (b = 0; b < (int)sizeof(uint64_t); b++) {
+            p = state_program_at(sys, offset + b);
+            if (p < 0)
+                continue;
+
+            /* already found from its installed flag */
+            if (state_get_installed(sys, state1, p) !=
+                state_get_installed(sys, state2, p))
+                continue;
+
+            if (state_get_version(sys, state1, p) !=
+                state_get_version(sys, state2, p)) {
+                if (changed != NULL)
+                    changed[ctr] = p;
+                ctr++;
+            }
+        }
+    }
+
+    return ctr;
+}
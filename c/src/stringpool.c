@@ -0,0 +1,272 @@
+/*
+  Smart search for upgrade paths
+  Copyright (C) 2016 Andrew Leeming <andrew.leeming@codethink.co.uk> and
+  Bob Mottram <bob.mottram@codethink.co.uk>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "scalam.h"
+
+/* Strings are stored within fixed blocks which never move, so that
+   a string can be read without locking while others are being added.
+   The high bits of an sc_string give the block and the low bits
+   the position within it. The first byte of the first block is
+   never used, so that a zeroed sc_string is the empty string */
+static char * string_pool_block[SC_STRING_POOL_MAX_BLOCKS];
+static int string_pool_blocks = 0;
+static unsigned int string_pool_block_used = 0;
+static unsigned int string_pool_block_size = 0;
+static unsigned long string_pool_bytes = 0;
+
+/* Open addressing index used to find strings which already exist */
+static sc_string * string_pool_slot = NULL;
+static unsigned int * string_pool_slot_hash = NULL;
+static unsigned int string_pool_slots = 0;
+static unsigned int string_pool_strings = 0;
+
+/**
+ * @brief Returns a hash for the given string
+ * @param str The string
+ * @param length Length of the string
+ * @returns Hash of the string
+ */
+static unsigned int string_pool_hash(const char * str, int length)
+{
+    unsigned int hash = 2166136261u;
+    int i;
+
+    for (i = 0; i < length; i++) {
+        hash ^= (unsigned char)str[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @brief Doubles the size of the index used to find existing strings
+ * @returns zero on success
+ */
+static int string_pool_grow_index()
+{
+    unsigned int slots = string_pool_slots * 2, i, s;
+    sc_string * slot;
+    unsigned int * slot_hash;
+
+    if (slots == 0)
+        slots = SC_STRING_POOL_INITIAL_SLOTS;
+
+    slot = (sc_string*)calloc(slots, sizeof(sc_string));
+    slot_hash = (unsigned int*)calloc(slots, sizeof(unsigned int));
+    if ((slot == NULL) || (slot_hash == NULL)) {
+        free(slot);
+        free(slot_hash);
+        return 1;
+    }
+
+    for (i = 0; i < string_pool_slots; i++) {
+        if (string_pool_slot[i] == 0)
+            continue;
+        s = string_pool_slot_hash[i] & (slots - 1);
+        while (slot[s] != 0)
+            s = (s + 1) & (slots - 1);
+        slot[s] = string_pool_slot[i];
+        slot_hash[s] = string_pool_slot_hash[i];
+    }
+
+    free(string_pool_slot);
+    free(string_pool_slot_hash);
+    string_pool_slot = slot;
+    string_pool_slot_hash = slot_hash;
+    string_pool_slots = slots;
+    return 0;
+}
+
+/**
+ * @brief Copies a string into the pool, without checking whether it
+ *        already exists
+ * @param str The string
+ * @param length Length of the string
+ * @returns The new string, or zero if the pool is full
+ */
+static sc_string string_pool_store(const char * str, int length)
+{
+    unsigned int size = SC_STRING_POOL_BLOCK_SIZE;
+    sc_string s;
+    char * block;
+
+    /* strings longer than a block are given a block of their own.
+       The position of a string within a block must fit within
+       SC_STRING_POOL_BLOCK_BITS, and here it is at most one */
+    if ((unsigned int)length + 2 > size)
+        size = (unsigned int)length + 2;
+
+    if ((string_pool_blocks == 0) ||
+        (string_pool_block_used + length + 1 > string_pool_block_size)) {
+        if (string_pool_blocks >= SC_STRING_POOL_MAX_BLOCKS)
+            return 0;
+
+        block = (char*)malloc(size);
+        if (block == NULL)
+            return 0;
+
+        block[0] = 0;
+        string_pool_block[string_pool_blocks++] = block;
+        string_pool_block_size = size;
+        string_pool_block_used = 0;
+        if (string_pool_blocks == 1)
+            string_pool_block_used = 1;
+    }
+
+    s = ((sc_string)(string_pool_blocks - 1) << SC_STRING_POOL_BLOCK_BITS) |
+        string_pool_block_used;
+    block = string_pool_block[string_pool_blocks - 1];
+    memcpy(&block[string_pool_block_used], str, length);
+    block[string_pool_block_used + length] = 0;
+    string_pool_block_used += length + 1;
+    string_pool_bytes += length + 1;
+    return s;
+}
+
+/**
+ * @brief Adds a string of the given length to the pool. Equal strings
+ *        are only stored once, so they always have the same sc_string
+ * @param str The string, which doesn't need to be terminated
+ * @param length Length of the string
+ * @returns The string within the pool, or zero (the empty string)
+ *          if it is empty or the pool is full
+ */
+sc_string string_pool_add_length(const char * str, int length)
+{
+    sc_string s = 0;
+    unsigned int hash, i;
+
+    if ((str == NULL) || (length <= 0))
+        return 0;
+
+    hash = string_pool_hash(str, length);
+
+#pragma omp critical (string_pool)
+    {
+        if ((string_pool_strings + 1) * 2 > string_pool_slots)
+            string_pool_grow_index();
+
+        if ((string_pool_strings + 1) * 2 <= string_pool_slots) {
+            i = hash & (string_pool_slots - 1);
+            while (string_pool_slot[i] != 0) {
+                if (string_pool_slot_hash[i] == hash) {
+                    char * existing = string_pool_get(string_pool_slot[i]);
+                    if ((strncmp(existing, str, length) == 0) &&
+                        (existing[length] == 0)) {
+                        s = string_pool_slot[i];
+                        break;
+                    }
+                }
+                i = (i + 1) & (string_pool_slots - 1);
+            }
+
+            if (s == 0) {
+                s = string_pool_store(str, length);
+                if (s != 0) {
+                    string_pool_slot[i] = s;
+                    string_pool_slot_hash[i] = hash;
+                    string_pool_strings++;
+                }
+            }
+        }
+    }
+
+    return s;
+}
+
+/**
+ * @brief Adds a string to the pool
+ * @param str The string
+ * @returns The string within the pool, or zero (the empty string)
+ *          if it is empty or the pool is full
+ */
+sc_string string_pool_add(const char * str)
+{
+    if (str == NULL)
+        return 0;
+
+    return string_pool_add_length(str, strlen(str));
+}
+
+/**
+ * @brief Adds a formatted string to the pool. Unlike formatting into
+ *        a buffer of SC_MAX_STRING the result is never truncated
+ * @param format printf style format
+ * @returns The string within the pool, or zero (the empty string)
+ *          if it is empty or could not be added
+ */
+sc_string string_pool_printf(const char * format, ...)
+{
+    char buffer[SC_MAX_STRING];
+    char * str = buffer;
+    va_list args;
+    int length;
+    sc_string s;
+
+    va_start(args, format);
+    length = vsnprintf(buffer, SC_MAX_STRING, format, args);
+    va_end(args);
+    if (length < 0)
+        return 0;
+
+    if (length >= SC_MAX_STRING) {
+        str = (char*)malloc(length + 1);
+        if (str == NULL)
+            return 0;
+        va_start(args, format);
+        vsnprintf(str, length + 1, format, args);
+        va_end(args);
+    }
+
+    s = string_pool_add_length(str, length);
+
+    if (str != buffer)
+        free(str);
+    return s;
+}
+
+/**
+ * @brief Returns the characters of a string within the pool.
+ *        These remain valid until the program exits, and must not
+ *        be modified since equal strings share them
+ * @param s The string within the pool
+ * @returns Terminated string
+ */
+char * string_pool_get(sc_string s)
+{
+    if (s == 0)
+        return "";
+
+    return &string_pool_block[s >> SC_STRING_POOL_BLOCK_BITS]
+        [s & ((1 << SC_STRING_POOL_BLOCK_BITS) - 1)];
+}
+
+/**
+ * @brief Returns the number of bytes used by strings within the pool
+ * @returns Number of bytes, including terminators
+ */
+unsigned long string_pool_size()
+{
+    unsigned long bytes;
+
+#pragma omp critical (string_pool)
+    bytes = string_pool_bytes;
+
+    return bytes;
+}
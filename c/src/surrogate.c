@@ -0,0 +1,317 @@
+/*
+  Smart search for upgrade paths
+  Copyright (C) 2016 Andrew Leeming <andrew.leeming@codethink.co.uk> and
+  Bob Mottram <bob.mottram@codethink.co.uk>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "scalam.h"
+
+/**
+ * @brief Enables a surrogate fitness model for a population. Once enabled
+ *        it is trained as scores are set, and once it has seen enough
+ *        evaluations it is used to choose which children are created
+ *        for the next generation.
+ * @param population The population object
+ * @returns zero on success
+ */
+int population_surrogate_enable(sc_population * population)
+{
+    sc_surrogate * surrogate;
+    sc_system * sys = &population->sys;
+    int p, d, ctr;
+
+    if (population->surrogate != NULL)
+        return 0;
+
+    surrogate = (sc_surrogate*)malloc(sizeof(sc_surrogate));
+    if (surrogate == NULL)
+        return 1;
+
+    memset((void*)surrogate, '\0', sizeof(sc_surrogate));
+    surrogate->learning_rate = SC_DEFAULT_SURROGATE_LEARNING_RATE;
+    surrogate->oversample = SC_DEFAULT_SURROGATE_OVERSAMPLE;
+    surrogate->min_samples = SC_DEFAULT_SURROGATE_MIN_SAMPLES;
+    population->surrogate = surrogate;
+
+    surrogate->candidate = (sc_genome*)malloc(genome_size(population));
+    surrogate->dependency_start =
+        (int*)malloc((sys->no_of_programs+1)*sizeof(int));
+    if ((surrogate->candidate == NULL) ||
+        (surrogate->dependency_start == NULL)) {
+        population_surrogate_free(population);
+        return 2;
+    }
+
+    /* count the dependencies */
+    ctr = 0;
+    if (sys->dependency_probability != NULL)
+        for (p = 0; p < sys->no_of_programs; p++)
+            for (d = 0; d < sys->no_of_programs; d++)
+                if ((d != p) && (sys->dependency_probability[p][d] != 0))
+                    ctr++;
+
+    surrogate->dependency = (int*)malloc((ctr+1)*sizeof(int));
+    if (surrogate->dependency == NULL) {
+        population_surrogate_free(population);
+        return 3;
+    }
+
+    /* store them as compressed rows */
+    ctr = 0;
+    for (p = 0; p < sys->no_of_programs; p++) {
+        surrogate->dependency_start[p] = ctr;
+        if (sys->dependency_probability == NULL)
+            continue;
+        for (d = 0; d < sys->no_of_programs; d++)
+            if ((d != p) && (sys->dependency_probability[p][d] != 0))
+                surrogate->dependency[ctr++] = d;
+    }
+    surrogate->dependency_start[sys->no_of_programs] = ctr;
+
+    return 0;
+}
+
+/**
+ * @brief Deallocates the surrogate model of a population, if there is one
+ * @param population The population object
+ */
+void population_surrogate_free(sc_population * population)
+{
+    sc_surrogate * surrogate = population->surrogate;
+
+    if (surrogate == NULL)
+        return;
+
+    free(surrogate->candidate);
+    free(surrogate->dependency_start);
+    free(surrogate->dependency);
+    free(surrogate);
+
+    population->surrogate = NULL;
+}
+
+/**
+ * @brief Copies the surrogate model of one population to another
+ *        with the same system
+ * @param destination Population to copy to, which has no surrogate
+ * @param source Population to copy from
+ * @returns zero on success
+ */
+int population_surrogate_copy(sc_population * destination,
+                              sc_population * source)
+{
+    sc_surrogate * surrogate;
+
+    destination->surrogate = NULL;
+    if (source->surrogate == NULL)
+        return 0;
+
+    if (population_surrogate_enable(destination) != 0)
+        return 1;
+
+    /* the learned state, leaving the buffers of the destination alone */
+    surrogate = destination->surrogate;
+    memcpy((void*)surrogate->weight, (void*)source->surrogate->weight,
+           SC_SURROGATE_FEATURES*sizeof(float));
+    surrogate->bias = source->surrogate->bias;
+    surrogate->learning_rate = source->surrogate->learning_rate;
+    surrogate->oversample = source->surrogate->oversample;
+    surrogate->min_samples = source->surrogate->min_samples;
+    surrogate->max_score = source->surrogate->max_score;
+    surrogate->samples = source->surrogate->samples;
+    surrogate->predictions = source->surrogate->predictions;
+    surrogate->correct = source->surrogate->correct;
+    surrogate->absolute_error = source->surrogate->absolute_error;
+    surrogate->children_screened = source->surrogate->children_screened;
+
+    return 0;
+}
+
+/**
+ * @brief Returns the feature index for a combination of values
+ */
+static unsigned int surrogate_hash(unsigned int a, unsigned int b,
+                                   unsigned int c, unsigned int d)
+{
+    unsigned int hash = 2166136261U;
+
+    hash = (hash ^ a) * 16777619U;
+    hash = (hash ^ b) * 16777619U;
+    hash = (hash ^ c) * 16777619U;
+    hash = (hash ^ d) * 16777619U;
+
+    return hash % SC_SURROGATE_FEATURES;
+}
+
+/**
+ * @brief Returns the bucket which a program version falls into
+ */
+static unsigned int surrogate_bucket(sc_system * sys, unsigned char * state,
+                                     int program_index)
+{
+    int no_of_versions = sys->program[program_index].no_of_versions;
+    int bucket;
+
+    if (no_of_versions <= 0)
+        return 0;
+
+    bucket = (int)(((int64_t)state_get_version(sys, state, program_index) *
+                    SC_SURROGATE_BUCKETS) / no_of_versions);
+    if (bucket >= SC_SURROGATE_BUCKETS)
+        bucket = SC_SURROGATE_BUCKETS-1;
+
+    return (unsigned int)bucket;
+}
+
+/**
+ * @brief Visits every feature of a genome, summing their weights
+ *        and optionally adjusting them
+ * @param population The population object
+ * @param individual The genome
+ * @param sum Returned sum of the weights of the features
+ * @param update Amount to add to the weight of each feature
+ * @returns The number of features
+ */
+static int surrogate_features(sc_population * population,
+                              sc_genome * individual,
+                              float * sum, float update)
+{
+    sc_surrogate * surrogate = population->surrogate;
+    sc_system * sys = &population->sys;
+    unsigned char * state;
+    unsigned int f, bucket;
+    int step, p, i, d, ctr = 0;
+
+    *sum = 0;
+    for (step = 0; step < individual->steps; step++) {
+        state = genome_state(population, individual, step);
+
+        for (p = 0; p < sys->no_of_programs; p++) {
+            if (!state_get_installed(sys, state, p))
+                continue;
+
+            bucket = surrogate_bucket(sys, state, p);
+
+            f = surrogate_hash((unsigned int)p, bucket, 0xffffffffU, 0);
+            *sum += surrogate->weight[f];
+            surrogate->weight[f] += update;
+            ctr++;
+
+            /* versions of the program with versions of its dependencies */
+            for (i = surrogate->dependency_start[p];
+                 i < surrogate->dependency_start[p+1]; i++) {
+                d = surrogate->dependency[i];
+                if (!state_get_installed(sys, state, d))
+                    continue;
+
+                f = surrogate_hash((unsigned int)p, bucket, (unsigned int)d,
+                                   surrogate_bucket(sys, state, d));
+                *sum += surrogate->weight[f];
+                surrogate->weight[f] += update;
+                ctr++;
+            }
+        }
+    }
+
+    return ctr;
+}
+
+/**
+ * @brief Predicts the score of a genome relative to the best seen so far
+ * @param population The population object, with a surrogate enabled
+ * @param individual The genome
+ * @returns Predicted score in the range 0.0 -> 1.0
+ */
+float surrogate_predict(sc_population * population, sc_genome * individual)
+{
+    float sum, z;
+    int ctr;
+
+    if (population->surrogate == NULL)
+        return 0;
+
+    ctr = surrogate_features(population, individual, &sum, 0);
+
+    /* features are scaled so that genomes with more installs
+       don't dominate */
+    z = population->surrogate->bias;
+    if (ctr > 0)
+        z += sum / (float)sqrt(ctr);
+
+    return 1.0f / (1.0f + (float)exp(-z));
+}
+
+/**
+ * @brief Trains the surrogate model on the real score of a genome.
+ *        Once children are being screened, the prediction made before
+ *        training is also used to measure the accuracy of the model.
+ * @param population The population object, with a surrogate enabled
+ * @param individual The evaluated genome
+ * @returns zero on success
+ */
+int surrogate_train(sc_population * population, sc_genome * individual)
+{
+    sc_surrogate * surrogate = population->surrogate;
+    float sum, z, predicted, target, gradient;
+    int ctr;
+
+    if (surrogate == NULL)
+        return 1;
+
+    if (individual->score > surrogate->max_score)
+        surrogate->max_score = individual->score;
+
+    target = 0;
+    if (surrogate->max_score > 0)
+        target = individual->score / surrogate->max_score;
+
+    ctr = surrogate_features(population, individual, &sum, 0);
+    z = surrogate->bias;
+    if (ctr > 0)
+        z += sum / (float)sqrt(ctr);
+    predicted = 1.0f / (1.0f + (float)exp(-z));
+
+    if (surrogate->samples >= surrogate->min_samples) {
+        surrogate->predictions++;
+        if ((predicted >= 0.5f) == (target >= 0.5f))
+            surrogate->correct++;
+        surrogate->absolute_error += (float)fabs(predicted - target);
+    }
+
+    /* logistic regression gradient step */
+    gradient = surrogate->learning_rate * (target - predicted);
+    surrogate->bias += gradient;
+    if (ctr > 0)
+        surrogate_features(population, individual, &sum,
+                           gradient / (float)sqrt(ctr));
+
+    surrogate->samples++;
+    return 0;
+}
+
+/**
+ * @brief Returns the fraction of predictions made by the surrogate
+ *        which were on the right side of half the best score
+ * @param surrogate The surrogate model
+ * @returns Accuracy in the range 0.0 -> 1.0
+ */
+float surrogate_accuracy(sc_surrogate * surrogate)
+{
+    if (surrogate->predictions <= 0)
+        return 0;
+
+    return (float)surrogate->correct / (float)surrogate->predictions;
+}
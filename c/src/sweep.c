@@ -0,0 +1,638 @@
+/*
+  Smart search for upgrade paths
+  Copyright (C) 2016 Andrew Leeming <andrew.leeming@codethink.co.uk> and
+  Bob Mottram <bob.mottram@codethink.co.uk>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "scalam.h"
+
+/**
+ * @brief Returns a monotonic time in seconds, for timing runs
+ * @returns Time in seconds
+ */
+static double sweep_seconds()
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + ((double)t.tv_nsec / 1000000000.0);
+}
+
+/* Names of the hyper-parameters, as given within range specifications */
+static const char * sweep_parameter_name[] = {
+    "population", "mutation", "crossover", "rebels"
+};
+
+/**
+ * @brief Sets the default range of every hyper-parameter
+ * @param range Array of SC_SWEEP_PARAMETERS ranges
+ */
+void sweep_ranges_init(sc_sweep_range * range)
+{
+    range[SC_SWEEP_POPULATION_SIZE].minimum = 16;
+    range[SC_SWEEP_POPULATION_SIZE].maximum = 128;
+    range[SC_SWEEP_POPULATION_SIZE].steps = 3;
+
+    range[SC_SWEEP_MUTATION_RATE].minimum = 0.05f;
+    range[SC_SWEEP_MUTATION_RATE].maximum = 0.4f;
+    range[SC_SWEEP_MUTATION_RATE].steps = 3;
+
+    range[SC_SWEEP_CROSSOVER].minimum = 0.2f;
+    range[SC_SWEEP_CROSSOVER].maximum = 0.8f;
+    range[SC_SWEEP_CROSSOVER].steps = 3;
+
+    range[SC_SWEEP_REBELS].minimum = 0;
+    range[SC_SWEEP_REBELS].maximum = 0.2f;
+    range[SC_SWEEP_REBELS].steps = 3;
+}
+
+/**
+ * @brief Returns the name of a hyper-parameter
+ * @param parameter The hyper-parameter, such as SC_SWEEP_MUTATION_RATE
+ * @returns The name, or NULL if the parameter is out of range
+ */
+const char * sweep_parameter(int parameter)
+{
+    if ((parameter < 0) || (parameter >= SC_SWEEP_PARAMETERS))
+        return NULL;
+
+    return sweep_parameter_name[parameter];
+}
+
+/**
+ * @brief Checks that a range only contains usable values
+ * @param parameter The hyper-parameter, such as SC_SWEEP_MUTATION_RATE
+ * @param range The range of the parameter
+ * @returns zero if the range is valid
+ */
+static int sweep_range_check(int parameter, sc_sweep_range * range)
+{
+    if (range->steps < 1)
+        return 1;
+
+    if (range->maximum < range->minimum)
+        return 2;
+
+    if (parameter == SC_SWEEP_POPULATION_SIZE) {
+        if ((range->minimum < 2) ||
+            (range->maximum > SC_MAX_POPULATION_SIZE))
+            return 3;
+    }
+    else if ((range->minimum < 0) || (range->maximum > 1)) {
+        return 4;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Sets the range of a hyper-parameter from a specification
+ *        of the form name=minimum:maximum:steps, such as
+ *        mutation=0.1:0.5:5. A single value, such as rebels=0.1,
+ *        fixes the parameter, and without a number of steps
+ *        only the minimum and maximum are used
+ * @param range Array of SC_SWEEP_PARAMETERS ranges, which is updated
+ * @param spec The range specification
+ * @returns zero on success
+ */
+int sweep_range_parse(sc_sweep_range * range, char * spec)
+{
+    sc_sweep_range parsed;
+    char name[SC_MAX_STRING];
+    int parameter, fields;
+    char * value;
+
+    value = strchr(spec, '=');
+    if ((value == NULL) || (value == spec) || (value - spec >= SC_MAX_STRING))
+        return 1;
+
+    memcpy((void*)name, (void*)spec, value - spec);
+    name[value - spec] = 0;
+
+    for (parameter = 0; parameter < SC_SWEEP_PARAMETERS; parameter++)
+        if (strcmp(name, sweep_parameter_name[parameter]) == 0)
+            break;
+    if (parameter == SC_SWEEP_PARAMETERS)
+        return 2;
+
+    fields = sscanf(value + 1, "%f:%f:%d", &parsed.minimum,
+                    &parsed.maximum, &parsed.steps);
+    if (fields < 1)
+        return 3;
+    if (fields == 1) {
+        parsed.maximum = parsed.minimum;
+        parsed.steps = 1;
+    }
+    else if (fields == 2) {
+        parsed.steps = (parsed.maximum > parsed.minimum) ? 2 : 1;
+    }
+
+    if (sweep_range_check(parameter, &parsed) != 0)
+        return 4;
+
+    range[parameter] = parsed;
+    return 0;
+}
+
+/**
+ * @brief Sets hyper-parameter ranges from a file containing one range
+ *        specification per line, as given to sweep_range_parse.
+ *        Blank lines and lines beginning with # are ignored
+ * @param range Array of SC_SWEEP_PARAMETERS ranges, which is updated
+ * @param filename The file to load
+ * @returns zero on success
+ */
+int sweep_ranges_load(sc_sweep_range * range, char * filename)
+{
+    FILE * fp;
+    char linestr[SC_MAX_STRING];
+    char * spec;
+    int retval = 0;
+
+    fp = fopen(filename, "r");
+    if (fp == NULL)
+        return 1;
+
+    while (fgets(linestr, SC_MAX_STRING, fp) != NULL) {
+        spec = linestr;
+        while ((*spec == ' ') || (*spec == '\t'))
+            spec++;
+        spec[strcspn(spec, " \t\r\n")] = 0;
+        if ((spec[0] == 0) || (spec[0] == '#'))
+            continue;
+
+        if (sweep_range_parse(range, spec) != 0) {
+            retval = 2;
+            break;
+        }
+    }
+
+    fclose(fp);
+    return retval;
+}
+
+/**
+ * @brief Creates a hyper-parameter sweep with no runs
+ * @param sweep The sweep object to be created
+ * @param no_of_programs Number of programs within the synthetic system
+ * @param max_generations Maximum number of generations for each run
+ * @param system_seed Seed used to create the synthetic system and its
+ *                    oracle, which is the same for every run
+ * @param range Array of SC_SWEEP_PARAMETERS ranges to be covered,
+ *              or NULL for the default ranges
+ * @returns zero on success
+ */
+int sweep_create(sc_sweep * sweep, int no_of_programs, int max_generations,
+                 unsigned int system_seed, sc_sweep_range * range)
+{
+    int i;
+
+    if ((no_of_programs < 1) || (no_of_programs > SC_MAX_SYSTEM_SIZE))
+        return 1;
+
+    if (max_generations < 1)
+        return 2;
+
+    if (range != NULL)
+        for (i = 0; i < SC_SWEEP_PARAMETERS; i++)
+            if (sweep_range_check(i, &range[i]) != 0)
+                return 3;
+
+    memset((void*)sweep, '\0', sizeof(sc_sweep));
+    sweep->no_of_programs = no_of_programs;
+    sweep->max_generations = max_generations;
+    sweep->system_seed = system_seed;
+
+    if (range != NULL)
+        memcpy((void*)sweep->range, (void*)range,
+               SC_SWEEP_PARAMETERS*sizeof(sc_sweep_range));
+    else
+        sweep_ranges_init(sweep->range);
+
+    return 0;
+}
+
+/**
+ * @brief Deallocates the runs of a sweep
+ * @param sweep The sweep object
+ */
+void sweep_free(sc_sweep * sweep)
+{
+    free(sweep->run);
+    sweep->run = NULL;
+    sweep->no_of_runs = 0;
+    sweep->max_runs = 0;
+    sweep->no_of_points = 0;
+}
+
+/**
+ * @brief Adds a run to a sweep
+ * @param sweep The sweep object
+ * @param point Index of the point within parameter space
+ * @param population_size Number of genomes in the population
+ * @param mutation_rate Mutation rate in the range 0.0 - 1.0
+ * @param crossover Crossover in the range 0.0 - 1.0
+ * @param rebels Fraction of rebels in the range 0.0 - 1.0
+ * @param random_seed Seed for the population
+ * @returns zero on success
+ */
+int sweep_add_run(sc_sweep * sweep, int point, int population_size,
+                  float mutation_rate, float crossover, float rebels,
+                  unsigned int random_seed)
+{
+    sc_sweep_run * run;
+    int max_runs;
+
+    if (point < 0)
+        return 1;
+
+    if ((population_size < 2) || (population_size > SC_MAX_POPULATION_SIZE))
+        return 2;
+
+    if (sweep->no_of_runs >= SC_MAX_SWEEP_RUNS)
+        return 3;
+
+    if (sweep->no_of_runs >= sweep->max_runs) {
+        max_runs = sweep->max_runs * 2;
+        if (max_runs < 64)
+            max_runs = 64;
+        run = (sc_sweep_run*)realloc(sweep->run, max_runs*sizeof(sc_sweep_run));
+        if (run == NULL)
+            return 4;
+        sweep->run = run;
+        sweep->max_runs = max_runs;
+    }
+
+    run = &sweep->run[sweep->no_of_runs++];
+    memset((void*)run, '\0', sizeof(sc_sweep_run));
+    run->point = point;
+    run->population_size = population_size;
+    run->mutation_rate = mutation_rate;
+    run->crossover = crossover;
+    run->rebels = rebels;
+    run->random_seed = random_seed;
+    run->evaluations_to_solution = -1;
+
+    if (point >= sweep->no_of_points)
+        sweep->no_of_points = point + 1;
+
+    return 0;
+}
+
+/**
+ * @brief Returns a value from a parameter range
+ * @param range The range of the parameter
+ * @param step The step within the range
+ * @returns The parameter value
+ */
+static float sweep_range_value(sc_sweep_range * range, int step)
+{
+    if (range->steps <= 1)
+        return range->minimum;
+
+    return range->minimum +
+        ((range->maximum - range->minimum) * step / (float)(range->steps - 1));
+}
+
+/**
+ * @brief Adds runs for every point on a grid covering the parameter ranges
+ * @param sweep The sweep object
+ * @param repeats Number of runs for each point, each with a different seed
+ * @param random_seed Seed from which the seeds of the runs are created
+ * @returns zero on success
+ */
+int sweep_grid(sc_sweep * sweep, int repeats, unsigned int random_seed)
+{
+    int step[SC_SWEEP_PARAMETERS];
+    int i, r, point, first_point, no_of_points = 1, retval;
+
+    if (repeats < 1)
+        return 1;
+
+    for (i = 0; i < SC_SWEEP_PARAMETERS; i++) {
+        if (sweep->range[i].steps < 1)
+            return 2;
+        no_of_points *= sweep->range[i].steps;
+    }
+
+    if ((long)no_of_points * repeats + sweep->no_of_runs > SC_MAX_SWEEP_RUNS)
+        return 3;
+
+    first_point = sweep->no_of_points;
+    for (point = 0; point < no_of_points; point++) {
+        /* position of the point on each axis of the grid */
+        r = point;
+        for (i = 0; i < SC_SWEEP_PARAMETERS; i++) {
+            step[i] = r % sweep->range[i].steps;
+            r /= sweep->range[i].steps;
+        }
+
+        for (r = 0; r < repeats; r++) {
+            retval =
+                sweep_add_run(sweep, first_point + point,
+                              (int)(sweep_range_value(&sweep->range[SC_SWEEP_POPULATION_SIZE],
+                                                      step[SC_SWEEP_POPULATION_SIZE]) + 0.5f),
+                              sweep_range_value(&sweep->range[SC_SWEEP_MUTATION_RATE],
+                                                step[SC_SWEEP_MUTATION_RATE]),
+                              sweep_range_value(&sweep->range[SC_SWEEP_CROSSOVER],
+                                                step[SC_SWEEP_CROSSOVER]),
+                              sweep_range_value(&sweep->range[SC_SWEEP_REBELS],
+                                                step[SC_SWEEP_REBELS]),
+                              rand_num(&random_seed));
+            if (retval != 0)
+                return 10 + retval;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Adds runs for points sampled at random within the parameter ranges
+ * @param sweep The sweep object
+ * @param samples Number of points to sample
+ * @param repeats Number of runs for each point, each with a different seed
+ * @param random_seed Seed used to sample points and create run seeds
+ * @returns zero on success
+ */
+int sweep_random(sc_sweep * sweep, int samples, int repeats,
+                 unsigned int random_seed)
+{
+    float value[SC_SWEEP_PARAMETERS];
+    int i, s, r, first_point, retval;
+
+    if ((samples < 1) || (repeats < 1))
+        return 1;
+
+    if ((long)samples * repeats + sweep->no_of_runs > SC_MAX_SWEEP_RUNS)
+        return 2;
+
+    first_point = sweep->no_of_points;
+    for (s = 0; s < samples; s++) {
+        for (i = 0; i < SC_SWEEP_PARAMETERS; i++)
+            value[i] = sweep->range[i].minimum +
+                ((sweep->range[i].maximum - sweep->range[i].minimum) *
+                 (rand_num(&random_seed) % 10001) / 10000.0f);
+
+        for (r = 0; r < repeats; r++) {
+            retval = sweep_add_run(sweep, first_point + s,
+                                   (int)(value[SC_SWEEP_POPULATION_SIZE] + 0.5f),
+                                   value[SC_SWEEP_MUTATION_RATE],
+                                   value[SC_SWEEP_CROSSOVER],
+                                   value[SC_SWEEP_REBELS],
+                                   rand_num(&random_seed));
+            if (retval != 0)
+                return 10 + retval;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Runs a single simulation of a sweep. The system, goal and
+ *        oracle are only read, so they can be shared between runs
+ * @param sweep The sweep object
+ * @param sys The synthetic system
+ * @param goal The goal
+ * @param oracle The oracle for the synthetic system
+ * @param run The run, which is updated with its results
+ */
+static void sweep_run_single(sc_sweep * sweep, sc_system * sys, sc_goal * goal,
+                             sc_synthetic_oracle * oracle, sc_sweep_run * run)
+{
+    sc_population * population;
+    double start_time = sweep_seconds();
+    float best_score;
+
+    population = (sc_population*)malloc(sizeof(sc_population));
+    if (population == NULL) {
+        run->status = 1;
+        return;
+    }
+
+    run->status = population_create_seeded(run->population_size, population,
+                                           sys, goal, run->random_seed);
+    if (run->status != 0) {
+        run->status += 100;
+        free(population);
+        return;
+    }
+
+    population->mutation_rate = run->mutation_rate;
+    population->crossover = run->crossover;
+    population->rebels = run->rebels;
+
+    /* runs are already in parallel, so each one uses a single thread */
+    run->status = synthetic_run(oracle, population, sweep->max_generations, 1,
+                                &run->generations,
+                                &run->evaluations_to_solution);
+
+    run->evaluations = population->evaluations;
+    best_score = population_best_score(population);
+    if (population->best_score_so_far > best_score)
+        best_score = population->best_score_so_far;
+    run->best_score = best_score;
+    run->average_score = population_average_score(population);
+    run->duration = sweep_seconds() - start_time;
+
+    population_free(population);
+    free(population);
+}
+
+/**
+ * @brief Runs every simulation of a sweep in parallel. Each thread only
+ *        holds one population at a time, so memory use depends upon the
+ *        number of threads rather than the number of runs
+ * @param sweep The sweep object
+ * @param max_threads Maximum number of simultaneous runs, or zero to
+ *                    use every processor
+ * @returns zero on success
+ */
+int sweep_run(sc_sweep * sweep, int max_threads)
+{
+    sc_system * sys;
+    sc_goal * goal;
+    sc_synthetic_oracle * oracle;
+    int i, retval = 0;
+
+    if (sweep->no_of_runs <= 0)
+        return 1;
+
+    if (max_threads <= 0)
+        max_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (max_threads <= 0)
+        max_threads = 1;
+
+    sys = (sc_system*)malloc(sizeof(sc_system));
+    goal = (sc_goal*)malloc(sizeof(sc_goal));
+    oracle = (sc_synthetic_oracle*)malloc(sizeof(sc_synthetic_oracle));
+    if ((sys == NULL) || (goal == NULL) || (oracle == NULL)) {
+        free(sys);
+        free(goal);
+        free(oracle);
+        return 2;
+    }
+    memset((void*)oracle, '\0', sizeof(sc_synthetic_oracle));
+
+    /* every run searches the same system */
+    if (synthetic_system_create(sys, sweep->no_of_programs,
+                                sweep->system_seed) != 0)
+        retval = 3;
+    else if (synthetic_oracle_create(oracle, sys, sweep->system_seed + 1) != 0)
+        retval = 4;
+    else if (goal_create_latest_versions(sys, goal) != 0)
+        retval = 5;
+
+    if (retval == 0) {
+#pragma omp parallel for schedule(dynamic) num_threads(max_threads)
+        for (i = 0; i < sweep->no_of_runs; i++)
+            sweep_run_single(sweep, sys, goal, oracle, &sweep->run[i]);
+
+        for (i = 0; i < sweep->no_of_runs; i++)
+            if (sweep->run[i].status != 0)
+                retval = 6;
+    }
+
+    synthetic_oracle_free(oracle);
+    free(oracle);
+    free(goal);
+    free(sys);
+    return retval;
+}
+
+/**
+ * @brief Saves the results of every run to a CSV file. Each row is
+ *        tagged with the parameters of its run, so that runs can be
+ *        grouped when plotting
+ * @param sweep The sweep object
+ * @param filename The CSV file to save
+ * @returns zero on success
+ */
+int sweep_save(sc_sweep * sweep, char * filename)
+{
+    sc_sweep_run * run;
+    FILE * fp;
+    int i;
+
+    fp = fopen(filename, "w");
+    if (fp == NULL)
+        return 1;
+
+    fprintf(fp, "run_ix,point_ix,population_size,mutation_rate,crossover,"
+            "rebels,seed,no_of_programs,system_seed,status,generations,"
+            "evaluations,evaluations_to_solution,best_score,average_score,"
+            "duration\n");
+
+    for (i = 0; i < sweep->no_of_runs; i++) {
+        run = &sweep->run[i];
+        fprintf(fp, "%d,%d,%d,%f,%f,%f,%u,%d,%u,%d,%d,%d,%d,%f,%f,%f\n",
+                i, run->point, run->population_size, run->mutation_rate,
+                run->crossover, run->rebels, run->random_seed,
+                sweep->no_of_programs, sweep->system_seed, run->status,
+                run->generations, run->evaluations,
+                run->evaluations_to_solution, run->best_score,
+                run->average_score, run->duration);
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+/* Totals for a point within parameter space, used for summaries */
+typedef struct {
+    sc_sweep_run * first;
+    int runs, solved;
+    double evaluations, evaluations_sq, best_score, duration;
+} sc_sweep_totals;
+
+/**
+ * @brief Saves summary statistics for each point within parameter space
+ *        to a CSV file. The evaluations to a solution are averaged over
+ *        the runs which found one
+ * @param sweep The sweep object
+ * @param filename The CSV file to save
+ * @returns zero on success
+ */
+int sweep_save_summary(sc_sweep * sweep, char * filename)
+{
+    sc_sweep_totals * totals, * t;
+    sc_sweep_run * run;
+    FILE * fp;
+    int point, i;
+    double mean, sd;
+
+    if (sweep->no_of_points <= 0)
+        return 1;
+
+    totals = (sc_sweep_totals*)calloc(sweep->no_of_points,
+                                      sizeof(sc_sweep_totals));
+    if (totals == NULL)
+        return 2;
+
+    for (i = 0; i < sweep->no_of_runs; i++) {
+        run = &sweep->run[i];
+        if (run->status != 0)
+            continue;
+
+        t = &totals[run->point];
+        if (t->first == NULL)
+            t->first = run;
+        t->runs++;
+        t->best_score += run->best_score;
+        t->duration += run->duration;
+        if (run->evaluations_to_solution >= 0) {
+            t->solved++;
+            t->evaluations += run->evaluations_to_solution;
+            t->evaluations_sq += (double)run->evaluations_to_solution *
+                run->evaluations_to_solution;
+        }
+    }
+
+    fp = fopen(filename, "w");
+    if (fp == NULL) {
+        free(totals);
+        return 3;
+    }
+
+    fprintf(fp, "point_ix,population_size,mutation_rate,crossover,rebels,"
+            "runs,solved,success_rate,mean_evaluations_to_solution,"
+            "sd_evaluations_to_solution,mean_best_score,mean_duration\n");
+
+    for (point = 0; point < sweep->no_of_points; point++) {
+        t = &totals[point];
+        if (t->runs == 0)
+            continue;
+
+        mean = 0;
+        sd = 0;
+        if (t->solved > 0) {
+            mean = t->evaluations / t->solved;
+            sd = t->evaluations_sq / t->solved - mean*mean;
+            sd = (sd > 0) ? sqrt(sd) : 0;
+        }
+
+        fprintf(fp, "%d,%d,%f,%f,%f,%d,%d,%f,%f,%f,%f,%f\n",
+                point, t->first->population_size, t->first->mutation_rate,
+                t->first->crossover, t->first->rebels, t->runs, t->solved,
+                t->solved / (float)t->runs, mean, sd,
+                t->best_score / t->runs, t->duration / t->runs);
+    }
+
+    fclose(fp);
+    free(totals);
+    return 0;
+}
@@ -0,0 +1,437 @@
+/*
+  Smart search for upgrade paths
+  Copyright (C) 2016 Andrew Leeming <andrew.leeming@codethink.co.uk> and
+  Bob Mottram <bob.mottram@codethink.co.uk>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "scalam.h"
+
+/**
+ * @brief Creates a synthetic system, with no repos, for experiments.
+ *        Every program is installed at the start, at roughly the same
+ *        fraction of the way through its versions. There is no dependency
+ *        matrix, since dependencies are part of the hidden model of
+ *        the oracle.
+ * @param sys Returned system object
+ * @param no_of_programs The number of programs within the system
+ * @param random_seed Seed used to generate the system
+ * @returns zero on success
+ */
+int synthetic_system_create(sc_system * sys, int no_of_programs,
+                            unsigned int random_seed)
+{
+    int p, no_of_versions;
+    float base, fraction;
+
+    if ((no_of_programs < 1) || (no_of_programs > SC_MAX_SYSTEM_SIZE))
+        return 1;
+
+    memset((void*)sys, '\0', sizeof(sc_system));
+    sys->no_of_programs = no_of_programs;
+
+    /* how far through their versions the programs are at the start */
+    base = (rand_num(&random_seed) % 40) / 100.0f;
+
+    for (p = 0; p < no_of_programs; p++) {
+        sys->program[p].name = string_pool_printf("synthetic%d", p);
+
+        no_of_versions = SC_SYNTHETIC_MIN_VERSIONS +
+            rand_num(&random_seed) %
+            (SC_SYNTHETIC_MAX_VERSIONS - SC_SYNTHETIC_MIN_VERSIONS + 1);
+        sys->program[p].no_of_versions = no_of_versions;
+
+        fraction = base + ((rand_num(&random_seed) % 5) - 2) / 100.0f;
+        if (fraction < 0) fraction = 0;
+        sys->program[p].version_index =
+            (int)(fraction * (float)(no_of_versions - 1));
+        sys->program[p].installed = 1;
+    }
+    system_index_names(sys);
+
+    return state_layout_create(sys);
+}
+
+/**
+ * @brief Creates a hidden model of which upgrades of a synthetic
+ *        system will build
+ * @param oracle Returned oracle object
+ * @param sys The synthetic system
+ * @param random_seed Seed used to generate the model
+ * @returns zero on success
+ */
+int synthetic_oracle_create(sc_synthetic_oracle * oracle, sc_system * sys,
+                            unsigned int random_seed)
+{
+    int p, d, i, dependencies, max_edges, duplicate;
+
+    if ((sys->no_of_programs < 1) || (sys->no_of_programs > SC_MAX_SYSTEM_SIZE))
+        return 1;
+
+    memset((void*)oracle, '\0', sizeof(sc_synthetic_oracle));
+    oracle->no_of_programs = sys->no_of_programs;
+    oracle->broken_per_mille = SC_SYNTHETIC_BROKEN_PER_MILLE;
+    oracle->random_seed = random_seed;
+
+    max_edges = sys->no_of_programs * SC_SYNTHETIC_MAX_DEPENDENCIES;
+    oracle->edge_dependency = (int*)malloc(max_edges*sizeof(int));
+    oracle->edge_lag = (float*)malloc(max_edges*sizeof(float));
+    oracle->edge_lead = (float*)malloc(max_edges*sizeof(float));
+    if ((oracle->edge_dependency == NULL) ||
+        (oracle->edge_lag == NULL) || (oracle->edge_lead == NULL)) {
+        synthetic_oracle_free(oracle);
+        return 2;
+    }
+
+    for (p = 0; p < sys->no_of_programs; p++) {
+        oracle->no_of_versions[p] = sys->program[p].no_of_versions;
+        oracle->tests[p] = 1 + rand_num(&random_seed) % 10;
+        oracle->max_jump[p] = sys->program[p].no_of_versions /
+            (2 + rand_num(&random_seed) % 6);
+        if (oracle->max_jump[p] < 1)
+            oracle->max_jump[p] = 1;
+        oracle->build_cost[p] = 1 + (rand_num(&random_seed) % 20) / 10.0f;
+
+        /* programs only depend upon earlier ones, so there are no cycles */
+        oracle->edge_start[p] = oracle->no_of_edges;
+        dependencies = rand_num(&random_seed) % (SC_SYNTHETIC_MAX_DEPENDENCIES+1);
+        if (dependencies > p)
+            dependencies = p;
+
+        while (oracle->no_of_edges - oracle->edge_start[p] < dependencies) {
+            d = rand_num(&random_seed) % p;
+
+            duplicate = 0;
+            for (i = oracle->edge_start[p]; i < oracle->no_of_edges; i++)
+                if (oracle->edge_dependency[i] == d)
+                    duplicate = 1;
+            if (duplicate)
+                continue;
+
+            /* windows wide enough that the starting state is compatible */
+            oracle->edge_dependency[oracle->no_of_edges] = d;
+            oracle->edge_lag[oracle->no_of_edges] =
+                0.3f + (rand_num(&random_seed) % 20) / 100.0f;
+            oracle->edge_lead[oracle->no_of_edges] =
+                0.3f + (rand_num(&random_seed) % 20) / 100.0f;
+            oracle->no_of_edges++;
+        }
+    }
+    oracle->edge_start[sys->no_of_programs] = oracle->no_of_edges;
+
+    return 0;
+}
+
+/**
+ * @brief Deallocates an oracle
+ * @param oracle The oracle object
+ */
+void synthetic_oracle_free(sc_synthetic_oracle * oracle)
+{
+    free(oracle->edge_dependency);
+    free(oracle->edge_lag);
+    free(oracle->edge_lead);
+    oracle->edge_dependency = NULL;
+    oracle->edge_lag = NULL;
+    oracle->edge_lead = NULL;
+}
+
+/**
+ * @brief Returns true if a version of a program never builds.
+ *        The latest version of each program always builds.
+ * @param oracle The oracle object
+ * @param program_index Array index of the program within the system
+ * @param version_index The version of the program
+ * @returns True if the version is broken
+ */
+int synthetic_version_broken(sc_synthetic_oracle * oracle,
+                             int program_index, int version_index)
+{
+    unsigned int hash = oracle->random_seed;
+
+    if (version_index == oracle->no_of_versions[program_index] - 1)
+        return 0;
+
+    hash = (hash ^ (unsigned int)program_index) * 16777619U;
+    hash = (hash ^ (unsigned int)version_index) * 16777619U;
+    hash ^= hash >> 15;
+
+    return ((int)(hash % 1000) < oracle->broken_per_mille);
+}
+
+/**
+ * @brief Returns how far through its versions a program is
+ */
+static float synthetic_fraction(sc_synthetic_oracle * oracle,
+                                int program_index, int version_index)
+{
+    if (oracle->no_of_versions[program_index] <= 1)
+        return 1;
+
+    return (float)version_index /
+        (float)(oracle->no_of_versions[program_index] - 1);
+}
+
+/**
+ * @brief Returns true if a program builds at a version, given the
+ *        versions which are installed after the step
+ */
+static int synthetic_install_passes(sc_synthetic_oracle * oracle,
+                                    int program_index,
+                                    int * version, unsigned char * installed,
+                                    int prev_installed, int prev_version)
+{
+    int i, d, jump;
+    float fraction, dependency_fraction;
+
+    if (synthetic_version_broken(oracle, program_index, version[program_index]))
+        return 0;
+
+    /* upgrading too far in one go */
+    if (prev_installed) {
+        jump = version[program_index] - prev_version;
+        if (jump < 0) jump = -jump;
+        if (jump > oracle->max_jump[program_index])
+            return 0;
+    }
+
+    fraction = synthetic_fraction(oracle, program_index, version[program_index]);
+
+    for (i = oracle->edge_start[program_index];
+         i < oracle->edge_start[program_index+1]; i++) {
+        d = oracle->edge_dependency[i];
+        if (!installed[d])
+            return 0;
+
+        dependency_fraction = synthetic_fraction(oracle, d, version[d]);
+        if ((dependency_fraction < fraction - oracle->edge_lag[i]) ||
+            (dependency_fraction > fraction + oracle->edge_lead[i]))
+            return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Simulates building each step of a genome, stopping at the
+ *        first install which fails. A genome with no steps goes
+ *        straight to the goal.
+ * @param oracle The oracle object
+ * @param population The population object
+ * @param individual The genome
+ * @param test_passes Returned number of tests passed
+ * @param cost Returned simulated build time
+ * @param steps_completed Returned number of steps which passed
+ * @returns zero if every step passed
+ */
+static int synthetic_simulate(sc_synthetic_oracle * oracle,
+                              sc_population * population,
+                              sc_genome * individual,
+                              int * test_passes, float * cost,
+                              int * steps_completed)
+{
+    sc_system * sys = &population->sys;
+    sc_goal * goal = &population->goal;
+    int version[SC_MAX_SYSTEM_SIZE], prev_version[SC_MAX_SYSTEM_SIZE];
+    unsigned char installed[SC_MAX_SYSTEM_SIZE];
+    unsigned char prev_installed[SC_MAX_SYSTEM_SIZE];
+    unsigned char * state;
+    int step, p, failed = 0, no_of_steps = individual->steps;
+
+    *test_passes = 0;
+    *cost = 0;
+    *steps_completed = 0;
+
+    for (p = 0; p < sys->no_of_programs; p++) {
+        prev_version[p] = goal->start.version_index[p];
+        prev_installed[p] = goal->start.installed[p];
+    }
+
+    if (no_of_steps == 0)
+        no_of_steps = 1;
+
+    for (step = 0; step < no_of_steps; step++) {
+        /* the state after this step */
+        if (individual->steps == 0) {
+            for (p = 0; p < sys->no_of_programs; p++) {
+                version[p] = goal->reference.version_index[p];
+                installed[p] = goal->reference.installed[p];
+            }
+        }
+        else {
+            state = genome_state(population, individual, step);
+            for (p = 0; p < sys->no_of_programs; p++) {
+                version[p] = state_get_version(sys, state, p);
+                installed[p] = (unsigned char)state_get_installed(sys, state, p);
+            }
+        }
+
+        for (p = 0; p < sys->no_of_programs; p++) {
+            if (!installed[p])
+                continue;
+            if (prev_installed[p] && (prev_version[p] == version[p]))
+                continue;
+
+            *cost += oracle->build_cost[p];
+            if (!synthetic_install_passes(oracle, p, version, installed,
+                                          prev_installed[p], prev_version[p])) {
+                failed = 1;
+                break;
+            }
+            *test_passes += oracle->tests[p];
+        }
+
+        if (failed)
+            return 1;
+
+        if (individual->steps > 0)
+            *steps_completed = step + 1;
+
+        memcpy((void*)prev_version, (void*)version,
+               sys->no_of_programs*sizeof(int));
+        memcpy((void*)prev_installed, (void*)installed,
+               sys->no_of_programs*sizeof(unsigned char));
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Evaluates a genome using the hidden model, without changing the
+ *        population, so that genomes can be evaluated in parallel
+ * @param context The oracle object
+ * @param population The population object
+ * @param index Array index of the genome within the population
+ * @param test_passes Returned number of tests passed
+ * @param steps_completed Returned number of steps which passed
+ * @param build_time Returned simulated build time
+ * @returns zero on success
+ */
+static int synthetic_evaluate_genome(void * context, sc_population * population,
+                                     int index, int * test_passes,
+                                     int * steps_completed, float * build_time)
+{
+    sc_synthetic_oracle * oracle = (sc_synthetic_oracle*)context;
+
+    if (population->sys.no_of_programs != oracle->no_of_programs)
+        return 1;
+
+    synthetic_simulate(oracle, population, population->individual[index],
+                       test_passes, build_time, steps_completed);
+    return 0;
+}
+
+/**
+ * @brief Scores a genome using the hidden model instead of building it
+ * @param oracle The oracle object
+ * @param population The population object
+ * @param index Array index of the genome within the population
+ * @returns zero on success
+ */
+int synthetic_evaluate(sc_synthetic_oracle * oracle,
+                       sc_population * population, int index)
+{
+    int test_passes, steps_completed, retval;
+    float cost;
+
+    if ((index < 0) || (index >= population->size))
+        return 1;
+
+    if (synthetic_evaluate_genome(oracle, population, index, &test_passes,
+                                  &steps_completed, &cost) != 0)
+        return 2;
+
+    retval = population_set_partial_score(population, index,
+                                          test_passes, steps_completed);
+    if (retval != 0)
+        return 10 + retval;
+
+    population->individual[index]->build_time = cost;
+    return 0;
+}
+
+/**
+ * @brief Returns true if a genome is a solution. That is, every step
+ *        builds and it ends at the goal.
+ * @param oracle The oracle object
+ * @param population The population object
+ * @param individual The genome
+ * @returns True if the genome is a solution
+ */
+int synthetic_solution(sc_synthetic_oracle * oracle,
+                       sc_population * population, sc_genome * individual)
+{
+    int test_passes, steps_completed;
+    float cost;
+
+    if (synthetic_simulate(oracle, population, individual,
+                           &test_passes, &cost, &steps_completed) != 0)
+        return 0;
+
+    return (goal_genome_distances(population, individual, NULL) == 0);
+}
+
+/**
+ * @brief Runs the genetic algorithm against an oracle until a solution
+ *        is found, to measure how efficiently the search works.
+ *        The results don't depend upon the number of threads.
+ * @param oracle The oracle object
+ * @param population The population, created with the synthetic system
+ * @param max_generations The maximum number of generations to run
+ * @param max_threads Maximum number of genomes evaluated at once
+ * @param generations Returned number of generations run
+ * @param evaluations_to_solution Returned number of evaluations made
+ *                                before a solution was found, or -1 if
+ *                                none was found
+ * @returns zero on success
+ */
+int synthetic_run(sc_synthetic_oracle * oracle, sc_population * population,
+                  int max_generations, int max_threads, int * generations,
+                  int * evaluations_to_solution)
+{
+    int genome_index[SC_MAX_POPULATION_SIZE];
+    int i, n, evaluations, retval;
+
+    *generations = 0;
+    *evaluations_to_solution = -1;
+
+    while (*generations < max_generations) {
+        evaluations = population->evaluations;
+        n = population_evaluate(population, synthetic_evaluate_genome, oracle,
+                                max_threads, genome_index);
+        if (n < 0)
+            return 1;
+
+        /* scores were set in this order, so count evaluations
+           up to the first solution */
+        for (i = 0; i < n; i++) {
+            if (synthetic_solution(oracle, population,
+                                   population->individual[genome_index[i]])) {
+                *evaluations_to_solution = evaluations + i + 1;
+                break;
+            }
+        }
+        (*generations)++;
+
+        if (*evaluations_to_solution >= 0)
+            break;
+
+        retval = population_next_generation(population);
+        if (retval != 0)
+            return 100 + retval;
+    }
+
+    return 0;
+}
@@ -31,8 +31,7 @@ int system_add_program_from_repo_directory(sc_system * sys, char * repos_dir,
                                            char * subdirectory, int ctr)
 {
     char full_directory[SC_MAX_STRING];
-    char current_checkout[SC_MAX_STRING];
-    int line_number;
+    int p, retval;
 
     if (ctr == 0)
         return 0;
@@ -44,37 +43,22 @@ int system_add_program_from_repo_directory(sc_system * sys, char * repos_dir,
     sprintf(full_directory,"%s/%s",repos_dir,subdirectory);
 
     /* set the name of the program */
-    sprintf((&sys->program[sys->no_of_programs])->name, "%s", subdirectory);
+    p = system_add_program(sys, subdirectory);
+    if (p < 0)
+        return 5;
 
     /* update the details for this program */
-    if (program_repo_get_commits(full_directory,
-                                 &sys->program[sys->no_of_programs]) != 0)
+    if (program_repo_get_commits(full_directory, &sys->program[p]) != 0)
         return 1;
 
     /* check that there are some commits */
-    if (sys->program[sys->no_of_programs].no_of_versions <= 0)
+    if (sys->program[p].no_of_versions <= 0)
         return 2;
 
-    /* get the current checkout commit */
-    if (program_repo_get_current_checkout(full_directory, current_checkout) != 0)
-        return 3;
-
-    /* Get the array index from the checkout */
-    line_number =
-        get_line_number_from_string_in_file((&sys->program[sys->no_of_programs])->versions_file,
-                                            (char*)current_checkout);
-    if (line_number < 0)
-        return 4;
-
-    /* Invert the line number so that the last line in versions_file
-       corresponds to version index zero. This just makes incrementing
-       through versions more intuitive. */
-    sys->program[sys->no_of_programs].version_index =
-        sys->program[sys->no_of_programs].no_of_versions -
-        line_number;
-
-    /* increment the number of programs in the system */
-    sys->no_of_programs++;
+    /* the version index of the current checkout */
+    retval = program_repo_get_current_version(full_directory, &sys->program[p]);
+    if (retval != 0)
+        return 2 + retval;
 
     return 0;
 }
@@ -116,62 +100,48 @@ int system_create_dependency_matrix(sc_system * sys)
  */
 int system_create_from_repos(sc_system * sys, char * repos_dir)
 {
-    char commandstr[SC_MAX_STRING];
-    char directories[SC_MAX_STRING];
     char subdirectory[SC_MAX_STRING];
-    char current_commit[SC_MAX_STRING];
-    char head_commit[SC_MAX_STRING];
-    int i, ctr, retval;
-
-    /* find the subdirectories. This returns a string with directories listed
-       such as:
-
-       dir1/
-       dir2/
-       dir3/
-    */
-    sprintf(commandstr, "cd %s\nls -F | grep /", repos_dir);
-    if (run_shell_command_with_output(commandstr, directories) != 0)
+    char full_directory[SC_MAX_STRING*2];
+    struct dirent ** entries;
+    int i, no_of_entries, no_of_repos = 0, retval = 0;
+
+    /* find the subdirectories in alphabetical order,
+       without running ls */
+    no_of_entries = scandir(repos_dir, &entries, NULL, alphasort);
+    if (no_of_entries < 0)
         return 1;
-    if (directories[0] == 0)
-        return 2;
-
-    subdirectory[0] = 0;
-    ctr = 0;
 
     /* clear the system so that it's initial state is consistent */
     memset((void*)sys, '\0', sizeof(sc_system));
 
     system_create_dependency_matrix(sys);
 
-    /* scan the directories string extracting individual subdirectories */
-    for (i = 0; i < strlen(directories); i++) {
-        /* look for carriage returns */
-        if ((directories[i] != '\n') && (i < strlen(directories)-1)) {
-            /* read the directory name */
-            if (directories[i] != '/')
-                subdirectory[ctr++] = directories[i];
-        }
-        else {
-            retval = system_add_program_from_repo_directory(sys, repos_dir,
-                                                            (char*)subdirectory, ctr);
-            if (retval != 0) {
-                printf("system_add_program_from_repo_directory err %d", retval);
-                return 3;
+    for (i = 0; i < no_of_entries; i++) {
+        /* hidden directories are ignored */
+        if ((retval == 0) && (entries[i]->d_name[0] != '.') &&
+            (strlen(entries[i]->d_name) < SC_MAX_STRING)) {
+            sprintf(full_directory, "%s/%s", repos_dir, entries[i]->d_name);
+            if (directory_exists(full_directory)) {
+                sprintf(subdirectory, "%s", entries[i]->d_name);
+                retval = system_add_program_from_repo_directory(sys, repos_dir,
+                                                                subdirectory,
+                                                                strlen(subdirectory));
+                if (retval != 0)
+                    printf("system_add_program_from_repo_directory err %d", retval);
+                no_of_repos++;
             }
-
-            /* reset the character counter */
-            ctr = 0;
         }
+        free(entries[i]);
     }
+    free(entries);
 
-    /* Handle any stragglers if we didn't encounter a final carriage
-       return or / character */
-    if (system_add_program_from_repo_directory(sys, repos_dir,
-                                               (char*)subdirectory, ctr) != 0)
-        return 4;
+    if (retval != 0)
+        return 3;
 
-    return 0;
+    if (no_of_repos == 0)
+        return 2;
+
+    return state_layout_create(sys);
 }
 
 /**
@@ -185,12 +155,12 @@ int system_create_from_repos(sc_system * sys, char * repos_dir)
 float system_build(sc_population *population, int pop_ix)
 {
     sc_program * program;
-    sc_system_state * state;
+    unsigned char * state;
     float score_sum=0;
     /* TODO */
 
 
-    state=population->individual[pop_ix]->change;
+    state=genome_state(population, population->individual[pop_ix], 0);
 
     /* Cycle through all programs in system */
     int i;
@@ -199,7 +169,7 @@ float system_build(sc_population *population, int pop_ix)
         program=&population->sys.program[i];
 
         /* If marked to install, attempt it */
-        if(state->installed[i])
+        if(state_get_installed(&population->sys, state, i))
         {
             /*
              * TODO
@@ -233,6 +203,22 @@ int system_copy(sc_system * destination, sc_system * source)
     memcpy((void*)&destination->program, (void*)&source->program,
            sizeof(sc_program)*SC_MAX_SYSTEM_SIZE);
 
+    /* the name index refers to programs by array index, so it's
+       the same for the copy */
+    memcpy((void*)destination->name_hash, (void*)source->name_hash,
+           sizeof(source->name_hash));
+    memcpy((void*)destination->name_slot, (void*)source->name_slot,
+           sizeof(source->name_slot));
+    destination->indexed_programs = source->indexed_programs;
+
+    if (state_layout_create(destination) != 0)
+        return 2;
+
+    /* some systems, such as synthetic ones, have no dependency matrix */
+    destination->dependency_probability = NULL;
+    if (source->dependency_probability == NULL)
+        return 0;
+
     if (system_create_dependency_matrix(destination) != 0)
         return 1;
 
@@ -261,6 +247,13 @@ int system_cmp(sc_system * sys1, sc_system * sys2)
                sizeof(sc_program)*SC_MAX_SYSTEM_SIZE) != 0)
         return 2;
 
+    if ((sys1->dependency_probability == NULL) ||
+        (sys2->dependency_probability == NULL)) {
+        if (sys1->dependency_probability != sys2->dependency_probability)
+            return 3;
+        return 0;
+    }
+
     for (i = 0; i < SC_MAX_SYSTEM_SIZE; i++)
         if (memcmp((void*)sys1->dependency_probability[i],
                    (void*)sys2->dependency_probability[i],
@@ -278,10 +271,14 @@ void system_free(sc_system * sys)
 {
     int i;
 
+    if (sys->dependency_probability == NULL)
+        return;
+
     for (i = 0; i < SC_MAX_SYSTEM_SIZE; i++)
         free(sys->dependency_probability[i]);
 
     free(sys->dependency_probability);
+    sys->dependency_probability = NULL;
 }
 
 /**
@@ -312,197 +309,157 @@ int system_from_baserock_get_string(sc_system * sys, char * linestr,
 }
 
 /**
- * @brief Given the name of a program return its array index within a system
- * @param sys System object
- * @param name The program name to search for
- * @returns Array index of the program, or -1 if not found
+ * @brief Returns the hash of a program name, which needn't be terminated
+ * @param str The name
+ * @param length Length of the name
+ * @returns FNV-1a hash
  */
-int system_program_index_from_name(sc_system * sys, char * name)
+static unsigned int system_name_hash(const char * str, int length)
 {
+    unsigned int hash = 2166136261U;
     int i;
 
-    for (i = 0; i < sys->no_of_programs; i++) {
-        if (strcmp(sys->program[i].name, name) == 0)
-            return i;
+    for (i = 0; i < length; i++) {
+        hash ^= (unsigned char)str[i];
+        hash *= 16777619U;
     }
-    return -1;
+    return hash;
 }
 
 /**
- * @brief Updates the dependency matrix for a system from baserock definitions
- * @brief definitions_dir The directory where baserock definitions exist
+ * @brief Finds the slot within the name index of a system for a name
  * @param sys System object
- * @returns zero on success
+ * @param str The name, which needn't be terminated
+ * @param length Length of the name
+ * @param hash Hash of the name
+ * @returns The slot containing the name, or the empty slot where it
+ *          would be added
  */
-int system_from_baserock_update_dependencies(char * definitions_dir, sc_system * sys)
+static int system_name_slot(sc_system * sys, const char * str, int length,
+                            unsigned int hash)
 {
-    /* this is how a dependency is detected */
-    char * dependency_prefix = "  - ";
-
-    DIR * dirp;
-    struct dirent * dp;
-    char search_dir[SC_MAX_STRING], linestr[SC_MAX_STRING];
-    char morph_filename[SC_MAX_STRING];
-    char name[SC_MAX_STRING], dependency[SC_MAX_STRING];
-    FILE * fp;
-    int program_index, dependency_index;
-
-    /* create directory string */
-    sprintf(search_dir, "%s/strata", definitions_dir);
-
-    /* search through the directory for morph files
-       and extract program names */
-    dirp = opendir(search_dir);
-    while ((dp = readdir(dirp)) != NULL) {
-        /* is this a morph file ? */
-        if (strstr(dp->d_name, ".morph") == NULL)
-            continue;
-
-        /* construct the full path for the file */
-        sprintf(morph_filename, "%s/strata/%s", definitions_dir, dp->d_name);
-
-        /* search through the morph file for program names */
-        fp = fopen(morph_filename, "r");
-        if (!fp)
-            continue;
-
-        name[0] = 0;
-        while (!feof(fp)) {
-            if (fgets(linestr , SC_MAX_STRING-1 , fp) != NULL) {
-                if (linestr == NULL) continue;
-                if (strlen(linestr) < 3) continue;
-
-
-                system_from_baserock_get_string(sys, (char*)linestr,
-                                                "- name:", name);
-                if (name[0] == 0) continue;
-
-                program_index = system_program_index_from_name(sys, name);
-                if (program_index == -1) continue;
-
-                dependency[0] = 0;
-                system_from_baserock_get_string(sys, (char*)linestr, "  - ", dependency);
-                if (dependency[0] == 0) continue;
-
-                dependency_index = system_program_index_from_name(sys, dependency);
-                /* NOTE: some dependencies are not found.
-                   This could mean that baserock definitions are inconsistent or have bugs */
-                if (dependency_index == -1) continue;
-
-                /* update the matrix */
-                sys->dependency_probability[program_index][dependency_index] = 1.0;
-            }
+    int slot = (int)(hash & (SC_NAME_INDEX_SIZE-1));
+    char * name;
+    int p;
+
+    while (sys->name_slot[slot] != 0) {
+        p = sys->name_slot[slot] - 1;
+        if (sys->name_hash[p] == hash) {
+            name = string_pool_get(sys->program[p].name);
+            if ((strncmp(name, str, length) == 0) && (name[length] == 0))
+                break;
         }
-
-        fclose(fp);
+        slot = (slot + 1) & (SC_NAME_INDEX_SIZE-1);
     }
-    (void)closedir(dirp);
+    return slot;
+}
 
-    return 0;
+/**
+ * @brief Adds a program to the name index of a system
+ * @param sys System object
+ * @param program_index Array index of the program
+ */
+static void system_index_name(sc_system * sys, int program_index)
+{
+    char * name = string_pool_get(sys->program[program_index].name);
+    int length = strlen(name);
+    int slot;
+
+    sys->name_hash[program_index] = system_name_hash(name, length);
+    slot = system_name_slot(sys, name, length, sys->name_hash[program_index]);
+
+    /* if there are duplicate names then the first is found */
+    if (sys->name_slot[slot] == 0)
+        sys->name_slot[slot] = program_index + 1;
 }
 
 /**
- * @brief Extracts programs and their dependencies from baserock strata files
- * @brief definitions_dir The directory where baserock definitions exist
+ * @brief Creates the index used to find programs by name. This should be
+ *        called after program names are set directly rather than with
+ *        system_add_program. Until then programs are found by a linear
+ *        search, which is slower but still correct if the number of
+ *        programs has changed.
  * @param sys System object
- * @returns zero on success
  */
-int system_from_baserock(char * definitions_dir, sc_system * sys)
+void system_index_names(sc_system * sys)
 {
-    DIR * dirp;
-    struct dirent * dp;
-    char search_dir[SC_MAX_STRING], linestr[SC_MAX_STRING];
-    char morph_filename[SC_MAX_STRING];
-    FILE * fp;
-    int i, j;
-    char * temp = NULL;
-    char *program_names[SC_MAX_SYSTEM_SIZE];
-    char prog_name[SC_MAX_STRING];
-
-    /* clear the system object */
-    sys->no_of_programs = 0;
-
-    /* create directory string */
-    sprintf(search_dir, "%s/strata", definitions_dir);
-
-    memset((void*)program_names, '\0', sizeof(char*)*SC_MAX_SYSTEM_SIZE);
-
-    /* search through the directory for morph files
-       and extract program names */
-    dirp = opendir(search_dir);
-    while ((dp = readdir(dirp)) != NULL) {
-        /* is this a morph file ? */
-        if (strstr(dp->d_name, ".morph") == NULL)
-            continue;
-
-        /* construct the full path for the file */
-        sprintf(morph_filename, "%s/strata/%s", definitions_dir, dp->d_name);
-
-        /* search through the morph file for program names */
-        fp = fopen(morph_filename, "r");
-        if (!fp)
-            continue;
-
-        while (!feof(fp)) {
-            if (fgets(linestr , SC_MAX_STRING-1 , fp) != NULL) {
-                if (linestr == NULL) continue;
-                if (strlen(linestr) < 3) continue;
-
-                prog_name[0] = 0;
-                if (system_from_baserock_get_string(sys, (char*)linestr,
-                                                    "- name:", prog_name) != 0) {
-                    /* free allocated program name strings */
-                    for (i = 0; i < sys->no_of_programs; i++)
-                        free(program_names[i]);
-
-                    /* close files */
-                    fclose(fp);
-                    (void)closedir(dirp);
-
-                    return 1;
-                }
-
-                if (prog_name[0] != 0) {
-                    /* does the program already exist within the temporary list? */
-                    for (i = 0; i < sys->no_of_programs; i++) {
-                        if (strcmp(program_names[i], prog_name) == 0)
-                            break;
-                    }
-
-                    /* add the program to the temporary list */
-                    if (i == sys->no_of_programs) {
-                        program_names[sys->no_of_programs] =
-                            (char*)malloc(sizeof(prog_name));
-                        strcpy(program_names[sys->no_of_programs++], prog_name);
-                    }
-                }
-            }
-        }
+    int p;
 
-        fclose(fp);
+    memset((void*)sys->name_slot, '\0', sizeof(sys->name_slot));
+    for (p = 0; p < sys->no_of_programs; p++)
+        system_index_name(sys, p);
+    sys->indexed_programs = sys->no_of_programs;
+}
+
+/**
+ * @brief Adds a program with the given name to a system, keeping the
+ *        name index up to date
+ * @param sys System object
+ * @param name Name of the program
+ * @returns Array index of the new program, or negative on error
+ */
+int system_add_program(sc_system * sys, char * name)
+{
+    int p = sys->no_of_programs;
+
+    if (p >= SC_MAX_SYSTEM_SIZE)
+        return -1;
+
+    if (name[0] == 0)
+        return -2;
+
+    memset((void*)&sys->program[p], '\0', sizeof(sc_program));
+    sys->program[p].name = string_pool_add(name);
+    if (sys->program[p].name == 0)
+        return -3;
+    sys->no_of_programs++;
+
+    /* keep the index up to date, if it was up to date before */
+    if (sys->indexed_programs == p) {
+        system_index_name(sys, p);
+        sys->indexed_programs++;
     }
-    (void)closedir(dirp);
-
-    /* sort the temporary list of programs */
-    for (i = 0; i < sys->no_of_programs; i++) {
-
-        for (j = i+1; j < sys->no_of_programs; j++) {
-            if (strcmp(program_names[i], program_names[j]) > 0) {
-                /* swap */
-                temp = program_names[i];
-                program_names[i] = program_names[j];
-                program_names[j] = temp;
-                temp = NULL;
-            }
+
+    return p;
+}
+
+/**
+ * @brief Given the name of a program, which needn't be terminated,
+ *        return its array index within a system
+ * @param sys System object
+ * @param str The program name to search for
+ * @param length Length of the name
+ * @returns Array index of the program, or -1 if not found
+ */
+int system_program_index_from_string(sc_system * sys, const char * str,
+                                     int length)
+{
+    char * name;
+    int i, slot;
+
+    /* programs were added without updating the index */
+    if (sys->indexed_programs != sys->no_of_programs) {
+        for (i = 0; i < sys->no_of_programs; i++) {
+            name = string_pool_get(sys->program[i].name);
+            if ((strncmp(name, str, length) == 0) && (name[length] == 0))
+                return i;
         }
-        sprintf(sys->program[i].name, "%s", program_names[i]);
+        return -1;
     }
 
-    /* free the temporary programs list */
-    for (i = 0; i < sys->no_of_programs; i++)
-        free(program_names[i]);
+    slot = system_name_slot(sys, str, length, system_name_hash(str, length));
+    return sys->name_slot[slot] - 1;
+}
 
-    return system_from_baserock_update_dependencies(definitions_dir, sys);
+/**
+ * @brief Given the name of a program return its array index within a system
+ * @param sys System object
+ * @param name The program name to search for
+ * @returns Array index of the program, or -1 if not found
+ */
+int system_program_index_from_name(sc_system * sys, char * name)
+{
+    return system_program_index_from_string(sys, name, strlen(name));
 }
 
 /**
@@ -175,69 +175,89 @@ int get_line_from_file(char * filename, int line_number, char * line)
 }
 
 /**
- * @brief Runs a shell command
+ * @brief Runs a shell command. Where the arguments are known
+ *        process_run should be used instead, which needs no shell
  * @param commandstr The command to be run
  * @returns Zero on success
  */
 int run_shell_command(char * commandstr)
 {
-    if (system(commandstr) != -1)
-        return 0;
-    else
+    char * argv[] = { "/bin/sh", "-c", commandstr, NULL };
+
+    if (process_run(argv, 0, 0) == SC_PROCESS_NOT_RUN)
         return 1;
+
+    return 0;
+}
+
+/**
+ * @brief Runs a shell command and returns its exit status, for when
+ *        it matters whether the command succeeded
+ * @param commandstr The command to be run
+ * @returns The exit status of the command, or negative if it
+ *          didn't run to completion
+ */
+int run_shell_command_exit_status(char * commandstr)
+{
+    char * argv[] = { "/bin/sh", "-c", commandstr, NULL };
+
+    return process_run(argv, 0, 0);
 }
 
 /**
- * @brief Runs a command and returns its output as a string
+ * @brief Runs a command and returns its output as a string, without
+ *        any trailing white space
  * @param commandstr The command to be run
- * @param output The returned output of the command
+ * @param output The returned output of the command, which is truncated
+ *               to SC_MAX_STRING
  * @param zero on success
  */
 int run_shell_command_with_output(char * commandstr, char * output)
 {
-    FILE *fp;
-    char str[2048];
-    int i, ctr = 0;
+    char * argv[] = { "/bin/sh", "-c", commandstr, NULL };
 
-    fp = popen(commandstr, "r");
-    if (fp == NULL) {
-        printf("Failed to run command\n" );
+    if (process_run_with_output(argv, 0, output,
+                                SC_MAX_STRING) == SC_PROCESS_NOT_RUN) {
+        printf("Failed to run command\n");
         return 1;
     }
 
-    /* Read the output */
-    output[0] = 0;
-    while (fgets(str, sizeof(str)-1, fp) != NULL) {
-        for (i = 0; i < strlen(str); i++) {
-            output[ctr++] = str[i];
-        }
-
-        /* at the end of each line */
-        output[ctr++] = '\n';
-    }
-
-    /* string terminator */
-    if (ctr > 1) ctr -= 2;
-    output[ctr] = 0;
-
-    pclose(fp);
-
     return 0;
 }
 
 /**
- * @breif Checks to see if software is installed
+ * @brief Checks to see if software is installed, by searching PATH
+ *        for an executable with the given name
  * @param softwarename Name of the cli software
  * @returns 1 on success
  */
 int software_installed(char * softwarename)
 {
-    char commandstr[SC_MAX_STRING];
+    char filename[SC_MAX_STRING*2];
+    char * path = getenv("PATH");
+    char * end;
+    int length;
+
+    if ((path == NULL) || (softwarename[0] == 0))
+        return 0;
+
+    while (*path != 0) {
+        end = strchr(path, ':');
+        length = (end != NULL) ? (int)(end - path) : (int)strlen(path);
+
+        if ((length > 0) && (length < SC_MAX_STRING)) {
+            snprintf(filename, sizeof(filename), "%.*s/%s",
+                     length, path, softwarename);
+            if (access(filename, X_OK) == 0)
+                return 1;
+        }
 
-    /* Apparently system runs sh not bash so messes up some of the syntax */
-    sprintf(commandstr, "[ $(which %s | wc -c) = 0 ]", softwarename);
+        if (end == NULL)
+            break;
+        path = end + 1;
+    }
 
-    return system(commandstr);
+    return 0;
 }
 
 /**
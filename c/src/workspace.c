@@ -0,0 +1,293 @@
+/*
+  Smart search for upgrade paths
+  Copyright (C) 2016 Andrew Leeming <andrew.leeming@codethink.co.uk> and
+  Bob Mottram <bob.mottram@codethink.co.uk>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "scalam.h"
+
+/**
+ * @brief Creates a pool of build workspaces. Worktrees within each
+ *        workspace are only created when first needed.
+ * @param pool The workspace pool to be created
+ * @param repos_dir Directory containing the original repos
+ * @param workspaces_dir Directory within which workspaces will be created
+ * @param no_of_workspaces The number of workspaces, typically the number
+ *                         of concurrent evaluations
+ * @returns zero on success, or 5 if a workspace path would be too long
+ */
+int workspace_pool_create(sc_workspace_pool * pool, char * repos_dir,
+                          char * workspaces_dir, int no_of_workspaces)
+{
+    char src_directory[SC_MAX_STRING*2];
+    sc_workspace * workspace;
+    int i, p;
+
+    if ((no_of_workspaces < 1) || (no_of_workspaces > SC_MAX_WORKSPACES))
+        return 1;
+
+    if (!directory_exists(repos_dir))
+        return 2;
+
+    memset((void*)pool, '\0', sizeof(sc_workspace_pool));
+    if ((snprintf(pool->repos_dir, sizeof(pool->repos_dir), "%s",
+                  repos_dir) >= (int)sizeof(pool->repos_dir)) ||
+        (snprintf(pool->workspaces_dir, sizeof(pool->workspaces_dir), "%s",
+                  workspaces_dir) >= (int)sizeof(pool->workspaces_dir)))
+        return 5;
+
+    pool->workspace =
+        (sc_workspace*)malloc(no_of_workspaces*sizeof(sc_workspace));
+    if (pool->workspace == NULL)
+        return 3;
+    pool->no_of_workspaces = no_of_workspaces;
+
+    for (i = 0; i < no_of_workspaces; i++) {
+        workspace = &pool->workspace[i];
+        workspace->in_use = 0;
+        for (p = 0; p < SC_MAX_SYSTEM_SIZE; p++)
+            workspace->version_index[p] = -1;
+
+        /* paths which would be truncated can't be used */
+        if ((snprintf(workspace->directory, sizeof(workspace->directory),
+                      "%s/workspace%d", workspaces_dir, i) >=
+             (int)sizeof(workspace->directory)) ||
+            (snprintf(workspace->install_prefix,
+                      sizeof(workspace->install_prefix), "%s/install",
+                      workspace->directory) >=
+             (int)sizeof(workspace->install_prefix))) {
+            free(pool->workspace);
+            pool->workspace = NULL;
+            return 5;
+        }
+
+        snprintf(src_directory, sizeof(src_directory), "%s/src",
+                 workspace->directory);
+        char * argv[] = {
+            "mkdir", "-p", src_directory, workspace->install_prefix, NULL
+        };
+        process_run(argv, 0, 0);
+        if (!directory_exists(workspace->install_prefix)) {
+            free(pool->workspace);
+            pool->workspace = NULL;
+            return 4;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Removes all workspaces and their worktrees
+ * @param pool The workspace pool
+ * @param sys The system whose programs were checked out
+ */
+void workspace_pool_free(sc_workspace_pool * pool, sc_system * sys)
+{
+    char repo_dir[SC_MAX_STRING*2];
+    char directory[SC_MAX_STRING*2];
+    char * remove_argv[] = {
+        "git", "-C", repo_dir, "worktree", "remove", "--force", directory, NULL
+    };
+    char * prune_argv[] = { "git", "-C", repo_dir, "worktree", "prune", NULL };
+    int i, p;
+
+    if (pool->workspace == NULL)
+        return;
+
+    for (i = 0; i < pool->no_of_workspaces; i++) {
+        char * rm_argv[] = { "rm", "-rf", pool->workspace[i].directory, NULL };
+
+        for (p = 0; p < sys->no_of_programs; p++) {
+            workspace_program_directory(pool, i, sys, p, directory);
+            if (!directory_exists(directory))
+                continue;
+            sprintf(repo_dir, "%s/%s",
+                    pool->repos_dir, string_pool_get(sys->program[p].name));
+            process_run(remove_argv, 0, 1);
+        }
+
+        process_run(rm_argv, 0, 0);
+    }
+
+    /* tidy up any worktree administrative files left behind */
+    for (p = 0; p < sys->no_of_programs; p++) {
+        sprintf(repo_dir, "%s/%s",
+                pool->repos_dir, string_pool_get(sys->program[p].name));
+        process_run(prune_argv, 0, 1);
+    }
+
+    /* only removed if nothing else was placed there */
+    rmdir(pool->workspaces_dir);
+
+    free(pool->workspace);
+    pool->workspace = NULL;
+    pool->no_of_workspaces = 0;
+}
+
+/**
+ * @brief Takes a free workspace from the pool for an evaluation.
+ *        The install prefix of the workspace is emptied, but any
+ *        checked out sources remain so that they can be reused.
+ * @param pool The workspace pool
+ * @returns Array index of the workspace, or -1 if none are free
+ */
+int workspace_acquire(sc_workspace_pool * pool)
+{
+    int i, index = -1;
+
+#pragma omp critical (workspace_pool)
+    {
+        for (i = 0; i < pool->no_of_workspaces; i++) {
+            if (!pool->workspace[i].in_use) {
+                pool->workspace[i].in_use = 1;
+                index = i;
+                break;
+            }
+        }
+    }
+
+    if (index < 0)
+        return -1;
+
+    /* nothing is installed at the start of an evaluation */
+    char * rm_argv[] = {
+        "rm", "-rf", pool->workspace[index].install_prefix, NULL
+    };
+    char * mkdir_argv[] = {
+        "mkdir", "-p", pool->workspace[index].install_prefix, NULL
+    };
+    if (process_run(rm_argv, 0, 0) == 0)
+        process_run(mkdir_argv, 0, 0);
+
+    return index;
+}
+
+/**
+ * @brief Returns a workspace to the pool
+ * @param pool The workspace pool
+ * @param index Array index of the workspace
+ */
+void workspace_release(sc_workspace_pool * pool, int index)
+{
+    if ((index < 0) || (index >= pool->no_of_workspaces))
+        return;
+
+#pragma omp critical (workspace_pool)
+    {
+        pool->workspace[index].in_use = 0;
+    }
+}
+
+/**
+ * @brief Returns the directory within a workspace where the source
+ *        for a program is checked out
+ * @param pool The workspace pool
+ * @param index Array index of the workspace
+ * @param sys System object
+ * @param program_index Array index of the program within the system
+ * @param directory Returned directory
+ * @returns zero on success
+ */
+int workspace_program_directory(sc_workspace_pool * pool, int index,
+                                sc_system * sys, int program_index,
+                                char * directory)
+{
+    if ((index < 0) || (index >= pool->no_of_workspaces))
+        return 1;
+
+    if ((program_index < 0) || (program_index >= sys->no_of_programs))
+        return 2;
+
+    sprintf(directory, "%s/src/%s",
+            pool->workspace[index].directory,
+            string_pool_get(sys->program[program_index].name));
+
+    return 0;
+}
+
+/**
+ * @brief Checks out the installed programs of a system state within a
+ *        workspace. Programs already at the required version are left
+ *        alone, so moving between similar states is cheap.
+ * @param pool The workspace pool
+ * @param index Array index of the workspace
+ * @param sys System object
+ * @param state Packed system state
+ * @returns zero on success
+ */
+int workspace_checkout(sc_workspace_pool * pool, int index,
+                       sc_system * sys, unsigned char * state)
+{
+    char repo_dir[SC_MAX_STRING*2];
+    char directory[SC_MAX_STRING*2];
+    char commit[SC_MAX_STRING], current_commit[SC_MAX_STRING];
+    char * add_argv[] = {
+        "git", "-C", repo_dir, "worktree", "add", "--detach", "--quiet",
+        directory, commit, NULL
+    };
+    char * checkout_argv[] = {
+        "git", "-C", directory, "checkout", "--detach", "--quiet", commit, NULL
+    };
+    sc_workspace * workspace;
+    int p, version_index;
+
+    if ((index < 0) || (index >= pool->no_of_workspaces))
+        return 1;
+
+    workspace = &pool->workspace[index];
+
+    for (p = 0; p < sys->no_of_programs; p++) {
+        if (!state_get_installed(sys, state, p))
+            continue;
+
+        version_index = state_get_version(sys, state, p);
+        if (workspace->version_index[p] == version_index)
+            continue;
+
+        if (program_version_from_index(&sys->program[p],
+                                       version_index, commit) != 0)
+            return 2;
+
+        workspace_program_directory(pool, index, sys, p, directory);
+
+        if (!directory_exists(directory)) {
+            /* Adding worktrees updates the administrative files of the
+               original repo, so only one is added at a time */
+            sprintf(repo_dir, "%s/%s",
+                    pool->repos_dir, string_pool_get(sys->program[p].name));
+#pragma omp critical (workspace_worktree)
+            {
+                process_run(add_argv, 0, 1);
+            }
+        }
+        else {
+            process_run(checkout_argv, 0, 1);
+        }
+
+        /* check that the expected commit is checked out */
+        if (program_repo_get_current_checkout(directory, current_commit) != 0)
+            return 3;
+        if (strcmp(current_commit, commit) != 0) {
+            workspace->version_index[p] = -1;
+            return 4;
+        }
+
+        workspace->version_index[p] = version_index;
+    }
+
+    return 0;
+}
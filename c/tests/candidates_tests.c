@@ -0,0 +1,248 @@
+/*
+  Smart search for upgrade paths
+  Copyright (C) 2016 Andrew Leeming <andrew.leeming@codethink.co.uk> and
+  Bob Mottram <bob.mottram@codethink.co.uk>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include "../src/scalam.h"
+
+/**
+ * @brief Creates a git repo with ten versions in the first parent history
+ *        of master. Version 3 has a lightweight tag, version 6 an annotated
+ *        tag and version 8 merges a branch
+ * @param repo_dir Directory of the repo
+ */
+static void test_candidates_create_repo(char * repo_dir)
+{
+    char commandstr[SC_MAX_STRING*4];
+    int c;
+
+    sprintf(commandstr,
+            "git init -q -b master %s && "
+            "git -C %s config user.email test@scalam && "
+            "git -C %s config user.name scalam",
+            repo_dir, repo_dir, repo_dir);
+    run_shell_command(commandstr);
+
+    for (c = 0; c < 10; c++) {
+        if (c == 8) {
+            sprintf(commandstr,
+                    "git -C %s checkout -q -b feature && "
+                    "echo feature > %s/feature && git -C %s add feature && "
+                    "git -C %s commit -q -m feature && "
+                    "git -C %s checkout -q master && "
+                    "git -C %s merge -q --no-ff -m merge feature",
+                    repo_dir, repo_dir, repo_dir, repo_dir, repo_dir, repo_dir);
+            run_shell_command(commandstr);
+            continue;
+        }
+        sprintf(commandstr,
+                "echo %d > %s/version && git -C %s add version && "
+                "git -C %s commit -q -m \"version %d\"",
+                c, repo_dir, repo_dir, repo_dir, c);
+        run_shell_command(commandstr);
+
+        if (c == 3) {
+            sprintf(commandstr, "git -C %s tag v1", repo_dir);
+            run_shell_command(commandstr);
+        }
+        if (c == 6) {
+            sprintf(commandstr, "git -C %s tag -a -m release v2", repo_dir);
+            run_shell_command(commandstr);
+        }
+    }
+}
+
+/**
+ * @brief Restricts a copy of a program to its candidates, checking that
+ *        they are the expected original version indexes
+ */
+static void test_candidates_expect(sc_program * original, int start_index,
+                                   int reference_index,
+                                   sc_candidate_options * options,
+                                   int * expected, int no_of_expected)
+{
+    sc_program prog = *original;
+    char version[SC_MAX_STRING];
+    char expected_version[SC_MAX_STRING];
+    int i, start_candidate = -1;
+
+    assert(candidates_program(&prog, start_index, reference_index,
+                              options) == 0);
+    assert(prog.no_of_versions == no_of_expected);
+    assert(prog.versions_file != original->versions_file);
+
+    for (i = 0; i < no_of_expected; i++) {
+        assert(program_version_from_index(&prog, i, version) == 0);
+        assert(program_version_from_index(original, expected[i],
+                                          expected_version) == 0);
+        assert(strcmp(version, expected_version) == 0);
+        if (expected[i] == start_index)
+            start_candidate = i;
+    }
+    assert(prog.version_index == start_candidate);
+}
+
+void test_candidates_program()
+{
+    char template[] = "/tmp/scalam.XXXXXX";
+    char * repo_dir = mkdtemp(template);
+    char commandstr[SC_MAX_STRING*2];
+    sc_candidate_options options;
+    sc_program prog;
+    int all[] = { 2, 3, 4, 5, 6, 7, 8, 9 };
+    int tags[] = { 2, 3, 6, 9 };
+    int merges[] = { 2, 8, 9 };
+    int every[] = { 2, 5, 8, 9 };
+    int downgrade[] = { 1, 3, 6 };
+
+    printf("test_candidates_program...");
+
+    test_candidates_create_repo(repo_dir);
+    memset((void*)&prog, '\0', sizeof(sc_program));
+    prog.name = string_pool_add("candidates");
+    assert(program_repo_get_commits(repo_dir, &prog) == 0);
+    assert(prog.no_of_versions == 10);
+
+    candidates_options_init(&options);
+    test_candidates_expect(&prog, 2, 9, &options, all, 8);
+
+    options.thinning = SC_CANDIDATES_TAGS;
+    test_candidates_expect(&prog, 2, 9, &options, tags, 4);
+
+    options.thinning = SC_CANDIDATES_MERGES;
+    test_candidates_expect(&prog, 2, 9, &options, merges, 3);
+
+    options.thinning = SC_CANDIDATES_EVERY_NTH;
+    options.every = 3;
+    test_candidates_expect(&prog, 2, 9, &options, every, 4);
+
+    /* the reference may be older than the start */
+    options.thinning = SC_CANDIDATES_TAGS;
+    test_candidates_expect(&prog, 6, 1, &options, downgrade, 3);
+
+    /* invalid options */
+    options.thinning = SC_CANDIDATES_EVERY_NTH;
+    options.every = 0;
+    assert(candidates_program(&prog, 2, 9, &options) != 0);
+    candidates_options_init(&options);
+    assert(candidates_program(&prog, 2, 10, &options) != 0);
+    assert(candidates_program(&prog, -1, 9, &options) != 0);
+
+    sprintf(commandstr, "rm -rf %s", repo_dir);
+    run_shell_command(commandstr);
+
+    printf("Ok\n");
+}
+
+void test_candidates_system()
+{
+    char template[] = "/tmp/scalam.XXXXXX";
+    char * tempdir = mkdtemp(template);
+    char commandstr[SC_MAX_STRING*2];
+    char versions_file[SC_MAX_STRING*2];
+    char version[SC_MAX_STRING];
+    sc_system * sys = (sc_system*)malloc(sizeof(sc_system));
+    sc_candidate_options options;
+    sc_goal goal;
+    FILE * fp;
+    int p, v;
+
+    printf("test_candidates_system...");
+
+    /* programs with versions from changelogs, which are not git repos.
+       The first has 300 versions, so needs two bytes per version index */
+    memset((void*)sys, '\0', sizeof(sc_system));
+    for (p = 0; p < 2; p++) {
+        sys->program[p].name = string_pool_printf("program%d", p);
+        sprintf(versions_file, "%s/program%d", tempdir, p);
+        mkdir(versions_file, 0700);
+        strcat(versions_file, "/versions.txt");
+        sys->program[p].versions_file = string_pool_add(versions_file);
+        sys->program[p].no_of_versions = (p == 0) ? 300 : 20;
+        sys->program[p].version_index = (p == 0) ? 250 : 19;
+        sys->program[p].installed = 1;
+
+        fp = fopen(versions_file, "w");
+        assert(fp != NULL);
+        for (v = sys->program[p].no_of_versions - 1; v >= 0; v--)
+            fprintf(fp, "%d.%d\n", p, v);
+        fclose(fp);
+    }
+    sys->no_of_programs = 2;
+    system_index_names(sys);
+    assert(state_layout_create(sys) == 0);
+    assert(sys->version_width[0] == 2);
+
+    candidates_options_init(&options);
+    options.thinning = SC_CANDIDATES_TAGS;
+
+    /* if any program fails then none of them are restricted */
+    sys->program[2].name = string_pool_add("missing");
+    sprintf(versions_file, "%s/missing/versions.txt", tempdir);
+    sys->program[2].versions_file = string_pool_add(versions_file);
+    sys->program[2].no_of_versions = 10;
+    sys->no_of_programs = 3;
+    assert(state_layout_create(sys) == 0);
+    assert(candidates_system(sys, &options) != 0);
+    assert(sys->program[0].no_of_versions == 300);
+    assert(sys->program[0].version_index == 250);
+    sprintf(versions_file, "%s/program0/versions.txt", tempdir);
+    assert(strcmp(string_pool_get(sys->program[0].versions_file),
+                  versions_file) == 0);
+    assert(sys->version_width[0] == 2);
+    sys->no_of_programs = 2;
+    assert(state_layout_create(sys) == 0);
+
+    /* changelog versions are all releases, so are all kept as tags */
+    assert(candidates_system(sys, &options) == 0);
+    assert(sys->program[0].no_of_versions == 50);
+    assert(sys->program[0].version_index == 0);
+    assert(sys->version_width[0] == 1);
+
+    /* programs already on their latest version have one candidate */
+    assert(sys->program[1].no_of_versions == 1);
+    assert(sys->program[1].version_index == 0);
+
+    /* the goal spans the candidates */
+    assert(goal_create_latest_versions(sys, &goal) == 0);
+    assert(goal.start.version_index[0] == 0);
+    assert(goal.reference.version_index[0] == 49);
+    assert(program_version_from_index(&sys->program[0],
+                                      goal.reference.version_index[0],
+                                      version) == 0);
+    assert(strcmp(version, "0.299") == 0);
+    assert(goal.distance[0] == 49);
+
+    /* restricting again keeps the same candidates */
+    assert(candidates_system(sys, &options) == 0);
+    assert(sys->program[0].no_of_versions == 50);
+    assert(program_version_from_index(&sys->program[0], 0, version) == 0);
+    assert(strcmp(version, "0.250") == 0);
+
+    sprintf(commandstr, "rm -rf %s", tempdir);
+    run_shell_command(commandstr);
+    free(sys);
+
+    printf("Ok\n");
+}
+
+void run_candidates_tests()
+{
+    test_candidates_program();
+    test_candidates_system();
+}
@@ -0,0 +1,380 @@
+/*
+  Smart search for upgrade paths
+  Copyright (C) 2016 Andrew Leeming <andrew.leeming@codethink.co.uk> and
+  Bob Mottram <bob.mottram@codethink.co.uk>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include "../src/scalam.h"
+
+static char * test_changelog_debian =
+    "scalam (1.2-1) unstable; urgency=medium\n"
+    "\n"
+    "  * New upstream release (2.0.1) mentioned in passing.\n"
+    "\n"
+    " -- Maintainer <maintainer@example.com>  Mon, 01 Jan 2018 00:00:00 +0000\n"
+    "\n"
+    "scalam (1.1-2) unstable; urgency=low\n"
+    "\n"
+    "  * Packaging fix.\n"
+    "\n"
+    " -- Maintainer <maintainer@example.com>  Mon, 01 Dec 2017 00:00:00 +0000\n"
+    "\n"
+    "scalam (1:1.0~rc1-1) experimental; urgency=low\n"
+    "\n"
+    "  * Initial release.\n";
+
+static char * test_changelog_spec =
+    "Name: scalam\n"
+    "Version: 1.23.4\n"
+    "\n"
+    "%description\n"
+    "* This line is not within the changelog 9.9\n"
+    "\n"
+    "%changelog\n"
+    "* Mon Jan 01 2018 Packager <packager@example.com> - 1.23.4-1\n"
+    "- Update to 1.23.4\n"
+    "\n"
+    "* Fri Dec 01 2017 Packager <packager@example.com> 1.22-2\n"
+    "- Rebuilt\n"
+    "* Wed Nov 01 2017 Packager <packager@example.com>\n"
+    "- An entry without a version\n"
+    "* Sun Oct 01 2017 Packager <packager@example.com> - 1.21-1\n";
+
+static char * test_changelog_news =
+    "GNU scalam NEWS\n"
+    "\n"
+    "* Noteworthy changes in release 2.1 (2021-02-13) [stable]\n"
+    "\n"
+    "** Bug fixes\n"
+    "  Fixed a crash when upgrading to 2.0.5\n"
+    "\n"
+    "## [v2.0.1] - 2020-05-01\n"
+    "Version 1.9.0rc1\n"
+    "Copyright (C) 2016-2021 Free Software Foundation\n"
+    "2019-03-01  Developer  <developer@example.com>\n"
+    "\n"
+    "\t* src/main.c: Released 1.8.1.\n"
+    "1.8 (2019-01-01)\n"
+    "Fixed in 1.9.0rc1 as well\n"
+    "1. A numbered list is not a version\n";
+
+void test_changelog_format()
+{
+    printf("test_changelog_format...");
+
+    assert(changelog_format_from_filename("a/debian/changelog") ==
+           SC_CHANGELOG_DEBIAN);
+    assert(changelog_format_from_filename("changelog.Debian.gz") ==
+           SC_CHANGELOG_DEBIAN);
+    assert(changelog_format_from_filename("pkg/scalam.spec") ==
+           SC_CHANGELOG_RPM);
+    assert(changelog_format_from_filename("NEWS") == SC_CHANGELOG_UNKNOWN);
+
+    assert(changelog_format_from_text(test_changelog_debian,
+                                      strlen(test_changelog_debian)) ==
+           SC_CHANGELOG_DEBIAN);
+    assert(changelog_format_from_text(test_changelog_spec,
+                                      strlen(test_changelog_spec)) ==
+           SC_CHANGELOG_RPM);
+    assert(changelog_format_from_text(test_changelog_news,
+                                      strlen(test_changelog_news)) ==
+           SC_CHANGELOG_NEWS);
+
+    printf("Ok\n");
+}
+
+void test_changelog_parse()
+{
+    sc_changelog changelog;
+
+    printf("test_changelog_parse...");
+
+    changelog_init(&changelog);
+    assert(changelog_parse(&changelog, test_changelog_debian,
+                           strlen(test_changelog_debian),
+                           SC_CHANGELOG_UNKNOWN) == 0);
+    assert(changelog.format == SC_CHANGELOG_DEBIAN);
+    assert(changelog.no_of_versions == 3);
+    assert(strcmp(string_pool_get(changelog.version[0]), "1.2-1") == 0);
+    assert(strcmp(string_pool_get(changelog.version[1]), "1.1-2") == 0);
+    assert(strcmp(string_pool_get(changelog.version[2]), "1:1.0~rc1-1") == 0);
+    changelog_free(&changelog);
+
+    changelog_init(&changelog);
+    assert(changelog_parse(&changelog, test_changelog_spec,
+                           strlen(test_changelog_spec),
+                           SC_CHANGELOG_UNKNOWN) == 0);
+    assert(changelog.format == SC_CHANGELOG_RPM);
+    assert(changelog.no_of_versions == 3);
+    assert(strcmp(string_pool_get(changelog.version[0]), "1.23.4-1") == 0);
+    assert(strcmp(string_pool_get(changelog.version[1]), "1.22-2") == 0);
+    assert(strcmp(string_pool_get(changelog.version[2]), "1.21-1") == 0);
+    changelog_free(&changelog);
+
+    /* repeated versions only count the first time */
+    changelog_init(&changelog);
+    assert(changelog_parse(&changelog, test_changelog_news,
+                           strlen(test_changelog_news),
+                           SC_CHANGELOG_UNKNOWN) == 0);
+    assert(changelog.format == SC_CHANGELOG_NEWS);
+    assert(changelog.no_of_versions == 4);
+    assert(strcmp(string_pool_get(changelog.version[0]), "2.1") == 0);
+    assert(strcmp(string_pool_get(changelog.version[1]), "2.0.1") == 0);
+    assert(strcmp(string_pool_get(changelog.version[2]), "1.9.0rc1") == 0);
+    assert(strcmp(string_pool_get(changelog.version[3]), "1.8") == 0);
+    changelog_free(&changelog);
+
+    /* nothing to read */
+    changelog_init(&changelog);
+    assert(changelog_parse(&changelog, "", 0, SC_CHANGELOG_UNKNOWN) == 0);
+    assert(changelog.no_of_versions == 0);
+    changelog_free(&changelog);
+
+    printf("Ok\n");
+}
+
+/**
+ * @brief Writes a file within a directory
+ */
+static void test_changelog_write(char * directory, char * name, char * text)
+{
+    char filename[SC_MAX_STRING*2];
+    FILE * fp;
+
+    assert(snprintf(filename, sizeof(filename), "%s/%s", directory, name) <
+           (int)sizeof(filename));
+    fp = fopen(filename, "w");
+    assert(fp != NULL);
+    fprintf(fp, "%s", text);
+    fclose(fp);
+}
+
+void test_changelog_read_tarball()
+{
+    char tempdir[SC_MAX_STRING];
+    char commandstr[SC_MAX_STRING*4];
+    char filename[SC_MAX_STRING*2];
+    char tarball[SC_MAX_STRING*2];
+    char line[SC_MAX_STRING];
+    sc_changelog changelog;
+    sc_program prog;
+
+    printf("test_changelog_read_tarball...");
+
+    assert(snprintf(tempdir, sizeof(tempdir), "/tmp/scalam_changelog.XXXXXX") <
+           (int)sizeof(tempdir));
+    assert(mkdtemp(tempdir) != NULL);
+
+    /* a GNU ChangeLog without versions, and NEWS further down */
+    assert(snprintf(commandstr, sizeof(commandstr),
+                    "mkdir -p %s/scalam-2.1/doc", tempdir) <
+           (int)sizeof(commandstr));
+    run_shell_command(commandstr);
+    assert(snprintf(filename, sizeof(filename), "%s/scalam-2.1", tempdir) <
+           (int)sizeof(filename));
+    test_changelog_write(filename, "ChangeLog",
+                         "2019-03-01  Developer  <developer@example.com>\n");
+    assert(snprintf(filename, sizeof(filename), "%s/scalam-2.1/doc", tempdir) <
+           (int)sizeof(filename));
+    test_changelog_write(filename, "NEWS", test_changelog_news);
+
+    assert(snprintf(tarball, sizeof(tarball),
+                    "%s/scalam-2.1.tar.gz", tempdir) <
+           (int)sizeof(tarball));
+    assert(snprintf(commandstr, sizeof(commandstr),
+                    "tar -czf %s -C %s scalam-2.1", tarball, tempdir) <
+           (int)sizeof(commandstr));
+    run_shell_command(commandstr);
+
+    changelog_init(&changelog);
+    assert(changelog_read_tarball(&changelog, tarball) == 0);
+    assert(changelog.no_of_versions == 4);
+    changelog_free(&changelog);
+
+    /* a debian changelog is preferred */
+    assert(snprintf(commandstr, sizeof(commandstr),
+                    "mkdir -p %s/scalam-2.1/debian", tempdir) <
+           (int)sizeof(commandstr));
+    run_shell_command(commandstr);
+    assert(snprintf(filename, sizeof(filename),
+                    "%s/scalam-2.1/debian", tempdir) <
+           (int)sizeof(filename));
+    test_changelog_write(filename, "changelog", test_changelog_debian);
+    assert(snprintf(commandstr, sizeof(commandstr),
+                    "tar -cJf %s/scalam.tar.xz -C %s scalam-2.1",
+                    tempdir, tempdir) <
+           (int)sizeof(commandstr));
+    run_shell_command(commandstr);
+
+    memset((void*)&prog, '\0', sizeof(sc_program));
+    prog.name = string_pool_add("scalam");
+    assert(snprintf(tarball, sizeof(tarball), "%s/scalam.tar.xz", tempdir) <
+           (int)sizeof(tarball));
+    assert(program_get_versions_from_repo(tempdir, tarball, &prog, NULL) == 0);
+    assert(prog.no_of_versions == 3);
+    assert(snprintf(filename, sizeof(filename),
+                    "%s/scalam/versions.txt", tempdir) <
+           (int)sizeof(filename));
+    assert(strcmp(string_pool_get(prog.versions_file), filename) == 0);
+    assert(lines_in_file(filename) == 3);
+
+    /* version index zero is the oldest */
+    assert(program_version_from_index(&prog, 0, line) == 0);
+    assert(strcmp(line, "1:1.0~rc1-1") == 0);
+    assert(program_version_from_index(&prog, 2, line) == 0);
+    assert(strcmp(line, "1.2-1") == 0);
+
+    /* the tarball was only read, not extracted */
+    assert(snprintf(filename, sizeof(filename), "%s/scalam/debian", tempdir) <
+           (int)sizeof(filename));
+    assert(!directory_exists(filename));
+
+    /* no changelog */
+    assert(snprintf(commandstr, sizeof(commandstr),
+                    "tar -czf %s/empty.tar.gz -C %s scalam", tempdir, tempdir) <
+           (int)sizeof(commandstr));
+    run_shell_command(commandstr);
+    assert(snprintf(tarball, sizeof(tarball), "%s/empty.tar.gz", tempdir) <
+           (int)sizeof(tarball));
+    changelog_init(&changelog);
+    assert(changelog_read_tarball(&changelog, tarball) != 0);
+    changelog_free(&changelog);
+
+    assert(snprintf(commandstr, sizeof(commandstr), "rm -rf %s", tempdir) <
+           (int)sizeof(commandstr));
+    run_shell_command(commandstr);
+
+    printf("Ok\n");
+}
+
+void test_changelog_read_deb_package()
+{
+    char tempdir[SC_MAX_STRING];
+    char commandstr[SC_MAX_STRING*4];
+    char filename[SC_MAX_STRING*2];
+    char package[SC_MAX_STRING*2];
+    sc_program prog;
+
+    printf("test_changelog_read_deb_package...");
+
+    if (!software_installed("dpkg-deb")) {
+        printf("Skipped\n");
+        return;
+    }
+
+    assert(snprintf(tempdir, sizeof(tempdir), "/tmp/scalam_changelog.XXXXXX") <
+           (int)sizeof(tempdir));
+    assert(mkdtemp(tempdir) != NULL);
+
+    assert(snprintf(commandstr, sizeof(commandstr),
+                    "mkdir -p %s/pkg/DEBIAN %s/pkg/usr/share/doc/scalam && "
+                    "printf 'Package: scalam\\nVersion: 1.2-1\\nArchitecture: all\\n"
+                    "Maintainer: Maintainer <maintainer@example.com>\\n"
+                    "Description: test\\n' > %s/pkg/DEBIAN/control",
+                    tempdir, tempdir, tempdir) <
+           (int)sizeof(commandstr));
+    run_shell_command(commandstr);
+    assert(snprintf(filename, sizeof(filename),
+                    "%s/pkg/usr/share/doc/scalam", tempdir) <
+           (int)sizeof(filename));
+    test_changelog_write(filename, "changelog.Debian", test_changelog_debian);
+    assert(snprintf(commandstr, sizeof(commandstr),
+                    "gzip -9 %s/changelog.Debian && "
+                    "dpkg-deb --build %s/pkg %s/scalam_1.2-1_all.deb > /dev/null",
+                    filename, tempdir, tempdir) <
+           (int)sizeof(commandstr));
+    run_shell_command(commandstr);
+
+    memset((void*)&prog, '\0', sizeof(sc_program));
+    prog.name = string_pool_add("scalam");
+    assert(snprintf(package, sizeof(package),
+                    "%s/scalam_1.2-1_all.deb", tempdir) <
+           (int)sizeof(package));
+    assert(program_get_versions_from_repo(tempdir, package, &prog, NULL) == 0);
+    assert(prog.no_of_versions == 3);
+    assert(snprintf(filename, sizeof(filename),
+                    "%s/scalam/versions.txt", tempdir) <
+           (int)sizeof(filename));
+    assert(lines_in_file(filename) == 3);
+
+    assert(snprintf(commandstr, sizeof(commandstr), "rm -rf %s", tempdir) <
+           (int)sizeof(commandstr));
+    run_shell_command(commandstr);
+
+    printf("Ok\n");
+}
+
+void test_changelog_read()
+{
+    char tempdir[SC_MAX_STRING];
+    char commandstr[SC_MAX_STRING*4];
+    char filename[SC_MAX_STRING*2];
+    sc_changelog changelog;
+    sc_program prog;
+
+    printf("test_changelog_read...");
+
+    assert(snprintf(tempdir, sizeof(tempdir), "/tmp/scalam_changelog.XXXXXX") <
+           (int)sizeof(tempdir));
+    assert(mkdtemp(tempdir) != NULL);
+
+    /* compressed spec file */
+    test_changelog_write(tempdir, "scalam.spec", test_changelog_spec);
+    assert(snprintf(commandstr, sizeof(commandstr),
+                    "gzip %s/scalam.spec", tempdir) <
+           (int)sizeof(commandstr));
+    run_shell_command(commandstr);
+    assert(snprintf(filename, sizeof(filename), "%s/scalam.spec.gz", tempdir) <
+           (int)sizeof(filename));
+    changelog_init(&changelog);
+    assert(changelog_read(&changelog, filename) == 0);
+    assert(changelog.format == SC_CHANGELOG_RPM);
+    assert(changelog.no_of_versions == 3);
+    changelog_free(&changelog);
+
+    /* the versions file is created next to the changelog */
+    test_changelog_write(tempdir, "NEWS", test_changelog_news);
+    assert(snprintf(filename, sizeof(filename), "%s/NEWS", tempdir) <
+           (int)sizeof(filename));
+    memset((void*)&prog, '\0', sizeof(sc_program));
+    prog.name = string_pool_add("scalam");
+    assert(program_get_versions_from_changelog(filename, &prog) == 0);
+    assert(prog.no_of_versions == 4);
+    assert(snprintf(filename, sizeof(filename), "%s/versions.txt", tempdir) <
+           (int)sizeof(filename));
+    assert(strcmp(string_pool_get(prog.versions_file), filename) == 0);
+
+    /* the versions file already exists */
+    assert(snprintf(filename, sizeof(filename), "%s/NEWS", tempdir) <
+           (int)sizeof(filename));
+    assert(program_get_versions_from_changelog(filename, &prog) == 6);
+
+    assert(snprintf(commandstr, sizeof(commandstr), "rm -rf %s", tempdir) <
+           (int)sizeof(commandstr));
+    run_shell_command(commandstr);
+
+    printf("Ok\n");
+}
+
+void run_changelog_tests()
+{
+    test_changelog_format();
+    test_changelog_parse();
+    test_changelog_read();
+    test_changelog_read_tarball();
+    test_changelog_read_deb_package();
+}
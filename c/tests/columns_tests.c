@@ -0,0 +1,222 @@
+/*
+  Smart search for upgrade paths
+  Copyright (C) 2016 Andrew Leeming <andrew.leeming@codethink.co.uk> and
+  Bob Mottram <bob.mottram@codethink.co.uk>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include "../src/scalam.h"
+
+void test_population_columns_statistics()
+{
+    sc_system system_definition;
+    sc_goal goal;
+    sc_population population;
+    char * repo_dir;
+    char template[] = "/tmp/scalam.XXXXXX";
+    char commandstr[SC_MAX_STRING];
+    unsigned int random_seed = 3461;
+    int i, gen, population_size = 50;
+    float average, variance;
+    int best, worst;
+
+    printf("test_population_columns_statistics...");
+
+    /* create a test directory which will contain repos */
+    repo_dir = mkdtemp(template);
+
+    /* make a test system with some repositories */
+    assert(test_create_system(&system_definition, repo_dir) == 0);
+
+    /* make a goal to get to the latest commits */
+    assert(goal_create_latest_versions(&system_definition, &goal) == 0);
+
+    assert(population_create(population_size, &population,
+                             &system_definition, &goal) == 0);
+
+    assert(population_columns_enable(&population) == 0);
+    assert(population.columns != NULL);
+
+    for (gen = 0; gen < 5; gen++) {
+        for (i = 0; i < population_size; i++) {
+            assert(population_set_test_passes(&population, i,
+                                              1 + rand_num(&random_seed) % 100) == 0);
+        }
+
+        /* statistics from the columns */
+        average = population_average_score(&population);
+        variance = population_variance(&population);
+        best = population_best_index(&population);
+        worst = population_worst_index(&population);
+
+        /* the score column matches the genomes */
+        for (i = 0; i < population_size; i++)
+            assert(population.columns->score[i] ==
+                   population.individual[i]->score);
+
+        /* the same statistics calculated from the genomes themselves */
+        population_columns_free(&population);
+        assert(population.columns == NULL);
+        assert(fabs(population_average_score(&population) - average) < 0.0001f);
+        assert(fabs(population_variance(&population) - variance) < 0.0001f);
+        assert(population_best_index(&population) == best);
+        assert(population_worst_index(&population) == worst);
+        assert(population_columns_enable(&population) == 0);
+
+        assert(population_next_generation(&population) == 0);
+    }
+
+    population_free(&population);
+
+    sprintf(commandstr,"rm -rf %s", repo_dir);
+    run_shell_command(commandstr);
+
+    printf("Ok\n");
+}
+
+void test_population_columns_installs()
+{
+    sc_system system_definition;
+    sc_goal goal;
+    sc_population population;
+    char * repo_dir;
+    char template[] = "/tmp/scalam.XXXXXX";
+    char commandstr[SC_MAX_STRING];
+    int i, p, step, ctr, population_size = 50;
+    int genome_index[50];
+
+    printf("test_population_columns_installs...");
+
+    /* create a test directory which will contain repos */
+    repo_dir = mkdtemp(template);
+
+    /* make a test system with some repositories */
+    assert(test_create_system(&system_definition, repo_dir) == 0);
+
+    /* make a goal to get to the latest commits */
+    assert(goal_create_latest_versions(&system_definition, &goal) == 0);
+
+    assert(population_create(population_size, &population,
+                             &system_definition, &goal) == 0);
+
+    /* columns must be enabled first */
+    assert(population_columns_installs(&population, 0, 0, NULL) < 0);
+
+    assert(population_columns_enable(&population) == 0);
+
+    for (step = 0; step < SC_MAX_CHANGE_SEQUENCE; step++) {
+        for (p = 0; p < population.sys.no_of_programs; p++) {
+            ctr = population_columns_installs(&population, step, p,
+                                              genome_index);
+            assert(ctr >= 0);
+
+            /* compare against walking through the genomes */
+            for (i = 0; i < ctr; i++) {
+                assert(population.individual[genome_index[i]]->steps > step);
+                assert(state_get_installed(&population.sys,
+                                           genome_state(&population,
+                                                        population.individual[genome_index[i]],
+                                                        step), p));
+            }
+            for (i = 0; i < population_size; i++) {
+                if ((population.individual[i]->steps > step) &&
+                    (state_get_installed(&population.sys,
+                                         genome_state(&population,
+                                                      population.individual[i],
+                                                      step), p)))
+                    ctr--;
+            }
+            assert(ctr == 0);
+        }
+    }
+
+    /* out of range */
+    assert(population_columns_installs(&population, -1, 0, NULL) < 0);
+    assert(population_columns_installs(&population, 0,
+                                       population.sys.no_of_programs,
+                                       NULL) < 0);
+
+    population_free(&population);
+
+    sprintf(commandstr,"rm -rf %s", repo_dir);
+    run_shell_command(commandstr);
+
+    printf("Ok\n");
+}
+
+void test_population_columns_sort()
+{
+    sc_population * population = (sc_population*)malloc(sizeof(sc_population));
+    unsigned int random_seed = 7193;
+    int i, sort, step, p, population_size = 30;
+    size_t column;
+    sc_genome * individual;
+    float best_score;
+
+    printf("test_population_columns_sort...");
+
+    assert(test_population_from_memory(population, population_size) == 0);
+    assert(population_columns_enable(population) == 0);
+
+    for (sort = 0; sort < 2; sort++) {
+        for (i = 0; i < population_size; i++) {
+            assert(population_set_test_passes(population, i,
+                                              1 + rand_num(&random_seed) % 100) == 0);
+            population->individual[i]->spawning_probability =
+                (rand_num(&random_seed) % 1000) / 1000.0f;
+        }
+
+        /* both sorts reorder the genomes */
+        if (sort == 0)
+            assert(population_sort(population) == 0);
+        else
+            assert(population_pareto_sort(population) == 0);
+
+        /* the columns are in the same order as the genomes */
+        for (i = 0; i < population_size; i++) {
+            individual = population->individual[i];
+            assert(population->columns->score[i] == individual->score);
+            assert(population->columns->steps[i] == individual->steps);
+            for (step = 0; step < individual->steps; step++) {
+                column = (size_t)step * population->columns->no_of_programs;
+                for (p = 0; p < population->sys.no_of_programs; p++, column++)
+                    assert(population->columns->version_index[column*population_size + i] ==
+                           state_get_version(&population->sys,
+                                             genome_state(population, individual, step), p));
+            }
+        }
+
+        /* statistics from the columns refer to the right genome */
+        best_score = 0;
+        for (i = 0; i < population_size; i++)
+            if (population->individual[i]->score > best_score)
+                best_score = population->individual[i]->score;
+        assert(population->individual[population_best_index(population)]->score ==
+               best_score);
+    }
+
+    population_free(population);
+    free(population);
+
+    printf("Ok\n");
+}
+
+void run_columns_tests()
+{
+    test_population_columns_statistics();
+    test_population_columns_installs();
+    test_population_columns_sort();
+}
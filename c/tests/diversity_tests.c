@@ -0,0 +1,238 @@
+/*
+  Smart search for upgrade paths
+  Copyright (C) 2016 Andrew Leeming <andrew.leeming@codethink.co.uk> and
+  Bob Mottram <bob.mottram@codethink.co.uk>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include "../src/scalam.h"
+
+/**
+ * @brief Makes every genome in the population the same as the first
+ * @param population The population object
+ */
+void test_diversity_clone_genomes(sc_population * population)
+{
+    int i;
+
+    for (i = 1; i < population->size; i++)
+        memcpy((void*)population->individual[i],
+               (void*)population->individual[0],
+               genome_size(population));
+}
+
+void test_genome_distance()
+{
+    sc_population * population = (sc_population*)malloc(sizeof(sc_population));
+    sc_genome * genome1, * genome2;
+    unsigned char * state;
+
+    printf("test_genome_distance...");
+
+    assert(test_population_from_memory(population, 10) == 0);
+
+    /* avoid the genome which goes straight to the goal */
+    genome1 = population->individual[0];
+    if (genome1->steps == 0)
+        genome1 = population->individual[1];
+    genome2 = population->individual[2];
+    if (genome2->steps == 0)
+        genome2 = population->individual[3];
+
+    /* distance to itself */
+    assert(genome_distance(population, genome1, genome1) == 0);
+
+    /* symmetric */
+    assert(genome_distance(population, genome1, genome2) ==
+           genome_distance(population, genome2, genome1));
+
+    /* a copy which differs by one gene */
+    memcpy((void*)genome2, (void*)genome1, genome_size(population));
+    state = genome_state(population, genome2, 0);
+    state_set_installed(&population->sys, state, 3,
+                        !state_get_installed(&population->sys, state, 3));
+    assert(genome_distance(population, genome1, genome2) == 1);
+
+    /* an extra step counts as every gene differing */
+    if (genome2->steps < SC_MAX_CHANGE_SEQUENCE) {
+        genome2->steps++;
+        assert(genome_distance(population, genome1, genome2) ==
+               1 + population->sys.no_of_programs);
+    }
+
+    population_free(population);
+    free(population);
+
+    printf("Ok\n");
+}
+
+void test_population_diversity_update()
+{
+    sc_population * population = (sc_population*)malloc(sizeof(sc_population));
+    unsigned int random_seed;
+
+    printf("test_population_diversity_update...");
+
+    assert(test_population_from_memory(population, 40) == 0);
+    random_seed = population->random_seed;
+
+    /* random genomes are diverse */
+    assert(population_diversity_update(population) == 0);
+    assert(population->diversity.unique_ratio == 1.0f);
+    assert(population->diversity.hamming > 0);
+    assert(population->diversity.hamming_normalised >
+           population->diversity_threshold);
+    assert(population->diversity.hamming_normalised <= 1.0f);
+    assert(population->diversity.entropy > 0);
+    assert(population_diversity_lost(population) == 0);
+
+    /* a single duplicate isn't a loss of diversity */
+    memcpy((void*)population->individual[1],
+           (void*)population->individual[0], genome_size(population));
+    assert(population_diversity_update(population) == 0);
+    assert(population->diversity.unique_ratio < 1.0f);
+    assert(population_diversity_lost(population) == 0);
+
+    /* measuring doesn't alter the course of the search */
+    assert(population->random_seed == random_seed);
+
+    /* the same using columns */
+    assert(population_columns_enable(population) == 0);
+    assert(population_diversity_update(population) == 0);
+    assert(population->diversity.entropy > 0);
+
+    /* identical genomes have no diversity */
+    test_diversity_clone_genomes(population);
+    assert(population_columns_update(population) == 0);
+    assert(population_diversity_update(population) == 0);
+    assert(population->diversity.unique_ratio * population->size < 1.5f);
+    assert(population->diversity.hamming == 0);
+    assert(population->diversity.hamming_normalised == 0);
+    assert(population->diversity.entropy == 0);
+    assert(population_diversity_lost(population) == 1);
+
+    population_free(population);
+    free(population);
+
+    printf("Ok\n");
+}
+
+void test_population_diversity_response()
+{
+    sc_population * population = (sc_population*)malloc(sizeof(sc_population));
+    int i;
+
+    printf("test_population_diversity_response...");
+
+    assert(test_population_from_memory(population, 30) == 0);
+
+    /* no variation in scores and no response is an error, as before */
+    test_diversity_clone_genomes(population);
+    for (i = 0; i < population->size; i++)
+        assert(population_set_test_passes(population, i, 10) == 0);
+    population->diversity_response = SC_DIVERSITY_RESPONSE_NONE;
+    assert(population_next_generation(population) == 1);
+
+    /* a partial restart brings back diversity */
+    population->diversity_response = SC_DIVERSITY_RESPONSE_RESTART;
+    assert(population_next_generation(population) == 0);
+    assert(population_diversity_update(population) == 0);
+    assert(population->diversity.unique_ratio == 1.0f);
+    assert(population->diversity.hamming_normalised >
+           population->diversity_threshold);
+
+    /* rebels */
+    test_diversity_clone_genomes(population);
+    for (i = 0; i < population->size; i++)
+        assert(population_set_test_passes(population, i, 10) == 0);
+    population->diversity_response = SC_DIVERSITY_RESPONSE_REBELS;
+    assert(population_next_generation(population) == 0);
+    assert(population_diversity_update(population) == 0);
+    assert(population->diversity.unique_ratio == 1.0f);
+
+    /* hypermutation only lasts for one generation */
+    test_diversity_clone_genomes(population);
+    population->diversity_response = SC_DIVERSITY_RESPONSE_HYPERMUTATE;
+    assert(population_next_generation(population) == 0);
+    assert(population->mutation_rate == (float)SC_DEFAULT_MUTATION_RATE);
+
+    /* stagnation triggers a response even when diverse */
+    population->stagnation_limit = 3;
+    population->stagnant_generations = 3;
+    population->diversity_threshold = 0;
+    assert(population_diversity_update(population) == 0);
+    assert(population_diversity_lost(population) == 2);
+
+    population_free(population);
+    free(population);
+
+    printf("Ok\n");
+}
+
+void test_population_diversity_mixed_steps()
+{
+    sc_population * population = (sc_population*)malloc(sizeof(sc_population));
+    float entropy;
+    int i;
+
+    printf("test_population_diversity_mixed_steps...");
+
+    assert(test_population_from_memory(population, 20) == 0);
+
+    for (i = 0; i < population->size; i++)
+        population->individual[i]->steps = 1;
+    assert(population_diversity_update(population) == 0);
+    entropy = population->diversity.entropy;
+    assert(entropy > 0);
+
+    /* steps which only one genome has can't be measured, so they
+       don't dilute the entropy of the steps which can */
+    population->individual[3]->steps = SC_MAX_CHANGE_SEQUENCE;
+    assert(population_diversity_update(population) == 0);
+    assert(fabs(population->diversity.entropy - entropy) < 0.0001f);
+
+    /* the same using columns */
+    assert(population_columns_enable(population) == 0);
+    assert(population_diversity_update(population) == 0);
+    assert(fabs(population->diversity.entropy - entropy) < 0.0001f);
+    population_columns_free(population);
+
+    /* with many long genomes the loci are sampled, but only from
+       steps which can be measured */
+    for (i = 0; i < 3; i++)
+        population->individual[i]->steps = SC_MAX_CHANGE_SEQUENCE;
+    assert(population_diversity_update(population) == 0);
+    assert(population->diversity.entropy > 0);
+
+    /* nothing to compare */
+    for (i = 1; i < population->size; i++)
+        population->individual[i]->steps = 0;
+    assert(population_diversity_update(population) == 0);
+    assert(population->diversity.entropy == 0);
+
+    population_free(population);
+    free(population);
+
+    printf("Ok\n");
+}
+
+void run_diversity_tests()
+{
+    test_genome_distance();
+    test_population_diversity_update();
+    test_population_diversity_mixed_steps();
+    test_population_diversity_response();
+}
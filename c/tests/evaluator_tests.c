@@ -0,0 +1,495 @@
+/*
+  Smart search for upgrade paths
+  Copyright (C) 2016 Andrew Leeming <andrew.leeming@codethink.co.uk> and
+  Bob Mottram <bob.mottram@codethink.co.uk>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include "../src/scalam.h"
+
+/* Counts calls made to the in-process backend */
+typedef struct {
+    int calls[SC_STAGES];
+    int failing_program;
+    int results;
+    int abort_after;
+    int delay_usec;
+} test_evaluator_context;
+
+/**
+ * @brief Sets the genome at the given index to a known two step sequence.
+ *        Step 0 installs programs 0 and 1. Step 1 changes the version
+ *        of program 0, keeps program 1 and installs program 2.
+ */
+static void test_evaluator_genome(sc_population * population, int index)
+{
+    sc_system * sys = &population->sys;
+    sc_genome * individual = population->individual[index];
+    unsigned char * state;
+
+    individual->steps = 2;
+    memset((void*)genome_state(population, individual, 0), '\0',
+           2*sys->state_bytes);
+
+    state = genome_state(population, individual, 0);
+    state_set_installed(sys, state, 0, 1);
+    state_set_version(sys, state, 0, 3);
+    state_set_installed(sys, state, 1, 1);
+    state_set_version(sys, state, 1, 5);
+
+    state = genome_state(population, individual, 1);
+    state_set_installed(sys, state, 0, 1);
+    state_set_version(sys, state, 0, 4);
+    state_set_installed(sys, state, 1, 1);
+    state_set_version(sys, state, 1, 5);
+    state_set_installed(sys, state, 2, 1);
+    state_set_version(sys, state, 2, 7);
+}
+
+static int test_evaluator_backend(void * context, sc_system * sys,
+                                  int stage, int program_index,
+                                  int version_index, char * source_dir,
+                                  char * install_prefix,
+                                  int * test_passes, int * test_failures)
+{
+    test_evaluator_context * ctx = (test_evaluator_context*)context;
+
+    /* the stub doesn't build anything, so doesn't need these */
+    (void)sys;
+    (void)version_index;
+    (void)source_dir;
+    (void)install_prefix;
+
+    ctx->calls[stage]++;
+
+    if (ctx->delay_usec > 0)
+        usleep(ctx->delay_usec);
+
+    if ((stage == SC_STAGE_BUILD) && (program_index == ctx->failing_program))
+        return 1;
+
+    if (stage == SC_STAGE_TEST) {
+        *test_passes = 5;
+        *test_failures = 1;
+    }
+    return 0;
+}
+
+static int test_evaluator_callback(void * context, int genome_index,
+                                   sc_program_result * result)
+{
+    test_evaluator_context * ctx = (test_evaluator_context*)context;
+
+    (void)genome_index;
+    (void)result;
+
+    ctx->results++;
+    return (ctx->results == ctx->abort_after);
+}
+
+void test_evaluator_install_steps()
+{
+    sc_population * population = (sc_population*)malloc(sizeof(sc_population));
+    sc_evaluation evaluation;
+    int expected[][3] = { {0, 0, 3}, {0, 1, 5}, {1, 0, 4}, {1, 2, 7} };
+    int i;
+
+    printf("test_evaluator_install_steps...");
+
+    assert(test_population_from_memory(population, 4) == 0);
+    test_evaluator_genome(population, 1);
+
+    assert(evaluation_create(&evaluation, population) == 0);
+    assert(evaluator_install_steps(population, 1, &evaluation) == 0);
+
+    /* unchanged programs are not installed again */
+    assert(evaluation.no_of_install_steps == 4);
+    for (i = 0; i < 4; i++) {
+        assert(evaluation.result[i].step == expected[i][0]);
+        assert(evaluation.result[i].program_index == expected[i][1]);
+        assert(evaluation.result[i].version_index == expected[i][2]);
+    }
+
+    assert(evaluator_install_steps(population, population->size, &evaluation) != 0);
+
+    evaluation_free(&evaluation);
+    population_free(population);
+    free(population);
+
+    printf("Ok\n");
+}
+
+void test_evaluator_direct_ascent()
+{
+    sc_population * population = (sc_population*)malloc(sizeof(sc_population));
+    sc_goal * goal;
+    sc_evaluator evaluator;
+    sc_evaluation evaluation;
+    test_evaluator_context ctx;
+    int i, installed = 0;
+
+    printf("test_evaluator_direct_ascent...");
+
+    assert(test_population_from_memory(population, 4) == 0);
+    goal = &population->goal;
+    for (i = 0; i < population->sys.no_of_programs; i++)
+        installed += goal->reference.installed[i];
+    assert(installed > 0);
+
+    /* a genome with no steps goes straight to the goal */
+    population->individual[0]->steps = 0;
+    assert(evaluation_create(&evaluation, population) == 0);
+    assert(evaluator_install_steps(population, 0, &evaluation) == 0);
+    assert(evaluation.no_of_install_steps == installed);
+    for (i = 0; i < evaluation.no_of_install_steps; i++) {
+        assert(evaluation.result[i].step == 0);
+        assert(goal->reference.installed[evaluation.result[i].program_index]);
+        assert(evaluation.result[i].version_index ==
+               goal->reference.version_index[evaluation.result[i].program_index]);
+    }
+
+    memset((void*)&ctx, '\0', sizeof(ctx));
+    ctx.failing_program = -1;
+    evaluator_init(&evaluator, NULL, "/tmp", "/tmp");
+    evaluator.backend = test_evaluator_backend;
+    evaluator.backend_context = &ctx;
+
+    assert(evaluator_run(&evaluator, population, 0, &evaluation) == 0);
+    assert(evaluation.no_of_results == installed);
+    assert(!evaluation.aborted);
+    assert(population->individual[0]->evaluated);
+    assert(population->individual[0]->test_passes == installed*5);
+    assert(population->individual[0]->score > 0);
+
+    evaluation_free(&evaluation);
+    population_free(population);
+    free(population);
+
+    printf("Ok\n");
+}
+
+void test_evaluator_early_abort()
+{
+    sc_population * population = (sc_population*)malloc(sizeof(sc_population));
+    sc_evaluator evaluator;
+    sc_evaluation evaluation;
+    test_evaluator_context ctx;
+
+    printf("test_evaluator_early_abort...");
+
+    assert(test_population_from_memory(population, 4) == 0);
+    test_evaluator_genome(population, 0);
+    assert(evaluation_create(&evaluation, population) == 0);
+
+    memset((void*)&ctx, '\0', sizeof(ctx));
+    ctx.failing_program = 1;
+    evaluator_init(&evaluator, NULL, "/tmp", "/tmp");
+    evaluator.backend = test_evaluator_backend;
+    evaluator.backend_context = &ctx;
+    evaluator.callback = test_evaluator_callback;
+    evaluator.callback_context = &ctx;
+
+    /* nothing to run */
+    evaluator.backend = NULL;
+    assert(evaluator_run(&evaluator, population, 0, &evaluation) != 0);
+    evaluator.backend = test_evaluator_backend;
+
+    /* the build of the second program fails, so nothing after it is built */
+    assert(evaluator_run(&evaluator, population, 0, &evaluation) == 0);
+    assert(evaluation.no_of_results == 2);
+    assert(evaluation.aborted);
+    assert(ctx.results == 2);
+    assert(ctx.calls[SC_STAGE_CONFIGURE] == 2);
+    assert(ctx.calls[SC_STAGE_BUILD] == 2);
+    assert(ctx.calls[SC_STAGE_TEST] == 1);
+    assert(evaluation.result[1].passed[SC_STAGE_CONFIGURE]);
+    assert(!evaluation.result[1].passed[SC_STAGE_BUILD]);
+    assert(!evaluation.result[1].passed[SC_STAGE_TEST]);
+    assert(evaluation.programs_passed == 1);
+    assert(evaluation.test_passes == 5);
+
+    /* the score was set from the tests which passed */
+    assert(population->individual[0]->evaluated);
+    assert(population->individual[0]->score ==
+           (5.0f / 3.0f) * (1.0f / 3.0f));
+
+    /* without early abort every step is built */
+    memset((void*)&ctx, '\0', sizeof(ctx));
+    ctx.failing_program = 1;
+    evaluator.abort_on_failure = 0;
+    assert(evaluator_run(&evaluator, population, 0, &evaluation) == 0);
+    assert(evaluation.no_of_results == 4);
+    assert(!evaluation.aborted);
+    assert(ctx.calls[SC_STAGE_BUILD] == 4);
+    assert(evaluation.test_passes == 15);
+
+    /* the callback can abort the evaluation */
+    memset((void*)&ctx, '\0', sizeof(ctx));
+    ctx.failing_program = -1;
+    ctx.abort_after = 3;
+    assert(evaluator_run(&evaluator, population, 0, &evaluation) == 0);
+    assert(evaluation.no_of_results == 3);
+    assert(evaluation.aborted);
+
+    evaluation_free(&evaluation);
+    population_free(population);
+    free(population);
+
+    printf("Ok\n");
+}
+
+void test_evaluator_command()
+{
+    char * stub = "../tools/evaluator_stub.sh";
+    char command[SC_MAX_STRING];
+    char install_prefix[SC_MAX_STRING];
+    char filename[SC_MAX_STRING*2];
+    char commandstr[SC_MAX_STRING];
+    sc_population * population = (sc_population*)malloc(sizeof(sc_population));
+    sc_evaluator evaluator;
+    sc_evaluation evaluation;
+
+    printf("test_evaluator_command...");
+
+    assert(file_exists(stub));
+
+    assert(snprintf(install_prefix, sizeof(install_prefix),
+                    "/tmp/scalam_evaluator.XXXXXX") <
+           (int)sizeof(install_prefix));
+    assert(mkdtemp(install_prefix) != NULL);
+
+    assert(test_population_from_memory(population, 4) == 0);
+    test_evaluator_genome(population, 2);
+    assert(evaluation_create(&evaluation, population) == 0);
+
+    evaluator_init(&evaluator, stub, "/tmp", install_prefix);
+    assert(evaluator_run(&evaluator, population, 2, &evaluation) == 0);
+    assert(evaluation.no_of_results == 4);
+    assert(!evaluation.aborted);
+    assert(evaluation.programs_passed == 4);
+    assert(evaluation.test_passes == 40);
+    assert(evaluation.result[3].test_failures == 0);
+
+    /* the stub installs into the prefix */
+    assert(snprintf(filename, sizeof(filename),
+                    "%s/program2", install_prefix) <
+           (int)sizeof(filename));
+    assert(file_exists(filename));
+
+    /* a failing test stage at the second step version of program 0 */
+    assert(snprintf(command, sizeof(command),
+                    "SCALAM_STUB_FAIL=program0@4:test %s", stub) <
+           (int)sizeof(command));
+    evaluator_init(&evaluator, command, "/tmp", install_prefix);
+    assert(evaluator_run(&evaluator, population, 2, &evaluation) == 0);
+    assert(evaluation.no_of_results == 3);
+    assert(evaluation.aborted);
+    assert(evaluation.result[2].passed[SC_STAGE_BUILD]);
+    assert(!evaluation.result[2].passed[SC_STAGE_TEST]);
+    assert(evaluation.test_passes == 20);
+
+    /* stages which take too long are stopped and fail */
+    assert(snprintf(command, sizeof(command),
+                    "SCALAM_STUB_DELAY=10 %s", stub) <
+           (int)sizeof(command));
+    evaluator_init(&evaluator, command, "/tmp", install_prefix);
+    evaluator.stage_timeout = 0.2;
+    assert(evaluator_run(&evaluator, population, 2, &evaluation) == 0);
+    assert(evaluation.no_of_results == 1);
+    assert(evaluation.aborted);
+    assert(!evaluation.result[0].passed[SC_STAGE_CONFIGURE]);
+    assert(evaluation.result[0].duration[SC_STAGE_CONFIGURE] < 5);
+
+    assert(snprintf(commandstr, sizeof(commandstr),
+                    "rm -rf %s", install_prefix) <
+           (int)sizeof(commandstr));
+    run_shell_command(commandstr);
+
+    evaluation_free(&evaluation);
+    population_free(population);
+    free(population);
+
+    printf("Ok\n");
+}
+
+void test_evaluator_budgets()
+{
+    sc_population * population = (sc_population*)malloc(sizeof(sc_population));
+    sc_evaluator evaluator;
+    sc_evaluation evaluation;
+    test_evaluator_context ctx;
+
+    printf("test_evaluator_budgets...");
+
+    assert(test_population_from_memory(population, 4) == 0);
+    test_evaluator_genome(population, 0);
+    assert(evaluation_create(&evaluation, population) == 0);
+
+    memset((void*)&ctx, '\0', sizeof(ctx));
+    ctx.failing_program = -1;
+    evaluator_init(&evaluator, NULL, "/tmp", "/tmp");
+    evaluator.backend = test_evaluator_backend;
+    evaluator.backend_context = &ctx;
+
+    /* only the two installs of the first step fit within the budget */
+    evaluator.step_budget = 2;
+    assert(evaluator_run(&evaluator, population, 0, &evaluation) == 0);
+    assert(evaluation.no_of_results == 2);
+    assert(evaluation.abort_reason == SC_ABORT_STEPS);
+    assert(evaluation.steps_completed == 1);
+
+    /* a partial score is recorded */
+    assert(population->individual[0]->evaluated);
+    assert(population->individual[0]->steps_completed == 1);
+    assert(population->individual[0]->test_passes == 10);
+    /* weighted by the two of three steps completed */
+    assert(population->individual[0]->score ==
+           (10.0f / 3.0f) * (2.0f / 3.0f));
+
+    /* program 2 hasn't been tested, so there is no bound on its tests */
+    assert(isinf(evaluation.upper_bound));
+
+    /* each stage takes longer than the time budget allows for a program */
+    evaluator.step_budget = 0;
+    evaluator.time_budget = 0.05;
+    ctx.delay_usec = 30000;
+    assert(evaluator_run(&evaluator, population, 0, &evaluation) == 0);
+    assert(evaluation.no_of_results == 1);
+    assert(evaluation.abort_reason == SC_ABORT_TIME);
+    assert(evaluation.steps_completed == 0);
+    assert(population->individual[0]->score ==
+           (5.0f / 3.0f) * (1.0f / 3.0f));
+
+    evaluation_free(&evaluation);
+    population_free(population);
+    free(population);
+
+    printf("Ok\n");
+}
+
+void test_evaluator_prune()
+{
+    sc_population * population = (sc_population*)malloc(sizeof(sc_population));
+    sc_evaluator evaluator;
+    sc_evaluation evaluation;
+    test_evaluator_context ctx;
+
+    printf("test_evaluator_prune...");
+
+    assert(test_population_from_memory(population, 4) == 0);
+    test_evaluator_genome(population, 0);
+    test_evaluator_genome(population, 1);
+    test_evaluator_genome(population, 2);
+    assert(evaluation_create(&evaluation, population) == 0);
+
+    memset((void*)&ctx, '\0', sizeof(ctx));
+    ctx.failing_program = -1;
+    evaluator_init(&evaluator, NULL, "/tmp", "/tmp");
+    evaluator.backend = test_evaluator_backend;
+    evaluator.backend_context = &ctx;
+    evaluator.prune = 1;
+
+    /* untested programs could pass any number of tests */
+    assert(evaluator_install_steps(population, 0, &evaluation) == 0);
+    assert(isinf(evaluator_upper_bound(&evaluator, population, 0,
+                                       &evaluation, 0)));
+
+    /* nothing to beat yet, so the first genome is evaluated in full */
+    assert(evaluator_run(&evaluator, population, 0, &evaluation) == 0);
+    assert(!evaluation.aborted);
+    assert(evaluation.no_of_results == 4);
+    assert(evaluator.elite_score == 20.0f / 3.0f);
+    assert(evaluator.max_test_passes[0] == 5);
+
+    /* an identical genome can't do better, so nothing is built */
+    assert(evaluator_run(&evaluator, population, 1, &evaluation) == 0);
+    assert(evaluation.abort_reason == SC_ABORT_PRUNED);
+    assert(evaluation.no_of_results == 0);
+    assert(ctx.calls[SC_STAGE_CONFIGURE] == 4);
+    assert(population->individual[1]->evaluated);
+    assert(population->individual[1]->score == 0);
+
+    /* a lower elite score means that it is worth evaluating */
+    evaluator.elite_score = 1;
+    assert(evaluator_run(&evaluator, population, 2, &evaluation) == 0);
+    assert(!evaluation.aborted);
+    assert(evaluation.no_of_results == 4);
+
+    evaluation_free(&evaluation);
+    population_free(population);
+    free(population);
+
+    printf("Ok\n");
+}
+
+void test_evaluator_goal_reached()
+{
+    sc_population * population = (sc_population*)malloc(sizeof(sc_population));
+    sc_evaluator evaluator;
+    sc_evaluation evaluation;
+    test_evaluator_context ctx;
+    int i, generation, generation_max = 10;
+
+    printf("test_evaluator_goal_reached...");
+
+    assert(test_population_from_memory(population, 8) == 0);
+    assert(evaluation_create(&evaluation, population) == 0);
+
+    memset((void*)&ctx, '\0', sizeof(ctx));
+    ctx.failing_program = -1;
+    evaluator_init(&evaluator, NULL, "/tmp", "/tmp");
+    evaluator.backend = test_evaluator_backend;
+    evaluator.backend_context = &ctx;
+
+    /* nothing has been built at the reference yet */
+    assert(goal_max_score(&population->goal) < 0);
+    assert(!goal_reached(population));
+
+    /* run in the same way as run_simulation */
+    for (generation = 0; generation < generation_max; generation++) {
+        for (i = 0; i < population->size; i++) {
+            if (population->individual[i]->evaluated)
+                continue;
+            assert(evaluator_run(&evaluator, population, i, &evaluation) == 0);
+        }
+        if (goal_reached(population))
+            break;
+        assert(population_next_generation(population) == 0);
+    }
+
+    /* the genome which goes straight to the goal gets the maximum score */
+    assert(generation == 0);
+    assert(goal_max_score(&population->goal) > 0);
+    assert(population_best_score(population) ==
+           goal_max_score(&population->goal));
+
+    evaluation_free(&evaluation);
+    population_free(population);
+    free(population);
+
+    printf("Ok\n");
+}
+
+void run_evaluator_tests()
+{
+    test_evaluator_install_steps();
+    test_evaluator_direct_ascent();
+    test_evaluator_early_abort();
+    test_evaluator_command();
+    test_evaluator_budgets();
+    test_evaluator_prune();
+    test_evaluator_goal_reached();
+}
@@ -59,7 +59,7 @@ void test_genome_spawn()
     sc_population population;
     sc_goal goal;
     sc_system system_definition;
-    sc_genome parent1, parent2, child;
+    sc_genome * parent1, * parent2, * child;
     int population_size = 100;
     char commandstr[SC_MAX_STRING];
     char * repo_dir;
@@ -84,20 +84,37 @@ void test_genome_spawn()
     }
     assert(retval == 0);
 
+    /* genomes are sized according to the system */
+    parent1 = (sc_genome*)malloc(genome_size(&population));
+    parent2 = (sc_genome*)malloc(genome_size(&population));
+    child = (sc_genome*)malloc(genome_size(&population));
+    memset((void*)child, '\0', genome_size(&population));
+
     /* create the parents */
-    assert(genome_create(&population, &parent1) == 0);
-    assert(genome_create(&population, &parent2) == 0);
+    assert(genome_create(&population, parent1) == 0);
+    assert(genome_create(&population, parent2) == 0);
+
+    /* values left by whatever genome was there before */
+    child->goal_distance = 99;
+    child->rank = 3;
+    child->crowding = 1.5f;
 
     /* create a child */
-    assert(genome_spawn(&population, &parent1, &parent2, &child) == 0);
+    assert(genome_spawn(&population, parent1, parent2, child) == 0);
+    assert(child->goal_distance == 0);
+    assert(child->rank == 0);
+    assert(child->crowding == 0);
 
     /* parents should be different */
-    assert(memcmp(&parent1, &parent2, sizeof(sc_genome)) != 0);
+    assert(memcmp(parent1, parent2, genome_size(&population)) != 0);
 
     /* child should not be exactly like either parent */
-    assert(memcmp(&child, &parent1, sizeof(sc_genome)) != 0);
-    assert(memcmp(&child, &parent2, sizeof(sc_genome)) != 0);
+    assert(memcmp(child, parent1, genome_size(&population)) != 0);
+    assert(memcmp(child, parent2, genome_size(&population)) != 0);
 
+    free(parent1);
+    free(parent2);
+    free(child);
     population_free(&population);
 
     printf("Ok\n");
@@ -108,7 +125,7 @@ void test_genome_create()
     sc_population population;
     sc_goal goal;
     sc_system system_definition;
-    sc_genome individual;
+    sc_genome * individual;
     int population_size = 100;
     char commandstr[SC_MAX_STRING];
     char * repo_dir;
@@ -133,8 +150,10 @@ void test_genome_create()
     }
     assert(retval == 0);
 
-    assert(genome_create(&population, &individual) == 0);
+    individual = (sc_genome*)malloc(genome_size(&population));
+    assert(genome_create(&population, individual) == 0);
 
+    free(individual);
     population_free(&population);
 
     printf("Ok\n");
@@ -47,7 +47,115 @@ void test_goal_create()
     printf("Ok\n");
 }
 
+void test_goal_reference()
+{
+    sc_system * sys = (sc_system*)malloc(sizeof(sc_system));
+    sc_goal * goal = (sc_goal*)malloc(sizeof(sc_goal));
+    sc_program_result result;
+    int p;
+
+    printf("test_goal_reference...");
+
+    test_state_system(sys, 20);
+    sys->program[3].installed = 1;
+    sys->program[3].version_index = 2;
+    assert(goal_create_latest_versions(sys, goal) == 0);
+
+    for (p = 0; p < sys->no_of_programs; p++) {
+        /* the head of master is the last valid version index */
+        assert(goal->reference.version_index[p] ==
+               sys->program[p].no_of_versions - 1);
+        assert(goal->test_passes[p] == -1);
+    }
+
+    /* an installed program is as many versions away as it needs to move */
+    assert(goal->distance[3] == sys->program[3].no_of_versions - 3);
+
+    /* a program which isn't installed is further away than any version */
+    assert(goal->distance[0] == sys->program[0].no_of_versions + 1);
+    assert(goal_program_distance(sys, goal, 0, 1, 0) < goal->distance[0]);
+
+    /* a program which shouldn't be installed */
+    goal->reference.installed[1] = 0;
+    assert(goal_program_distance(sys, goal, 1, 0, 5) == 0);
+    assert(goal_program_distance(sys, goal, 1, 1, 5) == 1);
+    goal->reference.installed[1] = 1;
+
+    assert(goal->start_distance > 0);
+
+    /* the maximum isn't known until the reference has been built */
+    assert(goal_max_score(goal) < 0);
+
+    memset((void*)&result, '\0', sizeof(sc_program_result));
+    result.passed[SC_STAGE_BUILD] = 1;
+    result.test_passes = 7;
+    for (p = 0; p < sys->no_of_programs; p++) {
+        result.program_index = p;
+
+        /* other versions say nothing about the reference */
+        result.version_index = 0;
+        assert(goal_record_result(goal, &result) == 0);
+
+        result.version_index = goal->reference.version_index[p];
+        assert(goal_record_result(goal, &result) == 1);
+        if (p < sys->no_of_programs - 1)
+            assert(goal_max_score(goal) < 0);
+    }
+    assert(goal_max_score(goal) == 20.0f * 7);
+
+    free(goal);
+    free(sys);
+
+    printf("Ok\n");
+}
+
+void test_goal_incremental_distance()
+{
+    sc_population * population = (sc_population*)malloc(sizeof(sc_population));
+    sc_system * sys;
+    sc_genome * individual;
+    int distance[SC_MAX_CHANGE_SEQUENCE];
+    int i, step;
+    float heuristic;
+
+    printf("test_goal_incremental_distance...");
+
+    assert(test_population_from_memory(population, 16) == 0);
+    sys = &population->sys;
+
+    /* as if each program passed a single test at the reference */
+    for (i = 0; i < sys->no_of_programs; i++)
+        population->goal.test_passes[i] = 1;
+
+    for (i = 0; i < population->size; i++) {
+        individual = population->individual[i];
+        goal_genome_distances(population, individual, distance);
+
+        /* the incremental distances agree with the full calculation */
+        for (step = 0; step < individual->steps; step++)
+            assert(distance[step] ==
+                   goal_state_distance(sys, &population->goal,
+                                       genome_state(population, individual,
+                                                    step)));
+
+        heuristic = goal_heuristic_score(population, individual);
+        assert(heuristic >= 0);
+        assert(heuristic <= goal_max_score(&population->goal));
+
+        /* going straight to the goal is the best possible estimate */
+        if (individual->steps == 0)
+            assert(heuristic == goal_max_score(&population->goal));
+    }
+
+    population_free(population);
+    free(population);
+
+    printf("Ok\n");
+}
+
 void run_goal_tests()
 {
     test_goal_create();
+    test_goal_reference();
+    test_goal_incremental_distance();
 }
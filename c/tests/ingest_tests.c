@@ -0,0 +1,272 @@
+/*
+  Smart search for upgrade paths
+  Copyright (C) 2016 Andrew Leeming <andrew.leeming@codethink.co.uk> and
+  Bob Mottram <bob.mottram@codethink.co.uk>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include "../src/scalam.h"
+
+#define TEST_INGEST_COMMITS 3
+
+/**
+ * @brief Creates a local git repo to be cloned, in which each commit
+ *        changes the contents of a file called version
+ * @param repo_dir Directory of the repo
+ */
+static void test_ingest_create_repo(char * repo_dir)
+{
+    char commandstr[SC_MAX_STRING*2];
+    int c;
+
+    assert(snprintf(commandstr, sizeof(commandstr),
+                    "git init -q -b master %s && "
+                    "git -C %s config user.email test@scalam && "
+                    "git -C %s config user.name scalam",
+                    repo_dir, repo_dir, repo_dir) <
+           (int)sizeof(commandstr));
+    run_shell_command(commandstr);
+
+    for (c = 0; c < TEST_INGEST_COMMITS; c++) {
+        assert(snprintf(commandstr, sizeof(commandstr),
+                        "echo %d > %s/version && git -C %s add version && "
+                        "git -C %s commit -q -m \"version %d\"",
+                        c, repo_dir, repo_dir, repo_dir, c) <
+               (int)sizeof(commandstr));
+        run_shell_command(commandstr);
+    }
+}
+
+/* Counts progress reports */
+static int test_ingest_reports = 0;
+static int test_ingest_last_finished = 0;
+
+static void test_ingest_progress(void * context, sc_ingest_entry * entry,
+                                 int finished, int total)
+{
+    sc_system * sys = (sc_system*)context;
+
+    /* programs which are done are already within the system */
+    if (entry->status == SC_INGEST_DONE)
+        assert(sys->program[entry->program_index].name == entry->name);
+
+    assert(finished == test_ingest_last_finished + 1);
+    assert(total == 4);
+    test_ingest_last_finished = finished;
+    test_ingest_reports++;
+}
+
+void test_ingest_load_sources()
+{
+    char filename[SC_MAX_STRING];
+    sc_ingest ingest;
+    FILE * fp;
+
+    printf("test_ingest_load_sources...");
+
+    assert(ingest_source_from_name("deb") == SC_INGEST_DEB);
+    assert(ingest_source_from_name("svn") == -1);
+    assert(ingest_source_from_url("http://a/b-1.0.tar.xz") == SC_INGEST_TARBALL);
+    assert(ingest_source_from_url("http://a/b.tgz") == SC_INGEST_TARBALL);
+    assert(ingest_source_from_url("http://a/b_1.0_all.deb") == SC_INGEST_DEB);
+    assert(ingest_source_from_url("http://a/b-1.0.rpm") == SC_INGEST_RPM);
+    assert(ingest_source_from_url("https://github.com/a/b") == SC_INGEST_GIT);
+
+    assert(snprintf(filename, sizeof(filename),
+                    "/tmp/scalam_ingest_sources.XXXXXX") <
+           (int)sizeof(filename));
+    assert(mkstemp(filename) >= 0);
+
+    fp = fopen(filename, "w");
+    assert(fp != NULL);
+    fprintf(fp, "# programs to ingest\n\n");
+    fprintf(fp, "alpha git https://github.com/example/alpha.git\n");
+    fprintf(fp, "beta   tarball\thttp://example.com/beta-1.0.tar.gz  # comment\n");
+    fprintf(fp, "gamma http://example.com/gamma_1.0_all.deb\n");
+    fprintf(fp, "delta aptitude\n");
+    fclose(fp);
+
+    ingest_create(&ingest);
+    assert(ingest_load_sources(&ingest, filename) == 0);
+    assert(ingest.no_of_entries == 4);
+    assert(strcmp(string_pool_get(ingest.entry[0].name), "alpha") == 0);
+    assert(ingest.entry[0].source == SC_INGEST_GIT);
+    assert(strcmp(string_pool_get(ingest.entry[1].url),
+                  "http://example.com/beta-1.0.tar.gz") == 0);
+    assert(ingest.entry[1].source == SC_INGEST_TARBALL);
+    assert(ingest.entry[2].source == SC_INGEST_DEB);
+    assert(ingest.entry[3].source == SC_INGEST_APTITUDE);
+    assert(ingest.entry[3].url == 0);
+
+    /* names are unique and valid, and only aptitude needs no url */
+    assert(ingest_add(&ingest, "alpha", SC_INGEST_GIT, "alpha.git") != 0);
+    assert(ingest_add(&ingest, "1alpha", SC_INGEST_GIT, "alpha.git") != 0);
+    assert(ingest_add(&ingest, "epsilon", SC_INGEST_RPM, NULL) != 0);
+    assert(ingest_add(&ingest, "epsilon", SC_INGEST_SOURCES, "e.rpm") != 0);
+    assert(ingest.no_of_entries == 4);
+    ingest_free(&ingest);
+
+    /* unknown sources */
+    fp = fopen(filename, "w");
+    assert(fp != NULL);
+    fprintf(fp, "alpha svn http://example.com/alpha\n");
+    fclose(fp);
+    ingest_create(&ingest);
+    assert(ingest_load_sources(&ingest, filename) != 0);
+    ingest_free(&ingest);
+
+    unlink(filename);
+
+    printf("Ok\n");
+}
+
+void test_ingest_run()
+{
+    char tempdir[SC_MAX_STRING];
+    char repos_dir[SC_MAX_STRING*2];
+    char source_dir[SC_MAX_STRING*2];
+    char filename[SC_MAX_STRING*2];
+    char commandstr[SC_MAX_STRING*4];
+    char version[SC_MAX_STRING];
+    sc_system * sys = (sc_system*)malloc(sizeof(sc_system));
+    sc_ingest ingest;
+    FILE * fp;
+    int stage;
+
+    printf("test_ingest_run...");
+
+    assert(snprintf(tempdir, sizeof(tempdir), "/tmp/scalam_ingest.XXXXXX") <
+           (int)sizeof(tempdir));
+    assert(mkdtemp(tempdir) != NULL);
+    assert(snprintf(repos_dir, sizeof(repos_dir), "%s/repos", tempdir) <
+           (int)sizeof(repos_dir));
+
+    /* repos to be cloned */
+    assert(snprintf(source_dir, sizeof(source_dir), "%s/alpha.git", tempdir) <
+           (int)sizeof(source_dir));
+    test_ingest_create_repo(source_dir);
+    assert(snprintf(source_dir, sizeof(source_dir), "%s/beta.git", tempdir) <
+           (int)sizeof(source_dir));
+    test_ingest_create_repo(source_dir);
+
+    /* a tarball containing a NEWS file */
+    assert(snprintf(commandstr, sizeof(commandstr),
+                    "mkdir -p %s/gamma-2.0", tempdir) <
+           (int)sizeof(commandstr));
+    run_shell_command(commandstr);
+    assert(snprintf(filename, sizeof(filename), "%s/gamma-2.0/NEWS", tempdir) <
+           (int)sizeof(filename));
+    fp = fopen(filename, "w");
+    assert(fp != NULL);
+    fprintf(fp, "gamma 2.0\n=========\n\n* Rewritten\n\n"
+            "gamma 1.1\n=========\n\n* Fixes\n\n"
+            "gamma 1.0\n=========\n\n* First release\n");
+    fclose(fp);
+    assert(snprintf(commandstr, sizeof(commandstr),
+                    "tar -czf %s/gamma-2.0.tar.gz -C %s gamma-2.0",
+                    tempdir, tempdir) <
+           (int)sizeof(commandstr));
+    run_shell_command(commandstr);
+
+    ingest_create(&ingest);
+    assert(snprintf(source_dir, sizeof(source_dir), "%s/alpha.git", tempdir) <
+           (int)sizeof(source_dir));
+    assert(ingest_add(&ingest, "alpha", SC_INGEST_GIT, source_dir) == 0);
+    assert(snprintf(filename, sizeof(filename),
+                    "%s/missing-1.0.tar.gz", tempdir) <
+           (int)sizeof(filename));
+    assert(ingest_add(&ingest, "missing", SC_INGEST_TARBALL, filename) == 0);
+    assert(snprintf(filename, sizeof(filename),
+                    "%s/gamma-2.0.tar.gz", tempdir) <
+           (int)sizeof(filename));
+    assert(ingest_add(&ingest, "gamma", SC_INGEST_TARBALL, filename) == 0);
+    assert(snprintf(source_dir, sizeof(source_dir), "%s/beta.git", tempdir) <
+           (int)sizeof(source_dir));
+    assert(ingest_add(&ingest, "beta", SC_INGEST_GIT, source_dir) == 0);
+
+    for (stage = 0; stage < SC_INGEST_STAGES; stage++)
+        assert(ingest_set_max_running(&ingest, stage, 2) == 0);
+    assert(ingest_set_max_running(&ingest, SC_INGEST_FETCH, 0) != 0);
+
+    ingest.callback = test_ingest_progress;
+    ingest.callback_context = (void*)sys;
+    test_ingest_reports = 0;
+    test_ingest_last_finished = 0;
+
+    assert(ingest_run(&ingest, repos_dir, sys) == 0);
+    assert(test_ingest_reports == 4);
+    assert(ingest.completed == 3);
+    assert(ingest.failed == 1);
+
+    /* the archive which doesn't exist fails to be fetched */
+    assert(ingest.entry[1].status == SC_INGEST_FAILED);
+    assert(ingest.entry[1].failed_stage == SC_INGEST_FETCH);
+    assert(ingest.entry[1].program_index == -1);
+
+    /* programs are in the order of the sources, whatever
+       order they finished in */
+    assert(sys->no_of_programs == 3);
+    assert(system_program_index_from_name(sys, "alpha") == 0);
+    assert(system_program_index_from_name(sys, "gamma") == 1);
+    assert(system_program_index_from_name(sys, "beta") == 2);
+    assert(system_program_index_from_name(sys, "missing") == -1);
+    assert(ingest.entry[3].program_index == 2);
+    assert(sys->state_bytes > 0);
+
+    /* clones are on their newest commit */
+    assert(sys->program[0].no_of_versions == TEST_INGEST_COMMITS);
+    assert(sys->program[0].version_index == TEST_INGEST_COMMITS - 1);
+    assert(snprintf(filename, sizeof(filename),
+                    "%s/alpha/version", repos_dir) <
+           (int)sizeof(filename));
+    assert(file_exists(filename));
+
+    /* archives are on their newest version */
+    assert(sys->program[1].no_of_versions == 3);
+    assert(sys->program[1].version_index == 2);
+    assert(program_version_from_index(&sys->program[1], 0, version) == 0);
+    assert(strcmp(version, "1.0") == 0);
+
+    /* git repos have no extract stage */
+    assert(ingest.entry[0].duration[SC_INGEST_EXTRACT] == 0);
+    assert(ingest.entry[0].duration[SC_INGEST_FETCH] > 0);
+
+    assert(snprintf(filename, sizeof(filename), "%s/ingest.csv", tempdir) <
+           (int)sizeof(filename));
+    assert(ingest_save(&ingest, filename) == 0);
+    assert(lines_in_file(filename) == 5);
+
+    /* existing clones are used as they are when ingesting again */
+    test_ingest_last_finished = 0;
+    assert(ingest_run(&ingest, repos_dir, sys) == 0);
+    assert(ingest.completed == 3);
+    assert(sys->program[2].no_of_versions == TEST_INGEST_COMMITS);
+
+    ingest_free(&ingest);
+
+    assert(snprintf(commandstr, sizeof(commandstr), "rm -rf %s", tempdir) <
+           (int)sizeof(commandstr));
+    run_shell_command(commandstr);
+    free(sys);
+
+    printf("Ok\n");
+}
+
+void run_ingest_tests()
+{
+    test_ingest_load_sources();
+    test_ingest_run();
+}
@@ -0,0 +1,137 @@
+/*
+  Smart search for upgrade paths
+  Copyright (C) 2016 Andrew Leeming <andrew.leeming@codethink.co.uk> and
+  Bob Mottram <bob.mottram@codethink.co.uk>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include "../src/scalam.h"
+
+/**
+ * @brief Returns true if a file contains a given line
+ */
+static int test_manifest_has_line(char * filename, char * line)
+{
+    FILE * fp;
+    char linestr[SC_MAX_STRING];
+    int found = 0;
+
+    fp = fopen(filename, "r");
+    assert(fp != NULL);
+    while (fgets(linestr, SC_MAX_STRING, fp) != NULL) {
+        linestr[strcspn(linestr, "\n")] = 0;
+        if (strcmp(linestr, line) == 0) {
+            found = 1;
+            break;
+        }
+    }
+    fclose(fp);
+    return found;
+}
+
+void test_manifest_fingerprint()
+{
+    sc_system * sys1 = (sc_system*)malloc(sizeof(sc_system));
+    sc_system * sys2 = (sc_system*)malloc(sizeof(sc_system));
+    uint64_t fingerprint;
+
+    printf("test_manifest_fingerprint...");
+
+    test_state_system(sys1, 20);
+    test_state_system(sys2, 20);
+    fingerprint = manifest_fingerprint(sys1);
+    assert(fingerprint == manifest_fingerprint(sys2));
+
+    /* a different version */
+    sys2->program[3].version_index++;
+    assert(fingerprint != manifest_fingerprint(sys2));
+    sys2->program[3].version_index--;
+    assert(fingerprint == manifest_fingerprint(sys2));
+
+    /* a program which isn't installed */
+    sys2->program[7].installed = 1 - sys2->program[7].installed;
+    assert(fingerprint != manifest_fingerprint(sys2));
+    sys2->program[7].installed = 1 - sys2->program[7].installed;
+
+    /* a different program */
+    sys2->program[0].name = string_pool_add("another");
+    assert(fingerprint != manifest_fingerprint(sys2));
+
+    free(sys1);
+    free(sys2);
+
+    printf("Ok\n");
+}
+
+void test_manifest_save()
+{
+    sc_population * population = (sc_population*)malloc(sizeof(sc_population));
+    sc_run_options options;
+    char * filename = "/tmp/scalam_test_manifest.txt";
+    char expected[SC_MAX_STRING];
+
+    printf("test_manifest_save...");
+
+    assert(test_population_from_memory(population, 10) == 0);
+    memset((void*)&options, '\0', sizeof(sc_run_options));
+    options.random_seed = 3141592;
+    options.max_threads = 3;
+
+    assert(manifest_save(filename, "synthetic", &options, 50, population) == 0);
+    assert(test_manifest_has_line(filename, "seed = 3141592"));
+    assert(test_manifest_has_line(filename, "threads = 3"));
+    assert(test_manifest_has_line(filename, "mode = synthetic"));
+    assert(test_manifest_has_line(filename, "max_generations = 50"));
+    assert(test_manifest_has_line(filename, "population_size = 10"));
+    assert(test_manifest_has_line(filename, "no_of_programs = 20"));
+
+    sprintf(expected, "fingerprint = %016llx",
+            (unsigned long long)manifest_fingerprint(&population->sys));
+    assert(test_manifest_has_line(filename, expected));
+
+    sprintf(expected, "program = %s %d %d",
+            string_pool_get(population->sys.program[0].name),
+            population->sys.program[0].version_index,
+            (int)population->sys.program[0].installed);
+    assert(test_manifest_has_line(filename, expected));
+
+    /* without a population only the options are recorded */
+    sweep_ranges_init(options.sweep_range);
+    assert(sweep_range_parse(options.sweep_range, "mutation=0.1:0.5:5") == 0);
+    options.system_seed = 27;
+    options.system_seed_given = 1;
+    assert(manifest_save(filename, "sweep", &options, 50, NULL) == 0);
+    assert(test_manifest_has_line(filename, "mode = sweep"));
+    assert(test_manifest_has_line(filename, "system_seed = 27"));
+    assert(test_manifest_has_line(filename,
+                                  "range = mutation 0.100000 0.500000 5"));
+    assert(!test_manifest_has_line(filename, "population_size = 10"));
+
+    assert(manifest_save("/tmp/scalam_missing/manifest.txt", "sweep",
+                         &options, 50, NULL) != 0);
+
+    unlink(filename);
+    population_free(population);
+    free(population);
+
+    printf("Ok\n");
+}
+
+void run_manifest_tests()
+{
+    test_manifest_fingerprint();
+    test_manifest_save();
+}
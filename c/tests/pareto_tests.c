@@ -0,0 +1,191 @@
+/*
+  Smart search for upgrade paths
+  Copyright (C) 2016 Andrew Leeming <andrew.leeming@codethink.co.uk> and
+  Bob Mottram <bob.mottram@codethink.co.uk>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include "../src/scalam.h"
+
+/**
+ * @brief Gives each genome of a population arbitrary objective values
+ */
+static void test_pareto_objectives(sc_population * population,
+                                   unsigned int * random_seed)
+{
+    sc_genome * individual;
+    int i;
+
+    for (i = 0; i < population->size; i++) {
+        individual = population->individual[i];
+        individual->test_passes = rand_num(random_seed) % 10;
+        individual->steps = rand_num(random_seed) % 5;
+        individual->goal_distance = rand_num(random_seed) % 10;
+        individual->build_time = (float)(rand_num(random_seed) % 10);
+    }
+}
+
+void test_pareto_dominates()
+{
+    sc_population * population = (sc_population*)malloc(sizeof(sc_population));
+    sc_genome * genome1, * genome2;
+
+    printf("test_pareto_dominates...");
+
+    assert(test_population_from_memory(population, 2) == 0);
+    genome1 = population->individual[0];
+    genome2 = population->individual[1];
+
+    genome1->test_passes = genome2->test_passes = 5;
+    genome1->steps = genome2->steps = 2;
+    genome1->goal_distance = genome2->goal_distance = 10;
+    genome1->build_time = genome2->build_time = 3;
+
+    /* equal genomes don't dominate each other */
+    assert(!genome_dominates(genome1, genome2));
+    assert(!genome_dominates(genome2, genome1));
+
+    /* more tests passing */
+    genome1->test_passes = 6;
+    assert(genome_dominates(genome1, genome2));
+    assert(!genome_dominates(genome2, genome1));
+
+    /* a trade off between freshness and build time */
+    genome1->build_time = 4;
+    assert(!genome_dominates(genome1, genome2));
+    assert(!genome_dominates(genome2, genome1));
+
+    /* fewer steps and closer to the goal */
+    genome1->test_passes = 5;
+    genome1->build_time = 3;
+    genome1->steps = 1;
+    genome1->goal_distance = 9;
+    assert(genome_dominates(genome1, genome2));
+
+    population_free(population);
+    free(population);
+
+    printf("Ok\n");
+}
+
+void test_pareto_sort()
+{
+    sc_population * population = (sc_population*)malloc(sizeof(sc_population));
+    sc_genome ** individual;
+    unsigned int random_seed = 2387;
+    int i, j, dominated, front_size, trial;
+    int front[SC_MAX_POPULATION_SIZE];
+
+    printf("test_pareto_sort...");
+
+    assert(test_population_from_memory(population, 40) == 0);
+    individual = population->individual;
+
+    for (trial = 0; trial < 10; trial++) {
+        test_pareto_objectives(population, &random_seed);
+        assert(population_pareto_sort(population) == 0);
+
+        for (i = 0; i < population->size; i++) {
+            /* sorted by front, then by decreasing crowding distance */
+            if (i > 0) {
+                assert(individual[i]->rank >= individual[i-1]->rank);
+                if (individual[i]->rank == individual[i-1]->rank)
+                    assert(individual[i]->crowding <= individual[i-1]->crowding);
+            }
+
+            dominated = 0;
+            for (j = 0; j < population->size; j++) {
+                if (!genome_dominates(individual[j], individual[i]))
+                    continue;
+
+                /* only genomes on earlier fronts dominate */
+                assert(individual[j]->rank < individual[i]->rank);
+                if (individual[j]->rank == individual[i]->rank - 1)
+                    dominated = 1;
+            }
+
+            /* the non-dominated front, and every later genome is
+               dominated by one on the previous front */
+            if (individual[i]->rank == 0)
+                assert(!dominated);
+            else
+                assert(dominated);
+
+            assert(individual[i]->spawning_probability ==
+                   1.0f / (float)(1 + individual[i]->rank));
+        }
+
+        front_size = population_pareto_front(population, front);
+        assert(front_size > 0);
+        for (i = 0; i < front_size; i++)
+            assert(individual[front[i]]->rank == 0);
+
+        /* the ends of the front are kept */
+        if (front_size >= 2)
+            assert(isinf(individual[front[0]]->crowding));
+    }
+
+    population_free(population);
+    free(population);
+
+    printf("Ok\n");
+}
+
+void test_pareto_next_generation()
+{
+    sc_population * population = (sc_population*)malloc(sizeof(sc_population));
+    unsigned int random_seed = 934;
+    int i, j, generation;
+
+    printf("test_pareto_next_generation...");
+
+    assert(test_population_from_memory(population, 32) == 0);
+    population->objectives = SC_OBJECTIVES_PARETO;
+    population->elites = 4;
+
+    for (generation = 0; generation < 5; generation++) {
+        for (i = 0; i < population->size; i++) {
+            if (!population->individual[i]->evaluated)
+                assert(population_set_test_passes(population, i,
+                                                  rand_num(&random_seed) % 50) == 0);
+            population->individual[i]->build_time =
+                (float)(rand_num(&random_seed) % 100);
+        }
+        assert(population_next_generation(population) == 0);
+
+        /* the generations don't share any genomes */
+        for (i = 0; i < population->size; i++)
+            for (j = 0; j < population->size; j++)
+                assert(population->individual[i] !=
+                       population->next_generation[j]);
+    }
+
+    /* elites from the non-dominated front were carried over */
+    for (i = 0; i < population->elites; i++)
+        assert(population->individual[i]->evaluated);
+
+    population_free(population);
+    free(population);
+
+    printf("Ok\n");
+}
+
+void run_pareto_tests()
+{
+    test_pareto_dominates();
+    test_pareto_sort();
+    test_pareto_next_generation();
+}
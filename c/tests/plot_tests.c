@@ -102,7 +102,16 @@ void test_plot_save()
         plot_create_df_slice(df, &population);
     }
   
-    plot_dataframe_save(df);
+    assert(plot_dataframe_save(df, NULL) == 0);
+    assert(file_exists(SC_DEFAULT_DATAFRAME_FILENAME));
+
+    /* a different filename can be given, for example for each run */
+    assert(plot_dataframe_save(df, "/tmp/scalam_test_dataframe.csv") == 0);
+    assert(file_exists("/tmp/scalam_test_dataframe.csv"));
+    unlink("/tmp/scalam_test_dataframe.csv");
+
+    /* can't save into a directory which doesn't exist */
+    assert(plot_dataframe_save(df, "/tmp/scalam_missing/dataframe.csv") != 0);
     plot_dataframe_free(df);
     
     printf("Manual check required\n");
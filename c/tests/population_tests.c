@@ -20,6 +20,31 @@
 #include <assert.h>
 #include "../src/scalam.h"
 
+/**
+ * @brief Creates a population from a system which exists only in memory,
+ *        so that no repos need to be cloned
+ * @param population The population to be created
+ * @param size Number of genomes
+ * @returns zero on success
+ */
+int test_population_from_memory(sc_population * population, int size)
+{
+    sc_system * sys = (sc_system*)malloc(sizeof(sc_system));
+    sc_goal * goal = (sc_goal*)malloc(sizeof(sc_goal));
+    int retval;
+
+    test_state_system(sys, 20);
+    assert(system_create_dependency_matrix(sys) == 0);
+    assert(goal_create_latest_versions(sys, goal) == 0);
+
+    /* the population takes ownership of the dependency matrix */
+    retval = population_create(size, population, sys, goal);
+
+    free(sys);
+    free(goal);
+    return retval;
+}
+
 
 /**
  * @brief Creates a simple population to use in other test functions
@@ -223,7 +248,7 @@ void test_population_copy()
     for (i = 0; i < source.size; i++) {
         if (memcmp(source.individual[i],
                    destination.individual[i],
-                   sizeof(sc_genome)) != 0) {
+                   genome_size(&source)) != 0) {
             population_free(&source);
             population_free(&destination);
             assert(0);
@@ -351,9 +376,341 @@ void test_population_next_generation()
     printf("Ok\n");
 }
 
+void test_population_arena()
+{
+    sc_system system_definition;
+    sc_goal goal;
+    sc_population population;
+    char * repo_dir;
+    char template[] = "/tmp/scalam.XXXXXX";
+    char commandstr[SC_MAX_STRING];
+    unsigned char * arena_end;
+    unsigned int random_seed = 7261;
+    int i, slot, population_size = 20;
+    int used[40];
+
+    printf("test_population_arena...");
+
+    /* create a test directory which will contain repos */
+    repo_dir = mkdtemp(template);
+
+    /* make a test system with some repositories */
+    assert(test_create_system(&system_definition, repo_dir) == 0);
+
+    /* make a goal to get to the latest commits */
+    assert(goal_create_latest_versions(&system_definition, &goal) == 0);
+
+    assert(population_create(population_size, &population,
+                             &system_definition, &goal) == 0);
+
+    /* genomes are aligned to cache lines */
+    assert(population.genome_stride >= genome_size(&population));
+    assert(population.genome_stride % SC_ARENA_ALIGNMENT == 0);
+    assert(((size_t)population.arena) % SC_ARENA_ALIGNMENT == 0);
+
+    arena_end = population.arena +
+        2 * population_size * population.genome_stride;
+
+    /* before any generations the current generation occupies
+       the first half of the arena */
+    for (i = 0; i < population_size; i++) {
+        assert((unsigned char*)population.individual[i] ==
+               population.arena + i*population.genome_stride);
+    }
+
+    for (i = 0; i < population_size; i++) {
+        assert(population_set_test_passes(&population, i,
+                                          1 + rand_num(&random_seed) % 100) == 0);
+    }
+    assert(population_next_generation(&population) == 0);
+
+    /* after swapping generations every genome is still within the
+       arena and each slot is used exactly once */
+    memset((void*)used, '\0', sizeof(used));
+    for (i = 0; i < population_size; i++) {
+        assert((unsigned char*)population.individual[i] >= population.arena);
+        assert((unsigned char*)population.individual[i] < arena_end);
+        assert((unsigned char*)population.next_generation[i] >= population.arena);
+        assert((unsigned char*)population.next_generation[i] < arena_end);
+
+        slot = ((unsigned char*)population.individual[i] - population.arena) /
+            population.genome_stride;
+        used[slot]++;
+        slot = ((unsigned char*)population.next_generation[i] - population.arena) /
+            population.genome_stride;
+        used[slot]++;
+    }
+    for (i = 0; i < population_size*2; i++)
+        assert(used[i] == 1);
+
+    population_free(&population);
+
+    sprintf(commandstr,"rm -rf %s", repo_dir);
+    run_shell_command(commandstr);
+
+    printf("Ok\n");
+}
+
+void test_population_elitism()
+{
+    sc_population * population = (sc_population*)malloc(sizeof(sc_population));
+    unsigned int random_seed = 2817;
+    uint32_t elite_hash[3];
+    float elite_score[3];
+    int i, j, found, unevaluated, population_size = 20;
+
+    printf("test_population_elitism...");
+
+    assert(test_population_from_memory(population, population_size) == 0);
+    population->elites = 3;
+
+    for (i = 0; i < population_size; i++)
+        assert(population_set_test_passes(population, i,
+                                          1 + rand_num(&random_seed) % 100) == 0);
+    assert(population->evaluations == population_size);
+
+    assert(population_next_generation(population) == 0);
+
+    /* the previous generation is now sorted with the best first */
+    for (i = 0; i < 3; i++) {
+        elite_hash[i] = genome_hash(population, population->next_generation[i]);
+        elite_score[i] = population->next_generation[i]->score;
+    }
+
+    /* the elites survive unchanged with their scores */
+    for (i = 0; i < 3; i++) {
+        found = 0;
+        for (j = 0; j < population_size; j++) {
+            if ((genome_hash(population, population->individual[j]) == elite_hash[i]) &&
+                (population->individual[j]->score == elite_score[i]) &&
+                (population->individual[j]->evaluated))
+                found = 1;
+        }
+        assert(found);
+    }
+
+    /* everything else needs to be evaluated */
+    unevaluated = 0;
+    for (i = 0; i < population_size; i++)
+        if (!population->individual[i]->evaluated)
+            unevaluated++;
+    assert(unevaluated == population_size - 3);
+
+    population_free(population);
+    free(population);
+
+    printf("Ok\n");
+}
+
+void test_population_steady_state()
+{
+    sc_population * population = (sc_population*)malloc(sizeof(sc_population));
+    unsigned int random_seed = 9317;
+    int i, gen, unevaluated, population_size = 20;
+
+    printf("test_population_steady_state...");
+
+    assert(test_population_from_memory(population, population_size) == 0);
+    population->replacement = SC_REPLACEMENT_STEADY_STATE;
+    population->steady_state_replacements = 4;
+    assert(population_survivors(population) == population_size - 4);
+
+    for (i = 0; i < population_size; i++)
+        assert(population_set_test_passes(population, i,
+                                          1 + rand_num(&random_seed) % 100) == 0);
+
+    for (gen = 0; gen < 10; gen++) {
+        assert(population_next_generation(population) == 0);
+
+        /* only the replaced genomes need to be evaluated */
+        unevaluated = 0;
+        for (i = 0; i < population_size; i++) {
+            if (population->individual[i]->evaluated)
+                continue;
+            unevaluated++;
+            assert(population_set_test_passes(population, i,
+                                              1 + rand_num(&random_seed) % 100) == 0);
+        }
+        assert(unevaluated == 4);
+
+        /* all genomes are unique */
+        for (i = 0; i < population_size-1; i++)
+            assert(genome_unique(population, population->individual[i], i, 0));
+    }
+    assert(population->evaluations == population_size + 10*4);
+
+    /* at least one new child each generation */
+    population->steady_state_replacements = 0;
+    assert(population_survivors(population) == population_size - 1);
+
+    population_free(population);
+    free(population);
+
+    printf("Ok\n");
+}
+
+/**
+ * @brief Creates a population from a system in memory, with a given seed
+ */
+static void test_population_seeded(sc_population * population, int size,
+                                   unsigned int random_seed)
+{
+    sc_system * sys = (sc_system*)malloc(sizeof(sc_system));
+    sc_goal * goal = (sc_goal*)malloc(sizeof(sc_goal));
+
+    test_state_system(sys, 20);
+    assert(system_create_dependency_matrix(sys) == 0);
+    assert(goal_create_latest_versions(sys, goal) == 0);
+    assert(population_create_seeded(size, population, sys, goal,
+                                    random_seed) == 0);
+
+    free(sys);
+    free(goal);
+}
+
+/**
+ * @brief Evaluation function which only reads the genome
+ */
+static int test_population_evaluate_genome(void * context,
+                                           sc_population * population,
+                                           int index, int * test_passes,
+                                           int * steps_completed,
+                                           float * build_time)
+{
+    sc_genome * individual = population->individual[index];
+
+    (void)context;
+
+    *test_passes = 1 + (individual->random_seed % 50);
+    *steps_completed = individual->steps / 2;
+    *build_time = (float)index;
+    return 0;
+}
+
+void test_population_create_seeded()
+{
+    sc_population * population1 = (sc_population*)malloc(sizeof(sc_population));
+    sc_population * population2 = (sc_population*)malloc(sizeof(sc_population));
+    int i, same = 1;
+
+    printf("test_population_create_seeded...");
+
+    /* the same seed gives the same genomes */
+    test_population_seeded(population1, 30, 2281);
+    test_population_seeded(population2, 30, 2281);
+    for (i = 0; i < population1->size; i++)
+        assert(memcmp(population1->individual[i], population2->individual[i],
+                      genome_size(population1)) == 0);
+    population_free(population2);
+
+    test_population_seeded(population2, 30, 2282);
+    for (i = 0; i < population1->size; i++)
+        if (memcmp(population1->individual[i], population2->individual[i],
+                   genome_size(population1)) != 0)
+            same = 0;
+    assert(!same);
+
+    population_free(population1);
+    population_free(population2);
+    free(population1);
+    free(population2);
+
+    printf("Ok\n");
+}
+
+void test_population_evaluate()
+{
+    sc_population * population1 = (sc_population*)malloc(sizeof(sc_population));
+    sc_population * population2 = (sc_population*)malloc(sizeof(sc_population));
+    int genome_index[40];
+    int i, gen;
+
+    printf("test_population_evaluate...");
+
+    test_population_seeded(population1, 40, 6623);
+    test_population_seeded(population2, 40, 6623);
+    population1->elites = 5;
+    population2->elites = 5;
+
+    /* the number of threads doesn't change the search */
+    for (gen = 0; gen < 5; gen++) {
+        assert(population_evaluate(population1, test_population_evaluate_genome,
+                                   NULL, 1, NULL) == (gen == 0 ? 40 : 35));
+        assert(population_evaluate(population2, test_population_evaluate_genome,
+                                   NULL, 4, genome_index) == (gen == 0 ? 40 : 35));
+
+        /* scores are set in array order */
+        for (i = 1; i < (gen == 0 ? 40 : 35); i++)
+            assert(genome_index[i] > genome_index[i-1]);
+
+        for (i = 0; i < population1->size; i++) {
+            assert(population1->individual[i]->evaluated);
+            assert(population1->individual[i]->score ==
+                   population2->individual[i]->score);
+            assert(population1->individual[i]->steps_completed ==
+                   population2->individual[i]->steps_completed);
+        }
+        assert(population1->evaluations == population2->evaluations);
+
+        /* nothing is left to evaluate */
+        assert(population_evaluate(population1, test_population_evaluate_genome,
+                                   NULL, 2, NULL) == 0);
+
+        assert(population_next_generation(population1) == 0);
+        assert(population_next_generation(population2) == 0);
+    }
+
+    population_free(population1);
+    population_free(population2);
+    free(population1);
+    free(population2);
+
+    printf("Ok\n");
+}
+
+void test_population_partial_score()
+{
+    sc_population * population = (sc_population*)malloc(sizeof(sc_population));
+    sc_genome * individual;
+    float full_score;
+
+    printf("test_population_partial_score...");
+
+    assert(test_population_from_memory(population, 4) == 0);
+    individual = population->individual[0];
+    individual->steps = 3;
+
+    assert(population_set_partial_score(population, 0, 12, 4) == 3);
+    assert(population_set_partial_score(population, 0, 12, -1) == 3);
+
+    /* completing every step gives the same score as the test passes */
+    assert(population_set_partial_score(population, 0, 12, 3) == 0);
+    full_score = individual->score;
+    assert(population_set_test_passes(population, 0, 12) == 0);
+    assert(individual->score == full_score);
+
+    /* the same test passes score less when evaluation ended early */
+    assert(population_set_partial_score(population, 0, 12, 1) == 0);
+    assert(individual->score < full_score);
+    assert(individual->score > 0);
+    assert(population_set_partial_score(population, 0, 12, 0) == 0);
+    assert(individual->score == full_score / 4);
+
+    population_free(population);
+    free(population);
+
+    printf("Ok\n");
+}
+
 void run_population_tests()
 {
     test_population_create();
     test_population_copy();
     test_population_next_generation();
+    test_population_arena();
+    test_population_elitism();
+    test_population_steady_state();
+    test_population_partial_score();
+    test_population_create_seeded();
+    test_population_evaluate();
 }
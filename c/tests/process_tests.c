@@ -0,0 +1,213 @@
+/*
+  Smart search for upgrade paths
+  Copyright (C) 2016 Andrew Leeming <andrew.leeming@codethink.co.uk> and
+  Bob Mottram <bob.mottram@codethink.co.uk>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include "../src/scalam.h"
+
+static double test_process_seconds()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec/1000000000.0;
+}
+
+void test_process_run()
+{
+    char * true_argv[] = { "true", NULL };
+    char * false_argv[] = { "false", NULL };
+    char * exit_argv[] = { "sh", "-c", "exit 3", NULL };
+    char * missing_argv[] = { "scalam_no_such_program", NULL };
+    char * empty_argv[] = { NULL };
+
+    printf("test_process_run...");
+
+    assert(process_run(true_argv, 0, 0) == 0);
+    assert(process_run(false_argv, 0, 0) == 1);
+    assert(process_run(exit_argv, 0, 0) == 3);
+    assert(process_run(missing_argv, 0, 1) == SC_PROCESS_NOT_RUN);
+    assert(process_run(empty_argv, 0, 0) == SC_PROCESS_NOT_RUN);
+
+    printf("Ok\n");
+}
+
+void test_process_run_with_output()
+{
+    char * argv[] = { "printf", "%s\n\n", "foo bar", NULL };
+    char * quoted_argv[] = { "printf", "%s", "a \"b\" $c; d", NULL };
+    char * seq_argv[] = { "seq", "1", "100000", NULL };
+    char output[SC_MAX_STRING];
+    sc_process_result result;
+
+    printf("test_process_run_with_output...");
+
+    /* trailing white space is removed */
+    assert(process_run_with_output(argv, 0, output, SC_MAX_STRING) == 0);
+    assert(strcmp(output, "foo bar") == 0);
+
+    /* output is truncated to fit */
+    assert(process_run_with_output(argv, 0, output, 4) == 0);
+    assert(strcmp(output, "foo") == 0);
+
+    /* arguments are passed as they are, without a shell */
+    assert(process_run_with_output(quoted_argv, 0, output, SC_MAX_STRING) == 0);
+    assert(strcmp(output, "a \"b\" $c; d") == 0);
+
+    /* large output is captured in full */
+    assert(process_run_with_options(seq_argv, NULL, &result) == 0);
+    assert(result.output_length == 588895);
+    assert(strlen(result.output) == result.output_length);
+    assert(strncmp(result.output, "1\n2\n", 4) == 0);
+    assert(strcmp(&result.output[result.output_length-7], "100000\n") == 0);
+    process_result_free(&result);
+    assert(result.output == NULL);
+
+    printf("Ok\n");
+}
+
+void test_process_options()
+{
+    char * pwd_argv[] = { "pwd", NULL };
+    char * cat_argv[] = { "cat", NULL };
+    char * error_argv[] = { "sh", "-c", "echo error >&2; echo output", NULL };
+    char filename[SC_MAX_STRING];
+    char output_filename[SC_MAX_STRING];
+    sc_process_options options;
+    sc_process_result result;
+    FILE * fp;
+    int fd;
+
+    printf("test_process_options...");
+
+    /* running within a directory */
+    process_options_init(&options);
+    options.directory = "/";
+    assert(process_run_with_options(pwd_argv, &options, &result) == 0);
+    assert(strcmp(result.output, "/\n") == 0);
+    process_result_free(&result);
+
+    /* with no input file, standard input is empty */
+    assert(process_run_with_options(cat_argv, NULL, &result) == 0);
+    assert(result.output_length == 0);
+    process_result_free(&result);
+
+    assert(snprintf(filename, sizeof(filename), "/tmp/scalam_process.XXXXXX") <
+           (int)sizeof(filename));
+    fd = mkstemp(filename);
+    assert(fd >= 0);
+    close(fd);
+    fp = fopen(filename, "w");
+    fprintf(fp, "first\nsecond\n");
+    fclose(fp);
+
+    /* standard input from a file */
+    process_options_init(&options);
+    options.input_filename = filename;
+    assert(process_run_with_options(cat_argv, &options, &result) == 0);
+    assert(strcmp(result.output, "first\nsecond\n") == 0);
+    process_result_free(&result);
+
+    /* standard output to a file, which isn't captured */
+    assert(snprintf(output_filename, sizeof(output_filename),
+                    "%s.out", filename) <
+           (int)sizeof(output_filename));
+    options.output_filename = output_filename;
+    options.quiet = 1;
+    assert(process_run_with_options(error_argv, &options, &result) == 0);
+    assert(result.output_length == 0);
+    process_result_free(&result);
+    assert(lines_in_file(output_filename) == 1);
+
+    assert(process_run_to_file(cat_argv, 0, output_filename) == 0);
+    assert(lines_in_file(output_filename) == 0);
+
+    /* the output file can't be created */
+    options.output_filename = "/nonexistent/scalam/output";
+    assert(process_run_with_options(cat_argv, &options, &result) ==
+           SC_PROCESS_NOT_RUN);
+    process_result_free(&result);
+
+    unlink(output_filename);
+    unlink(filename);
+
+    printf("Ok\n");
+}
+
+void test_process_timeout()
+{
+    char * sleep_argv[] = { "sleep", "10", NULL };
+    char * quick_argv[] = { "sleep", "0", NULL };
+    char * background_argv[] = { "sh", "-c", "exec >&-; sleep 10", NULL };
+    sc_process_options options;
+    sc_process_result result;
+    double start_time;
+
+    printf("test_process_timeout...");
+
+    start_time = test_process_seconds();
+    assert(process_run(sleep_argv, 200, 0) == SC_PROCESS_TIMED_OUT);
+    assert(test_process_seconds() - start_time < 5);
+
+    /* still timed out after the output is closed */
+    process_options_init(&options);
+    options.timeout = 200;
+    start_time = test_process_seconds();
+    assert(process_run_with_options(background_argv, &options, &result) ==
+           SC_PROCESS_TIMED_OUT);
+    assert(result.timed_out);
+    process_result_free(&result);
+    assert(test_process_seconds() - start_time < 5);
+
+    /* finishing within the time limit */
+    assert(process_run(quick_argv, 5000, 0) == 0);
+
+    printf("Ok\n");
+}
+
+void test_process_max_running()
+{
+    char * sleep_argv[] = { "sleep", "0.2", NULL };
+    double start_time;
+    int i, status[4];
+
+    printf("test_process_max_running...");
+
+    /* only one process at a time, so they run one after another */
+    process_set_max_running(1);
+    start_time = test_process_seconds();
+#pragma omp parallel for num_threads(4)
+    for (i = 0; i < 4; i++)
+        status[i] = process_run(sleep_argv, 0, 0);
+    assert(test_process_seconds() - start_time >= 0.75);
+    process_set_max_running(0);
+
+    for (i = 0; i < 4; i++)
+        assert(status[i] == 0);
+
+    printf("Ok\n");
+}
+
+void run_process_tests()
+{
+    test_process_run();
+    test_process_run_with_output();
+    test_process_options();
+    test_process_timeout();
+    test_process_max_running();
+}
@@ -97,9 +97,10 @@ void test_program_get_versions_from_git()
 
     printf("test_program_get_versions_from_git...");
 
-    sprintf(&prog.name[0],"%s",program_name);
+    memset((void*)&prog, '\0', sizeof(sc_program));
+    prog.name = string_pool_add(program_name);
     sprintf(rmcommandstr, "rm -rf %s", repos_dir);
-    assert(program_get_versions_from_repo(repos_dir, repo_url, &prog) == 0);
+    assert(program_get_versions_from_repo(repos_dir, repo_url, &prog, NULL) == 0);
 
     /* check that the versions file was created */
     sprintf(filename, "%s/%s/versions.txt", repos_dir, program_name);
@@ -163,7 +164,8 @@ void test_program_get_versions_from_aptitude()
 
     printf("test_program_get_versions_from_aptitude...");
 
-    sprintf(&prog.name[0],"%s",program_name);
+    memset((void*)&prog, '\0', sizeof(sc_program));
+    prog.name = string_pool_add(program_name);
     sprintf(rmcommandstr, "rm -rf %s", repos_dir);
     assert(program_get_versions_from_aptitude(repos_dir, &prog) == 0);
 
@@ -201,23 +203,24 @@ void test_program_name_is_valid()
 
     printf("test_program_name_is_valid...");
 
-    sprintf(&prog.name[0], "%s", "validprogram");
+    memset((void*)&prog, '\0', sizeof(sc_program));
+    prog.name = string_pool_add("validprogram");
     assert(program_name_is_valid(&prog) == 0);
 
     /* can include capitals */
-    sprintf(&prog.name[0], "%s", "ValidProgram");
+    prog.name = string_pool_add("ValidProgram");
     assert(program_name_is_valid(&prog) == 0);
 
     /* empty program name is not valid */
-    sprintf(&prog.name[0], "%s", "");
+    prog.name = string_pool_add("");
     assert(program_name_is_valid(&prog) != 0);
 
     /* null program name is not valid */
-    prog.name[0] = 0;
+    prog.name = 0;
     assert(program_name_is_valid(&prog) != 0);
 
     /* invalid program names */
-    sprintf(&prog.name[0], "%s", "^£!");
+    prog.name = string_pool_add("^£!");
     assert(program_name_is_valid(&prog) != 0);
 
     printf("Ok\n");
@@ -248,7 +251,8 @@ void test_program_get_versions_from_rpm_package()
     char commitstr[SC_MAX_STRING];
     sc_program prog;
 
-    sprintf(&prog.name[0],"%s",program_name);
+    memset((void*)&prog, '\0', sizeof(sc_program));
+    prog.name = string_pool_add(program_name);
     sprintf(rmcommandstr, "rm -rf %s", repos_dir);
     assert(program_get_versions_from_rpm_package(repos_dir, repo_url, &prog) == 0);
 
@@ -296,7 +300,7 @@ void test_program_version_from_index()
 
     assert(lines_in_file(test_filename) == 5);
 
-    sprintf(&prog.versions_file[0],"%s",test_filename);
+    prog.versions_file = string_pool_add(test_filename);
     prog.no_of_versions = lines_in_file(test_filename);
 
     str[0] = 0;
@@ -321,12 +325,282 @@ void test_program_name_from_repo()
     printf("OK\n");
 }
 
+/**
+ * @brief Adds commits to a local git repo
+ */
+static void test_program_add_commits(char * repo_dir, int first, int commits)
+{
+    char commandstr[SC_MAX_STRING*2];
+    int c;
+
+    for (c = first; c < first + commits; c++) {
+        assert(snprintf(commandstr, sizeof(commandstr),
+                        "echo %d > %s/version && git -C %s add version && "
+                        "git -C %s commit -q -m \"version %d\"",
+                        c, repo_dir, repo_dir, repo_dir, c) <
+               (int)sizeof(commandstr));
+        run_shell_command(commandstr);
+    }
+}
+
+void test_program_repo_update_commits()
+{
+    char template[] = "/tmp/scalam.XXXXXX";
+    char * repo_dir = mkdtemp(template);
+    char commandstr[SC_MAX_STRING*2];
+    char version[SC_MAX_STRING], version2[SC_MAX_STRING];
+    char checkout[SC_MAX_STRING];
+    sc_program prog;
+    int new_versions;
+
+    printf("test_program_repo_update_commits...");
+
+    assert(snprintf(commandstr, sizeof(commandstr),
+                    "git init -q -b master %s && "
+                    "git -C %s config user.email test@scalam && "
+                    "git -C %s config user.name scalam",
+                    repo_dir, repo_dir, repo_dir) <
+           (int)sizeof(commandstr));
+    run_shell_command(commandstr);
+    test_program_add_commits(repo_dir, 0, 4);
+
+    /* the first time the whole list is created */
+    memset((void*)&prog, '\0', sizeof(sc_program));
+    assert(program_repo_update_commits(repo_dir, &prog, &new_versions) == 0);
+    assert(new_versions == -1);
+    assert(prog.no_of_versions == 4);
+    assert(program_version_from_index(&prog, 3, version) == 0);
+    assert(program_repo_get_current_checkout(repo_dir, checkout) == 0);
+    assert(strcmp(version, checkout) == 0);
+
+    /* nothing changed */
+    assert(program_repo_update_commits(repo_dir, &prog, &new_versions) == 0);
+    assert(new_versions == 0);
+    assert(prog.no_of_versions == 4);
+
+    /* new commits are added without changing existing indexes */
+    test_program_add_commits(repo_dir, 4, 3);
+    assert(program_repo_update_commits(repo_dir, &prog, &new_versions) == 0);
+    assert(new_versions == 3);
+    assert(prog.no_of_versions == 7);
+    assert(lines_in_file(string_pool_get(prog.versions_file)) == 7);
+    assert(program_version_from_index(&prog, 3, version2) == 0);
+    assert(strcmp(version, version2) == 0);
+    assert(program_version_from_index(&prog, 6, version) == 0);
+    assert(program_repo_get_current_checkout(repo_dir, checkout) == 0);
+    assert(strcmp(version, checkout) == 0);
+
+    /* the same as recreating the list */
+    assert(snprintf(commandstr, sizeof(commandstr),
+                    "rm %s/%s", repo_dir, SC_VERSIONS_METADATA_FILENAME) <
+           (int)sizeof(commandstr));
+    run_shell_command(commandstr);
+    assert(program_repo_update_commits(repo_dir, &prog, &new_versions) == 0);
+    assert(new_versions == -1);
+    assert(prog.no_of_versions == 7);
+    assert(program_version_from_index(&prog, 3, version2) == 0);
+    assert(program_version_from_index(&prog, 6, version) == 0);
+    assert(strcmp(version, checkout) == 0);
+
+    /* rewritten history recreates the list */
+    assert(snprintf(commandstr, sizeof(commandstr),
+                    "git -C %s reset -q --hard HEAD~2", repo_dir) <
+           (int)sizeof(commandstr));
+    run_shell_command(commandstr);
+    test_program_add_commits(repo_dir, 10, 1);
+    assert(program_repo_update_commits(repo_dir, &prog, &new_versions) == 0);
+    assert(new_versions == -1);
+    assert(prog.no_of_versions == 6);
+    assert(lines_in_file(string_pool_get(prog.versions_file)) == 6);
+
+    assert(snprintf(commandstr, sizeof(commandstr), "rm -rf %s", repo_dir) <
+           (int)sizeof(commandstr));
+    run_shell_command(commandstr);
+
+    printf("Ok\n");
+}
+
+/**
+ * @brief Clones a bare repo with the given options, returning the
+ *        number of versions within the clone
+ */
+static int test_program_clone_versions(char * upstream, char * repo_dir,
+                                       sc_clone_options * options,
+                                       sc_program * prog)
+{
+    memset((void*)prog, '\0', sizeof(sc_program));
+    prog->name = string_pool_add("upstream");
+    assert(program_repo_clone(upstream, repo_dir, options) == 0);
+    assert(program_repo_get_commits(repo_dir, prog) == 0);
+    return prog->no_of_versions;
+}
+
+void test_program_repo_clone()
+{
+    char template[] = "/tmp/scalam.XXXXXX";
+    char * tempdir = mkdtemp(template);
+    char commandstr[SC_MAX_STRING*4];
+    char source_dir[SC_MAX_STRING*2];
+    char upstream[SC_MAX_STRING*2];
+    char repos_dir[SC_MAX_STRING*2];
+    char workspaces_dir[SC_MAX_STRING*2];
+    char repo_dir[SC_MAX_STRING*2];
+    char filename[SC_MAX_STRING*4];
+    sc_system * sys = (sc_system*)malloc(sizeof(sc_system));
+    sc_clone_options options;
+    sc_workspace_pool pool;
+    sc_program prog;
+    unsigned char * state;
+    FILE * fp;
+    int p, index, version = -1;
+
+    printf("test_program_repo_clone...");
+
+    /* a bare repo stands in for the upstream, with the start
+       version tagged at the third of five commits */
+    assert(snprintf(source_dir, sizeof(source_dir), "%s/source", tempdir) <
+           (int)sizeof(source_dir));
+    assert(snprintf(commandstr, sizeof(commandstr),
+                    "git init -q -b master %s && "
+                    "git -C %s config user.email test@scalam && "
+                    "git -C %s config user.name scalam",
+                    source_dir, source_dir, source_dir) <
+           (int)sizeof(commandstr));
+    run_shell_command(commandstr);
+    test_program_add_commits(source_dir, 0, 3);
+    assert(snprintf(commandstr, sizeof(commandstr),
+                    "git -C %s tag v2", source_dir) <
+           (int)sizeof(commandstr));
+    run_shell_command(commandstr);
+    test_program_add_commits(source_dir, 3, 2);
+
+    assert(snprintf(upstream, sizeof(upstream), "%s/upstream.git", tempdir) <
+           (int)sizeof(upstream));
+    assert(snprintf(commandstr, sizeof(commandstr),
+                    "git clone -q --bare %s %s && "
+                    "git -C %s config uploadpack.allowFilter true",
+                    source_dir, upstream, upstream) <
+           (int)sizeof(commandstr));
+    run_shell_command(commandstr);
+
+    assert(snprintf(repos_dir, sizeof(repos_dir), "%s/repos", tempdir) <
+           (int)sizeof(repos_dir));
+    mkdir(repos_dir, 0700);
+
+    /* the default is a full clone */
+    assert(snprintf(repo_dir, sizeof(repo_dir), "%s/full", repos_dir) <
+           (int)sizeof(repo_dir));
+    assert(test_program_clone_versions(upstream, repo_dir, NULL, &prog) == 5);
+    assert(snprintf(filename, sizeof(filename), "%s/version", repo_dir) <
+           (int)sizeof(filename));
+    assert(file_exists(filename));
+
+    /* the history window counts back from the head */
+    program_clone_options_init(&options);
+    options.depth = 2;
+    assert(snprintf(repo_dir, sizeof(repo_dir), "%s/depth", repos_dir) <
+           (int)sizeof(repo_dir));
+    assert(test_program_clone_versions(upstream, repo_dir, &options, &prog) == 2);
+
+    /* or from the start version */
+    options.depth = 0;
+    assert(snprintf(options.start_revision, sizeof(options.start_revision),
+                    "v2") <
+           (int)sizeof(options.start_revision));
+    assert(snprintf(repo_dir, sizeof(repo_dir), "%s/since", repos_dir) <
+           (int)sizeof(repo_dir));
+    assert(test_program_clone_versions(upstream, repo_dir, &options, &prog) == 3);
+
+    options.depth = 1;
+    assert(snprintf(repo_dir, sizeof(repo_dir), "%s/since_depth", repos_dir) <
+           (int)sizeof(repo_dir));
+    assert(test_program_clone_versions(upstream, repo_dir, &options, &prog) == 4);
+
+    /* the same options apply when versions are got from a url */
+    options.depth = 2;
+    options.start_revision[0] = 0;
+    memset((void*)&prog, '\0', sizeof(sc_program));
+    prog.name = string_pool_add("from_url");
+    assert(program_get_versions_from_repo(repos_dir, upstream, &prog,
+                                          &options) == 0);
+    assert(prog.no_of_versions == 2);
+
+    /* objects are borrowed from a reference repo */
+    program_clone_options_init(&options);
+    assert(snprintf(options.reference, sizeof(options.reference),
+                    "%s/full", repos_dir) <
+           (int)sizeof(options.reference));
+    assert(snprintf(repo_dir, sizeof(repo_dir), "%s/reference", repos_dir) <
+           (int)sizeof(repo_dir));
+    assert(test_program_clone_versions(upstream, repo_dir, &options, &prog) == 5);
+    assert(snprintf(filename, sizeof(filename),
+                    "%s/.git/objects/info/alternates", repo_dir) <
+           (int)sizeof(filename));
+    assert(file_exists(filename));
+
+    /* invalid options */
+    options.filter = SC_CLONE_TREELESS + 1;
+    assert(snprintf(repo_dir, sizeof(repo_dir), "%s/invalid", repos_dir) <
+           (int)sizeof(repo_dir));
+    assert(program_repo_clone(upstream, repo_dir, &options) != 0);
+    assert(!directory_exists(repo_dir));
+
+    /* A blobless clone without a checkout has versions, but no files
+       until a commit is checked out within a workspace */
+    program_clone_options_init(&options);
+    options.filter = SC_CLONE_BLOBLESS;
+    options.no_checkout = 1;
+    memset((void*)sys, '\0', sizeof(sc_system));
+    p = system_add_program(sys, "lazy");
+    assert(snprintf(repo_dir, sizeof(repo_dir), "%s/lazy", repos_dir) <
+           (int)sizeof(repo_dir));
+    assert(program_repo_clone(upstream, repo_dir, &options) == 0);
+    assert(program_repo_get_commits(repo_dir, &sys->program[p]) == 0);
+    assert(sys->program[p].no_of_versions == 5);
+    assert(program_repo_get_current_version(repo_dir, &sys->program[p]) == 0);
+    assert(sys->program[p].version_index == 4);
+    assert(snprintf(filename, sizeof(filename), "%s/version", repo_dir) <
+           (int)sizeof(filename));
+    assert(!file_exists(filename));
+    assert(state_layout_create(sys) == 0);
+
+    assert(snprintf(workspaces_dir, sizeof(workspaces_dir),
+                    "%s/workspaces", tempdir) <
+           (int)sizeof(workspaces_dir));
+    assert(workspace_pool_create(&pool, repos_dir, workspaces_dir, 1) == 0);
+    index = workspace_acquire(&pool);
+    state = (unsigned char*)malloc(sys->state_bytes);
+    memset((void*)state, '\0', sys->state_bytes);
+    state_set_installed(sys, state, p, 1);
+    state_set_version(sys, state, p, 1);
+    assert(workspace_checkout(&pool, index, sys, state) == 0);
+    workspace_program_directory(&pool, index, sys, p, filename);
+    strcat(filename, "/version");
+    fp = fopen(filename, "r");
+    assert(fp != NULL);
+    assert(fscanf(fp, "%d", &version) == 1);
+    fclose(fp);
+    assert(version == 1);
+    workspace_release(&pool, index);
+    workspace_pool_free(&pool, sys);
+
+    assert(snprintf(commandstr, sizeof(commandstr), "rm -rf %s", tempdir) <
+           (int)sizeof(commandstr));
+    run_shell_command(commandstr);
+    free(state);
+    free(sys);
+
+    printf("Ok\n");
+}
+
 void run_program_tests()
 {
     test_program_name_is_valid();
     test_program_name_from_repo();
     test_program_version_from_index();
     test_program_repo_get_current_checkout();
+    test_program_repo_update_commits();
+    test_program_repo_clone();
     test_program_get_versions_from_git();
     test_program_get_versions_from_changelog();
     test_program_get_versions_from_tarball();
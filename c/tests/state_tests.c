@@ -0,0 +1,354 @@
+/*
+  Smart search for upgrade paths
+  Copyright (C) 2016 Andrew Leeming <andrew.leeming@codethink.co.uk> and
+  Bob Mottram <bob.mottram@codethink.co.uk>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include "../src/scalam.h"
+
+/**
+ * @brief Creates a system with a mixture of small and large version counts.
+ *        No repos are needed since only the number of versions matters
+ *        for packing.
+ * @param sys Returned system object
+ * @param no_of_programs The number of programs in the system
+ */
+void test_state_system(sc_system * sys, int no_of_programs)
+{
+    int p;
+    int versions[] = { 12, 300, 70000, 255, 256, 65535 };
+
+    memset((void*)sys, '\0', sizeof(sc_system));
+    sys->no_of_programs = no_of_programs;
+    for (p = 0; p < no_of_programs; p++) {
+        sys->program[p].name = string_pool_printf("program%d", p);
+        sys->program[p].no_of_versions = versions[p % 6];
+    }
+    assert(state_layout_create(sys) == 0);
+}
+
+void test_state_layout()
+{
+    sc_system * sys = (sc_system*)malloc(sizeof(sc_system));
+    int p, width, installed_bytes;
+
+    printf("test_state_layout...");
+
+    test_state_system(sys, 130);
+
+    /* three 64 bit words for 130 installed flags */
+    assert(sys->installed_words == 3);
+    installed_bytes = sys->installed_words * (int)sizeof(uint64_t);
+
+    for (p = 0; p < sys->no_of_programs; p++) {
+        width = sys->version_width[p];
+
+        /* the narrowest width which can hold the number of versions */
+        if (sys->program[p].no_of_versions < 256)
+            assert(width == 1);
+        else if (sys->program[p].no_of_versions < 65536)
+            assert(width == 2);
+        else
+            assert(width == 4);
+
+        /* versions are after the installed flags, aligned and within the state */
+        assert(sys->version_offset[p] >= installed_bytes);
+        assert(sys->version_offset[p] % width == 0);
+        assert(sys->version_offset[p] + width <= sys->state_bytes);
+    }
+
+    /* consecutive states remain aligned */
+    assert(sys->state_bytes % sizeof(uint64_t) == 0);
+
+    /* much smaller than the unpacked form */
+    assert(sys->state_bytes * 2 < sys->no_of_programs *
+           (sizeof(int) + sizeof(unsigned char)));
+
+    free(sys);
+
+    printf("Ok\n");
+}
+
+void test_state_pack()
+{
+    sc_system * sys = (sc_system*)malloc(sizeof(sc_system));
+    sc_system_state * unpacked = (sc_system_state*)malloc(sizeof(sc_system_state));
+    sc_system_state * result = (sc_system_state*)malloc(sizeof(sc_system_state));
+    unsigned char * state;
+    unsigned int random_seed = 5327;
+    int p;
+
+    printf("test_state_pack...");
+
+    test_state_system(sys, 200);
+    state = (unsigned char*)malloc(sys->state_bytes);
+
+    for (p = 0; p < sys->no_of_programs; p++) {
+        unpacked->version_index[p] =
+            rand_num(&random_seed) % sys->program[p].no_of_versions;
+        unpacked->installed[p] = rand_num(&random_seed) % 2;
+    }
+
+    /* the largest version index for each width */
+    unpacked->version_index[3] = 255;
+    unpacked->version_index[5] = 65535;
+
+    state_pack(sys, unpacked, state);
+
+    for (p = 0; p < sys->no_of_programs; p++) {
+        assert(state_get_version(sys, state, p) == unpacked->version_index[p]);
+        assert(state_get_installed(sys, state, p) == unpacked->installed[p]);
+    }
+
+    state_unpack(sys, state, result);
+    for (p = 0; p < sys->no_of_programs; p++) {
+        assert(result->version_index[p] == unpacked->version_index[p]);
+        assert(result->installed[p] == unpacked->installed[p]);
+    }
+
+    /* setting one program leaves its neighbours alone */
+    state_set_version(sys, state, 2, 69999);
+    state_set_installed(sys, state, 64, !unpacked->installed[64]);
+    for (p = 0; p < sys->no_of_programs; p++) {
+        if (p == 2)
+            assert(state_get_version(sys, state, p) == 69999);
+        else
+            assert(state_get_version(sys, state, p) == unpacked->version_index[p]);
+
+        if (p == 64)
+            assert(state_get_installed(sys, state, p) != unpacked->installed[p]);
+        else
+            assert(state_get_installed(sys, state, p) == unpacked->installed[p]);
+    }
+
+    /* programs outside of the system are ignored */
+    state_set_installed(sys, state, sys->no_of_programs, 1);
+    assert(state_get_installed(sys, state, sys->no_of_programs) == 0);
+    assert(state_get_installed(sys, state, -1) == 0);
+
+    free(state);
+    free(unpacked);
+    free(result);
+    free(sys);
+
+    printf("Ok\n");
+}
+
+void test_state_cmp_hash_distance()
+{
+    sc_system * sys = (sc_system*)malloc(sizeof(sc_system));
+    unsigned char * state1, * state2;
+    unsigned int random_seed = 8261;
+    int i, p, expected;
+
+    printf("test_state_cmp_hash_distance...");
+
+    test_state_system(sys, 100);
+    state1 = (unsigned char*)malloc(sys->state_bytes);
+    state2 = (unsigned char*)malloc(sys->state_bytes);
+    memset((void*)state1, '\0', sys->state_bytes);
+
+    for (p = 0; p < sys->no_of_programs; p++) {
+        state_set_version(sys, state1, p,
+                          rand_num(&random_seed) % sys->program[p].no_of_versions);
+        state_set_installed(sys, state1, p, rand_num(&random_seed) % 2);
+    }
+    memcpy((void*)state2, (void*)state1, sys->state_bytes);
+
+    assert(state_cmp(sys, state1, state2) == 0);
+    assert(state_hash(sys, state1, 2166136261U) ==
+           state_hash(sys, state2, 2166136261U));
+    assert(state_distance(sys, state1, state2) == 0);
+
+    /* change the version of one program */
+    state_set_version(sys, state2, 7, (state_get_version(sys, state1, 7) + 1) %
+                      sys->program[7].no_of_versions);
+    assert(state_cmp(sys, state1, state2) != 0);
+    assert(state_hash(sys, state1, 2166136261U) !=
+           state_hash(sys, state2, 2166136261U));
+    assert(state_distance(sys, state1, state2) == 1);
+
+    /* install status of the same program only counts once */
+    state_set_installed(sys, state2, 7, !state_get_installed(sys, state1, 7));
+    assert(state_distance(sys, state1, state2) == 1);
+
+    /* another program in a different installed word */
+    state_set_installed(sys, state2, 90, !state_get_installed(sys, state1, 90));
+    assert(state_distance(sys, state1, state2) == 2);
+
+    /* the same as comparing gene by gene, for every width of version */
+    for (i = 0; i < 20; i++) {
+        for (p = 0; p < sys->no_of_programs; p++) {
+            if (rand_num(&random_seed) % 4 == 0)
+                state_set_version(sys, state2, p,
+                                  rand_num(&random_seed) %
+                                  sys->program[p].no_of_versions);
+            if (rand_num(&random_seed) % 4 == 0)
+                state_set_installed(sys, state2, p, rand_num(&random_seed) % 2);
+        }
+        expected = 0;
+        for (p = 0; p < sys->no_of_programs; p++)
+            if ((state_get_version(sys, state1, p) !=
+                 state_get_version(sys, state2, p)) ||
+                (state_get_installed(sys, state1, p) !=
+                 state_get_installed(sys, state2, p)))
+                expected++;
+        assert(state_distance(sys, state1, state2) == expected);
+    }
+
+    free(state1);
+    free(state2);
+    free(sys);
+
+    printf("Ok\n");
+}
+
+void test_state_changed_programs()
+{
+    sc_system * sys = (sc_system*)malloc(sizeof(sc_system));
+    unsigned char * state1, * state2;
+    int changed[SC_MAX_SYSTEM_SIZE];
+    int p, i, offset, found[4] = {0, 0, 0, 0};
+    int expected[] = { 2, 65, 100, 129 };
+
+    printf("test_state_changed_programs...");
+
+    test_state_system(sys, 130);
+
+    /* every version index can be traced back from its offset */
+    for (p = 0; p < sys->no_of_programs; p++)
+        assert(state_program_at(sys, sys->version_offset[p]) == p);
+    assert(state_program_at(sys, 0) == -1);
+    for (offset = 0; offset < sys->state_bytes; offset++) {
+        p = state_program_at(sys, offset);
+        if (p >= 0)
+            assert(sys->version_offset[p] == offset);
+    }
+
+    state1 = (unsigned char*)malloc(sys->state_bytes);
+    state2 = (unsigned char*)malloc(sys->state_bytes);
+    memset((void*)state1, '\0', sys->state_bytes);
+    for (p = 0; p < sys->no_of_programs; p++) {
+        state_set_installed(sys, state1, p, p % 2);
+        state_set_version(sys, state1, p, p % 11);
+    }
+    memcpy((void*)state2, (void*)state1, sys->state_bytes);
+    assert(state_changed_programs(sys, state1, state2, changed) == 0);
+
+    /* flag only, version only, both, and the last program */
+    state_set_installed(sys, state2, 2, 1);
+    state_set_version(sys, state2, 65, 3);
+    state_set_installed(sys, state2, 100, 1);
+    state_set_version(sys, state2, 100, 7);
+    state_set_version(sys, state2, 129, 0);
+
+    /* each changed program is found once */
+    assert(state_changed_programs(sys, state1, state2, NULL) == 4);
+    assert(state_changed_programs(sys, state1, state2, changed) == 4);
+    for (i = 0; i < 4; i++)
+        for (p = 0; p < 4; p++)
+            if (changed[i] == expected[p])
+                found[p]++;
+    for (p = 0; p < 4; p++)
+        assert(found[p] == 1);
+
+    free(state1);
+    free(state2);
+    free(sys);
+
+    printf("Ok\n");
+}
+
+void test_state_crossover()
+{
+    sc_system * sys = (sc_system*)malloc(sizeof(sc_system));
+    unsigned char * state1, * state2, * child;
+    uint64_t mask[(SC_MAX_SYSTEM_SIZE + 63) / 64];
+    unsigned int random_seed = 5127;
+    int i, p, parent, from2 = 0;
+
+    printf("test_state_crossover...");
+
+    test_state_system(sys, 130);
+    state1 = (unsigned char*)malloc(sys->state_bytes);
+    state2 = (unsigned char*)malloc(sys->state_bytes);
+    child = (unsigned char*)malloc(sys->state_bytes);
+    memset((void*)state1, '\0', sys->state_bytes);
+    memset((void*)state2, '\0', sys->state_bytes);
+
+    for (p = 0; p < sys->no_of_programs; p++) {
+        state_set_version(sys, state1, p,
+                          rand_num(&random_seed) % sys->program[p].no_of_versions);
+        state_set_installed(sys, state1, p, rand_num(&random_seed) % 2);
+        state_set_version(sys, state2, p,
+                          rand_num(&random_seed) % sys->program[p].no_of_versions);
+        state_set_installed(sys, state2, p, rand_num(&random_seed) % 2);
+    }
+
+    /* nothing from the second parent */
+    memset((void*)mask, '\0', sizeof(mask));
+    state_crossover(sys, state1, state2, mask, child);
+    assert(state_cmp(sys, child, state1) == 0);
+
+    /* everything from the second parent */
+    for (i = 0; i < sys->installed_words; i++)
+        mask[i] = ~(uint64_t)0;
+    state_crossover(sys, state1, state2, mask, child);
+    assert(state_cmp(sys, child, state2) == 0);
+
+    /* each gene comes from the parent given by the mask */
+    memset((void*)mask, '\0', sizeof(mask));
+    for (p = 0; p < sys->no_of_programs; p++) {
+        if (rand_num(&random_seed) % 2) {
+            mask[p >> 6] |= (uint64_t)1 << (p & 63);
+            from2++;
+        }
+    }
+    assert((from2 > 0) && (from2 < sys->no_of_programs));
+    state_crossover(sys, state1, state2, mask, child);
+    for (p = 0; p < sys->no_of_programs; p++) {
+        parent = (int)((mask[p >> 6] >> (p & 63)) & 1);
+        assert(state_get_version(sys, child, p) ==
+               state_get_version(sys, parent ? state2 : state1, p));
+        assert(state_get_installed(sys, child, p) ==
+               state_get_installed(sys, parent ? state2 : state1, p));
+    }
+
+    /* the child is the same as one built gene by gene */
+    memset((void*)state1, '\0', sys->state_bytes);
+    for (p = 0; p < sys->no_of_programs; p++) {
+        state_set_version(sys, state1, p, state_get_version(sys, child, p));
+        state_set_installed(sys, state1, p, state_get_installed(sys, child, p));
+    }
+    assert(state_cmp(sys, child, state1) == 0);
+
+    free(state1);
+    free(state2);
+    free(child);
+    free(sys);
+
+    printf("Ok\n");
+}
+
+void run_state_tests()
+{
+    test_state_layout();
+    test_state_pack();
+    test_state_cmp_hash_distance();
+    test_state_crossover();
+    test_state_changed_programs();
+}
@@ -0,0 +1,134 @@
+/*
+  Smart search for upgrade paths
+  Copyright (C) 2016 Andrew Leeming <andrew.leeming@codethink.co.uk> and
+  Bob Mottram <bob.mottram@codethink.co.uk>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include "../src/scalam.h"
+
+void test_string_pool_add()
+{
+    sc_string a, b, c;
+
+    printf("test_string_pool_add...");
+
+    /* the empty string is always zero */
+    assert(string_pool_add("") == 0);
+    assert(string_pool_add(NULL) == 0);
+    assert(string_pool_get(0)[0] == 0);
+
+    a = string_pool_add("test_string_pool_a");
+    b = string_pool_add("test_string_pool_b");
+    assert(a != 0);
+    assert(b != 0);
+    assert(a != b);
+    assert(strcmp(string_pool_get(a), "test_string_pool_a") == 0);
+    assert(strcmp(string_pool_get(b), "test_string_pool_b") == 0);
+
+    /* equal strings are only stored once */
+    c = string_pool_add("test_string_pool_a");
+    assert(c == a);
+    assert(string_pool_add_length("test_string_pool_abc", 18) == a);
+    assert(string_pool_printf("test_string_pool_%c", 'b') == b);
+
+    /* a prefix of an existing string is a different string */
+    c = string_pool_add_length("test_string_pool_a", 10);
+    assert((c != 0) && (c != a));
+    assert(strcmp(string_pool_get(c), "test_strin") == 0);
+
+    printf("Ok\n");
+}
+
+void test_string_pool_long_strings()
+{
+    int length = SC_STRING_POOL_BLOCK_SIZE + 100, i;
+    char * str = (char*)malloc(length + 1);
+    sc_string s, t, u;
+
+    printf("test_string_pool_long_strings...");
+
+    for (i = 0; i < length; i++)
+        str[i] = 'a' + (i % 26);
+    str[length] = 0;
+
+    /* longer than a block */
+    s = string_pool_add(str);
+    assert(s != 0);
+    assert(strlen(string_pool_get(s)) == length);
+    assert(strcmp(string_pool_get(s), str) == 0);
+
+    /* strings added afterwards are unaffected */
+    t = string_pool_add("test_string_pool_after_long");
+    assert(strcmp(string_pool_get(t), "test_string_pool_after_long") == 0);
+    assert(strcmp(string_pool_get(s), str) == 0);
+
+    /* formatting is not truncated at SC_MAX_STRING */
+    str[SC_MAX_STRING*2] = 0;
+    u = string_pool_printf("%s/versions.txt", str);
+    assert(strlen(string_pool_get(u)) == SC_MAX_STRING*2 + 13);
+    assert(strncmp(string_pool_get(u), str, SC_MAX_STRING*2) == 0);
+    assert(strcmp(&string_pool_get(u)[SC_MAX_STRING*2], "/versions.txt") == 0);
+
+    free(str);
+
+    printf("Ok\n");
+}
+
+void test_string_pool_threads()
+{
+    sc_string s[4][500];
+    int t, i;
+
+    printf("test_string_pool_threads...");
+
+    /* threads adding the same strings at the same time get the same result */
+#pragma omp parallel for num_threads(4)
+    for (t = 0; t < 4; t++) {
+        int j;
+        for (j = 0; j < 500; j++)
+            s[t][j] = string_pool_printf("test_string_pool_thread%d", j);
+    }
+
+    for (i = 0; i < 500; i++) {
+        char expected[SC_MAX_STRING];
+
+        sprintf(expected, "test_string_pool_thread%d", i);
+        assert(strcmp(string_pool_get(s[0][i]), expected) == 0);
+        for (t = 1; t < 4; t++)
+            assert(s[t][i] == s[0][i]);
+    }
+
+    printf("Ok\n");
+}
+
+void test_string_pool_program_size()
+{
+    printf("test_string_pool_program_size...");
+
+    /* programs only contain numbers, so fit within a cache line */
+    assert(sizeof(sc_program) <= SC_ARENA_ALIGNMENT);
+
+    printf("Ok\n");
+}
+
+void run_string_pool_tests()
+{
+    test_string_pool_add();
+    test_string_pool_long_strings();
+    test_string_pool_threads();
+    test_string_pool_program_size();
+}
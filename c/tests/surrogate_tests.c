@@ -0,0 +1,161 @@
+/*
+  Smart search for upgrade paths
+  Copyright (C) 2016 Andrew Leeming <andrew.leeming@codethink.co.uk> and
+  Bob Mottram <bob.mottram@codethink.co.uk>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include "../src/scalam.h"
+
+void test_surrogate_enable()
+{
+    sc_population * population = (sc_population*)malloc(sizeof(sc_population));
+    sc_surrogate * surrogate;
+
+    printf("test_surrogate_enable...");
+
+    assert(test_population_from_memory(population, 8) == 0);
+    assert(population->surrogate == NULL);
+
+    /* program 1 depends upon programs 0 and 3, and program 4 upon 1 */
+    population->sys.dependency_probability[1][0] = 1;
+    population->sys.dependency_probability[1][3] = 1;
+    population->sys.dependency_probability[4][1] = 1;
+
+    assert(population_surrogate_enable(population) == 0);
+    surrogate = population->surrogate;
+    assert(surrogate != NULL);
+    assert(surrogate->oversample == SC_DEFAULT_SURROGATE_OVERSAMPLE);
+
+    assert(surrogate->dependency_start[1] == 0);
+    assert(surrogate->dependency_start[2] == 2);
+    assert(surrogate->dependency[0] == 0);
+    assert(surrogate->dependency[1] == 3);
+    assert(surrogate->dependency_start[4] == 2);
+    assert(surrogate->dependency[2] == 1);
+    assert(surrogate->dependency_start[population->sys.no_of_programs] == 3);
+
+    /* nothing learned yet */
+    assert(surrogate_predict(population, population->individual[0]) == 0.5f);
+    assert(surrogate_accuracy(surrogate) == 0);
+
+    population_free(population);
+    assert(population->surrogate == NULL);
+    free(population);
+
+    printf("Ok\n");
+}
+
+void test_surrogate_train()
+{
+    sc_population * population = (sc_population*)malloc(sizeof(sc_population));
+    sc_population * copy = (sc_population*)malloc(sizeof(sc_population));
+    sc_genome * good, * bad;
+    int i, good_index = 1, bad_index = 2;
+
+    printf("test_surrogate_train...");
+
+    assert(test_population_from_memory(population, 8) == 0);
+    assert(population_surrogate_enable(population) == 0);
+    population->surrogate->min_samples = 10;
+
+    /* genomes with at least one step, which differ from each other */
+    if (population->individual[good_index]->steps == 0) good_index = 3;
+    if (population->individual[bad_index]->steps == 0) bad_index = 4;
+    good = population->individual[good_index];
+    bad = population->individual[bad_index];
+    assert(genome_hash(population, good) != genome_hash(population, bad));
+
+    for (i = 0; i < 50; i++) {
+        assert(population_set_test_passes(population, good_index, 100) == 0);
+        assert(population_set_test_passes(population, bad_index, 0) == 0);
+    }
+    assert(population->surrogate->samples == 100);
+
+    /* the good genome is predicted to score higher than the bad one */
+    assert(surrogate_predict(population, good) > 0.5f);
+    assert(surrogate_predict(population, bad) < 0.5f);
+
+    /* predictions were only checked after the first few samples */
+    assert(population->surrogate->predictions == 90);
+    assert(surrogate_accuracy(population->surrogate) > 0.5f);
+
+    /* copies predict the same */
+    assert(population_copy(copy, population) == 0);
+    assert(copy->surrogate != NULL);
+    assert(copy->surrogate != population->surrogate);
+    assert(surrogate_predict(copy, copy->individual[1]) ==
+           surrogate_predict(population, population->individual[1]));
+
+    population_free(copy);
+    free(copy);
+    population_free(population);
+    free(population);
+
+    printf("Ok\n");
+}
+
+void test_surrogate_screening()
+{
+    sc_population * population = (sc_population*)malloc(sizeof(sc_population));
+    unsigned int random_seed = 3562;
+    int i, j, generation;
+
+    printf("test_surrogate_screening...");
+
+    assert(test_population_from_memory(population, 32) == 0);
+    population->random_seed = 8271;
+    assert(population_surrogate_enable(population) == 0);
+    population->surrogate->min_samples = 2 * population->size;
+
+    for (generation = 0; generation < 3; generation++) {
+        for (i = 0; i < population->size; i++)
+            assert(population_set_test_passes(population, i,
+                                              1 + rand_num(&random_seed) % 100) == 0);
+        assert(population_next_generation(population) == 0);
+
+        /* the first generation only trains the model */
+        if (generation == 0)
+            assert(population->surrogate->children_screened == 0);
+    }
+
+    /* oversampled candidates were screened out by prediction */
+    assert(population->surrogate->children_screened > 0);
+    assert(population->surrogate->children_screened <=
+           2 * population->size * (population->surrogate->oversample - 1));
+    assert(population->surrogate->predictions == population->size);
+
+    /* children are still unique */
+    for (i = 0; i < population->size; i++)
+        for (j = i + 1; j < population->size; j++)
+            if (population->individual[i]->steps == population->individual[j]->steps)
+                assert(memcmp((void*)population->individual[i]->change,
+                              (void*)population->individual[j]->change,
+                              (size_t)population->individual[i]->steps *
+                              population->sys.state_bytes) != 0);
+
+    population_free(population);
+    free(population);
+
+    printf("Ok\n");
+}
+
+void run_surrogate_tests()
+{
+    test_surrogate_enable();
+    test_surrogate_train();
+    test_surrogate_screening();
+}
@@ -0,0 +1,257 @@
+/*
+  Smart search for upgrade paths
+  Copyright (C) 2016 Andrew Leeming <andrew.leeming@codethink.co.uk> and
+  Bob Mottram <bob.mottram@codethink.co.uk>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include "../src/scalam.h"
+
+/**
+ * @brief Returns the number of lines within a file
+ */
+static int test_sweep_lines(char * filename)
+{
+    FILE * fp;
+    char linestr[SC_MAX_STRING];
+    int lines = 0;
+
+    fp = fopen(filename, "r");
+    assert(fp != NULL);
+    while (fgets(linestr, SC_MAX_STRING, fp) != NULL)
+        lines++;
+    fclose(fp);
+    return lines;
+}
+
+void test_sweep_grid()
+{
+    sc_sweep sweep;
+    int i;
+
+    printf("test_sweep_grid...");
+
+    assert(sweep_create(&sweep, 0, 10, 1, NULL) != 0);
+    assert(sweep_create(&sweep, 10, 0, 1, NULL) != 0);
+    assert(sweep_create(&sweep, 10, 10, 1, NULL) == 0);
+
+    sweep.range[SC_SWEEP_POPULATION_SIZE].minimum = 10;
+    sweep.range[SC_SWEEP_POPULATION_SIZE].maximum = 20;
+    sweep.range[SC_SWEEP_POPULATION_SIZE].steps = 2;
+    sweep.range[SC_SWEEP_MUTATION_RATE].minimum = 0.1f;
+    sweep.range[SC_SWEEP_MUTATION_RATE].steps = 1;
+    sweep.range[SC_SWEEP_CROSSOVER].minimum = 0.2f;
+    sweep.range[SC_SWEEP_CROSSOVER].maximum = 0.6f;
+    sweep.range[SC_SWEEP_CROSSOVER].steps = 3;
+    sweep.range[SC_SWEEP_REBELS].minimum = 0.05f;
+    sweep.range[SC_SWEEP_REBELS].steps = 1;
+
+    assert(sweep_grid(&sweep, 0, 1) != 0);
+    assert(sweep_grid(&sweep, 2, 5381) == 0);
+    assert(sweep.no_of_points == 6);
+    assert(sweep.no_of_runs == 12);
+
+    for (i = 0; i < sweep.no_of_runs; i++) {
+        /* repeats are adjacent, with the same parameters */
+        assert(sweep.run[i].point == i / 2);
+        assert((sweep.run[i].population_size == 10) ||
+               (sweep.run[i].population_size == 20));
+        assert(fabs(sweep.run[i].mutation_rate - 0.1f) < 0.0001f);
+        assert(fabs(sweep.run[i].rebels - 0.05f) < 0.0001f);
+        assert(sweep.run[i].crossover > 0.19f);
+        assert(sweep.run[i].crossover < 0.61f);
+        if (i % 2 == 1) {
+            assert(sweep.run[i].population_size == sweep.run[i-1].population_size);
+            assert(sweep.run[i].crossover == sweep.run[i-1].crossover);
+            assert(sweep.run[i].random_seed != sweep.run[i-1].random_seed);
+        }
+    }
+
+    /* the first axis varies fastest */
+    assert(sweep.run[0].population_size == 10);
+    assert(sweep.run[2].population_size == 20);
+    assert(fabs(sweep.run[4].crossover - 0.4f) < 0.0001f);
+
+    sweep_free(&sweep);
+
+    printf("Ok\n");
+}
+
+void test_sweep_random()
+{
+    sc_sweep sweep1, sweep2;
+    int i, p;
+
+    printf("test_sweep_random...");
+
+    assert(sweep_create(&sweep1, 10, 10, 1, NULL) == 0);
+    assert(sweep_create(&sweep2, 10, 10, 1, NULL) == 0);
+    assert(sweep_random(&sweep1, 0, 1, 1) != 0);
+    assert(sweep_random(&sweep1, 20, 3, 6211) == 0);
+    assert(sweep_random(&sweep2, 20, 3, 6211) == 0);
+    assert(sweep1.no_of_points == 20);
+    assert(sweep1.no_of_runs == 60);
+
+    for (i = 0; i < sweep1.no_of_runs; i++) {
+        /* the same seed gives the same samples */
+        assert(memcmp(&sweep1.run[i], &sweep2.run[i],
+                      sizeof(sc_sweep_run)) == 0);
+
+        for (p = 0; p < SC_SWEEP_PARAMETERS; p++)
+            assert(sweep1.range[p].maximum > sweep1.range[p].minimum);
+        assert(sweep1.run[i].population_size >=
+               (int)sweep1.range[SC_SWEEP_POPULATION_SIZE].minimum);
+        assert(sweep1.run[i].population_size <=
+               (int)sweep1.range[SC_SWEEP_POPULATION_SIZE].maximum);
+        assert(sweep1.run[i].mutation_rate >=
+               sweep1.range[SC_SWEEP_MUTATION_RATE].minimum);
+        assert(sweep1.run[i].mutation_rate <=
+               sweep1.range[SC_SWEEP_MUTATION_RATE].maximum);
+        assert(sweep1.run[i].point == i / 3);
+    }
+
+    sweep_free(&sweep1);
+    sweep_free(&sweep2);
+
+    printf("Ok\n");
+}
+
+void test_sweep_run()
+{
+    sc_sweep sweep1, sweep2;
+    char * filename = "/tmp/scalam_test_sweep.csv";
+    char * summary_filename = "/tmp/scalam_test_sweep_summary.csv";
+    int i;
+
+    printf("test_sweep_run...");
+
+    assert(sweep_create(&sweep1, 12, 20, 7281, NULL) == 0);
+    sweep1.range[SC_SWEEP_POPULATION_SIZE].minimum = 8;
+    sweep1.range[SC_SWEEP_POPULATION_SIZE].maximum = 32;
+    sweep1.range[SC_SWEEP_MUTATION_RATE].steps = 2;
+    sweep1.range[SC_SWEEP_CROSSOVER].steps = 1;
+    sweep1.range[SC_SWEEP_REBELS].steps = 1;
+    assert(sweep_grid(&sweep1, 2, 4422) == 0);
+    assert(sweep1.no_of_runs == 12);
+
+    memcpy((void*)&sweep2, (void*)&sweep1, sizeof(sc_sweep));
+    sweep2.run = (sc_sweep_run*)malloc(sweep1.max_runs*sizeof(sc_sweep_run));
+    memcpy((void*)sweep2.run, (void*)sweep1.run,
+           sweep1.no_of_runs*sizeof(sc_sweep_run));
+
+    /* results don't depend upon the number of threads */
+    assert(sweep_run(&sweep1, 4) == 0);
+    assert(sweep_run(&sweep2, 1) == 0);
+    for (i = 0; i < sweep1.no_of_runs; i++) {
+        assert(sweep1.run[i].status == 0);
+        assert(sweep1.run[i].generations > 0);
+        assert(sweep1.run[i].evaluations > 0);
+        assert(sweep1.run[i].generations == sweep2.run[i].generations);
+        assert(sweep1.run[i].evaluations == sweep2.run[i].evaluations);
+        assert(sweep1.run[i].evaluations_to_solution ==
+               sweep2.run[i].evaluations_to_solution);
+        assert(sweep1.run[i].best_score == sweep2.run[i].best_score);
+    }
+
+    /* a row for each run and each point, plus headers */
+    assert(sweep_save(&sweep1, filename) == 0);
+    assert(test_sweep_lines(filename) == sweep1.no_of_runs + 1);
+    assert(sweep_save_summary(&sweep1, summary_filename) == 0);
+    assert(test_sweep_lines(summary_filename) == sweep1.no_of_points + 1);
+    assert(sweep_save(&sweep1, "/tmp/scalam_missing/sweep.csv") != 0);
+
+    unlink(filename);
+    unlink(summary_filename);
+    sweep_free(&sweep1);
+    sweep_free(&sweep2);
+
+    printf("Ok\n");
+}
+
+void test_sweep_ranges()
+{
+    sc_sweep_range range[SC_SWEEP_PARAMETERS];
+    sc_sweep sweep;
+    char * filename = "/tmp/scalam_test_sweep_ranges.txt";
+    FILE * fp;
+
+    printf("test_sweep_ranges...");
+
+    sweep_ranges_init(range);
+    assert(sweep_range_parse(range, "mutation=0.01:0.5:6") == 0);
+    assert(fabs(range[SC_SWEEP_MUTATION_RATE].minimum - 0.01f) < 0.0001f);
+    assert(fabs(range[SC_SWEEP_MUTATION_RATE].maximum - 0.5f) < 0.0001f);
+    assert(range[SC_SWEEP_MUTATION_RATE].steps == 6);
+
+    /* a single value fixes the parameter */
+    assert(sweep_range_parse(range, "rebels=0.1") == 0);
+    assert(fabs(range[SC_SWEEP_REBELS].maximum - 0.1f) < 0.0001f);
+    assert(range[SC_SWEEP_REBELS].steps == 1);
+
+    /* without a number of steps only the ends are used */
+    assert(sweep_range_parse(range, "population=8:64") == 0);
+    assert(range[SC_SWEEP_POPULATION_SIZE].steps == 2);
+
+    /* invalid specifications leave the ranges unchanged */
+    assert(sweep_range_parse(range, "unknown=1:2:3") != 0);
+    assert(sweep_range_parse(range, "mutation") != 0);
+    assert(sweep_range_parse(range, "mutation=") != 0);
+    assert(sweep_range_parse(range, "crossover=0.8:0.2:3") != 0);
+    assert(sweep_range_parse(range, "crossover=0.2:1.5:3") != 0);
+    assert(sweep_range_parse(range, "population=1:10:2") != 0);
+    assert(sweep_range_parse(range, "mutation=0.1:0.2:0") != 0);
+    assert(range[SC_SWEEP_MUTATION_RATE].steps == 6);
+
+    /* the sweep covers the given ranges */
+    assert(sweep_create(&sweep, 10, 10, 1, range) == 0);
+    assert(sweep_grid(&sweep, 1, 1) == 0);
+    assert(sweep.no_of_points == 2*6*3*1);
+    assert(sweep.run[0].population_size == 8);
+    assert(fabs(sweep.run[0].rebels - 0.1f) < 0.0001f);
+    sweep_free(&sweep);
+
+    range[SC_SWEEP_CROSSOVER].steps = 0;
+    assert(sweep_create(&sweep, 10, 10, 1, range) != 0);
+
+    /* ranges loaded from a file */
+    fp = fopen(filename, "w");
+    assert(fp != NULL);
+    fprintf(fp, "# tuning ranges\n\ncrossover=0.3:0.9:4\n  population=20\n");
+    fclose(fp);
+    assert(sweep_ranges_load(range, filename) == 0);
+    assert(range[SC_SWEEP_CROSSOVER].steps == 4);
+    assert(range[SC_SWEEP_POPULATION_SIZE].steps == 1);
+    assert((int)range[SC_SWEEP_POPULATION_SIZE].minimum == 20);
+
+    fp = fopen(filename, "w");
+    assert(fp != NULL);
+    fprintf(fp, "crossover=0.3:0.9:4\nbogus\n");
+    fclose(fp);
+    assert(sweep_ranges_load(range, filename) != 0);
+    assert(sweep_ranges_load(range, "/tmp/scalam_missing/ranges.txt") != 0);
+
+    unlink(filename);
+
+    printf("Ok\n");
+}
+
+void run_sweep_tests()
+{
+    test_sweep_grid();
+    test_sweep_random();
+    test_sweep_ranges();
+    test_sweep_run();
+}
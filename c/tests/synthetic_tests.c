@@ -0,0 +1,222 @@
+/*
+  Smart search for upgrade paths
+  Copyright (C) 2016 Andrew Leeming <andrew.leeming@codethink.co.uk> and
+  Bob Mottram <bob.mottram@codethink.co.uk>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include "../src/scalam.h"
+
+/**
+ * @brief Creates a population for a synthetic system and its oracle
+ */
+static void test_synthetic_population(sc_population * population,
+                                      sc_synthetic_oracle * oracle,
+                                      int no_of_programs, int size,
+                                      unsigned int random_seed)
+{
+    sc_system * sys = (sc_system*)malloc(sizeof(sc_system));
+    sc_goal * goal = (sc_goal*)malloc(sizeof(sc_goal));
+
+    assert(synthetic_system_create(sys, no_of_programs, random_seed) == 0);
+    assert(synthetic_oracle_create(oracle, sys, random_seed + 1) == 0);
+    assert(goal_create_latest_versions(sys, goal) == 0);
+    assert(population_create_seeded(size, population, sys, goal,
+                                    random_seed + 2) == 0);
+
+    free(goal);
+    free(sys);
+}
+
+void test_synthetic_system()
+{
+    sc_system * sys1 = (sc_system*)malloc(sizeof(sc_system));
+    sc_system * sys2 = (sc_system*)malloc(sizeof(sc_system));
+    sc_synthetic_oracle * oracle =
+        (sc_synthetic_oracle*)malloc(sizeof(sc_synthetic_oracle));
+    int p, i;
+
+    printf("test_synthetic_system...");
+
+    assert(synthetic_system_create(sys1, 0, 1) != 0);
+
+    /* the same seed gives the same system */
+    assert(synthetic_system_create(sys1, 50, 7612) == 0);
+    assert(synthetic_system_create(sys2, 50, 7612) == 0);
+    assert(system_cmp(sys1, sys2) == 0);
+    assert(synthetic_system_create(sys2, 50, 7613) == 0);
+    assert(system_cmp(sys1, sys2) != 0);
+
+    for (p = 0; p < sys1->no_of_programs; p++) {
+        assert(sys1->program[p].installed);
+        assert(sys1->program[p].no_of_versions >= SC_SYNTHETIC_MIN_VERSIONS);
+        assert(sys1->program[p].no_of_versions <= SC_SYNTHETIC_MAX_VERSIONS);
+        assert(sys1->program[p].version_index >= 0);
+        assert(sys1->program[p].version_index < sys1->program[p].no_of_versions);
+    }
+
+    assert(synthetic_oracle_create(oracle, sys1, 331) == 0);
+    assert(oracle->no_of_edges > 0);
+    for (p = 0; p < sys1->no_of_programs; p++) {
+        assert(oracle->max_jump[p] >= 1);
+
+        /* the latest versions always build */
+        assert(!synthetic_version_broken(oracle, p,
+                                         sys1->program[p].no_of_versions - 1));
+
+        /* dependencies are upon earlier programs */
+        for (i = oracle->edge_start[p]; i < oracle->edge_start[p+1]; i++)
+            assert(oracle->edge_dependency[i] < p);
+    }
+
+    synthetic_oracle_free(oracle);
+    free(oracle);
+    free(sys1);
+    free(sys2);
+
+    printf("Ok\n");
+}
+
+void test_synthetic_evaluate()
+{
+    sc_population * population = (sc_population*)malloc(sizeof(sc_population));
+    sc_synthetic_oracle * oracle =
+        (sc_synthetic_oracle*)malloc(sizeof(sc_synthetic_oracle));
+    sc_system * sys;
+    sc_goal * goal;
+    sc_genome * individual;
+    unsigned char * state;
+    int p, step, steps = 1, distance, start, reference;
+
+    printf("test_synthetic_evaluate...");
+
+    test_synthetic_population(population, oracle, 30, 4, 9921);
+    sys = &population->sys;
+    goal = &population->goal;
+    oracle->broken_per_mille = 0;
+
+    /* enough steps for every program to reach the goal */
+    for (p = 0; p < sys->no_of_programs; p++) {
+        distance = goal->reference.version_index[p] - goal->start.version_index[p];
+        if ((distance + oracle->max_jump[p] - 1) / oracle->max_jump[p] > steps)
+            steps = (distance + oracle->max_jump[p] - 1) / oracle->max_jump[p];
+    }
+    assert(steps <= SC_MAX_CHANGE_SEQUENCE);
+
+    /* move every program steadily towards the goal */
+    individual = population->individual[1];
+    individual->steps = steps;
+    memset((void*)genome_state(population, individual, 0), '\0',
+           steps*sys->state_bytes);
+    for (step = 0; step < steps; step++) {
+        state = genome_state(population, individual, step);
+        for (p = 0; p < sys->no_of_programs; p++) {
+            start = goal->start.version_index[p];
+            reference = goal->reference.version_index[p];
+            state_set_installed(sys, state, p, 1);
+            state_set_version(sys, state, p,
+                              start + ((reference - start) * (step + 1)) / steps);
+        }
+    }
+
+    assert(synthetic_solution(oracle, population, individual));
+    assert(synthetic_evaluate(oracle, population, 1) == 0);
+    assert(individual->evaluated);
+    assert(individual->steps_completed == steps);
+    assert(individual->goal_distance == 0);
+    assert(individual->test_passes > 0);
+    assert(individual->build_time > 0);
+
+    /* going straight to the goal is too far for some program */
+    if (steps > 1) {
+        individual->steps = 0;
+        assert(!synthetic_solution(oracle, population, individual));
+        assert(synthetic_evaluate(oracle, population, 1) == 0);
+        assert(individual->score == 0);
+    }
+
+    /* a final step which doesn't reach the goal isn't a solution */
+    individual->steps = steps;
+    state = genome_state(population, individual, steps-1);
+    state_set_version(sys, state, 0, goal->reference.version_index[0] - 1);
+    assert(!synthetic_solution(oracle, population, individual));
+
+    /* a missing dependency stops the evaluation at the first step */
+    assert(oracle->no_of_edges > 0);
+    state = genome_state(population, individual, 0);
+    state_set_installed(sys, state, oracle->edge_dependency[0], 0);
+    assert(synthetic_evaluate(oracle, population, 1) == 0);
+    assert(individual->steps_completed == 0);
+
+    synthetic_oracle_free(oracle);
+    free(oracle);
+    population_free(population);
+    free(population);
+
+    printf("Ok\n");
+}
+
+void test_synthetic_run()
+{
+    sc_population * population = (sc_population*)malloc(sizeof(sc_population));
+    sc_synthetic_oracle * oracle =
+        (sc_synthetic_oracle*)malloc(sizeof(sc_synthetic_oracle));
+    int generations, evaluations, run_generations[2], run_evaluations[2];
+    float run_scores[2][32];
+    int run, i;
+
+    printf("test_synthetic_run...");
+
+    /* runs with the same seeds give the same results,
+       whatever the number of threads */
+    for (run = 0; run < 2; run++) {
+        test_synthetic_population(population, oracle, 8, 32, 4410);
+        assert(synthetic_run(oracle, population, 20, 1 + run*3,
+                             &generations, &evaluations) == 0);
+        assert(generations > 0);
+        assert(generations <= 20);
+        if (evaluations >= 0) {
+            assert(evaluations <= population->evaluations);
+            assert(generations < 20 ||
+                   evaluations > population->evaluations - population->size);
+        }
+        else {
+            assert(generations == 20);
+        }
+        run_generations[run] = generations;
+        run_evaluations[run] = evaluations;
+        for (i = 0; i < population->size; i++)
+            run_scores[run][i] = population->individual[i]->score;
+
+        synthetic_oracle_free(oracle);
+        population_free(population);
+    }
+    assert(run_generations[0] == run_generations[1]);
+    assert(run_evaluations[0] == run_evaluations[1]);
+    assert(memcmp(run_scores[0], run_scores[1], sizeof(run_scores[0])) == 0);
+
+    free(oracle);
+    free(population);
+
+    printf("Ok\n");
+}
+
+void run_synthetic_tests()
+{
+    test_synthetic_system();
+    test_synthetic_evaluate();
+    test_synthetic_run();
+}
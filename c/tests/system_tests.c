@@ -56,27 +56,27 @@ void test_system_dummy(sc_system *sys)
     /* check that programs were actually created */
     for (p = 0; p < sys->no_of_programs; p++) {
         /* has a name */
-        assert(sys->program[p].name[0] != 0);
+        assert(sys->program[p].name != 0);
 
         /* has some commits */
         assert(sys->program[p].no_of_versions > 0);
 
         /* has a versions.txt file */
-        assert(sys->program[p].versions_file[0] != 0);
+        assert(sys->program[p].versions_file != 0);
 
-        /* non-zero current commit index */
-        assert(sys->program[p].version_index > 0);
+        /* a valid current commit index */
+        assert(sys->program[p].version_index >= 0);
 
         /* check that we are not at HEAD of master */
-        if (sys->program[p].version_index == sys->program[p].no_of_versions) {
+        if (sys->program[p].version_index == sys->program[p].no_of_versions - 1) {
             printf("\nversion_index is the same as the head of master\n");
             sprintf(commandstr,"rm -rf %s", repo_dir);
             run_shell_command(commandstr);
         }
-        assert(sys->program[p].version_index < sys->program[p].no_of_versions);
+        assert(sys->program[p].version_index < sys->program[p].no_of_versions - 1);
 
         /* check that versions.txt file exists */
-        assert(file_exists(sys->program[p].versions_file));
+        assert(file_exists(string_pool_get(sys->program[p].versions_file)));
     }
 
     /*  remove the test directory.
@@ -136,27 +136,27 @@ void test_system_create_from_repos()
     /* check that programs were actually created */
     for (p = 0; p < sys.no_of_programs; p++) {
         /* has a name */
-        assert(sys.program[p].name[0] != 0);
+        assert(sys.program[p].name != 0);
 
         /* has some commits */
         assert(sys.program[p].no_of_versions > 0);
 
         /* has a versions.txt file */
-        assert(sys.program[p].versions_file[0] != 0);
+        assert(sys.program[p].versions_file != 0);
 
-        /* non-zero current commit index */
-        assert(sys.program[p].version_index > 0);
+        /* a valid current commit index */
+        assert(sys.program[p].version_index >= 0);
 
         /* check that we are not at HEAD of master */
-        if (sys.program[p].version_index == sys.program[p].no_of_versions) {
+        if (sys.program[p].version_index == sys.program[p].no_of_versions - 1) {
             printf("\nversion_index is the same as the head of master\n");
             sprintf(commandstr,"rm -rf %s", repo_dir);
             run_shell_command(commandstr);
         }
-        assert(sys.program[p].version_index < sys.program[p].no_of_versions);
+        assert(sys.program[p].version_index < sys.program[p].no_of_versions - 1);
 
         /* check that versions.txt file exists */
-        assert(file_exists(sys.program[p].versions_file));
+        assert(file_exists(string_pool_get(sys.program[p].versions_file)));
     }
 
     /* deallocate */
@@ -223,9 +223,45 @@ void test_system_from_baserock()
 
 void test_system_copy()
 {
+    sc_system * source = (sc_system*)malloc(sizeof(sc_system));
+    sc_system * destination = (sc_system*)malloc(sizeof(sc_system));
+    char name[SC_MAX_STRING];
+    int p;
+
     printf("test_system_copy...");
 
-    /* TODO */
+    memset((void*)source, '\0', sizeof(sc_system));
+    for (p = 0; p < 100; p++) {
+        sprintf(name, "program%d", p);
+        assert(system_add_program(source, name) == p);
+        source->program[p].no_of_versions = 10 + p;
+    }
+    assert(state_layout_create(source) == 0);
+    assert(system_create_dependency_matrix(source) == 0);
+    source->dependency_probability[5][7] = 1.0;
+
+    assert(system_copy(destination, source) == 0);
+    assert(system_cmp(destination, source) == 0);
+    assert(destination->dependency_probability != source->dependency_probability);
+    assert(destination->dependency_probability[5][7] == 1.0);
+
+    /* programs can be found by name within the copy */
+    assert(destination->indexed_programs == 100);
+    for (p = 0; p < 100; p++) {
+        sprintf(name, "program%d", p);
+        assert(system_program_index_from_name(destination, name) == p);
+    }
+
+    /* and more can be added */
+    assert(system_add_program(destination, "another") == 100);
+    assert(system_program_index_from_name(destination, "another") == 100);
+    assert(system_program_index_from_name(source, "another") == -1);
+    assert(system_cmp(destination, source) != 0);
+
+    system_free(source);
+    system_free(destination);
+    free(source);
+    free(destination);
 
     printf("Ok\n");
 }
@@ -250,18 +286,245 @@ void test_system_from_baserock_get_string()
 
 void test_system_program_index_from_name()
 {
+    sc_system * sys = (sc_system*)malloc(sizeof(sc_system));
+    char name[SC_MAX_STRING];
+    char * long_name;
+    int p;
+
     printf("test_system_program_index_from_name...");
 
-    /* TODO */
+    memset((void*)sys, '\0', sizeof(sc_system));
+    assert(system_program_index_from_name(sys, "program0") == -1);
+
+    /* a full system */
+    for (p = 0; p < SC_MAX_SYSTEM_SIZE; p++) {
+        sprintf(name, "program%d", p);
+        assert(system_add_program(sys, name) == p);
+    }
+    assert(system_add_program(sys, "one too many") < 0);
+    assert(sys->indexed_programs == SC_MAX_SYSTEM_SIZE);
+
+    for (p = 0; p < SC_MAX_SYSTEM_SIZE; p++) {
+        sprintf(name, "program%d", p);
+        assert(system_program_index_from_name(sys, name) == p);
+    }
+    assert(system_program_index_from_name(sys, "program") == -1);
+    assert(system_program_index_from_name(sys, "program30000") == -1);
+    assert(system_program_index_from_name(sys, "") == -1);
+
+    /* names which aren't terminated */
+    assert(system_program_index_from_string(sys, "program123 and more", 10) == 123);
+    assert(system_program_index_from_string(sys, "program123", 9) == 12);
+
+    /* names set directly are found before and after indexing */
+    sys->no_of_programs = 2;
+    sys->indexed_programs = 0;
+    sys->program[1].name = string_pool_add("renamed");
+    assert(system_program_index_from_name(sys, "renamed") == 1);
+    system_index_names(sys);
+    assert(sys->indexed_programs == 2);
+    assert(system_program_index_from_name(sys, "renamed") == 1);
+    assert(system_program_index_from_name(sys, "program0") == 0);
+    assert(system_program_index_from_name(sys, "program2") == -1);
+
+    /* with duplicate names the first is found */
+    sys->program[1].name = string_pool_add("program0");
+    system_index_names(sys);
+    assert(system_program_index_from_name(sys, "program0") == 0);
+
+    /* names are not limited to SC_MAX_STRING */
+    sys->no_of_programs = 2;
+    long_name = (char*)malloc(SC_MAX_STRING*4);
+    memset((void*)long_name, 'x', SC_MAX_STRING*4 - 1);
+    long_name[SC_MAX_STRING*4 - 1] = 0;
+    assert(system_add_program(sys, long_name) == 2);
+    assert(strcmp(string_pool_get(sys->program[2].name), long_name) == 0);
+    assert(system_program_index_from_name(sys, long_name) == 2);
+    long_name[SC_MAX_STRING] = 0;
+    assert(system_program_index_from_name(sys, long_name) == -1);
+    free(long_name);
+
+    free(sys);
+
+    printf("Ok\n");
+}
+
+/**
+ * @brief Creates a small set of baserock definitions, with chunks which
+ *        appear in more than one stratum, dependencies between strata,
+ *        a dependency which doesn't exist and a file with no final newline
+ * @param definitions_dir Directory in which to create the definitions
+ */
+static void test_system_baserock_definitions(char * definitions_dir)
+{
+    char filename[SC_MAX_STRING*2];
+    FILE * fp;
+
+    sprintf(filename, "%s/strata", definitions_dir);
+    assert(mkdir(filename, 0755) == 0);
+
+    sprintf(filename, "%s/strata/core.morph", definitions_dir);
+    fp = fopen(filename, "w");
+    assert(fp != NULL);
+    fprintf(fp, "name: core\nkind: stratum\nbuild-depends:\n"
+            "- morph: strata/build-essential.morph\nchunks:\n"
+            "- name: glibc\n  repo: upstream:glibc\n  build-depends:\n"
+            "  - linux-api-headers\n"
+            "- name: zlib\n  build-depends:\n  - glibc");
+    fclose(fp);
+
+    sprintf(filename, "%s/strata/build-essential.morph", definitions_dir);
+    fp = fopen(filename, "w");
+    assert(fp != NULL);
+    fprintf(fp, "name: build-essential\nkind: stratum\nchunks:\n"
+            "- name: linux-api-headers\r\n"
+            "- name: binutils\n  build-depends:\n"
+            "  - linux-api-headers\n  - missing-program\n"
+            "- name: glibc\n");
+    fclose(fp);
+
+    /* not a morph file */
+    sprintf(filename, "%s/strata/README", definitions_dir);
+    fp = fopen(filename, "w");
+    assert(fp != NULL);
+    fprintf(fp, "- name: readme\n");
+    fclose(fp);
+}
+
+void test_system_from_baserock_local()
+{
+    char template[] = "/tmp/scalam.XXXXXX";
+    char * definitions_dir = mkdtemp(template);
+    char commandstr[SC_MAX_STRING];
+    sc_system * sys = (sc_system*)malloc(sizeof(sc_system));
+    int binutils, glibc, headers, zlib, i, j, dependencies = 0;
+
+    printf("test_system_from_baserock_local...");
+
+    test_system_baserock_definitions(definitions_dir);
+
+    memset((void*)sys, '\0', sizeof(sc_system));
+    assert(system_from_baserock(definitions_dir, sys) == 0);
+    assert(sys->no_of_programs == 4);
+
+    /* programs are sorted by name */
+    assert(strcmp(string_pool_get(sys->program[0].name), "binutils") == 0);
+    assert(strcmp(string_pool_get(sys->program[1].name), "glibc") == 0);
+    assert(strcmp(string_pool_get(sys->program[2].name), "linux-api-headers") == 0);
+    assert(strcmp(string_pool_get(sys->program[3].name), "zlib") == 0);
+    binutils = 0;
+    glibc = 1;
+    headers = 2;
+    zlib = 3;
+
+    /* dependencies can be upon chunks within other strata */
+    assert(sys->dependency_probability != NULL);
+    assert(sys->dependency_probability[glibc][headers] == 1.0);
+    assert(sys->dependency_probability[zlib][glibc] == 1.0);
+    assert(sys->dependency_probability[binutils][headers] == 1.0);
+    for (i = 0; i < sys->no_of_programs; i++)
+        for (j = 0; j < sys->no_of_programs; j++)
+            if (sys->dependency_probability[i][j] != 0)
+                dependencies++;
+    assert(dependencies == 3);
+
+    /* loading again gives the same result */
+    assert(system_from_baserock(definitions_dir, sys) == 0);
+    assert(sys->no_of_programs == 4);
+    assert(sys->dependency_probability[zlib][glibc] == 1.0);
+
+    assert(system_from_baserock("/tmp/scalam_missing", sys) != 0);
+
+    system_free(sys);
+    free(sys);
+
+    sprintf(commandstr, "rm -rf %s", definitions_dir);
+    run_shell_command(commandstr);
 
     printf("Ok\n");
 }
 
 void test_system_from_baserock_update_dependencies()
 {
+    char template[] = "/tmp/scalam.XXXXXX";
+    char * definitions_dir = mkdtemp(template);
+    char commandstr[SC_MAX_STRING];
+    sc_system * sys = (sc_system*)malloc(sizeof(sc_system));
+
     printf("test_system_from_baserock_update_dependencies...");
 
-    /* TODO */
+    test_system_baserock_definitions(definitions_dir);
+
+    /* only programs which are within the system get dependencies */
+    memset((void*)sys, '\0', sizeof(sc_system));
+    sys->no_of_programs = 2;
+    sys->program[0].name = string_pool_add("zlib");
+    sys->program[1].name = string_pool_add("glibc");
+    assert(system_create_dependency_matrix(sys) == 0);
+
+    assert(system_from_baserock_update_dependencies(definitions_dir, sys) == 0);
+    assert(sys->dependency_probability[0][1] == 1.0);
+    assert(sys->dependency_probability[1][0] == 0);
+    assert(sys->dependency_probability[0][0] == 0);
+    assert(sys->dependency_probability[1][1] == 0);
+
+    system_free(sys);
+    free(sys);
+
+    sprintf(commandstr, "rm -rf %s", definitions_dir);
+    run_shell_command(commandstr);
+
+    printf("Ok\n");
+}
+
+void test_system_from_baserock_large()
+{
+    char template[] = "/tmp/scalam.XXXXXX";
+    char * definitions_dir = mkdtemp(template);
+    char filename[SC_MAX_STRING*2];
+    char name[SC_MAX_STRING];
+    sc_system * sys = (sc_system*)malloc(sizeof(sc_system));
+    FILE * fp;
+    int f, c, index, dependency_index;
+
+    printf("test_system_from_baserock_large...");
+
+    sprintf(filename, "%s/strata", definitions_dir);
+    assert(mkdir(filename, 0755) == 0);
+
+    /* each chunk depends upon the previous one, which for the first
+       chunk of a stratum is within the previous stratum */
+    for (f = 0; f < 50; f++) {
+        sprintf(filename, "%s/strata/stratum%02d.morph", definitions_dir, f);
+        fp = fopen(filename, "w");
+        assert(fp != NULL);
+        fprintf(fp, "name: stratum%02d\nkind: stratum\nchunks:\n", f);
+        for (c = 0; c < 50; c++) {
+            fprintf(fp, "- name: chunk%04d\n", f*50 + c);
+            if (f*50 + c > 0)
+                fprintf(fp, "  build-depends:\n  - chunk%04d\n", f*50 + c - 1);
+        }
+        fclose(fp);
+    }
+
+    memset((void*)sys, '\0', sizeof(sc_system));
+    assert(system_from_baserock(definitions_dir, sys) == 0);
+    assert(sys->no_of_programs == 2500);
+
+    for (c = 1; c < sys->no_of_programs; c += 97) {
+        sprintf(name, "chunk%04d", c);
+        index = system_program_index_from_name(sys, name);
+        assert(index == c);
+        sprintf(name, "chunk%04d", c - 1);
+        dependency_index = system_program_index_from_name(sys, name);
+        assert(sys->dependency_probability[index][dependency_index] == 1.0);
+    }
+
+    system_free(sys);
+    free(sys);
+
+    sprintf(filename, "rm -rf %s", definitions_dir);
+    run_shell_command(filename);
 
     printf("Ok\n");
 }
@@ -283,6 +546,8 @@ void run_system_tests()
     test_system_program_index_from_name();
     test_system_create_from_repos();
     test_system_from_baserock_update_dependencies();
+    test_system_from_baserock_local();
+    test_system_from_baserock_large();
     test_system_from_baserock();
     test_system_program_install_sequence_probability();
 }
@@ -134,9 +134,24 @@ void run_tests()
     test_software_exists();
     test_run_shell_command_with_output();
     test_get_line_number_from_string_in_file();
+    run_process_tests();
+    run_changelog_tests();
+    run_string_pool_tests();
+    run_state_tests();
+    run_diversity_tests();
     run_program_tests();
     run_system_tests();
+    run_workspace_tests();
+    run_ingest_tests();
+    run_candidates_tests();
+    run_evaluator_tests();
+    run_surrogate_tests();
+    run_pareto_tests();
+    run_synthetic_tests();
+    run_sweep_tests();
+    run_manifest_tests();
     run_population_tests();
+    run_columns_tests();
     run_genome_tests();
     run_goal_tests();
     run_plot_tests();
@@ -0,0 +1,256 @@
+/*
+  Smart search for upgrade paths
+  Copyright (C) 2016 Andrew Leeming <andrew.leeming@codethink.co.uk> and
+  Bob Mottram <bob.mottram@codethink.co.uk>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include "../src/scalam.h"
+
+#define TEST_WORKSPACE_COMMITS 5
+
+/**
+ * @brief Creates local git repos in which each commit changes the contents
+ *        of a file called version, then a system containing them.
+ *        No network access is needed.
+ * @param repos_dir Directory within which to create the repos
+ * @param sys Returned system object
+ * @param no_of_programs The number of programs in the system
+ */
+void test_workspace_system(char * repos_dir, sc_system * sys,
+                           int no_of_programs)
+{
+    char commandstr[SC_MAX_STRING*2];
+    char repo_dir[SC_MAX_STRING];
+    int p, c;
+
+    memset((void*)sys, '\0', sizeof(sc_system));
+    sys->no_of_programs = no_of_programs;
+
+    for (p = 0; p < no_of_programs; p++) {
+        sys->program[p].name = string_pool_printf("program%d", p);
+        assert(snprintf(repo_dir, sizeof(repo_dir), "%s/%s", repos_dir,
+                        string_pool_get(sys->program[p].name)) <
+               (int)sizeof(repo_dir));
+
+        assert(snprintf(commandstr, sizeof(commandstr),
+                        "git init -q -b master %s && "
+                        "git -C %s config user.email test@scalam && "
+                        "git -C %s config user.name scalam",
+                        repo_dir, repo_dir, repo_dir) <
+               (int)sizeof(commandstr));
+        run_shell_command(commandstr);
+
+        for (c = 0; c < TEST_WORKSPACE_COMMITS; c++) {
+            assert(snprintf(commandstr, sizeof(commandstr),
+                            "echo %d > %s/version && git -C %s add version && "
+                            "git -C %s commit -q -m \"version %d\"",
+                            c, repo_dir, repo_dir, repo_dir, c) <
+                   (int)sizeof(commandstr));
+            run_shell_command(commandstr);
+        }
+
+        assert(program_repo_get_commits(repo_dir, &sys->program[p]) == 0);
+        assert(sys->program[p].no_of_versions == TEST_WORKSPACE_COMMITS);
+    }
+    assert(state_layout_create(sys) == 0);
+}
+
+/**
+ * @brief Returns the contents of the version file for a program
+ *        checked out within a workspace
+ */
+static int test_workspace_version(sc_workspace_pool * pool, int index,
+                                  sc_system * sys, int program_index)
+{
+    char directory[SC_MAX_STRING*2];
+    char filename[SC_MAX_STRING*2];
+    FILE * fp;
+    int version = -1;
+
+    assert(workspace_program_directory(pool, index, sys,
+                                       program_index, directory) == 0);
+    assert(snprintf(filename, sizeof(filename), "%s/version", directory) <
+           (int)sizeof(filename));
+
+    fp = fopen(filename, "r");
+    assert(fp != NULL);
+    assert(fscanf(fp, "%d", &version) == 1);
+    fclose(fp);
+
+    return version;
+}
+
+void test_workspace_acquire()
+{
+    char tempdir[SC_MAX_STRING];
+    char workspaces_dir[SC_MAX_STRING*2];
+    char commandstr[SC_MAX_STRING*2];
+    char long_dir[SC_MAX_STRING - 4];
+    sc_system * sys = (sc_system*)malloc(sizeof(sc_system));
+    sc_workspace_pool pool;
+    int a, b;
+
+    printf("test_workspace_acquire...");
+
+    assert(snprintf(tempdir, sizeof(tempdir), "/tmp/scalam_workspace.XXXXXX") <
+           (int)sizeof(tempdir));
+    assert(mkdtemp(tempdir) != NULL);
+    assert(snprintf(workspaces_dir, sizeof(workspaces_dir),
+                    "%s/workspaces", tempdir) <
+           (int)sizeof(workspaces_dir));
+
+    memset((void*)sys, '\0', sizeof(sc_system));
+
+    /* number of workspaces must be within range */
+    assert(workspace_pool_create(&pool, tempdir, workspaces_dir, 0) != 0);
+    assert(workspace_pool_create(&pool, tempdir, workspaces_dir,
+                                 SC_MAX_WORKSPACES+1) != 0);
+
+    /* paths which would be truncated are rejected */
+    memset((void*)long_dir, 'x', sizeof(long_dir) - 1);
+    long_dir[sizeof(long_dir) - 1] = 0;
+    long_dir[0] = '/';
+    assert(workspace_pool_create(&pool, tempdir, long_dir, 1) != 0);
+    assert(pool.workspace == NULL);
+
+    assert(workspace_pool_create(&pool, tempdir, workspaces_dir, 2) == 0);
+    assert(directory_exists(pool.workspace[0].install_prefix));
+    assert(directory_exists(pool.workspace[1].install_prefix));
+
+    a = workspace_acquire(&pool);
+    b = workspace_acquire(&pool);
+    assert((a >= 0) && (b >= 0) && (a != b));
+
+    /* all workspaces are in use */
+    assert(workspace_acquire(&pool) == -1);
+
+    /* anything installed is removed when the workspace is next acquired */
+    assert(snprintf(commandstr, sizeof(commandstr),
+                    "touch %s/installed", pool.workspace[a].install_prefix) <
+           (int)sizeof(commandstr));
+    run_shell_command(commandstr);
+    workspace_release(&pool, a);
+    assert(workspace_acquire(&pool) == a);
+    assert(snprintf(commandstr, sizeof(commandstr),
+                    "%s/installed", pool.workspace[a].install_prefix) <
+           (int)sizeof(commandstr));
+    assert(!file_exists(commandstr));
+    assert(directory_exists(pool.workspace[a].install_prefix));
+
+    workspace_pool_free(&pool, sys);
+    assert(!directory_exists(workspaces_dir));
+
+    assert(snprintf(commandstr, sizeof(commandstr), "rm -rf %s", tempdir) <
+           (int)sizeof(commandstr));
+    run_shell_command(commandstr);
+    free(sys);
+
+    printf("Ok\n");
+}
+
+void test_workspace_checkout()
+{
+    char tempdir[SC_MAX_STRING];
+    char workspaces_dir[SC_MAX_STRING*2];
+    char commandstr[SC_MAX_STRING*2];
+    char directory[SC_MAX_STRING*2];
+    unsigned char * state;
+    sc_system * sys = (sc_system*)malloc(sizeof(sc_system));
+    sc_workspace_pool pool;
+    int a, b;
+
+    printf("test_workspace_checkout...");
+
+    assert(snprintf(tempdir, sizeof(tempdir), "/tmp/scalam_workspace.XXXXXX") <
+           (int)sizeof(tempdir));
+    assert(mkdtemp(tempdir) != NULL);
+    assert(snprintf(workspaces_dir, sizeof(workspaces_dir),
+                    "%s/workspaces", tempdir) <
+           (int)sizeof(workspaces_dir));
+
+    test_workspace_system(tempdir, sys, 3);
+    state = (unsigned char*)malloc(sys->state_bytes);
+    memset((void*)state, '\0', sys->state_bytes);
+
+    assert(workspace_pool_create(&pool, tempdir, workspaces_dir, 2) == 0);
+    a = workspace_acquire(&pool);
+    b = workspace_acquire(&pool);
+
+    /* only installed programs are checked out.
+       Version indexes count from the oldest commit */
+    state_set_installed(sys, state, 0, 1);
+    state_set_version(sys, state, 0, 0);
+    state_set_installed(sys, state, 2, 1);
+    state_set_version(sys, state, 2, 3);
+    assert(workspace_checkout(&pool, a, sys, state) == 0);
+    assert(test_workspace_version(&pool, a, sys, 0) == 0);
+    assert(test_workspace_version(&pool, a, sys, 2) == 3);
+    workspace_program_directory(&pool, a, sys, 1, directory);
+    assert(!directory_exists(directory));
+    assert(pool.workspace[a].version_index[1] == -1);
+
+    /* workspaces are independent of each other */
+    state_set_version(sys, state, 0, 2);
+    assert(workspace_checkout(&pool, b, sys, state) == 0);
+    assert(test_workspace_version(&pool, b, sys, 0) == 2);
+    assert(test_workspace_version(&pool, a, sys, 0) == 0);
+
+    /* changing version within an existing worktree.
+       Unchanged programs are not checked out again, so a local
+       modification to them survives */
+    workspace_program_directory(&pool, a, sys, 2, directory);
+    assert(snprintf(commandstr, sizeof(commandstr),
+                    "touch %s/untouched", directory) <
+           (int)sizeof(commandstr));
+    run_shell_command(commandstr);
+    assert(workspace_checkout(&pool, a, sys, state) == 0);
+    assert(test_workspace_version(&pool, a, sys, 0) == 2);
+    assert(pool.workspace[a].version_index[0] == 2);
+    assert(snprintf(commandstr, sizeof(commandstr),
+                    "%s/untouched", directory) <
+           (int)sizeof(commandstr));
+    assert(file_exists(commandstr));
+
+    /* versions outside of the range fail */
+    state_set_version(sys, state, 2, TEST_WORKSPACE_COMMITS);
+    assert(workspace_checkout(&pool, a, sys, state) != 0);
+
+    workspace_release(&pool, a);
+    workspace_release(&pool, b);
+    workspace_pool_free(&pool, sys);
+    assert(!directory_exists(workspaces_dir));
+
+    /* the original repos no longer refer to the worktrees */
+    assert(snprintf(commandstr, sizeof(commandstr),
+                    "%s/program0/.git/worktrees", tempdir) <
+           (int)sizeof(commandstr));
+    assert(!directory_exists(commandstr));
+
+    assert(snprintf(commandstr, sizeof(commandstr), "rm -rf %s", tempdir) <
+           (int)sizeof(commandstr));
+    run_shell_command(commandstr);
+    free(state);
+    free(sys);
+
+    printf("Ok\n");
+}
+
+void run_workspace_tests()
+{
+    test_workspace_acquire();
+    test_workspace_checkout();
+}
@@ -18,14 +18,210 @@
 '''
 
 import random
+import sys
 from randnum import *
 from system import System
 from logger import logger
 
+try:
+    import numpy
+except ImportError:
+    print("Error: NumPy libary missing. For installation instructions "
+           "see: https://numpy.org/install")
+    sys.exit()
+
+class GenomeArrays:
+    '''
+    Dense storage for a batch of genomes, so that operations on a whole
+    population are array operations rather than loops over Program
+    objects. Upgrade steps are indexed as [genome, step, program], and
+    only the first steps[genome] of them are meaningful.
+    '''
+
+    def __init__(self, size, noOfPrograms, maxSteps):
+        '''
+        @param size (int) Number of genomes
+        @param noOfPrograms (int) Number of programs within the system
+        @param maxSteps (int) Maximum number of upgrade steps
+        '''
+
+        self.size=size
+        self.noOfPrograms=noOfPrograms
+        self.maxSteps=maxSteps
+
+        # version index and install state at each upgrade step
+        self.versions=numpy.zeros((size, maxSteps, noOfPrograms), dtype=numpy.int32)
+        self.installed=numpy.zeros((size, maxSteps, noOfPrograms), dtype=bool)
+
+        # number of upgrade steps within each genome
+        self.steps=numpy.zeros(size, dtype=numpy.int32)
+
+        # version index of each program within the current system
+        self.current=numpy.zeros((size, noOfPrograms), dtype=numpy.int32)
+
+        self.score=numpy.zeros(size, dtype=numpy.float64)
+
+    def take(self, rows):
+        '''
+        Reorders the genomes, such that genome i becomes rows[i]
+
+        @param rows (int[]) Indexes of the genomes in their new order
+        '''
+
+        self.versions[:]=self.versions[rows]
+        self.installed[:]=self.installed[rows]
+        self.steps[:]=self.steps[rows]
+        self.current[:]=self.current[rows]
+        self.score[:]=self.score[rows]
+
+    def randomise(self, rows, rng, startVersions, goalVersions, steps=None):
+        '''
+        Creates random upgrade sequences. Versions at each step are
+        between the start and the goal, and programs are installed
+        with even odds.
+
+        @param rows (int[]) Indexes of the genomes to randomise
+        @param rng (numpy.random.Generator) Random number generator
+        @param startVersions (int[]) Version index of each program at the start
+        @param goalVersions (int[]) Version index of each program at the goal
+        @param steps (int[]) Number of steps for each genome, or None for random
+        '''
+
+        rows=numpy.asarray(rows)
+        if steps is None:
+            steps=rng.integers(0, self.maxSteps, size=len(rows))
+        self.steps[rows]=steps
+
+        distance=numpy.maximum(goalVersions - startVersions, 1)
+        shape=(len(rows), self.maxSteps, self.noOfPrograms)
+        self.versions[rows]=startVersions + \
+            (rng.random(shape) * distance).astype(numpy.int32)
+        self.installed[rows]=rng.random(shape) > 0.5
+        self.current[rows]=startVersions
+
+    def crossover(self, rows, parents, parent1, parent2, rng):
+        '''
+        Creates children which take each upgrade step from one parent
+        or the other. Masks are drawn for every child at once.
+
+        @param rows (int[]) Indexes of the children
+        @param parents (GenomeArrays) Genomes of the parents
+        @param parent1 (int[]) Index of the first parent of each child
+        @param parent2 (int[]) Index of the second parent of each child
+        @param rng (numpy.random.Generator) Random number generator
+        '''
+
+        rows=numpy.asarray(rows)
+        parent1=numpy.asarray(parent1)
+        parent2=numpy.asarray(parent2)
+        steps1=parents.steps[parent1]
+
+        # the number of steps comes from either parent
+        self.steps[rows]=numpy.where(rng.random(len(rows)) > 0.5,
+                                     parents.steps[parent2], steps1)
+
+        # steps beyond the end of the first parent come from the second
+        fromParent1=(rng.random((len(rows), self.maxSteps)) < 0.5) & \
+            (numpy.arange(self.maxSteps) < steps1[:, None])
+        self.versions[rows]=numpy.where(fromParent1[..., None],
+                                        parents.versions[parent1],
+                                        parents.versions[parent2])
+        self.installed[rows]=numpy.where(fromParent1[..., None],
+                                         parents.installed[parent1],
+                                         parents.installed[parent2])
+
+        # each program of the current system comes from either parent
+        fromParent1=rng.random((len(rows), self.noOfPrograms)) < 0.5
+        self.current[rows]=numpy.where(fromParent1,
+                                       parents.current[parent1],
+                                       parents.current[parent2])
+        self.score[rows]=0
+
+    def mutate(self, rows, rng, mutationRate, noOfVersions, force=False):
+        '''
+        Upgrades randomly chosen programs of the current system by one
+        version. Each genome mutates with even odds unless forced.
+
+        @param rows (int[]) Indexes of the genomes which may mutate
+        @param rng (numpy.random.Generator) Random number generator
+        @param mutationRate (float) Fraction of programs to upgrade
+        @param noOfVersions (int[]) Number of versions of each program
+        @param force (bool) Whether every genome mutates
+        @returns bool[] Whether each genome mutated
+        '''
+
+        rows=numpy.asarray(rows)
+        mutated=numpy.ones(len(rows), dtype=bool)
+        if not force:
+            mutated=rng.random(len(rows)) > 0.5
+
+        count=int(mutationRate * self.noOfPrograms)
+        mutating=rows[mutated]
+        if count > 0 and len(mutating) > 0:
+            programs=rng.integers(0, self.noOfPrograms, size=(len(mutating), count))
+            numpy.add.at(self.current, (mutating[:, None], programs), 1)
+
+            # upgrades beyond the latest version have no effect
+            self.current[mutating]=numpy.minimum(self.current[mutating],
+                                                 noOfVersions - 1)
+            logger.debug("Mutated {} programs in {} genomes".format(count, len(mutating)))
+
+        return mutated
+
+    def evaluate(self, noOfVersions):
+        '''
+        Scores every genome by the progress of its current system towards
+        the latest versions, as a percentage. Each program is normalised,
+        so that none dominates.
+
+        @param noOfVersions (int[]) Number of versions of each program
+        @returns float[] Score of each genome
+        '''
+
+        if self.noOfPrograms == 0:
+            self.score[:]=0
+        else:
+            self.score[:]=(self.current / numpy.maximum(noOfVersions, 1)).mean(axis=1) * 100
+        return self.score
+
+    def hashes(self):
+        '''
+        Returns a hash of each genome, such that genomes with the same
+        steps and current system have the same hash. Steps beyond the end
+        of a genome are ignored.
+
+        @returns uint64[] Hash of each genome
+        '''
+
+        # each gene is packed into one code, zero beyond the last step
+        maxSteps=int(self.steps.max()) if self.size > 0 else 0
+        valid=numpy.arange(maxSteps) < self.steps[:, None]
+        genes=(self.versions[:, :maxSteps].astype(numpy.uint64) + 1) * 2 + \
+            self.installed[:, :maxSteps]
+        genes*=valid[..., None]
+        rows=numpy.concatenate((self.steps[:, None].astype(numpy.uint64),
+                                self.current.astype(numpy.uint64),
+                                genes.reshape(self.size, -1)), axis=1)
+
+        # a fixed random odd weight for each column, so that hashes are stable
+        if GenomeArrays.hashWeights is None or \
+           len(GenomeArrays.hashWeights) != rows.shape[1]:
+            GenomeArrays.hashWeights=numpy.random.default_rng(
+                GenomeArrays.HASH_SEED).integers(
+                    1, 2**63, size=rows.shape[1], dtype=numpy.uint64) | numpy.uint64(1)
+
+        hashes=(rows * GenomeArrays.hashWeights).sum(axis=1, dtype=numpy.uint64)
+        return hashes ^ (hashes >> numpy.uint64(29))
+
+    HASH_SEED=2557
+    hashWeights=None
+
 class Genome:
     '''
     A genome is a current instance of some software system and consists
-    of many programs that can evolve (change version numbers)
+    of many programs that can evolve (change version numbers).
+    Its state is a row of a GenomeArrays, either its own or that of the
+    population which it belongs to.
     '''
 
     MAX_CHANGE_SEQUENCE=32
@@ -51,6 +247,7 @@ class Genome:
                 raise TypeError(u"Genome 'systemGoal' expects a System instance")
 
         self.rand=RandNum(seed=self.seed)
+        self.rng=numpy.random.default_rng(self.seed)
 
         # the state of the system at start
         self.systemStart=systemStart
@@ -58,8 +255,13 @@ class Genome:
         # the state of the reference system
         self.systemGoal=systemGoal
 
-        # current system that evolves over time
-        self.currentSystem=systemStart.clone()
+        self.startVersions=systemStart.getVersionIndexes()
+        self.goalVersions=systemGoal.getVersionIndexes()
+        self.noOfVersions=systemStart.getNoOfVersions()
+
+        self.arrays=GenomeArrays(1, systemStart.count(), Genome.MAX_CHANGE_SEQUENCE)
+        self.index=0
+        self.arrays.current[0]=self.startVersions
 
         #TODO add option to pass argument in constructor?
         self.mutation_rate=Genome.DEFAULT_MUTATION_RATE
@@ -71,17 +273,121 @@ class Genome:
             self.steps=steps
         else:
             self.steps=self.rand.next() % Genome.MAX_CHANGE_SEQUENCE
-        self.score=0
 
-        # This contains a list of system objects which describe the upgrade sequence
-        self.upgradeStep = []
+        # number of upgrade steps created so far by createInstallationStep
+        self.createdSteps=0
 
-        # if parents have been specified then this is their child
+        # if parents have been specified then this is their child.
+        # The crossover attribute is the crossover rate, which hides the method
         if parent1 is not None:
             if parent2 is not None:
-                self.crossover(self, parent1, parent2)
+                Genome.crossover(self, parent1, parent2)
                 self.mutate()
 
+    @staticmethod
+    def fromArrays(arrays, index, systemStart, systemGoal, startVersions,
+                   goalVersions, noOfVersions):
+        '''
+        Creates a genome whose state is a row of an existing GenomeArrays.
+        Nothing is copied, so changes to either are seen by the other.
+
+        @param arrays (GenomeArrays) Storage for the genome
+        @param index (int) Row of the genome within the arrays
+        @param systemStart (System) The starting state of the system
+        @param systemGoal (System) The reference state for the system
+        @param startVersions (int[]) Version index of each program at the start
+        @param goalVersions (int[]) Version index of each program at the goal
+        @param noOfVersions (int[]) Number of versions of each program
+        @returns Genome
+        '''
+
+        genome=Genome.__new__(Genome)
+        genome.seed=None
+        genome.rand=None
+        genome.rng=None
+        genome.systemStart=systemStart
+        genome.systemGoal=systemGoal
+        genome.startVersions=startVersions
+        genome.goalVersions=goalVersions
+        genome.noOfVersions=noOfVersions
+        genome.arrays=arrays
+        genome.index=index
+        genome.mutation_rate=Genome.DEFAULT_MUTATION_RATE
+        genome.crossover=Genome.DEFAULT_CROSSOVER
+        genome.rebels=Genome.DEFAULT_REBELS
+        genome.spawning_probability=0.0
+        genome.createdSteps=int(arrays.steps[index])
+        return genome
+
+    @property
+    def steps(self):
+        return int(self.arrays.steps[self.index])
+
+    @steps.setter
+    def steps(self, steps):
+        if steps < 0 or steps > Genome.MAX_CHANGE_SEQUENCE:
+            raise ValueError(u"Genome 'steps' out of range ({})".format(steps))
+        self.arrays.steps[self.index]=steps
+
+    @property
+    def score(self):
+        return float(self.arrays.score[self.index])
+
+    @score.setter
+    def score(self, score):
+        self.arrays.score[self.index]=score
+
+    @property
+    def versions(self):
+        '''
+        View of the version index of each program at each upgrade step
+        '''
+
+        return self.arrays.versions[self.index, :self.steps]
+
+    @property
+    def installed(self):
+        '''
+        View of the install state of each program at each upgrade step
+        '''
+
+        return self.arrays.installed[self.index, :self.steps]
+
+    @property
+    def upgradeStep(self):
+        '''
+        A list of system objects which describe the upgrade sequence.
+        These are created from the arrays each time, so changing them
+        does not change the genome.
+
+        @returns System[]
+        '''
+
+        return [self.systemGoal.withState(self.arrays.versions[self.index, step],
+                                          self.arrays.installed[self.index, step])
+                for step in range(min(self.createdSteps, self.steps))]
+
+    @property
+    def currentSystem(self):
+        '''
+        The current system that evolves over time, created from the arrays
+
+        @returns System
+        '''
+
+        return self.systemStart.withState(self.arrays.current[self.index],
+                                          self.systemStart.getInstalled())
+
+    def _random(self):
+        '''
+        Returns the random number generator for this genome. Genomes
+        created from a population's arrays share their own.
+        '''
+
+        if self.rng is None:
+            self.rng=numpy.random.default_rng()
+        return self.rng
+
     @staticmethod
     def createRandom(systemStart, systemGoal, seed=None):
         '''
@@ -101,11 +407,11 @@ class Genome:
         '''
 
         genome=Genome(systemStart, systemGoal, seed=seed)
-        # create a number of system objects representing the state of
-        # the system at each upgrade step
-        genome.upgradeStep = []
-        for step in range(genome.steps):
-            genome.createInstallationStep()
+        # create all of the upgrade steps at once
+        genome.arrays.randomise([genome.index], genome._random(),
+                                genome.startVersions, genome.goalVersions,
+                                steps=[genome.steps])
+        genome.createdSteps=genome.steps
         return genome
 
     def getScore(self):
@@ -114,7 +420,10 @@ class Genome:
         '''
 
         #TODO do evaluation here or somewhere else?
-        return self.currentSystem.getScore()
+        current=self.arrays.current[self.index]
+        if len(current) == 0:
+            return 0
+        return float((current / numpy.maximum(self.noOfVersions, 1)).mean() * 100)
 
     def createInstallationStep(self):
         '''
@@ -122,26 +431,21 @@ class Genome:
         *        their versions/commits and whether they are installed or not
         * @returns zero on success
         '''
-        systemState = self.systemGoal.clone()
-        self.upgradeStep.append(systemState)
+
+        step=self.createdSteps
+        if step >= Genome.MAX_CHANGE_SEQUENCE:
+            return -1
 
         # use the systemStart and systemGoal to set programs and versions
-        # at each upgrade step randomly
+        # at this upgrade step randomly
         # Assumption: The list of programs are always in the same sequence
         #             in the starting and goal states
-        for programIndex in range(0, len(systemState.getPrograms())):
-            # Distance between the current version and the goal
-            distanceToGoal = \
-                             self.systemGoal.programs[programIndex].versionIndex - \
-                             self.systemStart.programs[programIndex].versionIndex
-
-            # A random version/commit index between the start and the goal
-            systemState.programs[programIndex].versionIndex = \
-                                                              self.systemStart.programs[programIndex].versionIndex + \
-                                                              (self.rand.next() % distanceToGoal)
-
-            # Random install state
-            systemState.programs[programIndex].installed = (self.rand.next() % 100 > 50)
+        rng=self._random()
+        distance=numpy.maximum(self.goalVersions - self.startVersions, 1)
+        self.arrays.versions[self.index, step]=self.startVersions + \
+            (rng.random(len(distance)) * distance).astype(numpy.int32)
+        self.arrays.installed[self.index, step]=rng.random(len(distance)) > 0.5
+        self.createdSteps+=1
         return 0
 
     def getMutability(self):
@@ -158,42 +462,9 @@ class Genome:
         Randomly attempts to mutate a genome. Returns true on sucessful mutation
         '''
 
-        # Do a random pr check to see if this genome will mutate
-        if self.rand.nextNormalised() > 0.5:
-
-            # Figure out how many of the programs inside the genome will change
-            genome_count=int(self.getMutability()*self.currentSystem.count())
-
-            logger.debug("Mutating {} programs in {}".format(genome_count, self))
-
-            i=0
-            while i < genome_count:
-                #Figure out which random program to mutate
-
-                prog=self.currentSystem.getRandomProgram(self.rand.next())
-
-                # Select mutatation strategy
-
-                #TODO get distance to the goal. select a random number of
-                # versions to change (pareto distribution?)
-                #
-                # For now, just do a single step
-
-                steps=1
-                logger.debug("Attempting to mutate {} {} times".format(prog, steps))
-
-                if prog.canUpgrade(steps):  #This could fail if steps >1 and ver = last-1
-                    prog.upgrade(steps)
-
-                    i+=1
-                else:
-                    logger.debug("Failed to upgrade {}".format(steps))
-            #end while
-
-            return True
-        #end if
-
-        return False
+        mutated=self.arrays.mutate([self.index], self._random(),
+                                   self.getMutability(), self.noOfVersions)
+        return bool(mutated[0])
 
     def crossover(self, parent1, parent2):
         '''
@@ -204,20 +475,26 @@ class Genome:
         @return Genome New child genome
         '''
 
-        rand=RandNum(self.seed)
+        parents=GenomeArrays(2, self.arrays.noOfPrograms, Genome.MAX_CHANGE_SEQUENCE)
+        for i, parent in enumerate([parent1, parent2]):
+            parents.versions[i]=parent.arrays.versions[parent.index]
+            parents.installed[i]=parent.arrays.installed[parent.index]
+            parents.steps[i]=parent.arrays.steps[parent.index]
+            parents.current[i]=parent.arrays.current[parent.index]
 
-        # pick the number of steps from either parent
-        self.steps = parent1.steps
-        if rand.next() % 100 > 50:
-            self.steps = parent2.steps
+        self.arrays.crossover([self.index], parents, [0], [1], self._random())
+        self.createdSteps=self.steps
+        return self
 
-        for s in range(self,steps):
-            # choose to take this step from one parent or the other
-            if rand.next() % 100 < 50 and s < parent1.steps:
-                systemState = parent1.upgradeStep[s].clone()
-            else:
-                systemState = parent2.upgradeStep[s].clone()
-            self.upgradeStep.append(systemState)
+    def hash(self):
+        '''
+        Returns a hash of the upgrade steps and current system, used to
+        check for duplicate genomes
+
+        @returns int
+        '''
+
+        return int(self.arrays.hashes()[self.index])
 
     ####
 
@@ -242,5 +519,13 @@ class Genome:
 
 
     def __eq__(self, genome):
-        #TODO Criteria for comparing genomes for the unique property
-        return False
+        if not isinstance(genome, Genome):
+            return False
+
+        return self.steps == genome.steps and \
+            numpy.array_equal(self.arrays.current[self.index],
+                              genome.arrays.current[genome.index]) and \
+            numpy.array_equal(self.versions, genome.versions) and \
+            numpy.array_equal(self.installed, genome.installed)
+
+    __hash__=hash
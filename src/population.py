@@ -18,14 +18,25 @@
 '''
 
 import random
+import sys
 from system import System
-from genome import Genome
+from genome import Genome, GenomeArrays
 from logger import logger
 
+try:
+    import numpy
+except ImportError:
+    print("Error: NumPy libary missing. For installation instructions "
+           "see: https://numpy.org/install")
+    sys.exit()
+
 class Population:
     '''maximum number of genomes to have in a population'''
     MAX_POPULATION_SIZE=256
 
+    '''attempts to mutate a duplicate child into a unique one'''
+    MAX_UNIQUE_ATTEMPTS=10
+
     def __init__(self, size, sys, goal, seed=None, prevgen=None):
         '''
         @param size (int) Number of individuals in the population. It's
@@ -59,13 +70,31 @@ class Population:
         self.size=size
         self.sys=sys
         self.goal=goal
+        self.rng=numpy.random.default_rng(self.seed)
+
+        self.mutation_rate=Genome.DEFAULT_MUTATION_RATE
+        self.crossover=Genome.DEFAULT_CROSSOVER
+        self.rebels=Genome.DEFAULT_REBELS
+
+        # Program state is read once, rather than for every genome
+        self.startVersions=sys.getVersionIndexes()
+        self.goalVersions=goal.getVersionIndexes()
+        self.noOfVersions=sys.getNoOfVersions()
+
+        # Every genome is a row of these arrays
+        self.arrays=GenomeArrays(size, sys.count(), Genome.MAX_CHANGE_SEQUENCE)
+        self.individuals=[Genome.fromArrays(self.arrays, i, sys, goal,
+                                            self.startVersions,
+                                            self.goalVersions,
+                                            self.noOfVersions)
+                          for i in range(size)]
 
         if prevgen is not None:
             if not isinstance(prevgen, Population):
                 raise TypeError("Population prevgen expects a Population instance");
             self.nextGeneration(prevgen)
         else:
-            self.individuals=self._createInitGenomes(self.seed)
+            self._createInitGenomes(self.seed)
 
     def _createInitGenomes(self, seed):
         '''
@@ -74,11 +103,13 @@ class Population:
         @return Genome[]
         '''
 
-        genomes=[]
-        for i in range(self.size):
-            genomes.append(Genome.createRandom(self.sys, self.goal ,seed))
+        self.arrays.randomise(numpy.arange(self.size), self.rng,
+                              self.startVersions, self.goalVersions)
+        for genome in self.individuals:
+            genome.createdSteps=genome.steps
+        self.arrays.evaluate(self.noOfVersions)
         #TODO anything else?
-        return genomes
+        return self.individuals
 
     def getGenomes(self):
         '''
@@ -89,6 +120,23 @@ class Population:
 
         return self.individuals
 
+    @property
+    def scores(self):
+        '''
+        View of the score of each genome
+        '''
+
+        return self.arrays.score
+
+    def evaluate(self):
+        '''
+        Scores every genome from its current system
+
+        @return float[] Score of each genome
+        '''
+
+        return self.arrays.evaluate(self.noOfVersions)
+
     def isGoalMet(self):
         '''
         Checks to see if any of the genomes meet the goal system
@@ -97,12 +145,23 @@ class Population:
         # TODO should we return a boolean or a genome (list?) that
         # meet the goal criteria
 
-        for genome in self.getGenomes():
-            logger.debug("Current score is {} needs {}?".format(genome.getScore(),self.goal.getMaxScore()))
-            if genome.getScore() == self.goal.getMaxScore():
-                return True
+        bestScore=self.getMaxScore()
+        logger.debug("Best score is {} needs {}?".format(bestScore, self.goal.getMaxScore()))
+        return bestScore == self.goal.getMaxScore()
 
-        return False
+    def _selectParents(self, prevgen, count):
+        '''
+        Selects parents from the previous generation, biased towards the
+        beginning. This assumes that the previous generation have been
+        sorted into descending score order
+
+        @param prevgen (Population) The previous generation
+        @param count (int) Number of parents to select
+        @return int[] Indexes of the parents within prevgen
+        '''
+
+        posn=self.rng.random(count)
+        return (posn * posn * prevgen.size).astype(numpy.int64)
 
     def selectParent(self, prevgen):
         '''
@@ -112,22 +171,65 @@ class Population:
 
         @return Genome The parent genome
         '''
-        rand=RandNum(self.seed)
-        posn=(rand.next() % 100000) / 100000
-        return prevgen.individual[int(posn * posn * len(prevgen.getGenomes()))]
 
-    def nextGeneration(self, prevgen):
+        return prevgen.individuals[int(self._selectParents(prevgen, 1)[0])]
+
+    def nextGeneration(self, prevgen=None):
         '''
-        Creates the next generation population
+        Creates the next generation population. Crossover, mutation and
+        the removal of duplicates are applied to every child at once.
 
+        @param prevgen (Population) The previous generation. If not given
+            then a new population is created from this one.
         @return Population
         '''
 
+        if prevgen is None:
+            return Population(self.size, self.sys, self.goal,
+                              seed=int(self.rng.integers(1, 9999999)),
+                              prevgen=self)
+
         prevgen.sort()
 
-        self.individuals=[]
-        for gen in range(len(prevgen.getGenomes())):
-            individuals.add(child=Genome(self.sys, self.goal, self.selectParent(prevgen), self.selectParent(prevgen)))
+        children=numpy.arange(self.size)
+        parent1=self._selectParents(prevgen, self.size)
+        parent2=self._selectParents(prevgen, self.size)
+        self.arrays.crossover(children, prevgen.arrays, parent1, parent2, self.rng)
+        self.arrays.mutate(children, self.rng, self.mutation_rate, self.noOfVersions)
+
+        # mutate duplicates until they are unique, so that the same
+        # upgrade hypothesis isn't evaluated more than once
+        duplicates=self._duplicates()
+        for attempt in range(Population.MAX_UNIQUE_ATTEMPTS):
+            if len(duplicates) == 0:
+                break
+            self.arrays.mutate(duplicates, self.rng, self.mutation_rate,
+                               self.noOfVersions, force=True)
+
+            # stop once mutation is no longer creating new genomes, such
+            # as when every program is at its latest version
+            previous=len(duplicates)
+            duplicates=self._duplicates()
+            if len(duplicates) >= previous:
+                break
+
+        for genome in self.individuals:
+            genome.createdSteps=genome.steps
+        self.evaluate()
+        return self
+
+    def _duplicates(self):
+        '''
+        Returns the indexes of genomes which are the same as an earlier one
+
+        @return int[]
+        '''
+
+        hashes=self.arrays.hashes()
+        unique, first=numpy.unique(hashes, return_index=True)
+        duplicate=numpy.ones(self.size, dtype=bool)
+        duplicate[first]=False
+        return numpy.flatnonzero(duplicate)
 
     ####
 
@@ -141,22 +243,18 @@ class Population:
         '''
         pass
 
-    def isGenomeUnique(self):
+    def isGenomeUnique(self, index):
         '''
         * @brief Returns true if the given genome is unique.
         *        This is used during creation of the next generation to ensure that the
         *        same upgrade hypothesis doesn't get evaluated more than once
-        * @param population The population object
-        * @param genome The genome to be tested
-        * @param genome_index Index for the current number of next generation genomes
-        *                     which have been created thus far
-        * @param next_generation Use the next generation (1) or the current generation (0)
+        * @param index Array index of the genome
         * @returns True if the given genome is unique
         int genome_unique()
-
-        TODO Shouldn't this be in Genome? Check
         '''
-        pass
+
+        hashes=self.arrays.hashes()
+        return numpy.count_nonzero(hashes == hashes[index]) == 1
 
     def reproductionFunction(self):
         '''
@@ -186,87 +284,82 @@ class Population:
         * @returns zero on success
         int population_sort()
         '''
-        # Maybe there is some python way to sort a list based on the getScore function
-        for i in range(len(self.getGenomes())):
-            for j in range(len(self.getGenomes())-i):
-                if self.individual[i].getScore() < self.individual[i+j].getScore():
-                    tempgen=self.individual[i]
-                    self.individual[i] = self.individual[i+j]
-                    self.individual[i+j] = tempgen
+        # genomes are rows of the arrays, so reorder the rows
+        self.arrays.take(numpy.argsort(-self.arrays.score, kind='stable'))
+        for genome in self.individuals:
+            genome.createdSteps=genome.steps
+        return 0
 
-    def setTestPasses(self):
+    def setTestPasses(self, index, test_passes):
         '''
         * @brief Sets the evaluation score for a genome with the given array index
-        * @param population The population after individuals have been evaluated
         * @param index Array index of the genome for an individual
         * @param test_passes The number of test passes from evaluation
         * @returns zero on success
         */
         int population_set_test_passes()
-
-        TODO is this needed in python?
         '''
-        pass
+        if index < 0 or index >= self.size:
+            return -1
+        self.arrays.score[index]=test_passes
+        return 0
 
-    def getScore(self):
+    def getScore(self, index):
         '''
         * @brief Returns the evaluation score for a genome with the given array index
-        * @param population The population after individuals have been evaluated
         * @param index Array index of the genome for an individual
         * @returns Evaluation score (fitness)
         */
         float population_get_score()
         '''
-        pass
+        return float(self.arrays.score[index])
 
     def getAvgScore(self):
         '''
         * @brief Returns the average fitness score for the population
-        * @param population The population after individuals have been evaluated
         * @returns Average score
         */
         float population_average_score()
-
-        TODO Needed? Expect to just go something like self.score.mean()
         '''
-        pass
+        return float(self.arrays.score.mean())
 
     def getBestIndex(self):
         '''
         * @brief Returns the array index of the top scoring genome
-        * @param population The population after individuals have been evaluated
         * @returns Array index of the highest scoring genome, or -1 on failure
         int population_best_index()
         '''
-        pass
+        if self.size == 0:
+            return -1
+        return int(numpy.argmax(self.arrays.score))
+
     def getWorstIndex(self):
         '''
         * @brief Returns the array index of the lowest scoring genome
-        * @param population The population after individuals have been evaluated
         * @returns Array index of the lowest scoring genome, or -1 on failure
         int population_worst_index()
         '''
-        pass
+        if self.size == 0:
+            return -1
+        return int(numpy.argmin(self.arrays.score))
 
     def getMaxScore(self):
         '''
         * @brief Returns the best score for the given population
-        * @param population The population after individuals have been evaluated
         * @returns The best score within the population
         float population_best_score()
-
-        TODO See getAvgScore
         '''
-        pass
+        if self.size == 0:
+            return 0
+        return float(self.arrays.score.max())
 
     def getVariance(self):
         '''
         * @brief Returns the RMS variance of scores within the population
-        * @param population The population after individuals have been evaluated
         * @returns RMS score variance
         float population_variance()
         '''
-        pass
+        return float(self.arrays.score.std())
 
     def __clone__(self):
         '''
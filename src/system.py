@@ -33,6 +33,13 @@ except ImportError:
            "see: https://github.com/gitpython-developers/GitPython")
     sys.exit()
 
+try:
+    import numpy
+except ImportError:
+    print("Error: NumPy libary missing. For installation instructions "
+           "see: https://numpy.org/install")
+    sys.exit()
+
 class System:
     def __init__(self, repo_path=None, definitions=None, programs=None):
         '''
@@ -153,6 +160,55 @@ class System:
 
         return len(self.programs)
 
+    def getVersionIndexes(self):
+        '''
+        Gets the current version index of each program
+
+        @return int[] Array with one entry per program
+        '''
+
+        return numpy.array([p.getCurrentVersionIndex() for p in self.programs],
+                           dtype=numpy.int32)
+
+    def getNoOfVersions(self):
+        '''
+        Gets the number of versions of each program
+
+        @return int[] Array with one entry per program
+        '''
+
+        return numpy.array([p.getNoOfVersions() for p in self.programs],
+                           dtype=numpy.int32)
+
+    def getInstalled(self):
+        '''
+        Gets whether each program is installed
+
+        @return bool[] Array with one entry per program
+        '''
+
+        return numpy.array([p.installed for p in self.programs], dtype=bool)
+
+    def withState(self, versionIndexes, installed):
+        '''
+        Creates a copy of the system with the given version index and
+        install state for each program. Programs are shallow copies, so
+        their repos and lists of versions are shared.
+
+        @param versionIndexes (int[]) Version index of each program
+        @param installed (bool[]) Whether each program is installed
+        @return System
+        '''
+
+        programs=[]
+        for p, prog in enumerate(self.programs):
+            state=prog.clone()
+            state.versionIndex=int(versionIndexes[p])
+            state.installed=bool(installed[p])
+            programs.append(state)
+
+        return System(programs=programs)
+
     def dependencyMatrix(self):
         '''
         Create a dependency matrix for a system
@@ -264,13 +320,11 @@ class System:
         TODO Scoring strategy. Percentage progress towards the latest commits
         '''
 
-        sumscore=0
-        for prog in self.programs:
-            # Normalise here so that there isn't a strong bias towards
-            # any particular program within the system
-            sumscore+=prog.getCurrentVersionIndex() / prog.getNoOfVersions()
+        # Normalise here so that there isn't a strong bias towards
+        # any particular program within the system
+        progress=self.getVersionIndexes() / self.getNoOfVersions()
 
-        return sumscore * 100 / len(self.programs)
+        return progress.sum() * 100 / len(self.programs)
 
 
     def getMaxScore(self):
@@ -0,0 +1,87 @@
+'''
+  Smart search for upgrade paths
+  Copyright (C) 2016 Andrew Leeming <andrew.leeming@codethink.co.uk> and
+  Bob Mottram <bob.mottram@codethink.co.uk>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+'''
+import gc
+import sys
+import unittest
+
+sys.path.insert(0, "../c/python/")
+try:
+    import scalam_core
+except ImportError:
+    scalam_core = None
+
+@unittest.skipIf(scalam_core is None, "scalam_core not built, run make python within c")
+class TestCore(unittest.TestCase):
+    def test_system(self):
+        sys = scalam_core.System()
+        self.assertEqual(sys.add_program("gcc", 5, version_index=1, installed=True), 0)
+        self.assertEqual(sys.add_program("make", 3), 1)
+        self.assertEqual(sys.no_of_programs, 2)
+        self.assertEqual(sys.index("make"), 1)
+        self.assertEqual(sys.name(0), "gcc")
+        self.assertEqual(sys.no_of_versions.tolist(), [5, 3])
+        self.assertEqual(sys.version_index.tolist(), [1, 0])
+        self.assertEqual(sys.installed.tolist(), [1, 0])
+        self.assertRaises(KeyError, sys.index, "cmake")
+        self.assertRaises(ValueError, sys.add_program, "gcc", 2)
+
+    def test_population(self):
+        sys = scalam_core.System.synthetic(10, 1)
+        population = scalam_core.Population(sys, 8, seed=2)
+        self.assertEqual(population.size, 8)
+
+        scores = population.scores
+        self.assertTrue(scores.readonly)
+        for i in range(population.size):
+            population.set_test_passes(i, (i + 1) * 2)
+
+        # scores are a view, so follow the population without copying
+        self.assertEqual(scores.tolist(), population.scores.tolist())
+        values = scores.tolist()
+        self.assertEqual(values[population.best_index()], max(values))
+        self.assertEqual(values[population.worst_index()], min(values))
+        self.assertEqual(population.best_score(), max(scores.tolist()))
+
+        versions = population.versions
+        self.assertEqual(versions.shape, (8, scalam_core.MAX_CHANGE_SEQUENCE, 10))
+        self.assertEqual(population.installed.shape, versions.shape)
+        steps = population.steps.tolist()
+        for i in range(population.size):
+            for step in range(steps[i]):
+                for p in range(sys.no_of_programs):
+                    self.assertTrue(0 <= versions[i, step, p] < sys.no_of_versions[p])
+
+        self.assertEqual(population.distance(3, 3), 0)
+        self.assertEqual(population.hash(3), population.hash(3))
+
+        population.mutation_rate = 1.0
+        self.assertEqual(population.mutation_rate, 1.0)
+        self.assertRaises(ValueError, setattr, population, "crossover", 2.0)
+
+        population.next_generation()
+        self.assertEqual(population.evaluations, 8)
+
+        # views keep the population alive after it is released
+        del population
+        del sys
+        gc.collect()
+        self.assertEqual(len(versions.tolist()), 8)
+
+if __name__ == '__main__':
+    unittest.main()
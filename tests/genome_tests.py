@@ -16,6 +16,8 @@
   You should have received a copy of the GNU General Public License
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 '''
+import os
+import shutil
 import sys
 import tempfile
 import unittest
@@ -47,3 +49,60 @@ class TestGenome(unittest.TestCase):
         genome=Genome(systemStart, systemGoal, seed, steps=upgradeSteps)
         self.assertTrue(genome)
         self.assertTrue(genome.steps == upgradeSteps)
+
+    def test_crossover(self):
+        parent_dir=createTestRepos(3, 6)
+        systemStart=System(parent_dir)
+        systemStart.setLowestVersions()
+        systemGoal=systemStart.withState(systemStart.getNoOfVersions() - 1,
+                                         systemStart.getInstalled())
+
+        parent1=Genome.createRandom(systemStart, systemGoal, seed=12)
+        parent2=Genome.createRandom(systemStart, systemGoal, seed=34)
+        self.assertEqual(len(parent1.upgradeStep), parent1.steps)
+        self.assertEqual(parent1.versions.shape, (parent1.steps, 3))
+
+        # every step of the child comes from one parent or the other
+        child=Genome(systemStart, systemGoal, seed=56, parent1=parent1, parent2=parent2)
+        self.assertIn(child.steps, [parent1.steps, parent2.steps])
+        for step in range(child.steps):
+            fromParent1=step < parent1.steps and \
+                (child.versions[step] == parent1.versions[step]).all()
+            fromParent2=step < parent2.steps and \
+                (child.versions[step] == parent2.versions[step]).all()
+            self.assertTrue(fromParent1 or fromParent2)
+
+        self.assertTrue(child == child)
+        self.assertEqual(child.hash(), child.hash())
+
+        # mutation never goes beyond the latest version
+        for i in range(20):
+            child.mutate()
+        self.assertTrue((child.currentSystem.getVersionIndexes() <
+                         systemStart.getNoOfVersions()).all())
+        self.assertTrue(0 <= child.getScore() <= 100)
+
+        shutil.rmtree(parent_dir)
+
+def createTestRepos(no_of_programs, no_of_commits):
+    '''
+    Creates local git repos in which each commit changes a file,
+    so that no network access is needed
+
+    @param no_of_programs (int) Number of repos to create
+    @param no_of_commits (int) Number of commits within each repo
+    @return String Directory containing the repos
+    '''
+
+    parent_dir=tempfile.mkdtemp('.scalam')
+    for p in range(no_of_programs):
+        repo=git.Repo.init(os.path.join(parent_dir, "program%d"%p))
+        with repo.config_writer() as config:
+            config.set_value("user", "name", "scalam")
+            config.set_value("user", "email", "test@scalam")
+        for c in range(no_of_commits):
+            with open(os.path.join(repo.working_dir, "version"), "w") as f:
+                f.write("%d\n"%c)
+            repo.index.add(["version"])
+            repo.index.commit("version %d"%c)
+    return parent_dir
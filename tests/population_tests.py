@@ -0,0 +1,95 @@
+'''
+  Smart search for upgrade paths
+  Copyright (C) 2016 Andrew Leeming <andrew.leeming@codethink.co.uk> and
+  Bob Mottram <bob.mottram@codethink.co.uk>
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+'''
+import shutil
+import sys
+import unittest
+
+sys.path.insert(0, "../src/")
+from population import *
+from system import *
+from genome_tests import createTestRepos
+
+class TestPopulation(unittest.TestCase):
+    def setUp(self):
+        self.parent_dir=createTestRepos(4, 8)
+        self.sys=System(self.parent_dir)
+        self.sys.setLowestVersions()
+        self.goal=self.sys.withState(self.sys.getNoOfVersions() - 1,
+                                     self.sys.getInstalled())
+
+    def tearDown(self):
+        shutil.rmtree(self.parent_dir)
+
+    def test_create(self):
+        pop=Population(16, self.sys, self.goal, seed=123)
+        self.assertEqual(len(pop.getGenomes()), 16)
+        self.assertEqual(pop.arrays.versions.shape,
+                         (16, Genome.MAX_CHANGE_SEQUENCE, 4))
+
+        # genomes are views of the population arrays
+        genome=pop.getGenomes()[3]
+        self.assertEqual(genome.steps, pop.arrays.steps[3])
+        pop.setTestPasses(3, 42)
+        self.assertEqual(genome.score, 42)
+        self.assertEqual(pop.getBestIndex(), 3)
+        self.assertEqual(pop.getMaxScore(), 42)
+
+        # versions are between the start and the goal
+        versions=pop.arrays.versions
+        self.assertTrue((versions >= 0).all())
+        self.assertTrue((versions < self.sys.getNoOfVersions()).all())
+
+        # the same seed gives the same population
+        same=Population(16, self.sys, self.goal, seed=123)
+        self.assertTrue((same.arrays.hashes() == pop.arrays.hashes()).all())
+
+    def test_nextGeneration(self):
+        pop=Population(32, self.sys, self.goal, seed=7)
+        for generation in range(20):
+            pop=pop.nextGeneration()
+            self.assertEqual(pop.size, 32)
+            self.assertTrue((pop.scores >= 0).all())
+            self.assertTrue((pop.scores <= 100).all())
+            self.assertEqual(pop.getBestIndex(), int(pop.scores.argmax()))
+            self.assertAlmostEqual(pop.getAvgScore(), float(pop.scores.mean()))
+
+        # scores improve as programs are upgraded
+        self.assertTrue(pop.getMaxScore() > 0)
+
+        pop.sort()
+        self.assertTrue((pop.scores[:-1] >= pop.scores[1:]).all())
+
+    def test_unique(self):
+        pop=Population(8, self.sys, self.goal, seed=99)
+        arrays=pop.arrays
+        arrays.versions[1]=arrays.versions[0]
+        arrays.installed[1]=arrays.installed[0]
+        arrays.steps[1]=arrays.steps[0]
+        arrays.current[1]=arrays.current[0]
+        self.assertFalse(pop.isGenomeUnique(0))
+        self.assertEqual(list(pop._duplicates()), [1])
+
+        # steps beyond the end of a genome don't count
+        arrays.versions[1, arrays.steps[1]:]+=1
+        self.assertFalse(pop.isGenomeUnique(1))
+        arrays.current[1, 0]+=1
+        self.assertTrue(pop.isGenomeUnique(1))
+
+if __name__ == '__main__':
+    unittest.main()
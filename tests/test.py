@@ -4,6 +4,8 @@ import system_tests
 import util_tests
 import random_tests
 import genome_tests
+import population_tests
+import core_tests
 
 def run_tests():
     programTestSuite = unittest.TestLoader().loadTestsFromTestCase(program_tests.TestProgram)
@@ -11,12 +13,16 @@ def run_tests():
     systemTestSuite = unittest.TestLoader().loadTestsFromTestCase(system_tests.TestSystem)
     randomTestSuite = unittest.TestLoader().loadTestsFromTestCase(random_tests.TestRandom)
     genomeTestSuite = unittest.TestLoader().loadTestsFromTestCase(genome_tests.TestGenome)
+    populationTestSuite = unittest.TestLoader().loadTestsFromTestCase(population_tests.TestPopulation)
+    coreTestSuite = unittest.TestLoader().loadTestsFromTestCase(core_tests.TestCore)
 
     unittest.TextTestRunner(verbosity=2).run(programTestSuite)
     unittest.TextTestRunner(verbosity=2).run(utilTestSuite)
     unittest.TextTestRunner(verbosity=2).run(systemTestSuite)
     unittest.TextTestRunner(verbosity=2).run(randomTestSuite)
     unittest.TextTestRunner(verbosity=2).run(genomeTestSuite)
+    unittest.TextTestRunner(verbosity=2).run(populationTestSuite)
+    unittest.TextTestRunner(verbosity=2).run(coreTestSuite)
 
 if __name__ == '__main__':
     run_tests()
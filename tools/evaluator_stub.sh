@@ -0,0 +1,69 @@
+#!/bin/sh
+#
+#  Smart search for upgrade paths
+#  Copyright (C) 2016 Andrew Leeming <andrew.leeming@codethink.co.uk> and
+#                     Bob Mottram <bob.mottram@codethink.co.uk>
+#
+#  This program is free software: you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation, either version 3 of the License, or
+#  (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Stand-in for a real build system, for use as the scalam evaluator
+# command. Nothing is actually built. It is called as:
+#
+#   evaluator_stub.sh stage program version source_dir install_prefix
+#
+# Environment variables:
+#   SCALAM_STUB_FAIL   Space separated list of program, program@version
+#                      or program@version:stage which should fail
+#   SCALAM_STUB_TESTS  Number of tests which each program has (default 10)
+#   SCALAM_STUB_DELAY  Seconds to sleep for each stage (default 0)
+
+STAGE=$1
+PROGRAM=$2
+VERSION=$3
+SOURCE_DIR=$4
+INSTALL_PREFIX=$5
+
+if [ -n "$SCALAM_STUB_DELAY" ]; then
+    sleep "$SCALAM_STUB_DELAY"
+fi
+
+for failure in $SCALAM_STUB_FAIL; do
+    if [ "$failure" = "$PROGRAM" ] || \
+       [ "$failure" = "$PROGRAM@$VERSION" ] || \
+       [ "$failure" = "$PROGRAM@$VERSION:$STAGE" ]; then
+        echo "$STAGE failed for $PROGRAM $VERSION" >&2
+        exit 1
+    fi
+done
+
+case "$STAGE" in
+    configure)
+        ;;
+    build)
+        if [ -n "$INSTALL_PREFIX" ]; then
+            mkdir -p "$INSTALL_PREFIX" && \
+                echo "$VERSION" > "$INSTALL_PREFIX/$PROGRAM"
+        fi
+        ;;
+    test)
+        # passes and failures
+        echo "${SCALAM_STUB_TESTS:-10} 0"
+        ;;
+    *)
+        echo "Unknown stage $STAGE" >&2
+        exit 2
+        ;;
+esac
+
+exit 0
@@ -20,13 +20,19 @@
 import pandas as pd
 import numpy as np
 import random
+import sys
 import seaborn as sns
 
 import matplotlib.pyplot as plt
 import matplotlib.ticker as ticker
 
 
-df=pd.DataFrame.from_csv('dataframe.csv', index_col=None);
+# the dataframe to plot can be given as an argument
+filename='dataframe.csv'
+if len(sys.argv) > 1:
+    filename=sys.argv[1]
+
+df=pd.DataFrame.from_csv(filename, index_col=None);
 
 sns.set_style("whitegrid")
 